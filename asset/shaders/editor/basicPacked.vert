@@ -0,0 +1,29 @@
+#version 450
+
+#include "../renderer/packed.glsl"
+
+layout(location = 0) in vec4 a_position; // unorm16 within quantization box
+layout(location = 1) in vec2 a_normal; // unorm16 octahedral
+
+layout(location = 0) out vec3 v_normal;
+layout(location = 1) out vec3 v_forward;
+layout(location = 2) out vec3 v_color;
+
+layout(binding = 0, std140) uniform CameraUniformBuffer
+{
+	mat4 u_mvp;
+};
+layout(binding = 1, std140) uniform QuantizationUniformBuffer
+{
+	vec4 u_quantizationOffset; // Min of the quantized bounds
+	vec4 u_quantizationScale; // Extent of the quantized bounds divided by 65535
+};
+
+void main()
+{
+	vec3 position = u_quantizationOffset.xyz + a_position.xyz * u_quantizationScale.xyz;
+	gl_Position = u_mvp * vec4(position, 1.0);
+	v_normal = decodeOctahedral(a_normal);
+	v_forward = mat3(u_mvp) * vec3(0, 0, -1);
+	v_color = vec3(1.0);
+}
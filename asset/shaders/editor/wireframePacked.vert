@@ -0,0 +1,19 @@
+#version 450
+
+layout (location = 0) in vec4 a_position; // unorm16 within quantization box
+
+layout(binding = 0, std140) uniform ModelUniformBuffer {
+	mat4 u_mvp;
+};
+layout(binding = 1, std140) uniform QuantizationUniformBuffer {
+	vec4 u_quantizationOffset; // Min of the quantized bounds
+	vec4 u_quantizationScale; // Extent of the quantized bounds divided by 65535
+};
+
+layout (location = 0) out vec4 v_color;
+
+void main(void) {
+	vec3 position = u_quantizationOffset.xyz + a_position.xyz * u_quantizationScale.xyz;
+	gl_Position = u_mvp * vec4(position, 1.0);
+	v_color = vec4(1.0);
+}
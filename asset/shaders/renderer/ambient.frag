@@ -1,5 +1,9 @@
 #version 450
 
+#include "brdf.glsl"
+
+const int SH_COUNT = 9;
+
 layout(location = 0) out vec4 o_color;
 
 layout(location = 0) in vec2 v_uv;
@@ -7,8 +11,9 @@ layout(location = 0) in vec2 v_uv;
 layout(binding = 0) uniform sampler2D u_positionTexture;
 layout(binding = 1) uniform sampler2D u_albedoTexture;
 layout(binding = 2) uniform sampler2D u_normalTexture;
-//layout(binding = 3) uniform sampler2D u_materialTexture;
-layout(binding = 3) uniform samplerCube u_skyboxTexture;
+layout(binding = 3) uniform sampler2D u_materialTexture;
+layout(binding = 4) uniform sampler2D u_prefilteredTexture; // Equirectangular, roughness along mips
+layout(binding = 5) uniform sampler2D u_brdfTexture; // Split sum scale & bias
 
 layout(std140, binding = 0) uniform CameraUniformBuffer {
 	mat4 u_view;
@@ -17,24 +22,61 @@ layout(std140, binding = 0) uniform CameraUniformBuffer {
 	mat4 u_projectionInverse;
 };
 
+layout(std140, binding = 1) uniform EnvironmentUniformBuffer {
+	vec4 u_irradiance[SH_COUNT]; // SH9 irradiance, divided by pi
+	float u_prefilteredLevel; // Level of roughness 1
+};
+
+vec2 equirectangular(vec3 direction)
+{
+	return vec2(atan(direction.z, direction.x) / (2.0 * PI) + 0.5, asin(clamp(direction.y, -1.0, 1.0)) / PI + 0.5);
+}
+
+vec3 irradiance(vec3 n)
+{
+	vec3 color = u_irradiance[0].rgb * 0.282095;
+	color += u_irradiance[1].rgb * 0.488603 * n.y;
+	color += u_irradiance[2].rgb * 0.488603 * n.z;
+	color += u_irradiance[3].rgb * 0.488603 * n.x;
+	color += u_irradiance[4].rgb * 1.092548 * n.x * n.y;
+	color += u_irradiance[5].rgb * 1.092548 * n.y * n.z;
+	color += u_irradiance[6].rgb * 0.315392 * (3.0 * n.z * n.z - 1.0);
+	color += u_irradiance[7].rgb * 1.092548 * n.x * n.z;
+	color += u_irradiance[8].rgb * 0.546274 * (n.x * n.x - n.y * n.y);
+	return max(color, vec3(0.0));
+}
+
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness)
+{
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(max(1.0 - cosTheta, 0.0), 5.0);
+}
+
 void main(void)
 {
 	vec3 position = texture(u_positionTexture, v_uv).rgb;
 	vec3 normal   = texture(u_normalTexture, v_uv).rgb;
 	vec3 albedo   = pow(texture(u_albedoTexture, v_uv).rgb, vec3(2.2)); // To Linear space
-	//vec3 material = texture(u_materialTexture, v_uv).rgb; // AO / roughness / metalness
-	//float ao = material.r;
+	vec3 material = texture(u_materialTexture, v_uv).rgb; // AO / roughness / metalness
+	float ao = material.r;
+	float roughness = material.g;
+	float metalness = material.b;
 
 	vec3 N = normalize(normal);
 	vec3 V = normalize(vec3(u_viewInverse[3]) - position);
-	vec3 I = -V;
+	vec3 R = reflect(-V, N);
+	float NdotV = max(dot(N, V), 0.0);
+
+	vec3 F0 = mix(vec3(0.04), albedo, vec3(metalness));
+	vec3 F  = fresnelSchlickRoughness(NdotV, F0, roughness);
+	vec3 kD = (vec3(1.0) - F) * (1.0 - metalness);
 
-	// Reflection
-	vec3 reflection = texture(u_skyboxTexture, reflect(I, N)).rgb;
+	// Split sum approximation, mips are sampled explicitly as equirectangular derivatives break on the seam
+	vec3 prefiltered = textureLod(u_prefilteredTexture, equirectangular(R), roughness * u_prefilteredLevel).rgb;
+	vec2 brdf = texture(u_brdfTexture, vec2(NdotV, roughness)).rg;
 
-	// Basic ambient shading
-	vec3 indirect = 0.03 * albedo; // ao broken for some
-	vec3 color = indirect + reflection * 0.01; // TODO use irradiance map
+	vec3 diffuse  = kD * albedo * irradiance(N);
+	vec3 specular = prefiltered * (F * brdf.x + brdf.y);
+	vec3 color = (diffuse + specular) * ao;
 
 	o_color = vec4(color, 1.0);
 }
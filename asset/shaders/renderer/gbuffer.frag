@@ -38,8 +38,9 @@ void main(void)
 	b = b - n * dot( b, n ); // orthonormalization of the binormal vectors to the normal vector
 	b = b - t * dot( b, t ); // orthonormalization of the binormal vectors to the tangent vector
 	mat3 tbn = mat3(t, b, n);
-	vec3 normal = texture(u_normalTexture, v_uv).rgb;
-	normal = normal * 2.0 - 1.0;
+	// Normal maps might be stored as RG, rebuild z.
+	vec2 xy = texture(u_normalTexture, v_uv).rg * 2.0 - 1.0;
+	vec3 normal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
 	normal = normalize(tbn * normal);
 
 	// --- Generate depth
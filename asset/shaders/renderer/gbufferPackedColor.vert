@@ -0,0 +1,44 @@
+#version 450
+
+#include "packed.glsl"
+
+layout (location = 0) in vec4 a_position; // unorm16 within quantization box
+layout (location = 1) in vec2 a_normal; // unorm16 octahedral
+layout (location = 2) in vec2 a_uv; // half
+layout (location = 3) in vec4 a_color; // unorm8
+layout (location = 4) in vec2 a_tangent; // packed tangent
+
+layout(std140, binding = 0) uniform ModelUniformBuffer {
+	mat4 u_model;
+	mat3 u_normalMatrix;
+	vec4 u_color;
+};
+layout(std140, binding = 1) uniform CameraUniformBuffer {
+	mat4 u_view;
+	mat4 u_projection;
+	mat4 u_viewInverse;
+	mat4 u_projectionInverse;
+};
+layout(std140, binding = 2) uniform QuantizationUniformBuffer {
+	vec4 u_quantizationOffset; // Min of the quantized bounds
+	vec4 u_quantizationScale; // Extent of the quantized bounds divided by 65535
+};
+
+layout (location = 0) out vec3 v_position; // world space
+layout (location = 1) out vec3 v_normal; // world space
+layout (location = 2) out vec2 v_uv; // texture space
+layout (location = 3) out vec4 v_color;
+layout (location = 4) out vec4 v_tangent; // world space, bitangent sign in w
+
+void main(void)
+{
+	vec3 position = u_quantizationOffset.xyz + a_position.xyz * u_quantizationScale.xyz;
+	gl_Position = u_projection * u_view * u_model * vec4(position, 1.0);
+
+	v_position = vec3(u_model * vec4(position, 1.0));
+	v_normal = normalize(u_normalMatrix * decodeOctahedral(a_normal));
+	vec4 tangent = decodeTangent(a_tangent);
+	v_tangent = transformTangent(mat3(u_model), tangent, v_normal);
+	v_uv = decodeHalf2(a_uv);
+	v_color = u_color * (a_color / 255.0);
+}
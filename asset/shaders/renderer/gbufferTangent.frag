@@ -0,0 +1,44 @@
+#version 450
+
+layout (location = 0) out vec3 o_position;
+layout (location = 1) out vec4 o_albedo;
+layout (location = 2) out vec3 o_normal;
+layout (location = 3) out vec3 o_roughness;
+
+layout (location = 0) in vec3 v_position;
+layout (location = 1) in vec3 v_normal;
+layout (location = 2) in vec2 v_uv;
+layout (location = 3) in vec4 v_color;
+layout (location = 4) in vec4 v_tangent;
+
+layout (binding = 0) uniform sampler2D u_colorTexture;
+layout (binding = 1) uniform sampler2D u_normalTexture;
+layout (binding = 2) uniform sampler2D u_materialTexture;
+
+void main(void)
+{
+	// --- Generate albedo
+	vec4 albedo = v_color * texture(u_colorTexture, v_uv);
+
+	// --- Generate normals
+	// Tangent frame generated at import with a sign for handedness,
+	// interpolated vectors are used unnormalized and bitangent is rebuilt per fragment.
+	vec3 b = v_tangent.w * cross(v_normal, v_tangent.xyz);
+	// Normal maps might be stored as RG, rebuild z.
+	vec2 xy = texture(u_normalTexture, v_uv).rg * 2.0 - 1.0;
+	vec3 normal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
+	normal = normalize(normal.x * v_tangent.xyz + normal.y * b + normal.z * v_normal);
+
+	// --- Generate depth
+	//gl_FragDepth = gl_FragCoord.z;
+
+	// --- Alpha
+	if (bool(albedo.a < 0.8)) { // TODO use threshold
+		discard;
+	}
+
+	o_position = v_position;
+	o_normal = normal;
+	o_albedo = albedo;
+	o_roughness = texture(u_materialTexture, v_uv).rgb;
+}
@@ -0,0 +1,41 @@
+// Decoding of packed vertex attributes.
+// Attributes are fetched as raw unsigned integer values converted to float.
+
+// Octahedral direction in [-1, 1]
+vec3 decodeOctahedralSnorm(vec2 f)
+{
+	vec3 n = vec3(f.x, f.y, 1.0 - abs(f.x) - abs(f.y));
+	float t = max(-n.z, 0.0);
+	n.x += (n.x >= 0.0) ? -t : t;
+	n.y += (n.y >= 0.0) ? -t : t;
+	return normalize(n);
+}
+
+// Octahedral normal stored as unorm16
+vec3 decodeOctahedral(vec2 packed)
+{
+	return decodeOctahedralSnorm(packed / 65535.0 * 2.0 - 1.0);
+}
+
+// Octahedral tangent stored as unorm16 & unorm15, with bitangent sign in lowest bit
+vec4 decodeTangent(vec2 packed)
+{
+	uint y = uint(packed.y);
+	vec2 f = vec2(packed.x / 65535.0, float(y >> 1) / 32767.0) * 2.0 - 1.0;
+	return vec4(decodeOctahedralSnorm(f), ((y & 1u) != 0u) ? -1.0 : 1.0);
+}
+
+// Two half floats stored as raw 16 bits
+vec2 decodeHalf2(vec2 bits)
+{
+	return unpackHalf2x16(uint(bits.x) | (uint(bits.y) << 16));
+}
+
+// Tangent frame to world space. Tangents follow the surface, they are transformed by the model matrix
+// & orthogonalized against the world normal. Mirroring transforms flip the bitangent sign.
+vec4 transformTangent(mat3 model, vec4 tangent, vec3 normal)
+{
+	vec3 t = model * tangent.xyz;
+	t = normalize(t - normal * dot(normal, t));
+	return vec4(t, (determinant(model) < 0.0) ? -tangent.w : tangent.w);
+}
@@ -0,0 +1,14 @@
+#version 450 core
+
+layout(location = 0) in vec3 a_position;
+
+layout(std140, binding = 0) uniform LightInstanceUniformBuffer {
+	mat4 u_models[128]; // InstancedComponent::batchSize
+};
+layout(std140, binding = 1) uniform DirectionalLightUniformBuffer {
+	mat4 u_light;
+};
+
+void main() {
+	gl_Position = u_light * u_models[gl_InstanceID] * vec4(a_position, 1.0);
+}
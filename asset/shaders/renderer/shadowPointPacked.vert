@@ -0,0 +1,25 @@
+#version 450 core
+
+layout(location = 0) in vec4 a_position; // unorm16 within quantization box
+layout(location = 0) out vec4 v_position;
+
+layout(std140, binding = 0) uniform PointLightUniformBuffer {
+	mat4 u_light;
+	vec3 u_lightPos;
+	float u_far;
+};
+
+layout(std140, binding = 1) uniform LightModelUniformBuffer {
+	mat4 u_model;
+};
+layout(std140, binding = 2) uniform QuantizationUniformBuffer {
+	vec4 u_quantizationOffset; // Min of the quantized bounds
+	vec4 u_quantizationScale; // Extent of the quantized bounds divided by 65535
+};
+
+void main()
+{
+	vec3 position = u_quantizationOffset.xyz + a_position.xyz * u_quantizationScale.xyz;
+	v_position = u_model * vec4(position, 1.0);
+	gl_Position = u_light * v_position;
+}
@@ -43,9 +43,10 @@ void Editor::onCreate(int argc, char* argv[])
 		editor->onCreate(m_world);
 
 	// --- Model
-	ResourceManager* resource = Application::resource();
-	resource->parse("library/library.json");
-	Scene::load(m_world, "library/scene.json");
+	// Library files referenced by the scene are loaded concurrently with the scene,
+	// the rest of the library is loaded on demand from the asset editor.
+	// Binary scene is read unless the JSON one was written after it.
+	Scene::load(m_world, Scene::getStartupPath());
 	//Importer::importScene("asset/glTF-Sample-Models/2.0/Lantern/glTF/Lantern.glTF", m_world);
 
 	// --- Lights
@@ -2,6 +2,8 @@
 
 #include "../Model/Model.h"
 #include "../Model/Importer.h"
+#include "../Model/AssetPack.h"
+#include "../Model/LibraryLoader.h"
 
 #include <imgui.h>
 
@@ -99,12 +101,28 @@ void AssetEditor::onRender(aka::World& world)
 			{
 				if (ImGui::MenuItem("Load"))
 				{
-					resources->parse("library/library.json");
+					// Assets baked by AkaImport are not in the library manifest until it is saved.
+					ImportCache cache("library/import.json");
+					cache.load();
+					LibraryLoader loader;
+					loader.index("library/library.json");
+					loader.index(cache);
+					loader.load();
 				}
 				if (ImGui::MenuItem("Save"))
 				{
 					resources->serialize("library/library.json");
 				}
+				if (ImGui::MenuItem("Pack"))
+				{
+					if (!AssetPack::build("library/library.pack"))
+						aka::Logger::error("Failed to build library pack");
+				}
+				if (ImGui::MenuItem("Pack compressed"))
+				{
+					if (!AssetPack::build("library/library.pack", Codec::LZ4))
+						aka::Logger::error("Failed to build library pack");
+				}
 				ImGui::EndMenu();
 			}
 			if (ImGui::BeginMenu("Import"))
@@ -135,13 +153,20 @@ void AssetEditor::onRender(aka::World& world)
 						return Importer::importTexture2D(OS::File::basename(path), path, TextureFlag::ShaderResource);
 					});
 				}
+				if (ImGui::MenuItem("Texture2D compressed"))
+				{
+					openImportWindow = true;
+					import([&](const aka::Path& path) -> bool {
+						aka::Logger::info("Image : ", path);
+						return Importer::importTexture2D(OS::File::basename(path), path, TextureFlag::ShaderResource, true);
+					});
+				}
 				if (ImGui::MenuItem("Cubemap"))
 				{
 					openImportWindow = true;
 					import([&](const aka::Path& path) -> bool{
 						aka::Logger::info("Image : ", path);
-						//return Importer::importTextureCubemap(File::basename(path), path);
-						return false;
+						return Importer::importTextureEquirectangular(OS::File::basename(path), path, 1024, TextureFlag::ShaderResource | TextureFlag::GenerateMips);
 					});
 				}
 				if (ImGui::MenuItem("Audio"))
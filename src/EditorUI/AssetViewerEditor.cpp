@@ -1,4 +1,6 @@
 #include "AssetViewerEditor.h"
+#include "../Model/LibraryLoader.h"
+#include "../Model/Model.h"
 
 #include <Aka/Aka.h>
 
@@ -251,6 +253,12 @@ void BufferViewerEditor::draw(const String& name, Resource<Buffer>& resource)
 	ImGui::TextColored(color, name.cstr());
 
 	Buffer::Ptr buffer = resource.resource;
+	if (buffer == nullptr)
+	{
+		// Buffers of batched meshes are released, their library file is kept.
+		ImGui::TextDisabled("Released, meshes draw from batch buffers");
+		return;
+	}
 	ImGui::Text("Type : %s", toString(buffer->type()));
 	ImGui::Text("Usage : %s", toString(buffer->usage()));
 	ImGui::Text("Access : %s", toString(buffer->access()));
@@ -272,6 +280,10 @@ void MeshViewerEditor::onCreate(World& world)
 	m_material = Material::create(p);
 	m_uniform = Buffer::create(BufferType::Uniform, sizeof(mat4f), BufferUsage::Default, BufferCPUAccess::None);
 	m_material->set("CameraUniformBuffer", m_uniform);
+	m_packedMaterial = Material::create(program->get("editor.basicPacked"));
+	m_packedUniform = Buffer::create(BufferType::Uniform, sizeof(mat4f), BufferUsage::Default, BufferCPUAccess::None);
+	m_packedMaterial->set("CameraUniformBuffer", m_packedUniform);
+	m_world = &world;
 	m_arcball.set(aabbox<>(point3f(-20.f), point3f(20.f)));
 	m_projection = mat4f::perspective(anglef::degree(90.f), m_width / (float)m_height, 0.1f, 100.f);
 }
@@ -297,17 +309,60 @@ void MeshViewerEditor::drawMesh(const Mesh::Ptr& mesh)
 	pass.submesh.count = mesh->isIndexed() ? mesh->getIndexCount() : mesh->getVertexCount(0);
 	pass.submesh.offset = 0;
 	pass.submesh.type = PrimitiveType::Triangles;
-	pass.material = m_material;
 	pass.depth = Depth{ DepthCompare::LessOrEqual, true };
 	pass.clear = Clear{ ClearMask::Depth | ClearMask::Color, color4f(0.f), 1.f, 1 };
 	mat4f mvp = m_projection * m_arcball.view();
-	m_uniform->upload(&mvp);
+	VertexLayout layout = Scene::getVertexLayout(mesh);
+	if (layout == VertexLayout::Packed || layout == VertexLayout::PackedColor)
+	{
+		Buffer::Ptr quantization = getQuantization(mesh);
+		if (quantization == nullptr)
+			return;
+		m_packedUniform->upload(&mvp);
+		pass.material = m_packedMaterial;
+		pass.material->set("QuantizationUniformBuffer", quantization);
+	}
+	else
+	{
+		m_uniform->upload(&mvp);
+		pass.material = m_material;
+	}
 	pass.execute();
 }
 
+Buffer::Ptr MeshViewerEditor::getQuantization(const Mesh::Ptr& mesh) const
+{
+	// LODs & position only streams share the vertices, hence the quantization, of their base mesh.
+	Buffer::Ptr quantization;
+	if (m_world != nullptr)
+	{
+		m_world->registry().view<MeshComponent>().each([&](const MeshComponent& component) {
+			if (component.submesh.mesh == mesh || component.depth.mesh == mesh)
+				quantization = component.quantization;
+			for (uint32_t lod = 0; lod < component.lodCount; lod++)
+				if (component.lods[lod].mesh == mesh || component.depthLods[lod].mesh == mesh)
+					quantization = component.quantization;
+		});
+	}
+	if (quantization != nullptr)
+		return quantization;
+	// Base meshes no entity draws
+	ResourceManager* resource = Application::resource();
+	String name = Scene::getQuantizationName(resource->name<Mesh>(mesh));
+	return resource->has<Buffer>(name) ? resource->get<Buffer>(name) : nullptr;
+}
+
+// Shared buffers of batched meshes are not resources
+static String getBufferName(const Buffer::Ptr& buffer)
+{
+	for (auto& element : Application::resource()->allocator<Buffer>())
+		if (element.second.resource == buffer)
+			return element.first;
+	return "batch";
+}
+
 void MeshViewerEditor::draw(const String& name, Resource<Mesh>& resource)
 {
-	ResourceManager* resources = Application::resource();
 	static const ImVec4 color = ImVec4(0.93f, 0.04f, 0.26f, 1.f);
 	ImGui::TextColored(color, name.cstr());
 	Mesh::Ptr mesh = resource.resource;
@@ -324,7 +379,7 @@ void MeshViewerEditor::draw(const String& name, Resource<Mesh>& resource)
 			ImGui::BulletText("Type : %s", toString(mesh->getVertexAttribute(i).type));
 			ImGui::BulletText("Count : %u", mesh->getVertexCount(i));
 			ImGui::BulletText("Offset : %u", mesh->getVertexOffset(i));
-			ImGui::BulletText("Buffer : %s", resources->name<Buffer>(mesh->getVertexBuffer(i).buffer).cstr());
+			ImGui::BulletText("Buffer : %s", getBufferName(mesh->getVertexBuffer(i).buffer).cstr());
 			ImGui::TreePop();
 		}
 	}
@@ -332,7 +387,7 @@ void MeshViewerEditor::draw(const String& name, Resource<Mesh>& resource)
 	ImGui::Text("Indices");
 	ImGui::BulletText("Format : %s", toString(mesh->getIndexFormat()));
 	ImGui::BulletText("Count : %u", mesh->getIndexCount());
-	ImGui::BulletText("Buffer : %s", resources->name<Buffer>(mesh->getIndexBuffer().buffer).cstr());
+	ImGui::BulletText("Buffer : %s", getBufferName(mesh->getIndexBuffer().buffer).cstr());
 	ImGui::Separator();
 
 	// Mesh viewer
@@ -352,6 +407,12 @@ void MeshViewerEditor::draw(const String& name, Resource<Mesh>& resource)
 	ImGui::PopStyleVar();
 }
 
+Resource<Texture> TextureViewerEditor::reload(const Path& path)
+{
+	// Stored levels are uploaded instead of being generated from the base level.
+	return LibraryLoader::loadTexture(path);
+}
+
 void TextureViewerEditor::draw(const String& name, Resource<Texture>& resource)
 {
 	static const ImVec4 color = ImVec4(0.93f, 0.04f, 0.26f, 1.f);
@@ -492,7 +553,8 @@ FontViewerEditor::FontViewerEditor() :
 }
 
 MeshViewerEditor::MeshViewerEditor() :
-	AssetViewerEditor("Mesh")
+	AssetViewerEditor("Mesh"),
+	m_world(nullptr)
 {
 }
 
@@ -24,6 +24,8 @@ public:
 protected:
 	virtual void draw(const aka::String& name, aka::Resource<T>& resource) = 0;
 	virtual void onResourceChange() {}
+	// Load the resource again from its library file
+	virtual aka::Resource<T> reload(const aka::Path& path) { return aka::Resource<T>::load(path); }
 protected:
 	const char* m_type;
 	bool m_opened;
@@ -50,14 +52,19 @@ protected:
 	void draw(const aka::String& name, aka::Resource<aka::Mesh>& resource) override;
 	void onResourceChange() override;
 	void drawMesh(const aka::Mesh::Ptr& mesh);
+	// Quantization of packed positions, from a mesh component using the mesh or stored with it, null if none
+	aka::Buffer::Ptr getQuantization(const aka::Mesh::Ptr& mesh) const;
 private:
 	const uint32_t m_width = 512;
 	const uint32_t m_height = 512;
+	aka::World* m_world;
 	aka::mat4f m_projection;
 	aka::Texture2D::Ptr m_renderTarget;
 	aka::Framebuffer::Ptr m_target;
 	aka::Material::Ptr m_material;
 	aka::Buffer::Ptr m_uniform;
+	aka::Material::Ptr m_packedMaterial;
+	aka::Buffer::Ptr m_packedUniform;
 	aka::CameraArcball m_arcball;
 };
 class BufferViewerEditor : public AssetViewerEditor<aka::Buffer>
@@ -74,6 +81,7 @@ public:
 	TextureViewerEditor();
 protected:
 	void draw(const aka::String& name, aka::Resource<aka::Texture>& resource) override;
+	aka::Resource<aka::Texture> reload(const aka::Path& path) override;
 };
 
 class AudioViewerEditor : public AssetViewerEditor<aka::AudioStream>
@@ -114,7 +122,7 @@ inline void AssetViewerEditor<T>::onRender(aka::World& world)
 					}
 					if (ImGui::MenuItem("Reload"))
 					{
-						auto res = aka::Resource<T>::load(m_resource.path);
+						auto res = reload(m_resource.path);
 						if (res.resource == nullptr)
 							aka::Logger::error("Failed to load resource ", m_name);
 						else
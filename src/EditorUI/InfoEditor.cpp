@@ -1,5 +1,7 @@
 #include "InfoEditor.h"
 
+#include "../Model/Model.h"
+#include "../System/ShadowMapSystem.h"
 
 #include <imgui.h>
 
@@ -23,6 +25,24 @@ void InfoEditor::onRender(aka::World& world)
 		//ImGui::Text("Vertices : %zu", m_batch.verticesCount());
 		//ImGui::Text("Indices : %zu", m_batch.indicesCount());
 		ImGui::Separator();
+		// Shadow maps are only rendered when a light is dirty, these are the counts of the last update.
+		const ShadowPassStats& shadow = ShadowMapSystem::stats();
+		ImGui::Text("Shadow lights : %u", shadow.lightCount);
+		ImGui::Text("Shadow draw call : %u", shadow.drawCount);
+		ImGui::Text("Shadow triangles : %zu", shadow.triangleCount);
+		ImGui::Text("Shadow vertex fetch : %.2f MB", shadow.vertexBytes / (1024.f * 1024.f));
+		ImGui::Text("Shadow CPU : %zu ms", shadow.cpuTime);
+		if (ImGui::Checkbox("Shadow depth streams", &ShadowMapSystem::depthStreams))
+		{
+			// Render shadow maps again to measure the other layout
+			for (entt::entity e : world.registry().view<PointLightComponent>())
+				if (!world.registry().has<DirtyLightComponent>(e))
+					world.registry().emplace<DirtyLightComponent>(e);
+			for (entt::entity e : world.registry().view<DirectionalLightComponent>())
+				if (!world.registry().has<DirtyLightComponent>(e))
+					world.registry().emplace<DirtyLightComponent>(e);
+		}
+		ImGui::Separator();
 		const char* apiName[] = {
 			"None",
 			"OpenGL",
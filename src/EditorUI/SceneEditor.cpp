@@ -4,12 +4,51 @@
 #include <imguizmo.h>
 
 #include "../Model/Model.h"
+#include "../Model/MappedFile.h"
 #include "AssetViewerEditor.h"
 
 #include <Aka/Aka.h>
 
+#include <cstdio>
+
 namespace app {
 
+// Save the world in both scene formats and time loading each of them in an empty world.
+// Static meshes are not batched so that only parsing & component creation are measured.
+static void benchmarkSceneFormats(const World& world)
+{
+	const uint32_t iterations = 5;
+	struct Format {
+		const char* name;
+		Path path;
+		bool(*save)(const Path&, const World&);
+		bool(*load)(World&, const Path&);
+	};
+	for (const Format& format : { Format{ "JSON", "library/benchmark.json", &Scene::saveJSON, &Scene::loadJSON }, Format{ "Binary", "library/benchmark.bin", &Scene::saveBinary, &Scene::loadBinary } })
+	{
+		Time start = Time::now();
+		if (!format.save(format.path, world))
+			continue;
+		Time save = Time::now() - start;
+		uint64_t load = 0;
+		for (uint32_t i = 0; i < iterations; i++)
+		{
+			World loaded;
+			start = Time::now();
+			format.load(loaded, format.path);
+			load += (Time::now() - start).milliseconds();
+		}
+		size_t size = 0;
+		{
+			MappedFile file;
+			if (file.open(format.path))
+				size = file.size();
+		}
+		std::remove(format.path.cstr());
+		Logger::info(format.name, " scene : ", size / 1024, "KB, save ", save.milliseconds(), "ms, load ", load / (float)iterations, "ms");
+	}
+}
+
 void TextureDisplay(const String& name, Texture::Ptr texture, const ImVec2& size)
 {
 	// TODO open a window on click for a complete texture inspector ?
@@ -79,6 +118,8 @@ struct ComponentNode {
 	static const char* name() { return "Unknown"; }
 	//static const char* icon() { return ""; }
 	static bool draw(T& component) { Logger::error("Trying to draw an undefined component"); return false; }
+	// Components referencing world data, such as the material table, specialize this one instead.
+	static bool draw(World& world, T& component) { return draw(component); }
 };
 
 template <> const char* ComponentNode<TagComponent>::name() { return "Tag"; }
@@ -265,6 +306,9 @@ template <> bool ComponentNode<MeshComponent>::draw(MeshComponent& mesh)
 		ImGui::Text("Primitive : %s", type.cstr());
 		ImGui::Text("Bounds min : (%f, %f, %f)", mesh.bounds.min.x, mesh.bounds.min.y, mesh.bounds.min.z);
 		ImGui::Text("Bounds max : (%f, %f, %f)", mesh.bounds.max.x, mesh.bounds.max.y, mesh.bounds.max.z);
+		ImGui::Text("LOD count : %u", mesh.lodCount);
+		for (uint32_t i = 0; i < mesh.lodCount; i++)
+			ImGui::BulletText("LOD %u index count : %u", i + 1, mesh.lods[i].count);
 	}
 	else
 	{
@@ -274,9 +318,28 @@ template <> bool ComponentNode<MeshComponent>::draw(MeshComponent& mesh)
 }
 
 template <> const char* ComponentNode<MaterialComponent>::name() { return "Material"; }
-template <> bool ComponentNode<MaterialComponent>::draw(MaterialComponent& material) 
+template <> bool ComponentNode<MaterialComponent>::draw(World& world, MaterialComponent& component)
 {
 	bool updated = false;
+	MaterialTable& materials = Scene::getMaterials(world);
+	if (ImGui::BeginCombo("Asset", materials.valid(component.material) ? materials.get(component.material).name.cstr() : "None"))
+	{
+		for (MaterialHandle handle = 0; handle < materials.size(); handle++)
+		{
+			char buffer[256];
+			snprintf(buffer, 256, "%s##%u", materials.get(handle).name.cstr(), handle);
+			if (ImGui::Selectable(buffer, handle == component.material))
+			{
+				component.material = handle;
+				updated = true;
+			}
+		}
+		ImGui::EndCombo();
+	}
+	if (!materials.valid(component.material))
+		return updated;
+	// Edits are shared by every entity referencing the material.
+	MaterialAsset& material = materials.get(component.material);
 	updated |= ImGui::ColorEdit4("Color", material.color.data);
 	updated |= ImGui::Checkbox("Double sided", &material.doubleSided);
 	TextureDisplay("Color", material.albedo.texture, ImVec2(100, 100));
@@ -333,7 +396,7 @@ void component(World& world, entt::entity entity)
 			snprintf(buffer, 256, "ClosePopUp##%p", &component);
 			if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(1))
 				ImGui::OpenPopup(buffer);
-			if (ComponentNode<T>::draw(component))
+			if (ComponentNode<T>::draw(world, component))
 			{
 				world.registry().patch<T>(entity);
 			}
@@ -368,6 +431,8 @@ void SceneEditor::onCreate(World& world)
 	m_wireframeMaterial = Material::create(m_wireframeProgram);
 	m_wireFrameUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(mat4f), BufferUsage::Default, BufferCPUAccess::None);
 	m_wireframeMaterial->set("ModelUniformBuffer", m_wireFrameUniformBuffer);
+	m_wireframePackedMaterial = Material::create(program->get("editor.wireframePacked"));
+	m_wireframePackedMaterial->set("ModelUniformBuffer", m_wireFrameUniformBuffer);
 }
 
 void SceneEditor::onDestroy(World& world)
@@ -505,12 +570,16 @@ void recurse(World& world, entt::entity entity, const std::map<entt::entity, std
 	}
 }
 
-void SceneEditor::drawWireFrame(const mat4f& model, const mat4f& view, const mat4f& projection, const SubMesh& submesh)
+void SceneEditor::drawWireFrame(const mat4f& model, const mat4f& view, const mat4f& projection, const SubMesh& submesh, const Buffer::Ptr& quantization)
 {
 	GraphicDevice* device = Application::graphic();
+	VertexLayout layout = Scene::getVertexLayout(submesh.mesh);
+	bool packed = layout == VertexLayout::Packed || layout == VertexLayout::PackedColor;
+	if (packed && quantization == nullptr)
+		return;
 	RenderPass r;
 	r.framebuffer = device->backbuffer();
-	r.material = m_wireframeMaterial;
+	r.material = packed ? m_wireframePackedMaterial : m_wireframeMaterial;
 	r.clear = Clear::none;
 	r.blend = Blending::none;
 	r.depth = Depth{ DepthCompare::LessOrEqual, false };
@@ -524,6 +593,8 @@ void SceneEditor::drawWireFrame(const mat4f& model, const mat4f& view, const mat
 		r.submesh.type = PrimitiveType::LineStrip;
 		mat4f mvp = projection * view * model;
 		m_wireFrameUniformBuffer->upload(&mvp);
+		if (packed)
+			r.material->set("QuantizationUniformBuffer", quantization);
 		r.execute();
 	}
 }
@@ -545,12 +616,24 @@ void SceneEditor::onRender(World& world)
 			{
 				if (ImGui::MenuItem("Save"))
 				{
-					Scene::save("library/scene.json", world);
+					Scene::save("library/scene.bin", world);
 				}
 				if (ImGui::MenuItem("Load"))
+				{
+					Scene::load(world, "library/scene.bin");
+				}
+				if (ImGui::MenuItem("Export JSON"))
+				{
+					Scene::save("library/scene.json", world);
+				}
+				if (ImGui::MenuItem("Import JSON"))
 				{
 					Scene::load(world, "library/scene.json");
 				}
+				if (ImGui::MenuItem("Benchmark formats"))
+				{
+					benchmarkSceneFormats(world);
+				}
 				ImGui::EndMenu();
 			}
 			if (ImGui::BeginMenu("Entity"))
@@ -623,7 +706,7 @@ void SceneEditor::onRender(World& world)
 					if (ImGui::MenuItem("Mesh", nullptr, nullptr, !e.has<MeshComponent>()))
 						e.add<MeshComponent>(MeshComponent{});
 					if (ImGui::MenuItem("Material", nullptr, nullptr, !e.has<MaterialComponent>()))
-						e.add<MaterialComponent>(MaterialComponent{ color4f(1.f), false, { nullptr, TextureSampler::nearest}, { nullptr, TextureSampler::nearest}, { nullptr, TextureSampler::nearest} });
+						e.add<MaterialComponent>(MaterialComponent{ Scene::getDefaultMaterial(world) });
 					if (ImGui::MenuItem("Point light", nullptr, nullptr, !e.has<PointLightComponent>()))
 						e.add<PointLightComponent>(PointLightComponent{
 							color3f(1.f), 1.f, {},
@@ -791,7 +874,8 @@ void SceneEditor::onRender(World& world)
 				// Draw debug views
 				if (world.registry().has<MeshComponent>(m_currentEntity))
 				{
-					drawWireFrame(transform.transform, view, projection, world.registry().get<MeshComponent>(m_currentEntity).submesh);
+					const MeshComponent& mesh = world.registry().get<MeshComponent>(m_currentEntity);
+					drawWireFrame(transform.transform, view, projection, mesh.submesh, mesh.quantization);
 				}
 				if (world.registry().has<Camera3DComponent>(m_currentEntity))
 				{
@@ -13,13 +13,15 @@ public:
 	void onUpdate(aka::World& world, aka::Time deltaTime) override;
 	void onRender(aka::World& world) override;
 private:
-	void drawWireFrame(const aka::mat4f& model, const aka::mat4f& view, const aka::mat4f& projection, const aka::SubMesh& submesh);
+	// Packed positions are expanded with the quantization of the mesh component
+	void drawWireFrame(const aka::mat4f& model, const aka::mat4f& view, const aka::mat4f& projection, const aka::SubMesh& submesh, const aka::Buffer::Ptr& quantization);
 private:
 	entt::entity m_currentEntity;
 	uint32_t m_gizmoOperation;
 	char m_entityName[256];
 	aka::Program::Ptr m_wireframeProgram;
 	aka::Material::Ptr m_wireframeMaterial;
+	aka::Material::Ptr m_wireframePackedMaterial;
 	aka::Buffer::Ptr m_wireFrameUniformBuffer;
 };
 
@@ -4,6 +4,7 @@
 #include "System/RenderSystem.h"
 #include "System/ScriptSystem.h"
 #include "System/ShadowMapSystem.h"
+#include "Model/AssetPack.h"
 
 namespace app {
 
@@ -19,9 +20,11 @@ void Game::onCreate(int argc, char* argv[])
 	m_world.attach<ScriptSystem>();
 
 	// --- Model
-	ResourceManager* resource = Application::resource();
-	resource->parse("library/library.json");
-	Scene::load(m_world, "library/scene.json");
+	// Packed library is loaded with a single mapping, unless the library changed since it was built.
+	// Without it, library files referenced by the scene are loaded concurrently with the scene.
+	AssetPack::load("library/library.pack");
+	// Binary scene is read unless the JSON one was written after it.
+	Scene::load(m_world, Scene::getStartupPath());
 }
 
 void Game::onDestroy()
@@ -0,0 +1,507 @@
+#include "AssetPack.h"
+#include "MappedFile.h"
+#include "Compression.h"
+#include "WorkerPool.h"
+#include "GraphicFormat.h"
+#include "LibraryLoader.h"
+#include "ImportCache.h"
+#include "BufferFile.h"
+#include "TextureFile.h"
+
+#include <fstream>
+#include <map>
+#include <atomic>
+
+namespace app {
+
+using namespace aka;
+
+static const char packMagic[4] = { 'A', 'K', 'P', 'K' };
+static const uint32_t packVersion = 4;
+// Alignment of payloads in the pack, enough for any vertex, index or pixel type.
+static const uint64_t packAlignment = 64;
+
+enum class PackAssetType : uint32_t {
+	Buffer,
+	Mesh,
+	Texture2D,
+	// Assets without a pack format, loaded from their library path, without payload
+	TextureFile,
+	FontFile,
+	AudioFile,
+};
+
+struct PackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t stringSize;
+	uint64_t tocOffset; // Entries followed by the string table
+	uint64_t libraryHash; // Hash of the library manifests the pack was built with
+};
+
+struct PackEntry {
+	PackAssetType type;
+	uint32_t name; // Offset in string table
+	uint64_t offset; // Payload offset in pack, aligned on packAlignment
+	uint64_t size; // Stored payload size in bytes
+	uint64_t rawSize; // Payload size in bytes once decompressed
+	Codec codec;
+	uint32_t chunkCount; // Compressed payloads start with the stored size of each chunk
+	uint32_t path; // Offset in string table of the library file the asset was packed from
+	uint32_t padding;
+};
+
+// Payload is followed by the buffer bytes
+struct PackBuffer {
+	uint32_t type;
+	uint32_t usage;
+	uint32_t access;
+	uint32_t size;
+};
+
+// Payload is followed by the vertex accessors
+struct PackMesh {
+	uint32_t attributeCount;
+	uint32_t indexFormat;
+	uint32_t indexCount;
+	uint32_t indexBuffer; // Offset in string table
+	uint32_t indexOffset;
+	uint32_t padding;
+};
+
+struct PackVertex {
+	uint32_t semantic;
+	uint32_t format;
+	uint32_t type;
+	uint32_t buffer; // Offset in string table
+	uint32_t count;
+	uint32_t offset;
+	uint32_t bufferOffset;
+	uint32_t bufferSize;
+	uint32_t bufferStride;
+	uint32_t padding;
+};
+
+// Payload is followed by every level, each aligned on packAlignment
+struct PackTexture {
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+	uint32_t format;
+	uint32_t flags;
+	uint32_t padding[11];
+};
+static_assert(sizeof(PackTexture) % packAlignment == 0, "Texture levels must stay aligned");
+
+// Any import or save of the library rewrites one of its manifests, leaving older packs stale.
+static uint64_t hashLibrary()
+{
+	return ImportCache::hashFile("library/import.json", ImportCache::hashFile("library/library.json"));
+}
+
+static uint64_t align(uint64_t offset)
+{
+	return (offset + packAlignment - 1) & ~(packAlignment - 1);
+}
+
+// Stream payloads to the pack, table of contents is written at the end.
+class PackWriter
+{
+public:
+	PackWriter(const Path& path) : m_stream(path.cstr(), std::ios::binary)
+	{
+		PackHeader header{};
+		m_stream.write((const char*)&header, sizeof(PackHeader));
+		m_offset = sizeof(PackHeader);
+		m_rawSize = 0;
+	}
+	bool ok() const { return m_stream.good(); }
+	uint32_t string(const String& str)
+	{
+		auto it = m_strings.find(str.cstr());
+		if (it != m_strings.end())
+			return it->second;
+		uint32_t offset = (uint32_t)m_stringTable.size();
+		m_stringTable.insert(m_stringTable.end(), str.cstr(), str.cstr() + str.length() + 1);
+		m_strings.insert(std::make_pair(str.cstr(), offset));
+		return offset;
+	}
+	void begin(PackAssetType type, const String& name, const Path& path)
+	{
+		padStream();
+		m_entries.push_back(PackEntry{ type, string(name), m_offset, 0, 0, Codec::None, 0, string(path.cstr()), 0 });
+		m_payload.clear();
+	}
+	void write(const void* data, size_t size)
+	{
+		m_payload.insert(m_payload.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+	}
+	// Align next write on packAlignment, relative to payload start
+	void pad()
+	{
+		m_payload.resize(align(m_payload.size()), 0);
+	}
+	// Write payload to the pack, compressing its chunks on workers
+	void end(Codec codec)
+	{
+		PackEntry& entry = m_entries.back();
+		entry.rawSize = m_payload.size();
+		if (codec == Codec::None || m_payload.empty())
+		{
+			m_stream.write((const char*)m_payload.data(), m_payload.size());
+			entry.size = m_payload.size();
+		}
+		else
+		{
+			entry.codec = codec;
+			entry.chunkCount = ChunkedPayload::getChunkCount(m_payload.size());
+			std::vector<std::vector<uint8_t>> chunks(entry.chunkCount);
+			m_pool.parallelFor(entry.chunkCount, [&](size_t i) {
+				chunks[i] = ChunkedPayload::compress(codec, m_payload.data(), m_payload.size(), (uint32_t)i);
+			});
+			std::vector<uint8_t> compressed = ChunkedPayload::join(chunks);
+			m_stream.write((const char*)compressed.data(), compressed.size());
+			entry.size = compressed.size();
+		}
+		m_offset += entry.size;
+		m_rawSize += entry.rawSize;
+	}
+	bool close(uint64_t libraryHash)
+	{
+		padStream();
+		PackHeader header;
+		memcpy(header.magic, packMagic, sizeof(packMagic));
+		header.version = packVersion;
+		header.entryCount = (uint32_t)m_entries.size();
+		header.stringSize = (uint32_t)m_stringTable.size();
+		header.tocOffset = m_offset;
+		header.libraryHash = libraryHash;
+		m_stream.write((const char*)m_entries.data(), m_entries.size() * sizeof(PackEntry));
+		m_stream.write(m_stringTable.data(), m_stringTable.size());
+		m_stream.seekp(0);
+		m_stream.write((const char*)&header, sizeof(PackHeader));
+		m_stream.close();
+		Logger::info("Packed ", m_entries.size(), " assets, ", m_rawSize, " bytes stored in ", m_offset, " bytes");
+		return !m_stream.fail();
+	}
+private:
+	// Align stream on packAlignment
+	void padStream()
+	{
+		static const char zeros[packAlignment] = {};
+		uint64_t aligned = align(m_offset);
+		m_stream.write(zeros, aligned - m_offset);
+		m_offset = aligned;
+	}
+private:
+	WorkerPool m_pool;
+	std::ofstream m_stream;
+	std::vector<uint8_t> m_payload;
+	uint64_t m_offset;
+	uint64_t m_rawSize;
+	std::vector<PackEntry> m_entries;
+	std::vector<char> m_stringTable;
+	std::map<std::string, uint32_t> m_strings;
+};
+
+bool AssetPack::build(const Path& path, Codec codec)
+{
+	ResourceManager* resource = Application::resource();
+	PackWriter writer(path);
+	if (!writer.ok())
+		return false;
+	// Buffers are written first as meshes reference them.
+	for (auto& element : resource->allocator<Buffer>())
+	{
+		BufferStorage storage;
+		if (!BufferFile::load(element.second.path, storage))
+		{
+			Logger::error("Failed to pack buffer ", element.first);
+			return false;
+		}
+		PackBuffer buffer{ (uint32_t)storage.type, (uint32_t)storage.usage, (uint32_t)storage.access, (uint32_t)storage.bytes.size() };
+		writer.begin(PackAssetType::Buffer, element.first, element.second.path);
+		writer.write(&buffer, sizeof(PackBuffer));
+		writer.pad();
+		writer.write(storage.bytes.data(), storage.bytes.size());
+		writer.end(codec);
+	}
+	// Meshes are packed from their library file, resident meshes may draw from batch buffers.
+	for (auto& element : resource->allocator<Mesh>())
+	{
+		MeshStorage storage;
+		if (!storage.load(element.second.path))
+		{
+			Logger::error("Failed to pack mesh ", element.first);
+			return false;
+		}
+		PackMesh packMesh{};
+		packMesh.attributeCount = (uint32_t)storage.vertices.size();
+		packMesh.indexFormat = (uint32_t)storage.indexFormat;
+		packMesh.indexCount = storage.indexCount;
+		packMesh.indexBuffer = writer.string(storage.indexBufferName);
+		packMesh.indexOffset = storage.indexBufferOffset;
+		std::vector<PackVertex> vertices(packMesh.attributeCount);
+		for (uint32_t i = 0; i < packMesh.attributeCount; i++)
+		{
+			// Fields in declaration order, as initialized by the importer
+			const auto& [attribute, bufferName, count, offset, bufferOffset, size, stride] = storage.vertices[i];
+			PackVertex& vertex = vertices[i];
+			vertex.semantic = (uint32_t)attribute.semantic;
+			vertex.format = (uint32_t)attribute.format;
+			vertex.type = (uint32_t)attribute.type;
+			vertex.buffer = writer.string(bufferName);
+			vertex.count = count;
+			vertex.offset = offset;
+			vertex.bufferOffset = bufferOffset;
+			vertex.bufferSize = size;
+			vertex.bufferStride = stride;
+			vertex.padding = 0;
+		}
+		writer.begin(PackAssetType::Mesh, element.first, element.second.path);
+		writer.write(&packMesh, sizeof(PackMesh));
+		writer.write(vertices.data(), vertices.size() * sizeof(PackVertex));
+		writer.end(Codec::None);
+	}
+	for (auto& element : resource->allocator<Texture>())
+	{
+		// Legacy files without header, cubemaps & block compressed textures are read by the library loader.
+		TextureFile file;
+		bool legacy = !file.open(element.second.path);
+		file.close();
+		TextureData data;
+		if (!legacy && !TextureFile::load(element.second.path, data))
+		{
+			Logger::error("Failed to pack texture ", element.first);
+			return false;
+		}
+		if (legacy || data.type != TextureType::Texture2D || data.block != BlockFormat::None)
+		{
+			writer.begin(PackAssetType::TextureFile, element.first, element.second.path);
+			writer.end(Codec::None);
+			continue;
+		}
+		PackTexture texture{};
+		texture.width = data.images[0].width;
+		texture.height = data.images[0].height;
+		texture.levels = (uint32_t)data.images.size();
+		texture.format = (uint32_t)data.format;
+		texture.flags = (uint32_t)LibraryLoader::getLevelFlags(data.flags, 1);
+		writer.begin(PackAssetType::Texture2D, element.first, element.second.path);
+		writer.write(&texture, sizeof(PackTexture));
+		for (const TextureData::Image& level : data.images)
+		{
+			writer.pad();
+			writer.write(level.bytes.data(), level.bytes.size());
+		}
+		writer.end(codec);
+	}
+	for (auto& element : resource->allocator<Font>())
+	{
+		writer.begin(PackAssetType::FontFile, element.first, element.second.path);
+		writer.end(Codec::None);
+	}
+	for (auto& element : resource->allocator<AudioStream>())
+	{
+		writer.begin(PackAssetType::AudioFile, element.first, element.second.path);
+		writer.end(Codec::None);
+	}
+	return writer.close(hashLibrary());
+}
+
+bool AssetPack::load(const Path& path)
+{
+	ResourceManager* resource = Application::resource();
+	// GPU resources copy their payload on creation, the mapping only lives during load.
+	MappedFile file;
+	if (!file.open(path))
+		return false;
+	const PackHeader* header = (const PackHeader*)file.data();
+	if (file.size() < sizeof(PackHeader) || memcmp(header->magic, packMagic, sizeof(packMagic)) != 0 || header->version != packVersion)
+	{
+		Logger::error("Invalid asset pack : ", path);
+		return false;
+	}
+	if (header->libraryHash != hashLibrary())
+	{
+		Logger::warn("Asset pack ", path, " is older than the library, loading library files instead. Pack the library again.");
+		return false;
+	}
+	if (header->tocOffset + header->entryCount * sizeof(PackEntry) + header->stringSize > file.size())
+	{
+		Logger::error("Truncated asset pack : ", path);
+		return false;
+	}
+	const PackEntry* entries = (const PackEntry*)(file.data() + header->tocOffset);
+	const char* strings = (const char*)(entries + header->entryCount);
+	// Strings are read in place, the table must end with a terminator.
+	if (header->stringSize == 0 || strings[header->stringSize - 1] != '\0')
+	{
+		Logger::error("Corrupted asset pack string table : ", path);
+		return false;
+	}
+	Time start = Time::now();
+
+	// Decompress every chunk of compressed payloads on workers before creating resources.
+	std::vector<std::vector<uint8_t>> decompressed(header->entryCount);
+	std::vector<ChunkedPayload::Chunk> chunks;
+	size_t decompressedBytes = 0;
+	for (uint32_t iEntry = 0; iEntry < header->entryCount; iEntry++)
+	{
+		const PackEntry& entry = entries[iEntry];
+		if (entry.offset + entry.size > header->tocOffset || entry.name >= header->stringSize || entry.path >= header->stringSize)
+		{
+			Logger::error("Truncated asset pack : ", path);
+			return false;
+		}
+		if (entry.codec == Codec::None)
+			continue;
+		// Sizes are checked before allocating the decompressed payload.
+		const uint8_t* payload = file.data() + entry.offset;
+		if (entry.codec > Codec::Zstd || !ChunkedPayload::check(payload, entry.size, entry.rawSize) || entry.chunkCount != ChunkedPayload::getChunkCount(entry.rawSize))
+		{
+			Logger::error("Corrupted asset pack entry : ", strings + entry.name);
+			return false;
+		}
+		decompressed[iEntry].resize(entry.rawSize);
+		decompressedBytes += entry.rawSize;
+		ChunkedPayload::split(entry.codec, payload, entry.size, decompressed[iEntry].data(), entry.rawSize, chunks);
+	}
+	if (chunks.size() > 0)
+	{
+		std::atomic<bool> failed(false);
+		WorkerPool pool;
+		pool.parallelFor(chunks.size(), [&](size_t i) {
+			if (!ChunkedPayload::decompress(chunks[i]))
+				failed = true;
+		});
+		if (failed)
+		{
+			Logger::error("Failed to decompress asset pack : ", path);
+			return false;
+		}
+	}
+
+	size_t uploadedBytes = 0;
+	for (uint32_t iEntry = 0; iEntry < header->entryCount; iEntry++)
+	{
+		const PackEntry& entry = entries[iEntry];
+		const uint8_t* payload = (entry.codec == Codec::None) ? file.data() + entry.offset : decompressed[iEntry].data();
+		uint64_t payloadSize = (entry.codec == Codec::None) ? entry.size : entry.rawSize;
+		String name = strings + entry.name;
+		// Assets are registered with the library file they were packed from, so that the library can be saved & packed again.
+		Path libPath = strings + entry.path;
+		// Sizes read from the payload are checked against it before reading what follows.
+		bool valid = true;
+		switch (entry.type)
+		{
+		case PackAssetType::Buffer: {
+			const PackBuffer& buffer = *(const PackBuffer*)payload;
+			valid = payloadSize >= align(sizeof(PackBuffer)) && align(sizeof(PackBuffer)) + buffer.size <= payloadSize;
+			if (!valid)
+				break;
+			const void* bytes = payload + align(sizeof(PackBuffer));
+			Buffer::Ptr ptr = Buffer::create((BufferType)buffer.type, buffer.size, (BufferUsage)buffer.usage, (BufferCPUAccess)buffer.access, bytes);
+			LibraryLoader::registerResource<Buffer>(name, libPath, ptr, buffer.size);
+			uploadedBytes += buffer.size;
+			break;
+		}
+		case PackAssetType::Mesh: {
+			const PackMesh& packMesh = *(const PackMesh*)payload;
+			valid = payloadSize >= sizeof(PackMesh) && sizeof(PackMesh) + (uint64_t)packMesh.attributeCount * sizeof(PackVertex) <= payloadSize && packMesh.indexBuffer < header->stringSize;
+			if (!valid)
+				break;
+			const PackVertex* vertices = (const PackVertex*)(payload + sizeof(PackMesh));
+			std::vector<VertexAccessor> accessors(packMesh.attributeCount);
+			for (uint32_t i = 0; i < packMesh.attributeCount && valid; i++)
+			{
+				const PackVertex& vertex = vertices[i];
+				valid = vertex.buffer < header->stringSize;
+				accessors[i].attribute = VertexAttribute{ (VertexSemantic)vertex.semantic, (VertexFormat)vertex.format, (VertexType)vertex.type };
+				accessors[i].bufferView = VertexBufferView{ valid ? resource->get<Buffer>(strings + vertex.buffer) : nullptr, vertex.bufferOffset, vertex.bufferSize, vertex.bufferStride };
+				accessors[i].offset = vertex.offset;
+				accessors[i].count = vertex.count;
+			}
+			if (!valid)
+				break;
+			IndexFormat indexFormat = (IndexFormat)packMesh.indexFormat;
+			uint32_t indexSize = packMesh.indexCount * GraphicFormat::getIndexSize(indexFormat);
+			IndexAccessor indexAccessor{ indexFormat, IndexBufferView{ resource->get<Buffer>(strings + packMesh.indexBuffer), packMesh.indexOffset, indexSize }, packMesh.indexCount };
+			Mesh::Ptr mesh = Mesh::create();
+			mesh->upload(accessors.data(), accessors.size(), indexAccessor);
+			LibraryLoader::registerResource<Mesh>(name, libPath, mesh, entry.size);
+			break;
+		}
+		case PackAssetType::Texture2D: {
+			const PackTexture& texture = *(const PackTexture*)payload;
+			valid = payloadSize >= sizeof(PackTexture) && texture.levels > 0 && GraphicFormat::getPixelSize((TextureFormat)texture.format) != 0;
+			if (!valid)
+				break;
+			TextureFormat format = (TextureFormat)texture.format;
+			size_t pixelSize = GraphicFormat::getPixelSize(format);
+			uint64_t levelOffset = sizeof(PackTexture);
+			uint32_t levelWidth = texture.width, levelHeight = texture.height;
+			for (uint32_t iLevel = 0; iLevel < texture.levels && valid; iLevel++)
+			{
+				uint64_t levelSize = (uint64_t)levelWidth * levelHeight * pixelSize;
+				valid = levelOffset + levelSize <= payloadSize;
+				levelOffset += align(levelSize);
+				levelWidth = max(levelWidth / 2, 1U);
+				levelHeight = max(levelHeight / 2, 1U);
+			}
+			if (!valid)
+				break;
+			const uint8_t* level = payload + sizeof(PackTexture);
+			Texture2D::Ptr ptr = Texture2D::create(texture.width, texture.height, format, LibraryLoader::getLevelFlags((TextureFlag)texture.flags, texture.levels), nullptr);
+			if (ptr == nullptr)
+			{
+				Logger::error("Failed to create texture2D ", name);
+				break;
+			}
+			uint32_t width = texture.width, height = texture.height;
+			for (uint32_t iLevel = 0; iLevel < texture.levels; iLevel++)
+			{
+				ptr->upload(level, iLevel);
+				level += align(width * height * pixelSize);
+				width = max(width / 2, 1U);
+				height = max(height / 2, 1U);
+			}
+			LibraryLoader::registerResource<Texture>(name, libPath, ptr, entry.size);
+			uploadedBytes += entry.rawSize - sizeof(PackTexture);
+			break;
+		}
+		case PackAssetType::TextureFile: {
+			// Cubemaps are read by the library loader, which uploads their stored levels.
+			Resource<Texture> texture = LibraryLoader::loadTexture(libPath);
+			if (texture.resource != nullptr)
+				LibraryLoader::registerResource<Texture>(name, libPath, texture.resource, texture.size);
+			break;
+		}
+		case PackAssetType::FontFile:
+			resource->load<Font>(name, libPath);
+			break;
+		case PackAssetType::AudioFile:
+			resource->load<AudioStream>(name, libPath);
+			break;
+		default:
+			Logger::warn("Unknown asset type in pack : ", name);
+			break;
+		}
+		if (!valid)
+		{
+			Logger::error("Corrupted asset pack entry : ", name);
+			return false;
+		}
+		// Release decompressed payload once uploaded
+		std::vector<uint8_t>().swap(decompressed[iEntry]);
+	}
+	// Uncompressed payloads go from mapped pages to the driver, only compressed ones are written on the heap.
+	Time duration = Time::now() - start;
+	Logger::info("Loaded ", header->entryCount, " assets from ", path, " in ", duration.milliseconds(), "ms, read ", file.size(), " bytes, uploaded ", uploadedBytes, " bytes, decompressed ", decompressedBytes, " bytes");
+	if (duration.milliseconds() > 0)
+		Logger::info("Pack load throughput : ", (uploadedBytes / 1000) / duration.milliseconds(), " MB/s");
+	return true;
+}
+
+};
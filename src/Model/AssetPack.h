@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "Compression.h"
+
+namespace app {
+
+// Single file archive of the library with a binary table of contents.
+// Buffer & texture payloads are aligned so that they are uploaded straight from a memory mapping of the pack.
+struct AssetPack {
+	// Write every buffer, mesh, texture, font & audio registered in the resource manager to a pack.
+	// Buffer & texture payloads are compressed on workers if requested.
+	// The pack records the library manifests (library.json & import.json) it was built with.
+	static bool build(const aka::Path& path, Codec codec = Codec::None);
+	// Map a pack and register its assets in the resource manager, with the library path they were packed from.
+	// Sizes stored in the pack are checked against their payload, a corrupted entry fails the load.
+	// A pack built before the last change of the library manifests is not loaded.
+	static bool load(const aka::Path& path);
+};
+
+};
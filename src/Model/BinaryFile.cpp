@@ -0,0 +1,17 @@
+#include "BinaryFile.h"
+
+namespace app {
+
+using namespace aka;
+
+void BinaryWriter::align(size_t alignment)
+{
+	bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+}
+
+bool BinaryWriter::save(const Path& path) const
+{
+	return OS::File::write(path, Blob(bytes.data(), bytes.size()));
+}
+
+};
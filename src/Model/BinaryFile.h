@@ -0,0 +1,53 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <vector>
+
+namespace app {
+
+// Bytes of a binary library file being written, saved at once with OS::File.
+struct BinaryWriter {
+	std::vector<uint8_t> bytes;
+
+	template <typename T>
+	void write(const T* data, size_t count)
+	{
+		const uint8_t* begin = (const uint8_t*)data;
+		bytes.insert(bytes.end(), begin, begin + count * sizeof(T));
+	}
+	// Pad with zeros up to a multiple of alignment
+	void align(size_t alignment);
+	bool save(const aka::Path& path) const;
+};
+
+// Bounds checked reads of a binary library file, mapped or read in memory.
+struct BinaryReader {
+	const uint8_t* data;
+	size_t size;
+	size_t offset;
+
+	// Point to the next count elements, nullptr if the file is truncated
+	template <typename T>
+	const T* read(size_t count)
+	{
+		if (offset > size || count > (size - offset) / sizeof(T))
+			return nullptr;
+		const T* value = (const T*)(data + offset);
+		offset += count * sizeof(T);
+		return value;
+	}
+	// Copy the next count elements, false if the file is truncated
+	template <typename T>
+	bool read(T* values, size_t count)
+	{
+		const T* value = read<T>(count);
+		if (value == nullptr)
+			return false;
+		memcpy(values, value, count * sizeof(T));
+		return true;
+	}
+	bool end() const { return offset == size; }
+};
+
+};
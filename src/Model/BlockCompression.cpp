@@ -0,0 +1,697 @@
+#include "BlockCompression.h"
+#include "GraphicFormat.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace app {
+
+using namespace aka;
+
+// Interpolation weights in 64th of BC7 & BC6H 4 bits indices, symmetric so that swapping endpoints mirrors indices
+static const uint32_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Bits of a 16 bytes block, least significant first
+static void writeBits(uint8_t* block, uint32_t& offset, uint32_t value, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, offset++)
+		if ((value >> i) & 1)
+			block[offset / 8] |= (uint8_t)(1 << (offset % 8));
+}
+
+static uint32_t readBits(const uint8_t* block, uint32_t& offset, uint32_t count)
+{
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < count; i++, offset++)
+		value |= (uint32_t)((block[offset / 8] >> (offset % 8)) & 1) << i;
+	return value;
+}
+
+// Principal axis of the points of a block, by power iteration on their covariance.
+static void getPrincipalAxis(const float points[16][4], uint32_t dimensions, float mean[4], float axis[4])
+{
+	float minimum[4], maximum[4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		mean[c] = 0.f;
+		minimum[c] = FLT_MAX;
+		maximum[c] = -FLT_MAX;
+	}
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < dimensions; c++)
+		{
+			mean[c] += points[i][c] / 16.f;
+			minimum[c] = std::min(minimum[c], points[i][c]);
+			maximum[c] = std::max(maximum[c], points[i][c]);
+		}
+	}
+	float covariance[4][4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t a = 0; a < dimensions; a++)
+			for (uint32_t b = 0; b < dimensions; b++)
+				covariance[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+	for (uint32_t c = 0; c < 4; c++)
+		axis[c] = (c < dimensions) ? maximum[c] - minimum[c] : 0.f;
+	for (uint32_t iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.f;
+		for (uint32_t a = 0; a < dimensions; a++)
+		{
+			for (uint32_t b = 0; b < dimensions; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, std::abs(next[a]));
+		}
+		if (length == 0.f)
+			break;
+		for (uint32_t c = 0; c < dimensions; c++)
+			axis[c] = next[c] / length;
+	}
+}
+
+// Endpoints at the extremes of the projection of the points on their principal axis
+static void getEndpoints(const float points[16][4], uint32_t dimensions, float e0[4], float e1[4])
+{
+	float mean[4], axis[4];
+	getPrincipalAxis(points, dimensions, mean, axis);
+	float minimum = FLT_MAX, maximum = -FLT_MAX;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float t = 0.f;
+		for (uint32_t c = 0; c < dimensions; c++)
+			t += (points[i][c] - mean[c]) * axis[c];
+		minimum = std::min(minimum, t);
+		maximum = std::max(maximum, t);
+	}
+	float length = 0.f;
+	for (uint32_t c = 0; c < dimensions; c++)
+		length += axis[c] * axis[c];
+	if (length > 0.f)
+	{
+		minimum /= length;
+		maximum /= length;
+	}
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		e0[c] = mean[c] + axis[c] * maximum;
+		e1[c] = mean[c] + axis[c] * minimum;
+	}
+}
+
+// Least squares endpoints of points interpolated with weight[i] of e1 & 1 - weight[i] of e0, false if degenerate
+static bool fitEndpoints(const float points[16][4], uint32_t dimensions, const float weight[16], float e0[4], float e1[4])
+{
+	float aa = 0.f, ab = 0.f, bb = 0.f;
+	float ax[4] = {}, bx[4] = {};
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float a = 1.f - weight[i];
+		float b = weight[i];
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (uint32_t c = 0; c < dimensions; c++)
+		{
+			ax[c] += a * points[i][c];
+			bx[c] += b * points[i][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) < 1e-6f)
+		return false;
+	for (uint32_t c = 0; c < dimensions; c++)
+	{
+		e0[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+		e1[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+	}
+	return true;
+}
+
+// Nearest palette entry of every point, returns the squared error
+static float getIndices(const float points[16][4], uint32_t dimensions, const float palette[][4], uint32_t paletteSize, uint32_t indices[16])
+{
+	float error = 0.f;
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		float best = FLT_MAX;
+		for (uint32_t p = 0; p < paletteSize; p++)
+		{
+			float distance = 0.f;
+			for (uint32_t c = 0; c < dimensions; c++)
+				distance += (points[i][c] - palette[p][c]) * (points[i][c] - palette[p][c]);
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = p;
+			}
+		}
+		error += best;
+	}
+	return error;
+}
+
+// BC1 color block ------------------------------------------------------------
+
+static uint16_t pack565(const float color[4])
+{
+	uint32_t r = (uint32_t)(clamp(color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+	uint32_t g = (uint32_t)(clamp(color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+	uint32_t b = (uint32_t)(clamp(color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpack565(uint16_t value, uint32_t color[3])
+{
+	uint32_t r = value >> 11, g = (value >> 5) & 63, b = value & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Colors of the 4 indices, 3 colors & transparent black when c0 <= c1 unless opaque (BC3 color blocks)
+static void getColorPalette(uint16_t c0, uint16_t c1, bool opaque, uint32_t palette[4][4])
+{
+	unpack565(c0, palette[0]);
+	unpack565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+	for (uint32_t c = 0; c < 3; c++)
+	{
+		if (c0 > c1 || opaque)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = (c0 > c1 || opaque) ? 255 : 0;
+}
+
+// Color of 16 RGBA8 pixels in 4 colors mode, alpha is ignored
+static void encodeColorBlock(const uint8_t* pixels, uint8_t* block)
+{
+	// Weight of c1 per index
+	static const float weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+	float points[16][4];
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < 4; c++)
+			points[i][c] = (c < 3) ? pixels[4 * i + c] : 0.f;
+	float e0[4], e1[4];
+	getEndpoints(points, 3, e0, e1);
+	float bestError = FLT_MAX;
+	for (uint32_t iteration = 0; iteration < 2; iteration++)
+	{
+		uint16_t c0 = pack565(e0);
+		uint16_t c1 = pack565(e1);
+		if (c0 < c1)
+			std::swap(c0, c1);
+		uint32_t indices[16] = {};
+		float error = 0.f;
+		if (c0 != c1)
+		{
+			uint32_t colors[4][4];
+			getColorPalette(c0, c1, true, colors);
+			float palette[4][4];
+			for (uint32_t p = 0; p < 4; p++)
+				for (uint32_t c = 0; c < 4; c++)
+					palette[p][c] = (float)colors[p][c];
+			error = getIndices(points, 3, palette, 4, indices);
+		}
+		else
+		{
+			// Equal endpoints are decoded in 3 colors mode, the first one is exact
+			uint32_t color[3];
+			unpack565(c0, color);
+			for (uint32_t i = 0; i < 16; i++)
+				for (uint32_t c = 0; c < 3; c++)
+					error += (points[i][c] - color[c]) * (points[i][c] - color[c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			uint32_t bits = 0;
+			for (uint32_t i = 0; i < 16; i++)
+				bits |= indices[i] << (2 * i);
+			block[0] = (uint8_t)(c0 & 0xff);
+			block[1] = (uint8_t)(c0 >> 8);
+			block[2] = (uint8_t)(c1 & 0xff);
+			block[3] = (uint8_t)(c1 >> 8);
+			memcpy(block + 4, &bits, sizeof(uint32_t));
+		}
+		float weight[16];
+		for (uint32_t i = 0; i < 16; i++)
+			weight[i] = weights[indices[i]];
+		if (c0 == c1 || !fitEndpoints(points, 3, weight, e0, e1))
+			break;
+	}
+}
+
+static void decodeColorBlock(const uint8_t* block, bool opaque, uint8_t* pixels)
+{
+	uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+	uint32_t bits;
+	memcpy(&bits, block + 4, sizeof(uint32_t));
+	uint32_t palette[4][4];
+	getColorPalette(c0, c1, opaque, palette);
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < 4; c++)
+			pixels[4 * i + c] = (uint8_t)palette[(bits >> (2 * i)) & 3][c];
+}
+
+// BC4 channel block ----------------------------------------------------------
+
+// Values of the 8 indices, 6 interpolated when r0 > r1, 4 interpolated & 0, 255 otherwise. Interpolations are rounded to nearest.
+static void getChannelPalette(uint32_t r0, uint32_t r1, uint32_t palette[8])
+{
+	palette[0] = r0;
+	palette[1] = r1;
+	if (r0 > r1)
+	{
+		for (uint32_t i = 2; i < 8; i++)
+			palette[i] = (r0 * (8 - i) + r1 * (i - 1) + 3) / 7;
+	}
+	else
+	{
+		for (uint32_t i = 2; i < 6; i++)
+			palette[i] = (r0 * (6 - i) + r1 * (i - 1) + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// 16 values with a stride, in the mode with the lowest error
+static void encodeChannelBlock(const uint8_t* values, uint32_t stride, uint8_t* block)
+{
+	uint32_t minimum = 255, maximum = 0;
+	uint32_t innerMinimum = 255, innerMaximum = 0; // Without 0 & 255, exact in 6 values mode
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t value = values[i * stride];
+		minimum = std::min(minimum, value);
+		maximum = std::max(maximum, value);
+		if (value != 0 && value != 255)
+		{
+			innerMinimum = std::min(innerMinimum, value);
+			innerMaximum = std::max(innerMaximum, value);
+		}
+	}
+	if (innerMinimum > innerMaximum)
+		innerMinimum = innerMaximum = 0;
+	const uint32_t endpoints[2][2] = { { maximum, minimum }, { innerMinimum, innerMaximum } };
+	uint32_t bestError = UINT32_MAX;
+	for (uint32_t mode = 0; mode < 2; mode++)
+	{
+		uint32_t palette[8];
+		getChannelPalette(endpoints[mode][0], endpoints[mode][1], palette);
+		uint64_t bits = 0;
+		uint32_t error = 0;
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			int32_t value = values[i * stride];
+			uint32_t best = UINT32_MAX, index = 0;
+			for (uint32_t p = 0; p < 8; p++)
+			{
+				uint32_t distance = (uint32_t)((value - (int32_t)palette[p]) * (value - (int32_t)palette[p]));
+				if (distance < best)
+				{
+					best = distance;
+					index = p;
+				}
+			}
+			error += best;
+			bits |= (uint64_t)index << (3 * i);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			block[0] = (uint8_t)endpoints[mode][0];
+			block[1] = (uint8_t)endpoints[mode][1];
+			for (uint32_t i = 0; i < 6; i++)
+				block[2 + i] = (uint8_t)(bits >> (8 * i));
+		}
+	}
+}
+
+static void decodeChannelBlock(const uint8_t* block, uint8_t* values, uint32_t stride)
+{
+	uint32_t palette[8];
+	getChannelPalette(block[0], block[1], palette);
+	uint64_t bits = 0;
+	for (uint32_t i = 0; i < 6; i++)
+		bits |= (uint64_t)block[2 + i] << (8 * i);
+	for (uint32_t i = 0; i < 16; i++)
+		values[i * stride] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+}
+
+// BC7 mode 6 block -----------------------------------------------------------
+
+static uint32_t interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+{
+	return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// 7 bits RGBA endpoint & its shared p bit closest to a color
+static uint32_t quantizeEndpoint(const float color[4], uint32_t endpoint[4])
+{
+	float bestError = FLT_MAX;
+	uint32_t best = 0;
+	for (uint32_t p = 0; p < 2; p++)
+	{
+		uint32_t quantized[4];
+		float error = 0.f;
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			quantized[c] = (uint32_t)clamp((color[c] - p) / 2.f + 0.5f, 0.f, 127.f);
+			float value = (float)((quantized[c] << 1) | p);
+			error += (value - color[c]) * (value - color[c]);
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			best = p;
+			memcpy(endpoint, quantized, sizeof(quantized));
+		}
+	}
+	return best;
+}
+
+static void encodeBC7Block(const uint8_t* pixels, uint8_t* block)
+{
+	float points[16][4];
+	for (uint32_t i = 0; i < 16; i++)
+		for (uint32_t c = 0; c < 4; c++)
+			points[i][c] = pixels[4 * i + c];
+	float e[2][4];
+	getEndpoints(points, 4, e[0], e[1]);
+	float bestError = FLT_MAX;
+	for (uint32_t iteration = 0; iteration < 3; iteration++)
+	{
+		uint32_t endpoints[2][4], pbits[2];
+		float palette[16][4];
+		for (uint32_t i = 0; i < 2; i++)
+			pbits[i] = quantizeEndpoint(e[i], endpoints[i]);
+		for (uint32_t p = 0; p < 16; p++)
+			for (uint32_t c = 0; c < 4; c++)
+				palette[p][c] = (float)interpolate((endpoints[0][c] << 1) | pbits[0], (endpoints[1][c] << 1) | pbits[1], weights4[p]);
+		uint32_t indices[16];
+		float error = getIndices(points, 4, palette, 16, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			// Most significant bit of the first index is implicit 0, swapping endpoints mirrors indices
+			uint32_t first = (indices[0] >= 8) ? 1 : 0;
+			uint8_t encoded[16] = {};
+			uint32_t offset = 0;
+			writeBits(encoded, offset, 1 << 6, 7);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				writeBits(encoded, offset, endpoints[first][c], 7);
+				writeBits(encoded, offset, endpoints[1 - first][c], 7);
+			}
+			writeBits(encoded, offset, pbits[first], 1);
+			writeBits(encoded, offset, pbits[1 - first], 1);
+			for (uint32_t i = 0; i < 16; i++)
+				writeBits(encoded, offset, first ? 15 - indices[i] : indices[i], i == 0 ? 3 : 4);
+			memcpy(block, encoded, sizeof(encoded));
+		}
+		float weight[16];
+		for (uint32_t i = 0; i < 16; i++)
+			weight[i] = weights4[indices[i]] / 64.f;
+		if (!fitEndpoints(points, 4, weight, e[0], e[1]))
+			break;
+	}
+}
+
+static void decodeBC7Block(const uint8_t* block, uint8_t* pixels)
+{
+	if ((block[0] & 0x7f) != (1 << 6))
+	{
+		memset(pixels, 0, 16 * 4);
+		return;
+	}
+	uint32_t offset = 7;
+	uint32_t endpoints[2][4];
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = readBits(block, offset, 7) << 1;
+		endpoints[1][c] = readBits(block, offset, 7) << 1;
+	}
+	uint32_t p0 = readBits(block, offset, 1);
+	uint32_t p1 = readBits(block, offset, 1);
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		endpoints[0][c] |= p0;
+		endpoints[1][c] |= p1;
+	}
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t index = readBits(block, offset, i == 0 ? 3 : 4);
+		for (uint32_t c = 0; c < 4; c++)
+			pixels[4 * i + c] = (uint8_t)interpolate(endpoints[0][c], endpoints[1][c], weights4[index]);
+	}
+}
+
+// BC6H mode 11 block ---------------------------------------------------------
+// Values are interpolated as 16 bits integers, scaled by 31/64 to the bits of unsigned halves.
+
+static uint32_t unquantizeHalf(uint32_t value)
+{
+	if (value == 0)
+		return 0;
+	if (value == 1023)
+		return 0xffff;
+	return ((value << 16) + 0x8000) >> 10;
+}
+
+static uint32_t finishHalf(uint32_t value)
+{
+	return (value * 31) >> 6;
+}
+
+// Bits of a half as a positive value, negative values & NaN are clamped to 0 & infinity to the largest half
+static float getHalfValue(uint16_t half)
+{
+	if (half & 0x8000)
+		return 0.f;
+	if ((half & 0x7c00) == 0x7c00)
+		return (half & 0x3ff) ? 0.f : (float)0x7bff;
+	return (float)half;
+}
+
+static void encodeBC6HBlock(const uint8_t* pixels, uint8_t* block)
+{
+	float points[16][4]; // Half bits
+	float scaled[16][4]; // Before finish, in the interpolated 16 bits range
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			uint16_t half;
+			memcpy(&half, pixels + 8 * i + 2 * c, sizeof(uint16_t));
+			points[i][c] = (c < 3) ? getHalfValue(half) : 0.f;
+			scaled[i][c] = points[i][c] * 64.f / 31.f;
+		}
+	}
+	float e[2][4];
+	getEndpoints(scaled, 3, e[0], e[1]);
+	float bestError = FLT_MAX;
+	for (uint32_t iteration = 0; iteration < 3; iteration++)
+	{
+		uint32_t endpoints[2][3];
+		float palette[16][4];
+		for (uint32_t i = 0; i < 2; i++)
+			for (uint32_t c = 0; c < 3; c++)
+				endpoints[i][c] = (uint32_t)clamp((e[i][c] - 32.f) / 64.f + 0.5f, 0.f, 1023.f);
+		for (uint32_t p = 0; p < 16; p++)
+			for (uint32_t c = 0; c < 3; c++)
+				palette[p][c] = (float)finishHalf(interpolate(unquantizeHalf(endpoints[0][c]), unquantizeHalf(endpoints[1][c]), weights4[p]));
+		uint32_t indices[16];
+		float error = getIndices(points, 3, palette, 16, indices);
+		if (error < bestError)
+		{
+			bestError = error;
+			uint32_t first = (indices[0] >= 8) ? 1 : 0;
+			uint8_t encoded[16] = {};
+			uint32_t offset = 0;
+			writeBits(encoded, offset, 3, 5);
+			for (uint32_t i = 0; i < 2; i++)
+				for (uint32_t c = 0; c < 3; c++)
+					writeBits(encoded, offset, endpoints[i == 0 ? first : 1 - first][c], 10);
+			for (uint32_t i = 0; i < 16; i++)
+				writeBits(encoded, offset, first ? 15 - indices[i] : indices[i], i == 0 ? 3 : 4);
+			memcpy(block, encoded, sizeof(encoded));
+		}
+		float weight[16];
+		for (uint32_t i = 0; i < 16; i++)
+			weight[i] = weights4[indices[i]] / 64.f;
+		if (!fitEndpoints(scaled, 3, weight, e[0], e[1]))
+			break;
+	}
+}
+
+static void decodeBC6HBlock(const uint8_t* block, uint8_t* pixels)
+{
+	const uint16_t one = 0x3c00;
+	uint32_t offset = 0;
+	if (readBits(block, offset, 5) != 3)
+	{
+		for (uint32_t i = 0; i < 16; i++)
+		{
+			memset(pixels + 8 * i, 0, 6);
+			memcpy(pixels + 8 * i + 6, &one, sizeof(uint16_t));
+		}
+		return;
+	}
+	uint32_t endpoints[2][3];
+	for (uint32_t i = 0; i < 2; i++)
+		for (uint32_t c = 0; c < 3; c++)
+			endpoints[i][c] = unquantizeHalf(readBits(block, offset, 10));
+	for (uint32_t i = 0; i < 16; i++)
+	{
+		uint32_t index = readBits(block, offset, i == 0 ? 3 : 4);
+		uint16_t half[4];
+		for (uint32_t c = 0; c < 3; c++)
+			half[c] = (uint16_t)finishHalf(interpolate(endpoints[0][c], endpoints[1][c], weights4[index]));
+		half[3] = one;
+		memcpy(pixels + 8 * i, half, sizeof(half));
+	}
+}
+
+// Images ---------------------------------------------------------------------
+
+size_t BlockCompression::getBlockSize(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC1:
+	case BlockFormat::BC4:
+		return 8;
+	case BlockFormat::BC3:
+	case BlockFormat::BC5:
+	case BlockFormat::BC6H:
+	case BlockFormat::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t BlockCompression::getImageSize(BlockFormat format, uint32_t width, uint32_t height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+TextureFormat BlockCompression::getDecodedFormat(BlockFormat format)
+{
+	switch (format)
+	{
+	case BlockFormat::BC4: return TextureFormat::R8;
+	case BlockFormat::BC5: return TextureFormat::RG8;
+	case BlockFormat::BC6H: return TextureFormat::RGBA16F;
+	default: return TextureFormat::RGBA8;
+	}
+}
+
+void BlockCompression::encode(BlockFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow, uint8_t* blocks)
+{
+	size_t pixelSize = GraphicFormat::getPixelSize(getDecodedFormat(format));
+	size_t blockSize = getBlockSize(format);
+	uint32_t blockCount = (width + 3) / 4;
+	uint8_t texels[16 * 8];
+	for (uint32_t row = firstRow; row < lastRow; row++)
+	{
+		for (uint32_t column = 0; column < blockCount; column++)
+		{
+			// Partial blocks repeat the last row & column of the image
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = std::min(column * 4 + i % 4, width - 1);
+				uint32_t y = std::min(row * 4 + i / 4, height - 1);
+				memcpy(texels + i * pixelSize, pixels + ((size_t)y * width + x) * pixelSize, pixelSize);
+			}
+			uint8_t* block = blocks + ((size_t)row * blockCount + column) * blockSize;
+			switch (format)
+			{
+			case BlockFormat::BC1:
+				encodeColorBlock(texels, block);
+				break;
+			case BlockFormat::BC3:
+				encodeChannelBlock(texels + 3, 4, block);
+				encodeColorBlock(texels, block + 8);
+				break;
+			case BlockFormat::BC4:
+				encodeChannelBlock(texels, 1, block);
+				break;
+			case BlockFormat::BC5:
+				encodeChannelBlock(texels, 2, block);
+				encodeChannelBlock(texels + 1, 2, block + 8);
+				break;
+			case BlockFormat::BC6H:
+				encodeBC6HBlock(texels, block);
+				break;
+			case BlockFormat::BC7:
+				encodeBC7Block(texels, block);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void BlockCompression::decode(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* pixels)
+{
+	size_t pixelSize = GraphicFormat::getPixelSize(getDecodedFormat(format));
+	size_t blockSize = getBlockSize(format);
+	uint32_t blockCount = (width + 3) / 4;
+	uint8_t texels[16 * 8];
+	for (uint32_t row = 0; row < (height + 3) / 4; row++)
+	{
+		for (uint32_t column = 0; column < blockCount; column++)
+		{
+			const uint8_t* block = blocks + ((size_t)row * blockCount + column) * blockSize;
+			switch (format)
+			{
+			case BlockFormat::BC1:
+				decodeColorBlock(block, false, texels);
+				break;
+			case BlockFormat::BC3:
+				decodeColorBlock(block + 8, true, texels);
+				decodeChannelBlock(block, texels + 3, 4);
+				break;
+			case BlockFormat::BC4:
+				decodeChannelBlock(block, texels, 1);
+				break;
+			case BlockFormat::BC5:
+				decodeChannelBlock(block, texels, 2);
+				decodeChannelBlock(block + 8, texels + 1, 2);
+				break;
+			case BlockFormat::BC6H:
+				decodeBC6HBlock(block, texels);
+				break;
+			case BlockFormat::BC7:
+				decodeBC7Block(block, texels);
+				break;
+			default:
+				return;
+			}
+			for (uint32_t i = 0; i < 16; i++)
+			{
+				uint32_t x = column * 4 + i % 4;
+				uint32_t y = row * 4 + i / 4;
+				if (x < width && y < height)
+					memcpy(pixels + ((size_t)y * width + x) * pixelSize, texels + i * pixelSize, pixelSize);
+			}
+		}
+	}
+}
+
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+namespace app {
+
+// Block compressed formats of library textures, encoding 4x4 pixel blocks in 8 or 16 bytes.
+enum class BlockFormat : uint32_t {
+	None,
+	BC1, // RGB, 8 bytes per block, opaque
+	BC3, // RGBA, 16 bytes per block, BC4 alpha & BC1 color
+	BC4, // R, 8 bytes per block
+	BC5, // RG, 16 bytes per block, two BC4 blocks
+	BC6H, // Unsigned RGB half, 16 bytes per block
+	BC7, // RGBA, 16 bytes per block
+};
+
+// CPU encoder & decoder of block compressed textures.
+// Pixels are in the decoded format of the block format : RGBA8 for BC1, BC3 & BC7, R8 for BC4, RG8 for BC5
+// and RGBA16F for BC6H, which ignores alpha & clamps negative values to 0.
+// Encoders write a single mode of BC7 (mode 6, one subset with RGBA endpoints) & BC6H (mode 11, one region with 10 bits endpoints),
+// decoders only read these modes, blocks of other modes decode to black.
+struct BlockCompression {
+	// Size in bytes of a block, 0 for None
+	static size_t getBlockSize(BlockFormat format);
+	// Size in bytes of the blocks of an image, partial blocks at the edges are padded
+	static size_t getImageSize(BlockFormat format, uint32_t width, uint32_t height);
+	// Format of the pixels encoded & decoded
+	static aka::TextureFormat getDecodedFormat(BlockFormat format);
+	// Encode the rows of blocks [firstRow, lastRow) of an image to the blocks of the whole image.
+	// Rows of blocks are independent, an image can be encoded in bands on workers.
+	static void encode(BlockFormat format, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow, uint8_t* blocks);
+	// Decode the blocks of a whole image
+	static void decode(BlockFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* pixels);
+};
+
+};
@@ -0,0 +1,94 @@
+#include "BufferFile.h"
+
+#include <atomic>
+
+namespace app {
+
+using namespace aka;
+
+static const char bufferMagic[4] = { 'A', 'K', 'B', 'F' };
+static const uint32_t bufferVersion = 2;
+
+struct BufferHeader {
+	uint32_t type;
+	uint32_t usage;
+	uint32_t access;
+	uint32_t padding;
+};
+
+static std::atomic<size_t> copied{ 0 };
+
+bool BufferFile::save(const Path& path, const BufferStorage& storage, Codec codec)
+{
+	BufferHeader header{};
+	header.type = (uint32_t)storage.type;
+	header.usage = (uint32_t)storage.usage;
+	header.access = (uint32_t)storage.access;
+	return PayloadFile::save(path, bufferMagic, bufferVersion, &header, sizeof(BufferHeader), storage.bytes.data(), storage.bytes.size(), codec);
+}
+
+bool BufferFile::load(const Path& path, BufferStorage& storage)
+{
+	BufferFile file;
+	if (file.open(path))
+	{
+		std::vector<ChunkedPayload::Chunk> chunks;
+		bool valid = file.split(chunks);
+		for (const ChunkedPayload::Chunk& chunk : chunks)
+			valid = valid && ChunkedPayload::decompress(chunk);
+		if (valid)
+			file.read(storage);
+		return valid;
+	}
+	if (!storage.load(path))
+		return false;
+	copied += storage.bytes.size();
+	return true;
+}
+
+size_t BufferFile::copiedBytes()
+{
+	return copied;
+}
+
+bool BufferFile::open(const Path& path)
+{
+	if (!m_file.open(path, bufferMagic, bufferVersion, sizeof(BufferHeader)))
+		return false;
+	BufferHeader header;
+	memcpy(&header, m_file.header(), sizeof(BufferHeader));
+	m_type = (BufferType)header.type;
+	m_usage = (BufferUsage)header.usage;
+	m_access = (BufferCPUAccess)header.access;
+	return true;
+}
+
+void BufferFile::close()
+{
+	m_file.close();
+}
+
+bool BufferFile::split(std::vector<ChunkedPayload::Chunk>& chunks)
+{
+	if (m_file.codec() != Codec::None)
+		copied += m_file.size();
+	return m_file.split(chunks);
+}
+
+Buffer::Ptr BufferFile::create() const
+{
+	if (m_file.data() == nullptr)
+		return nullptr;
+	return Buffer::create(m_type, m_file.size(), m_usage, m_access, m_file.data());
+}
+
+void BufferFile::read(BufferStorage& storage) const
+{
+	storage.type = m_type;
+	storage.usage = m_usage;
+	storage.access = m_access;
+	storage.bytes.assign(m_file.data(), m_file.data() + m_file.size());
+	copied += m_file.size();
+}
+
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "PayloadFile.h"
+
+namespace app {
+
+// Library file of a buffer. Raw payloads follow an aligned header so that a mapping of the file is uploaded as is,
+// compressed payloads are decompressed on the heap. Files written before the header are Aka buffer storages, they are only read through load.
+class BufferFile
+{
+public:
+	// Write the storage with its header, its payload compressed with codec
+	static bool save(const aka::Path& path, const aka::BufferStorage& storage, Codec codec = Codec::None);
+	// Read the file in storage, either format, the payload is copied on the heap
+	static bool load(const aka::Path& path, aka::BufferStorage& storage);
+	// Bytes of payload copied or decompressed on the heap by every load, split & read since start
+	static size_t copiedBytes();
+
+	// Map the file, false if it can't be opened or has no header
+	bool open(const aka::Path& path);
+	void close();
+	// Chunks of a compressed payload to decompress before create & read, false if the payload is corrupted
+	bool split(std::vector<ChunkedPayload::Chunk>& chunks);
+	// Create the buffer from the payload, nothing is copied on the heap for raw payloads
+	aka::Buffer::Ptr create() const;
+	// Copy the payload in storage
+	void read(aka::BufferStorage& storage) const;
+
+	Codec codec() const { return m_file.codec(); }
+	// Mapped or decompressed payload, null if not opened
+	const uint8_t* data() const { return m_file.data(); }
+	size_t size() const { return m_file.size(); }
+private:
+	PayloadFile m_file;
+	aka::BufferType m_type;
+	aka::BufferUsage m_usage;
+	aka::BufferCPUAccess m_access;
+};
+
+};
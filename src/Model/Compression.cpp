@@ -0,0 +1,1741 @@
+#include "Compression.h"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <cmath>
+
+namespace app {
+
+static const size_t minMatch = 4;
+// Last bytes of a block are always literals, and the last match starts before this limit
+static const size_t lastLiterals = 5;
+static const size_t matchFindLimit = 12;
+static const size_t maxOffset = 65535;
+static const uint32_t hashLog = 12;
+
+static uint32_t read32(const uint8_t* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(uint32_t));
+	return value;
+}
+
+static uint32_t hash(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - hashLog);
+}
+
+// Write a length continuation, return false if it overflows destination
+static bool writeLength(uint8_t*& op, const uint8_t* oend, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		if (op >= oend)
+			return false;
+		*op++ = 255;
+	}
+	if (op >= oend)
+		return false;
+	*op++ = (uint8_t)length;
+	return true;
+}
+
+static bool writeSequence(uint8_t*& op, const uint8_t* oend, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+	if (op >= oend)
+		return false;
+	uint8_t* token = op++;
+	*token = (uint8_t)(std::min<size_t>(literalLength, 15) << 4);
+	if (literalLength >= 15 && !writeLength(op, oend, literalLength - 15))
+		return false;
+	if ((size_t)(oend - op) < literalLength)
+		return false;
+	if (literalLength > 0)
+		memcpy(op, literals, literalLength);
+	op += literalLength;
+	if (matchLength == 0)
+		return true; // Last sequence
+	if (oend - op < 2)
+		return false;
+	*op++ = (uint8_t)(offset & 0xff);
+	*op++ = (uint8_t)(offset >> 8);
+	size_t length = matchLength - minMatch;
+	*token |= (uint8_t)std::min<size_t>(length, 15);
+	if (length >= 15 && !writeLength(op, oend, length - 15))
+		return false;
+	return true;
+}
+
+size_t LZ4::compressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t LZ4::compress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity)
+{
+	const uint8_t* src = (const uint8_t*)source;
+	uint8_t* op = (uint8_t*)destination;
+	const uint8_t* oend = op + destinationCapacity;
+	size_t anchor = 0;
+	if (sourceSize > matchFindLimit)
+	{
+		// Last position seen for each hashed sequence
+		std::vector<uint32_t> table(1U << hashLog, 0);
+		size_t matchLimit = sourceSize - lastLiterals;
+		size_t inputLimit = sourceSize - matchFindLimit;
+		size_t ip = 1;
+		while (ip <= inputLimit)
+		{
+			uint32_t sequence = read32(src + ip);
+			uint32_t h = hash(sequence);
+			size_t ref = table[h];
+			table[h] = (uint32_t)ip;
+			if (ip - ref > maxOffset || read32(src + ref) != sequence)
+			{
+				// Skip faster through incompressible data
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			// Extend match backward over pending literals, then forward
+			while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+			{
+				ip--;
+				ref--;
+			}
+			size_t length = minMatch;
+			while (ip + length < matchLimit && src[ip + length] == src[ref + length])
+				length++;
+			if (!writeSequence(op, oend, src + anchor, ip - anchor, ip - ref, length))
+				return 0;
+			ip += length;
+			anchor = ip;
+			if (ip <= inputLimit)
+				table[hash(read32(src + ip - 2))] = (uint32_t)(ip - 2);
+		}
+	}
+	if (!writeSequence(op, oend, src + anchor, sourceSize - anchor, 0, 0))
+		return 0;
+	return op - (uint8_t*)destination;
+}
+
+// Read a length continuation, return false if it overflows source
+static bool readLength(const uint8_t*& ip, const uint8_t* iend, size_t& length)
+{
+	uint8_t byte;
+	do {
+		if (ip >= iend)
+			return false;
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+size_t LZ4::decompress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity)
+{
+	const uint8_t* ip = (const uint8_t*)source;
+	const uint8_t* iend = ip + sourceSize;
+	uint8_t* dst = (uint8_t*)destination;
+	uint8_t* op = dst;
+	const uint8_t* oend = dst + destinationCapacity;
+	while (ip < iend)
+	{
+		uint8_t token = *ip++;
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(ip, iend, literalLength))
+			return 0;
+		if ((size_t)(iend - ip) < literalLength || (size_t)(oend - op) < literalLength)
+			return 0;
+		if (literalLength > 0)
+			memcpy(op, ip, literalLength);
+		op += literalLength;
+		ip += literalLength;
+		if (ip == iend)
+			break; // Last sequence has no match
+		if (iend - ip < 2)
+			return 0;
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst))
+			return 0;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(ip, iend, matchLength))
+			return 0;
+		matchLength += minMatch;
+		if ((size_t)(oend - op) < matchLength)
+			return 0;
+		// Match can overlap output when offset is smaller than its length
+		const uint8_t* match = op - offset;
+		if (offset >= matchLength)
+			memcpy(op, match, matchLength);
+		else
+			for (size_t i = 0; i < matchLength; i++)
+				op[i] = match[i];
+		op += matchLength;
+	}
+	return op - dst;
+}
+
+// Zstandard codec, see https://www.rfc-editor.org/rfc/rfc8878
+namespace zstd {
+
+static const uint32_t frameMagic = 0xFD2FB528;
+static const uint32_t skippableMagic = 0x184D2A50; // Low 4 bits are free
+static const size_t blockSizeMax = 128 * 1024;
+static const uint32_t maxHuffmanBits = 11;
+static const uint32_t minMatch = 4; // Format allows 3, shorter matches rarely pay for their sequence
+
+enum BlockType : uint32_t { RawBlock, RLEBlock, CompressedBlock, ReservedBlock };
+enum LiteralsType : uint32_t { RawLiterals, RLELiterals, CompressedLiterals, TreelessLiterals };
+enum SymbolMode : uint32_t { PredefinedMode, RLEMode, CompressedMode, RepeatMode };
+
+static const uint32_t literalLengthBaselines[36] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+	8192, 16384, 32768, 65536,
+};
+static const uint8_t literalLengthBits[36] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16,
+};
+static const uint32_t matchLengthBaselines[53] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+	4099, 8195, 16387, 32771, 65539,
+};
+static const uint8_t matchLengthBits[53] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16,
+};
+// Predefined distributions, -1 is a probability lower than 1
+static const int16_t literalLengthDefaults[36] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1,
+};
+static const int16_t matchLengthDefaults[53] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1,
+};
+static const int16_t offsetDefaults[29] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1,
+};
+
+// Sequence streams, with their symbol count, predefined distribution & accuracy limits
+struct SymbolStream {
+	uint32_t symbolCount;
+	const int16_t* defaults;
+	uint32_t defaultCount;
+	uint32_t defaultLog;
+	uint32_t maxLog;
+};
+static const SymbolStream literalLengthStream{ 36, literalLengthDefaults, 36, 6, 9 };
+static const SymbolStream offsetStream{ 32, offsetDefaults, 29, 5, 8 };
+static const SymbolStream matchLengthStream{ 53, matchLengthDefaults, 53, 6, 9 };
+
+static uint32_t highbit(uint32_t value)
+{
+	uint32_t bit = 0;
+	while (value >>= 1)
+		bit++;
+	return bit;
+}
+
+static uint32_t readLE(const uint8_t* data, size_t size)
+{
+	uint32_t value = 0;
+	for (size_t i = 0; i < size; i++)
+		value |= (uint32_t)data[i] << (8 * i);
+	return value;
+}
+
+// Bits read from the end of a stream, its last byte holds a marker above the last written bit.
+// Bits before the stream start read as zeros, reading them overflows the stream.
+struct BackwardReader {
+	const uint8_t* data;
+	size_t size;
+	int64_t position; // Bits left to read
+
+	bool init(const uint8_t* stream, size_t streamSize)
+	{
+		data = stream;
+		size = streamSize;
+		if (size == 0 || data[size - 1] == 0)
+			return false;
+		position = (int64_t)size * 8 - 8 + highbit(data[size - 1]);
+		return true;
+	}
+	// Bits [start, start + count[ of the stream, count up to 56
+	uint64_t bits(int64_t start, uint32_t count) const
+	{
+		if (count == 0 || start + count <= 0)
+			return 0;
+		if (start < 0)
+			return bits(0, (uint32_t)(count + start)) << (-start);
+		size_t byte = (size_t)(start >> 3);
+		uint64_t word = 0;
+		if (byte + 8 <= size)
+			memcpy(&word, data + byte, sizeof(uint64_t)); // Little endian hosts
+		else
+			for (size_t i = 0; byte + i < size; i++)
+				word |= (uint64_t)data[byte + i] << (8 * i);
+		return (word >> (start & 7)) & ((1ULL << count) - 1);
+	}
+	uint64_t peek(uint32_t count) const { return bits(position - count, count); }
+	void skip(uint32_t count) { position -= count; }
+	uint64_t read(uint32_t count)
+	{
+		position -= count;
+		return bits(position, count);
+	}
+	bool overflow() const { return position < 0; }
+};
+
+// Bits written forward, to be read backward
+struct BitWriter {
+	std::vector<uint8_t> bytes;
+	uint64_t container = 0;
+	uint32_t count = 0;
+
+	// Add up to 32 bits
+	void add(uint64_t value, uint32_t bits)
+	{
+		container |= (value & ((1ULL << bits) - 1)) << count;
+		count += bits;
+		if (count >= 32)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				bytes.push_back((uint8_t)(container >> (8 * i)));
+			container >>= 32;
+			count -= 32;
+		}
+	}
+	// End the stream with its marker
+	void close()
+	{
+		add(1, 1);
+		for (; count > 0; count = count > 8 ? count - 8 : 0)
+		{
+			bytes.push_back((uint8_t)container);
+			container >>= 8;
+		}
+	}
+};
+
+struct FSEEntry {
+	uint16_t baseline;
+	uint8_t bits;
+	uint8_t symbol;
+};
+
+struct FSETable {
+	FSEEntry entries[1 << 9];
+	uint32_t accuracyLog;
+	bool valid;
+};
+
+// Spread symbols of a distribution over a table of 1 << accuracyLog states, as both coders do
+static bool spreadSymbols(const int16_t* probabilities, uint32_t symbolCount, uint32_t accuracyLog, uint8_t* symbols)
+{
+	uint32_t size = 1U << accuracyLog;
+	uint32_t high = size - 1;
+	for (uint32_t s = 0; s < symbolCount; s++)
+		if (probabilities[s] == -1)
+			symbols[high--] = (uint8_t)s;
+	uint32_t position = 0;
+	uint32_t step = (size >> 1) + (size >> 3) + 3;
+	for (uint32_t s = 0; s < symbolCount; s++)
+	{
+		for (int16_t i = 0; i < probabilities[s]; i++)
+		{
+			symbols[position] = (uint8_t)s;
+			do {
+				position = (position + step) & (size - 1);
+			} while (position > high);
+		}
+	}
+	return position == 0;
+}
+
+static bool buildFSETable(FSETable& table, const int16_t* probabilities, uint32_t symbolCount, uint32_t accuracyLog)
+{
+	uint32_t size = 1U << accuracyLog;
+	uint8_t symbols[1 << 9];
+	if (!spreadSymbols(probabilities, symbolCount, accuracyLog, symbols))
+		return false;
+	uint16_t next[256];
+	for (uint32_t s = 0; s < symbolCount; s++)
+		next[s] = probabilities[s] == -1 ? 1 : probabilities[s];
+	for (uint32_t u = 0; u < size; u++)
+	{
+		uint32_t state = next[symbols[u]]++;
+		uint32_t bits = accuracyLog - highbit(state);
+		table.entries[u] = FSEEntry{ (uint16_t)((state << bits) - size), (uint8_t)bits, symbols[u] };
+	}
+	table.accuracyLog = accuracyLog;
+	table.valid = true;
+	return true;
+}
+
+// Read a normalized distribution, return bytes read or 0 if malformed
+static size_t readDistribution(const uint8_t* data, size_t size, uint32_t maxSymbolCount, uint32_t maxLog, int16_t* probabilities, uint32_t& symbolCount, uint32_t& accuracyLog)
+{
+	uint64_t position = 0;
+	// Bits past the end read as zeros, the final position is checked
+	auto peek = [&](uint32_t count) {
+		uint32_t value = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint64_t bit = position + i;
+			if (bit / 8 < size)
+				value |= ((data[bit / 8] >> (bit % 8)) & 1U) << i;
+		}
+		return value;
+	};
+	accuracyLog = peek(4) + 5;
+	position += 4;
+	if (accuracyLog > maxLog)
+		return 0;
+	int32_t remaining = (1 << accuracyLog) + 1;
+	int32_t threshold = 1 << accuracyLog;
+	uint32_t bits = accuracyLog + 1;
+	uint32_t symbol = 0;
+	bool previousZero = false;
+	for (uint32_t s = 0; s < maxSymbolCount; s++)
+		probabilities[s] = 0;
+	while (remaining > 1 && symbol < maxSymbolCount)
+	{
+		if (previousZero)
+		{
+			uint32_t repeat;
+			do {
+				repeat = peek(2);
+				position += 2;
+				symbol += repeat;
+			} while (repeat == 3 && position <= size * 8);
+			if (symbol >= maxSymbolCount)
+				return 0;
+		}
+		int32_t max = (2 * threshold - 1) - remaining;
+		int32_t value = (int32_t)peek(bits);
+		int32_t count;
+		if ((value & (threshold - 1)) < max)
+		{
+			count = value & (threshold - 1);
+			position += bits - 1;
+		}
+		else
+		{
+			count = value & (2 * threshold - 1);
+			if (count >= threshold)
+				count -= max;
+			position += bits;
+		}
+		count--;
+		remaining -= count < 0 ? -count : count;
+		if (remaining < 1)
+			return 0;
+		probabilities[symbol++] = (int16_t)count;
+		previousZero = count == 0;
+		while (remaining < threshold)
+		{
+			bits--;
+			threshold >>= 1;
+		}
+	}
+	if (remaining != 1 || position > size * 8)
+		return 0;
+	symbolCount = symbol;
+	return (size_t)((position + 7) / 8);
+}
+
+struct HuffmanEntry {
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+struct HuffmanTable {
+	HuffmanEntry entries[1 << maxHuffmanBits];
+	uint32_t maxBits;
+	bool valid;
+};
+
+// Read a Huffman tree description, return bytes read or 0 if malformed
+static size_t readHuffmanTable(const uint8_t* data, size_t size, HuffmanTable& table)
+{
+	if (size == 0)
+		return 0;
+	uint8_t weights[256] = {};
+	uint32_t weightCount = 0;
+	size_t read;
+	if (data[0] >= 128)
+	{
+		// 4 bits per weight
+		weightCount = data[0] - 127;
+		read = 1 + (weightCount + 1) / 2;
+		if (read > size)
+			return 0;
+		for (uint32_t i = 0; i < weightCount; i++)
+			weights[i] = (i % 2 == 0) ? data[1 + i / 2] >> 4 : data[1 + i / 2] & 15;
+	}
+	else
+	{
+		// Weights compressed with FSE, decoded by two interleaved states
+		read = 1 + (size_t)data[0];
+		if (read > size)
+			return 0;
+		int16_t probabilities[16];
+		uint32_t symbolCount, accuracyLog;
+		size_t header = readDistribution(data + 1, data[0], 16, 6, probabilities, symbolCount, accuracyLog);
+		FSETable fse;
+		BackwardReader reader;
+		if (header == 0 || !buildFSETable(fse, probabilities, symbolCount, accuracyLog) || !reader.init(data + 1 + header, data[0] - header))
+			return 0;
+		uint32_t states[2];
+		states[0] = (uint32_t)reader.read(accuracyLog);
+		states[1] = (uint32_t)reader.read(accuracyLog);
+		for (uint32_t s = 0; ; s ^= 1)
+		{
+			if (weightCount >= 255)
+				return 0;
+			const FSEEntry& entry = fse.entries[states[s]];
+			weights[weightCount++] = entry.symbol;
+			states[s] = entry.baseline + (uint32_t)reader.read(entry.bits);
+			if (reader.overflow())
+			{
+				weights[weightCount++] = fse.entries[states[s ^ 1]].symbol;
+				break;
+			}
+		}
+	}
+	// Last weight completes the code, its weight is implied
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < weightCount; i++)
+	{
+		if (weights[i] > maxHuffmanBits)
+			return 0;
+		if (weights[i] > 0)
+			total += 1U << (weights[i] - 1);
+	}
+	if (total == 0)
+		return 0;
+	uint32_t maxBits = highbit(total) + 1;
+	uint32_t left = (1U << maxBits) - total;
+	if (maxBits > maxHuffmanBits || (left & (left - 1)) != 0)
+		return 0;
+	weights[weightCount++] = (uint8_t)(highbit(left) + 1);
+	// Codes of a weight follow those of lower weights, in symbol order
+	uint32_t position = 0;
+	for (uint32_t weight = 1; weight <= maxBits; weight++)
+	{
+		for (uint32_t s = 0; s < weightCount; s++)
+		{
+			if (weights[s] != weight)
+				continue;
+			for (uint32_t i = 0; i < (1U << (weight - 1)); i++)
+				table.entries[position++] = HuffmanEntry{ (uint8_t)s, (uint8_t)(maxBits + 1 - weight) };
+		}
+	}
+	table.maxBits = maxBits;
+	table.valid = true;
+	return read;
+}
+
+static bool decodeHuffmanStream(const HuffmanTable& table, const uint8_t* data, size_t size, uint8_t* output, size_t count)
+{
+	BackwardReader reader;
+	if (!reader.init(data, size))
+		return false;
+	for (size_t i = 0; i < count; i++)
+	{
+		const HuffmanEntry& entry = table.entries[reader.peek(table.maxBits)];
+		output[i] = entry.symbol;
+		reader.skip(entry.bits);
+	}
+	return reader.position == 0;
+}
+
+// Entropy tables & repeat offsets shared by blocks of a frame
+struct Context {
+	std::vector<uint8_t> literals;
+	HuffmanTable huffman;
+	FSETable literalLengths;
+	FSETable offsets;
+	FSETable matchLengths;
+	size_t repeats[3];
+
+	Context() : literals(blockSizeMax) {}
+	void reset()
+	{
+		huffman.valid = false;
+		literalLengths.valid = false;
+		offsets.valid = false;
+		matchLengths.valid = false;
+		repeats[0] = 1;
+		repeats[1] = 4;
+		repeats[2] = 8;
+	}
+};
+
+// Offset of a sequence from its offset value & update the repeated offsets, same on both sides.
+// Values 1 to 3 select a repeated offset, shifted by one without literals.
+static size_t updateRepeats(size_t* repeats, uint32_t offsetValue, bool noLiterals)
+{
+	if (offsetValue > 3)
+	{
+		repeats[2] = repeats[1];
+		repeats[1] = repeats[0];
+		repeats[0] = offsetValue - 3;
+		return repeats[0];
+	}
+	uint32_t index = offsetValue - 1 + (noLiterals ? 1 : 0);
+	if (index == 0)
+		return repeats[0];
+	size_t offset = index == 3 ? repeats[0] - 1 : repeats[index];
+	if (index != 1)
+		repeats[2] = repeats[1];
+	repeats[1] = repeats[0];
+	repeats[0] = offset;
+	return offset;
+}
+
+static bool decodeLiterals(const uint8_t*& ip, const uint8_t* iend, Context& context, const uint8_t*& literals, size_t& literalCount)
+{
+	if (ip >= iend)
+		return false;
+	uint32_t type = ip[0] & 3;
+	uint32_t format = (ip[0] >> 2) & 3;
+	if (type == RawLiterals || type == RLELiterals)
+	{
+		size_t header = (format & 1) == 0 ? 1 : format == 1 ? 2 : 3;
+		if ((size_t)(iend - ip) < header)
+			return false;
+		if (header == 1)
+			literalCount = ip[0] >> 3;
+		else
+			literalCount = (ip[0] >> 4) + (readLE(ip + 1, header - 1) << 4);
+		ip += header;
+		if (literalCount > blockSizeMax)
+			return false;
+		if (type == RawLiterals)
+		{
+			if ((size_t)(iend - ip) < literalCount)
+				return false;
+			literals = ip;
+			ip += literalCount;
+			return true;
+		}
+		if (ip >= iend)
+			return false;
+		memset(context.literals.data(), *ip++, literalCount);
+		literals = context.literals.data();
+		return true;
+	}
+	size_t header = format < 2 ? 3 : format + 2;
+	uint32_t sizeBits = format < 2 ? 10 : format == 2 ? 14 : 18;
+	if ((size_t)(iend - ip) < header)
+		return false;
+	uint64_t value = 0;
+	for (size_t i = 0; i < header; i++)
+		value |= (uint64_t)ip[i] << (8 * i);
+	literalCount = (size_t)((value >> 4) & ((1U << sizeBits) - 1));
+	size_t size = (size_t)((value >> (4 + sizeBits)) & ((1U << sizeBits) - 1));
+	ip += header;
+	if (literalCount > blockSizeMax || (size_t)(iend - ip) < size)
+		return false;
+	const uint8_t* data = ip;
+	ip += size;
+	if (type == CompressedLiterals)
+	{
+		size_t table = readHuffmanTable(data, size, context.huffman);
+		if (table == 0)
+			return false;
+		data += table;
+		size -= table;
+	}
+	else if (!context.huffman.valid)
+		return false;
+	uint8_t* output = context.literals.data();
+	literals = output;
+	if (format == 0)
+		return decodeHuffmanStream(context.huffman, data, size, output, literalCount);
+	// 4 streams, after a jump table of the 3 first stream sizes
+	if (size < 6)
+		return false;
+	size_t sizes[4] = { readLE(data, 2), readLE(data + 2, 2), readLE(data + 4, 2), 0 };
+	if (sizes[0] + sizes[1] + sizes[2] > size - 6)
+		return false;
+	sizes[3] = size - 6 - sizes[0] - sizes[1] - sizes[2];
+	size_t segment = (literalCount + 3) / 4;
+	if (segment * 3 > literalCount)
+		return false;
+	data += 6;
+	for (size_t i = 0; i < 4; i++)
+	{
+		size_t count = i < 3 ? segment : literalCount - segment * 3;
+		if (!decodeHuffmanStream(context.huffman, data, sizes[i], output + segment * i, count))
+			return false;
+		data += sizes[i];
+	}
+	return true;
+}
+
+static bool readSymbolTable(FSETable& table, uint32_t mode, const SymbolStream& stream, const uint8_t*& ip, const uint8_t* iend)
+{
+	switch (mode)
+	{
+	case PredefinedMode:
+		return buildFSETable(table, stream.defaults, stream.defaultCount, stream.defaultLog);
+	case RLEMode:
+		if (ip >= iend || *ip >= stream.symbolCount)
+			return false;
+		table.entries[0] = FSEEntry{ 0, 0, *ip++ };
+		table.accuracyLog = 0;
+		table.valid = true;
+		return true;
+	case CompressedMode: {
+		int16_t probabilities[53];
+		uint32_t symbolCount, accuracyLog;
+		size_t read = readDistribution(ip, iend - ip, stream.symbolCount, stream.maxLog, probabilities, symbolCount, accuracyLog);
+		if (read == 0)
+			return false;
+		ip += read;
+		return buildFSETable(table, probabilities, symbolCount, accuracyLog);
+	}
+	default:
+		return table.valid;
+	}
+}
+
+// Decode a compressed block after the output written by previous blocks of its frame
+static bool decodeBlock(const uint8_t* ip, const uint8_t* iend, Context& context, const uint8_t* frame, uint8_t*& op, const uint8_t* oend)
+{
+	const uint8_t* literals;
+	size_t literalCount;
+	if (!decodeLiterals(ip, iend, context, literals, literalCount))
+		return false;
+	if (ip >= iend)
+		return false;
+	size_t sequenceCount = *ip++;
+	if (sequenceCount == 255)
+	{
+		if (iend - ip < 2)
+			return false;
+		sequenceCount = readLE(ip, 2) + 0x7F00;
+		ip += 2;
+	}
+	else if (sequenceCount >= 128)
+	{
+		if (ip >= iend)
+			return false;
+		sequenceCount = ((sequenceCount - 128) << 8) + *ip++;
+	}
+	size_t literalOffset = 0;
+	if (sequenceCount > 0)
+	{
+		if (ip >= iend || (*ip & 3) != 0)
+			return false;
+		uint32_t modes = *ip++;
+		if (!readSymbolTable(context.literalLengths, modes >> 6, literalLengthStream, ip, iend) ||
+			!readSymbolTable(context.offsets, (modes >> 4) & 3, offsetStream, ip, iend) ||
+			!readSymbolTable(context.matchLengths, (modes >> 2) & 3, matchLengthStream, ip, iend))
+			return false;
+		BackwardReader reader;
+		if (!reader.init(ip, iend - ip))
+			return false;
+		uint32_t literalLengthState = (uint32_t)reader.read(context.literalLengths.accuracyLog);
+		uint32_t offsetState = (uint32_t)reader.read(context.offsets.accuracyLog);
+		uint32_t matchLengthState = (uint32_t)reader.read(context.matchLengths.accuracyLog);
+		for (size_t i = 0; i < sequenceCount; i++)
+		{
+			const FSEEntry& literalLength = context.literalLengths.entries[literalLengthState];
+			const FSEEntry& offset = context.offsets.entries[offsetState];
+			const FSEEntry& matchLength = context.matchLengths.entries[matchLengthState];
+			if (offset.symbol > 31)
+				return false;
+			// Extra bits are read offset first, states are updated literal length first
+			uint32_t offsetValue = (1U << offset.symbol) + (uint32_t)reader.read(offset.symbol);
+			size_t matchSize = matchLengthBaselines[matchLength.symbol] + (size_t)reader.read(matchLengthBits[matchLength.symbol]);
+			size_t literalSize = literalLengthBaselines[literalLength.symbol] + (size_t)reader.read(literalLengthBits[literalLength.symbol]);
+			if (i + 1 < sequenceCount)
+			{
+				literalLengthState = literalLength.baseline + (uint32_t)reader.read(literalLength.bits);
+				matchLengthState = matchLength.baseline + (uint32_t)reader.read(matchLength.bits);
+				offsetState = offset.baseline + (uint32_t)reader.read(offset.bits);
+			}
+			size_t distance = updateRepeats(context.repeats, offsetValue, literalSize == 0);
+			if (literalSize > literalCount - literalOffset || literalSize > (size_t)(oend - op))
+				return false;
+			if (literalSize > 0)
+				memcpy(op, literals + literalOffset, literalSize);
+			op += literalSize;
+			literalOffset += literalSize;
+			if (distance == 0 || distance > (size_t)(op - frame) || matchSize > (size_t)(oend - op))
+				return false;
+			// Match can overlap output when offset is smaller than its length
+			const uint8_t* match = op - distance;
+			if (distance >= matchSize)
+				memcpy(op, match, matchSize);
+			else
+				for (size_t j = 0; j < matchSize; j++)
+					op[j] = match[j];
+			op += matchSize;
+		}
+		if (reader.position != 0)
+			return false;
+	}
+	size_t rest = literalCount - literalOffset;
+	if (rest > (size_t)(oend - op))
+		return false;
+	if (rest > 0)
+		memcpy(op, literals + literalOffset, rest);
+	op += rest;
+	return true;
+}
+
+// Compression
+
+// Encoding of a symbol by the FSE encoder of a distribution
+struct FSETransform {
+	int32_t deltaFindState;
+	uint32_t deltaBits;
+};
+
+struct FSEEncoder {
+	uint16_t states[1 << 9];
+	FSETransform transforms[256];
+	uint32_t accuracyLog;
+	bool rle; // Single symbol, coded without bits
+};
+
+static void buildFSEEncoder(FSEEncoder& encoder, const int16_t* probabilities, uint32_t symbolCount, uint32_t accuracyLog)
+{
+	uint32_t size = 1U << accuracyLog;
+	uint8_t symbols[1 << 9];
+	spreadSymbols(probabilities, symbolCount, accuracyLog, symbols);
+	uint32_t cumulative[257];
+	cumulative[0] = 0;
+	for (uint32_t s = 0; s < symbolCount; s++)
+		cumulative[s + 1] = cumulative[s] + (probabilities[s] == -1 ? 1 : probabilities[s]);
+	for (uint32_t u = 0; u < size; u++)
+		encoder.states[cumulative[symbols[u]]++] = (uint16_t)(size + u);
+	int32_t total = 0;
+	for (uint32_t s = 0; s < symbolCount; s++)
+	{
+		int32_t probability = probabilities[s];
+		if (probability == 0)
+			encoder.transforms[s] = FSETransform{ 0, ((accuracyLog + 1) << 16) - size };
+		else if (probability == -1 || probability == 1)
+		{
+			encoder.transforms[s] = FSETransform{ total - 1, (accuracyLog << 16) - size };
+			total++;
+		}
+		else
+		{
+			uint32_t maxBits = accuracyLog - highbit(probability - 1);
+			encoder.transforms[s] = FSETransform{ total - probability, (maxBits << 16) - ((uint32_t)probability << maxBits) };
+			total += probability;
+		}
+	}
+	encoder.accuracyLog = accuracyLog;
+	encoder.rle = false;
+}
+
+struct FSEState {
+	const FSEEncoder* encoder;
+	uint32_t value;
+
+	void init(const FSEEncoder& fse, uint32_t symbol)
+	{
+		encoder = &fse;
+		value = 0;
+		if (fse.rle)
+			return;
+		const FSETransform& transform = fse.transforms[symbol];
+		uint32_t bits = (transform.deltaBits + (1 << 15)) >> 16;
+		uint32_t state = (bits << 16) - transform.deltaBits;
+		value = fse.states[(state >> bits) + transform.deltaFindState];
+	}
+	void encode(BitWriter& writer, uint32_t symbol)
+	{
+		if (encoder->rle)
+			return;
+		const FSETransform& transform = encoder->transforms[symbol];
+		uint32_t bits = (value + transform.deltaBits) >> 16;
+		writer.add(value, bits);
+		value = encoder->states[(value >> bits) + transform.deltaFindState];
+	}
+	void flush(BitWriter& writer)
+	{
+		if (!encoder->rle)
+			writer.add(value, encoder->accuracyLog);
+	}
+};
+
+// Smallest accuracy fitting the symbols, largest the sample can fill
+static uint32_t getAccuracyLog(size_t sampleCount, uint32_t maxSymbol, uint32_t maxLog)
+{
+	uint32_t log = maxLog;
+	uint32_t sampleBits = highbit((uint32_t)(sampleCount - 1)) - 2;
+	if (sampleCount > 4 && sampleBits < log)
+		log = sampleBits;
+	uint32_t minLog = std::min(highbit((uint32_t)(sampleCount - 1)) + 1, highbit(maxSymbol) + 2);
+	log = std::max(log, minLog);
+	return std::max(5U, std::min(log, maxLog));
+}
+
+// Scale counts to a distribution summing to 1 << accuracyLog, every present symbol keeps at least 1
+static void normalizeCounts(const uint32_t* counts, uint32_t symbolCount, size_t total, uint32_t accuracyLog, int16_t* probabilities)
+{
+	int32_t size = 1 << accuracyLog;
+	int32_t sum = 0;
+	uint32_t largest = 0;
+	for (uint32_t s = 0; s < symbolCount; s++)
+	{
+		probabilities[s] = 0;
+		if (counts[s] == 0)
+			continue;
+		probabilities[s] = (int16_t)std::max<uint64_t>(1, ((uint64_t)counts[s] * size + total / 2) / total);
+		sum += probabilities[s];
+		if (counts[s] > counts[largest])
+			largest = s;
+	}
+	// Rounding error goes to the largest symbols
+	while (sum != size)
+	{
+		if (sum < size)
+		{
+			probabilities[largest] += (int16_t)(size - sum);
+			sum = size;
+			break;
+		}
+		uint32_t pick = largest;
+		for (uint32_t s = 0; s < symbolCount; s++)
+			if (probabilities[s] > probabilities[pick])
+				pick = s;
+		int32_t excess = std::min<int32_t>(sum - size, (probabilities[pick] + 1) / 2);
+		probabilities[pick] -= (int16_t)excess;
+		sum -= excess;
+	}
+}
+
+// Write a normalized distribution in the header format read by readDistribution
+static void writeDistribution(std::vector<uint8_t>& output, const int16_t* probabilities, uint32_t symbolCount, uint32_t accuracyLog)
+{
+	uint64_t container = 0;
+	uint32_t count = 0;
+	auto add = [&](uint32_t value, uint32_t bits) {
+		container |= (uint64_t)value << count;
+		count += bits;
+		while (count >= 8)
+		{
+			output.push_back((uint8_t)container);
+			container >>= 8;
+			count -= 8;
+		}
+	};
+	add(accuracyLog - 5, 4);
+	int32_t remaining = (1 << accuracyLog) + 1;
+	int32_t threshold = 1 << accuracyLog;
+	uint32_t bits = accuracyLog + 1;
+	uint32_t symbol = 0;
+	bool previousZero = false;
+	while (symbol < symbolCount && remaining > 1)
+	{
+		if (previousZero)
+		{
+			uint32_t start = symbol;
+			while (symbol < symbolCount && probabilities[symbol] == 0)
+				symbol++;
+			for (; symbol >= start + 3; start += 3)
+				add(3, 2);
+			add(symbol - start, 2);
+		}
+		int32_t value = probabilities[symbol++];
+		int32_t max = (2 * threshold - 1) - remaining;
+		remaining -= value < 0 ? -value : value;
+		value++;
+		if (value >= threshold)
+			value += max;
+		add((uint32_t)value, value < max ? bits - 1 : bits);
+		previousZero = value == 1;
+		while (remaining < threshold)
+		{
+			bits--;
+			threshold >>= 1;
+		}
+	}
+	if (count > 0)
+		output.push_back((uint8_t)container);
+}
+
+static uint32_t getLiteralLengthCode(uint32_t length)
+{
+	if (length >= 64)
+		return highbit(length) + 19;
+	uint32_t code = length < 16 ? length : 16;
+	while (code + 1 < 36 && literalLengthBaselines[code + 1] <= length)
+		code++;
+	return code;
+}
+
+static uint32_t getMatchLengthCode(uint32_t length)
+{
+	uint32_t base = length - 3;
+	if (base >= 128)
+		return highbit(base) + 36;
+	uint32_t code = base < 32 ? base : 32;
+	while (code + 1 < 53 && matchLengthBaselines[code + 1] <= length)
+		code++;
+	return code;
+}
+
+struct Sequence {
+	uint32_t literalLength;
+	uint32_t matchLength;
+	uint32_t offsetValue;
+};
+
+// Bits to code symbols with a distribution, probabilities lower than 1 count as 1
+static double getCost(const uint32_t* counts, uint32_t symbolCount, const int16_t* probabilities, uint32_t accuracyLog)
+{
+	double cost = 0.0;
+	for (uint32_t s = 0; s < symbolCount; s++)
+	{
+		if (counts[s] == 0)
+			continue;
+		if (probabilities[s] == 0)
+			return 1e30;
+		cost += counts[s] * (accuracyLog - std::log2((double)std::max<int16_t>(probabilities[s], 1)));
+	}
+	return cost;
+}
+
+// Choose the mode coding a sequence stream, write its table & build its encoder
+static uint32_t writeSymbolTable(std::vector<uint8_t>& output, FSEEncoder& encoder, const uint8_t* codes, size_t count, const SymbolStream& stream)
+{
+	uint32_t counts[53] = {};
+	uint32_t maxSymbol = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		counts[codes[i]]++;
+		maxSymbol = std::max<uint32_t>(maxSymbol, codes[i]);
+	}
+	if (counts[codes[0]] == count && count > 2)
+	{
+		output.push_back(codes[0]);
+		encoder.rle = true;
+		encoder.accuracyLog = 0;
+		return RLEMode;
+	}
+	double predefinedCost = maxSymbol < stream.defaultCount ? getCost(counts, stream.defaultCount, stream.defaults, stream.defaultLog) : 1e30;
+	uint32_t accuracyLog = getAccuracyLog(count, maxSymbol, stream.maxLog);
+	int16_t probabilities[53];
+	normalizeCounts(counts, maxSymbol + 1, count, accuracyLog, probabilities);
+	std::vector<uint8_t> table;
+	writeDistribution(table, probabilities, maxSymbol + 1, accuracyLog);
+	double compressedCost = getCost(counts, maxSymbol + 1, probabilities, accuracyLog) + table.size() * 8.0;
+	if (predefinedCost <= compressedCost)
+	{
+		buildFSEEncoder(encoder, stream.defaults, stream.defaultCount, stream.defaultLog);
+		return PredefinedMode;
+	}
+	output.insert(output.end(), table.begin(), table.end());
+	buildFSEEncoder(encoder, probabilities, maxSymbol + 1, accuracyLog);
+	return CompressedMode;
+}
+
+static void writeSequences(std::vector<uint8_t>& output, const std::vector<Sequence>& sequences)
+{
+	size_t count = sequences.size();
+	if (count < 128)
+		output.push_back((uint8_t)count);
+	else if (count < 0x7F00)
+	{
+		output.push_back((uint8_t)((count >> 8) + 128));
+		output.push_back((uint8_t)count);
+	}
+	else
+	{
+		output.push_back(255);
+		output.push_back((uint8_t)(count - 0x7F00));
+		output.push_back((uint8_t)((count - 0x7F00) >> 8));
+	}
+	if (count == 0)
+		return;
+	std::vector<uint8_t> literalLengthCodes(count), offsetCodes(count), matchLengthCodes(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		literalLengthCodes[i] = (uint8_t)getLiteralLengthCode(sequences[i].literalLength);
+		offsetCodes[i] = (uint8_t)highbit(sequences[i].offsetValue);
+		matchLengthCodes[i] = (uint8_t)getMatchLengthCode(sequences[i].matchLength);
+	}
+	size_t modes = output.size();
+	output.push_back(0);
+	FSEEncoder literalLengths, offsets, matchLengths;
+	uint32_t literalLengthMode = writeSymbolTable(output, literalLengths, literalLengthCodes.data(), count, literalLengthStream);
+	uint32_t offsetMode = writeSymbolTable(output, offsets, offsetCodes.data(), count, offsetStream);
+	uint32_t matchLengthMode = writeSymbolTable(output, matchLengths, matchLengthCodes.data(), count, matchLengthStream);
+	output[modes] = (uint8_t)((literalLengthMode << 6) | (offsetMode << 4) | (matchLengthMode << 2));
+
+	// Sequences are written last to first, so that the decoder reads them in order
+	BitWriter writer;
+	FSEState literalLengthState, offsetState, matchLengthState;
+	auto addExtraBits = [&](size_t i) {
+		writer.add(sequences[i].literalLength - literalLengthBaselines[literalLengthCodes[i]], literalLengthBits[literalLengthCodes[i]]);
+		writer.add(sequences[i].matchLength - matchLengthBaselines[matchLengthCodes[i]], matchLengthBits[matchLengthCodes[i]]);
+		writer.add(sequences[i].offsetValue - (1U << offsetCodes[i]), offsetCodes[i]);
+	};
+	matchLengthState.init(matchLengths, matchLengthCodes[count - 1]);
+	offsetState.init(offsets, offsetCodes[count - 1]);
+	literalLengthState.init(literalLengths, literalLengthCodes[count - 1]);
+	addExtraBits(count - 1);
+	for (size_t i = count - 1; i-- > 0;)
+	{
+		offsetState.encode(writer, offsetCodes[i]);
+		matchLengthState.encode(writer, matchLengthCodes[i]);
+		literalLengthState.encode(writer, literalLengthCodes[i]);
+		addExtraBits(i);
+	}
+	matchLengthState.flush(writer);
+	offsetState.flush(writer);
+	literalLengthState.flush(writer);
+	writer.close();
+	output.insert(output.end(), writer.bytes.begin(), writer.bytes.end());
+}
+
+// Code lengths of a complete prefix code, limited to maxHuffmanBits. Return the longest length.
+static uint32_t buildHuffmanLengths(const uint32_t* counts, uint32_t symbolCount, uint8_t* lengths)
+{
+	// Huffman tree over present symbols, nodes after the leaves are internal
+	std::vector<uint32_t> weights, parents;
+	std::vector<uint32_t> leaves;
+	for (uint32_t s = 0; s < symbolCount; s++)
+	{
+		lengths[s] = 0;
+		if (counts[s] == 0)
+			continue;
+		leaves.push_back(s);
+		weights.push_back(counts[s]);
+	}
+	parents.assign(weights.size(), 0);
+	using Node = std::pair<uint64_t, uint32_t>;
+	std::priority_queue<Node, std::vector<Node>, std::greater<Node>> queue;
+	for (uint32_t i = 0; i < weights.size(); i++)
+		queue.push(Node{ weights[i], i });
+	while (queue.size() > 1)
+	{
+		Node a = queue.top();
+		queue.pop();
+		Node b = queue.top();
+		queue.pop();
+		uint32_t node = (uint32_t)parents.size();
+		parents.push_back(0);
+		parents[a.second] = node;
+		parents[b.second] = node;
+		queue.push(Node{ a.first + b.first, node });
+	}
+	// Depths are found from the root down, parents are created after their children
+	std::vector<uint32_t> depths(parents.size(), 0);
+	for (size_t node = parents.size() - 1; node-- > 0;)
+		depths[node] = depths[parents[node]] + 1;
+	const uint32_t unit = 1U << maxHuffmanBits;
+	uint32_t kraft = 0;
+	for (uint32_t i = 0; i < leaves.size(); i++)
+	{
+		lengths[leaves[i]] = (uint8_t)std::min(depths[i], maxHuffmanBits);
+		kraft += unit >> lengths[leaves[i]];
+	}
+	// Lengthen the rarest of the longest codes below the limit until the code fits
+	while (kraft > unit)
+	{
+		uint32_t pick = symbolCount;
+		for (uint32_t s : leaves)
+			if (lengths[s] < maxHuffmanBits && (pick == symbolCount || lengths[s] > lengths[pick] || (lengths[s] == lengths[pick] && counts[s] < counts[pick])))
+				pick = s;
+		kraft -= unit >> (lengths[pick] + 1);
+		lengths[pick]++;
+	}
+	// Shorten the most frequent codes the slack allows until the code is complete
+	while (kraft < unit)
+	{
+		uint32_t pick = symbolCount;
+		for (uint32_t s : leaves)
+			if (lengths[s] > 1 && (unit >> lengths[s]) <= unit - kraft && (pick == symbolCount || counts[s] > counts[pick]))
+				pick = s;
+		kraft += unit >> lengths[pick];
+		lengths[pick]--;
+	}
+	uint32_t maxBits = 0;
+	for (uint32_t s : leaves)
+		maxBits = std::max<uint32_t>(maxBits, lengths[s]);
+	return maxBits;
+}
+
+// Write weights of every symbol but the last, FSE compressed if smaller. Return false if they can't be written.
+static bool writeHuffmanWeights(std::vector<uint8_t>& output, const uint8_t* weights, uint32_t weightCount)
+{
+	uint32_t counts[16] = {};
+	uint32_t maxWeight = 0;
+	for (uint32_t i = 0; i < weightCount; i++)
+	{
+		counts[weights[i]]++;
+		maxWeight = std::max<uint32_t>(maxWeight, weights[i]);
+	}
+	std::vector<uint8_t> compressed;
+	if (weightCount > 1 && counts[weights[0]] < weightCount && *std::max_element(counts, counts + 16) > 1)
+	{
+		uint32_t accuracyLog = getAccuracyLog(weightCount, maxWeight, 6);
+		int16_t probabilities[16];
+		normalizeCounts(counts, maxWeight + 1, weightCount, accuracyLog, probabilities);
+		FSEEncoder encoder;
+		writeDistribution(compressed, probabilities, maxWeight + 1, accuracyLog);
+		buildFSEEncoder(encoder, probabilities, maxWeight + 1, accuracyLog);
+		// Two interleaved states, the first one decodes the first weight
+		BitWriter writer;
+		FSEState states[2];
+		uint32_t i = weightCount;
+		if (weightCount % 2 == 1)
+		{
+			states[0].init(encoder, weights[--i]);
+			states[1].init(encoder, weights[--i]);
+			states[0].encode(writer, weights[--i]);
+		}
+		else
+		{
+			states[1].init(encoder, weights[--i]);
+			states[0].init(encoder, weights[--i]);
+		}
+		while (i > 0)
+		{
+			states[1].encode(writer, weights[--i]);
+			states[0].encode(writer, weights[--i]);
+		}
+		states[1].flush(writer);
+		states[0].flush(writer);
+		writer.close();
+		compressed.insert(compressed.end(), writer.bytes.begin(), writer.bytes.end());
+	}
+	size_t directSize = (weightCount + 1) / 2;
+	if (!compressed.empty() && compressed.size() < 128 && (weightCount > 128 || compressed.size() < directSize))
+	{
+		output.push_back((uint8_t)compressed.size());
+		output.insert(output.end(), compressed.begin(), compressed.end());
+		return true;
+	}
+	if (weightCount > 128)
+		return false;
+	output.push_back((uint8_t)(127 + weightCount));
+	for (uint32_t i = 0; i < weightCount; i += 2)
+		output.push_back((uint8_t)((weights[i] << 4) | (i + 1 < weightCount ? weights[i + 1] : 0)));
+	return true;
+}
+
+static void writeLiteralsHeader(std::vector<uint8_t>& output, uint32_t type, size_t count)
+{
+	if (count < 32)
+		output.push_back((uint8_t)(type | (count << 3)));
+	else if (count < 4096)
+	{
+		output.push_back((uint8_t)(type | (1 << 2) | ((count & 15) << 4)));
+		output.push_back((uint8_t)(count >> 4));
+	}
+	else
+	{
+		output.push_back((uint8_t)(type | (3 << 2) | ((count & 15) << 4)));
+		output.push_back((uint8_t)(count >> 4));
+		output.push_back((uint8_t)(count >> 12));
+	}
+}
+
+// Huffman coded literals, false if they would not be smaller than raw ones
+static bool writeHuffmanLiterals(std::vector<uint8_t>& output, const uint8_t* literals, size_t count)
+{
+	uint32_t counts[256] = {};
+	for (size_t i = 0; i < count; i++)
+		counts[literals[i]]++;
+	uint32_t lastSymbol = 255;
+	while (counts[lastSymbol] == 0)
+		lastSymbol--;
+	uint8_t lengths[256];
+	uint32_t maxBits = buildHuffmanLengths(counts, lastSymbol + 1, lengths);
+	uint8_t weights[256];
+	for (uint32_t s = 0; s <= lastSymbol; s++)
+		weights[s] = lengths[s] > 0 ? (uint8_t)(maxBits + 1 - lengths[s]) : 0;
+	std::vector<uint8_t> body;
+	if (!writeHuffmanWeights(body, weights, lastSymbol))
+		return false;
+	// Codes of a weight follow those of lower weights, in symbol order, as the decoder table is filled
+	uint16_t codes[256];
+	uint32_t position = 0;
+	for (uint32_t weight = 1; weight <= maxBits; weight++)
+	{
+		for (uint32_t s = 0; s <= lastSymbol; s++)
+		{
+			if (weights[s] != weight)
+				continue;
+			codes[s] = (uint16_t)(position >> (weight - 1));
+			position += 1U << (weight - 1);
+		}
+	}
+	// Symbols are written last to first, so that the decoder reads them in order
+	auto writeStream = [&](const uint8_t* symbols, size_t symbolCount) {
+		BitWriter writer;
+		for (size_t i = symbolCount; i-- > 0;)
+			writer.add(codes[symbols[i]], lengths[symbols[i]]);
+		writer.close();
+		return writer.bytes;
+	};
+	bool singleStream = count < 256;
+	if (singleStream)
+	{
+		std::vector<uint8_t> stream = writeStream(literals, count);
+		body.insert(body.end(), stream.begin(), stream.end());
+	}
+	else
+	{
+		size_t segment = (count + 3) / 4;
+		std::vector<uint8_t> streams[4];
+		for (size_t i = 0; i < 4; i++)
+			streams[i] = writeStream(literals + segment * i, i < 3 ? segment : count - segment * 3);
+		for (size_t i = 0; i < 3; i++)
+		{
+			if (streams[i].size() > 0xFFFF)
+				return false;
+			body.push_back((uint8_t)streams[i].size());
+			body.push_back((uint8_t)(streams[i].size() >> 8));
+		}
+		for (size_t i = 0; i < 4; i++)
+			body.insert(body.end(), streams[i].begin(), streams[i].end());
+	}
+	size_t size = body.size();
+	uint32_t format = singleStream ? 0 : (count < 1024 && size < 1024) ? 1 : (count < 16384 && size < 16384) ? 2 : 3;
+	size_t header = format < 2 ? 3 : format + 2;
+	if (size + header >= count || size >= (1U << 18))
+		return false;
+	uint32_t sizeBits = format < 2 ? 10 : format == 2 ? 14 : 18;
+	uint64_t value = CompressedLiterals | (format << 2) | ((uint64_t)count << 4) | ((uint64_t)size << (4 + sizeBits));
+	for (size_t i = 0; i < header; i++)
+		output.push_back((uint8_t)(value >> (8 * i)));
+	output.insert(output.end(), body.begin(), body.end());
+	return true;
+}
+
+static void writeLiterals(std::vector<uint8_t>& output, const uint8_t* literals, size_t count)
+{
+	if (count > 0 && std::count(literals, literals + count, literals[0]) == (std::ptrdiff_t)count)
+	{
+		writeLiteralsHeader(output, RLELiterals, count);
+		output.push_back(literals[0]);
+		return;
+	}
+	if (count >= 64 && writeHuffmanLiterals(output, literals, count))
+		return;
+	writeLiteralsHeader(output, RawLiterals, count);
+	output.insert(output.end(), literals, literals + count);
+}
+
+// Offset value of a match, a repeated offset if it is one
+static uint32_t getOffsetValue(const size_t* repeats, size_t offset, bool noLiterals)
+{
+	if (!noLiterals)
+	{
+		for (uint32_t i = 0; i < 3; i++)
+			if (repeats[i] == offset)
+				return i + 1;
+	}
+	else
+	{
+		if (repeats[1] == offset)
+			return 1;
+		if (repeats[2] == offset)
+			return 2;
+		if (repeats[0] - 1 == offset)
+			return 3;
+	}
+	return (uint32_t)offset + 3;
+}
+
+// Hash chains of every position in a window before the current one
+struct MatchFinder {
+	static const uint32_t searchDepth = 16;
+	const uint8_t* source;
+	size_t size;
+	uint32_t hashLog;
+	std::vector<int32_t> heads;
+	std::vector<int32_t> chain;
+	size_t windowMask;
+	size_t next; // Next position to insert
+
+	MatchFinder(const uint8_t* data, size_t dataSize) : source(data), size(dataSize), next(0)
+	{
+		hashLog = std::max(10U, std::min(16U, highbit((uint32_t)std::min<size_t>(size, 1U << 20)) + 1));
+		size_t window = 1;
+		while (window < size && window < (1U << 20))
+			window <<= 1;
+		windowMask = window - 1;
+		heads.assign((size_t)1 << hashLog, -1);
+		chain.assign(window, -1);
+	}
+	uint32_t hash(size_t position) const
+	{
+		return (read32(source + position) * 2654435761U) >> (32 - hashLog);
+	}
+	void insert(size_t end)
+	{
+		for (; next < end && next + 4 <= size; next++)
+		{
+			uint32_t h = hash(next);
+			chain[next & windowMask] = heads[h];
+			heads[h] = (int32_t)next;
+		}
+	}
+	size_t length(size_t position, size_t reference, size_t end) const
+	{
+		size_t length = 0;
+		while (position + length < end && source[position + length] == source[reference + length])
+			length++;
+		return length;
+	}
+	// Longest match of position ending before end, 0 if none
+	size_t find(size_t position, size_t end, size_t& offset)
+	{
+		insert(position);
+		size_t best = 0;
+		int32_t candidate = heads[hash(position)];
+		for (uint32_t depth = 0; depth < searchDepth && candidate >= 0 && position - candidate <= windowMask; depth++)
+		{
+			size_t length = this->length(position, candidate, end);
+			if (length > best)
+			{
+				best = length;
+				offset = position - candidate;
+			}
+			candidate = chain[candidate & windowMask];
+		}
+		return best >= minMatch ? best : 0;
+	}
+};
+
+// Compressed content of the block [start, end[ of the source, false if it does not shrink
+static bool writeBlock(std::vector<uint8_t>& output, MatchFinder& finder, size_t start, size_t end, size_t* repeats)
+{
+	const uint8_t* source = finder.source;
+	std::vector<Sequence> sequences;
+	std::vector<uint8_t> literals;
+	size_t anchor = start;
+	size_t position = start;
+	while (position + minMatch <= end)
+	{
+		bool noLiterals = position == anchor;
+		// Repeated offsets cost a few bits, they are taken when as long as the best match
+		size_t repeatLength = 0, repeatOffset = 0;
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			size_t offset = (noLiterals && i == 0) ? repeats[0] - 1 : repeats[i];
+			if (offset == 0 || offset > position)
+				continue;
+			size_t length = finder.length(position, position - offset, end);
+			if (length > repeatLength)
+			{
+				repeatLength = length;
+				repeatOffset = offset;
+			}
+		}
+		size_t offset = 0;
+		size_t length = finder.find(position, end, offset);
+		if (repeatLength >= minMatch && repeatLength + 1 >= length)
+		{
+			length = repeatLength;
+			offset = repeatOffset;
+		}
+		if (length < minMatch)
+		{
+			position += 1 + ((position - anchor) >> 8);
+			continue;
+		}
+		// Extend match backward over pending literals
+		while (position > anchor && position > offset && source[position - 1] == source[position - 1 - offset])
+		{
+			position--;
+			length++;
+		}
+		Sequence sequence;
+		sequence.literalLength = (uint32_t)(position - anchor);
+		sequence.matchLength = (uint32_t)length;
+		sequence.offsetValue = getOffsetValue(repeats, offset, sequence.literalLength == 0);
+		updateRepeats(repeats, sequence.offsetValue, sequence.literalLength == 0);
+		sequences.push_back(sequence);
+		literals.insert(literals.end(), source + anchor, source + position);
+		position += length;
+		anchor = position;
+	}
+	literals.insert(literals.end(), source + anchor, source + end);
+	finder.insert(end);
+	writeLiterals(output, literals.data(), literals.size());
+	writeSequences(output, sequences);
+	return output.size() < end - start;
+}
+
+};
+
+size_t Zstd::compressBound(size_t size)
+{
+	// Frame header, then every block stored raw
+	return 4 + 1 + 8 + (size / zstd::blockSizeMax + 1) * 3 + size;
+}
+
+size_t Zstd::compress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity)
+{
+	using namespace zstd;
+	const uint8_t* src = (const uint8_t*)source;
+	std::vector<uint8_t> output;
+	output.reserve(std::min(compressBound(sourceSize), destinationCapacity));
+	// Single segment frame with its content size, without checksum nor dictionary
+	for (uint32_t i = 0; i < 4; i++)
+		output.push_back((uint8_t)(frameMagic >> (8 * i)));
+	uint32_t sizeFlag = sourceSize < 256 ? 0 : sourceSize < 65536 + 256 ? 1 : sourceSize <= 0xFFFFFFFFU ? 2 : 3;
+	output.push_back((uint8_t)((sizeFlag << 6) | 0x20));
+	uint64_t contentSize = sizeFlag == 1 ? sourceSize - 256 : sourceSize;
+	for (uint32_t i = 0; i < (sizeFlag == 0 ? 1U : 1U << sizeFlag); i++)
+		output.push_back((uint8_t)(contentSize >> (8 * i)));
+
+	MatchFinder finder(src, sourceSize);
+	size_t repeats[3] = { 1, 4, 8 };
+	size_t start = 0;
+	std::vector<uint8_t> block;
+	do {
+		size_t end = std::min(sourceSize, start + blockSizeMax);
+		size_t size = end - start;
+		uint32_t last = end == sourceSize ? 1 : 0;
+		block.clear();
+		size_t saved[3] = { repeats[0], repeats[1], repeats[2] };
+		uint32_t type;
+		if (size > 0 && std::count(src + start, src + end, src[start]) == (std::ptrdiff_t)size)
+		{
+			type = RLEBlock;
+			block.push_back(src[start]);
+			finder.insert(end);
+		}
+		else if (size > 0 && writeBlock(block, finder, start, end, repeats))
+			type = CompressedBlock;
+		else
+		{
+			// The decoder does not see sequences of a block stored raw
+			memcpy(repeats, saved, sizeof(saved));
+			type = RawBlock;
+			block.assign(src + start, src + end);
+		}
+		uint32_t header = last | (type << 1) | ((uint32_t)(type == CompressedBlock ? block.size() : size) << 3);
+		for (uint32_t i = 0; i < 3; i++)
+			output.push_back((uint8_t)(header >> (8 * i)));
+		output.insert(output.end(), block.begin(), block.end());
+		start = end;
+	} while (start < sourceSize);
+	if (output.size() > destinationCapacity)
+		return 0;
+	memcpy(destination, output.data(), output.size());
+	return output.size();
+}
+
+size_t Zstd::decompress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity)
+{
+	using namespace zstd;
+	const uint8_t* ip = (const uint8_t*)source;
+	const uint8_t* iend = ip + sourceSize;
+	uint8_t* dst = (uint8_t*)destination;
+	uint8_t* op = dst;
+	const uint8_t* oend = dst + destinationCapacity;
+	std::unique_ptr<Context> context;
+	while (ip < iend)
+	{
+		if (iend - ip < 4)
+			return 0;
+		uint32_t magic = readLE(ip, 4);
+		if ((magic & 0xFFFFFFF0U) == skippableMagic)
+		{
+			if (iend - ip < 8 || (size_t)(iend - ip - 8) < readLE(ip + 4, 4))
+				return 0;
+			ip += 8 + readLE(ip + 4, 4);
+			continue;
+		}
+		if (magic != frameMagic || iend - ip < 5)
+			return 0;
+		ip += 4;
+		uint8_t descriptor = *ip++;
+		uint32_t sizeFlag = descriptor >> 6;
+		bool singleSegment = (descriptor & 0x20) != 0;
+		bool checksum = (descriptor & 4) != 0;
+		const size_t dictionarySizes[4] = { 0, 1, 2, 4 };
+		size_t dictionarySize = dictionarySizes[descriptor & 3];
+		size_t contentSizeSize = sizeFlag == 0 ? (singleSegment ? 1 : 0) : (size_t)1 << sizeFlag;
+		if ((descriptor & 8) != 0 || (size_t)(iend - ip) < (singleSegment ? 0 : 1) + dictionarySize + contentSizeSize)
+			return 0;
+		// Whole output is kept, the window does not matter
+		if (!singleSegment)
+			ip++;
+		// Dictionaries are not supported
+		for (size_t i = 0; i < dictionarySize; i++)
+			if (*ip++ != 0)
+				return 0;
+		uint64_t contentSize = 0;
+		for (size_t i = 0; i < contentSizeSize; i++)
+			contentSize |= (uint64_t)*ip++ << (8 * i);
+		if (contentSizeSize == 2)
+			contentSize += 256;
+		if (context == nullptr)
+			context.reset(new Context());
+		context->reset();
+		uint8_t* frame = op;
+		bool last = false;
+		while (!last)
+		{
+			if (iend - ip < 3)
+				return 0;
+			uint32_t header = readLE(ip, 3);
+			ip += 3;
+			last = (header & 1) != 0;
+			size_t size = header >> 3;
+			if (size > blockSizeMax)
+				return 0;
+			switch ((header >> 1) & 3)
+			{
+			case RawBlock:
+				if ((size_t)(iend - ip) < size || (size_t)(oend - op) < size)
+					return 0;
+				memcpy(op, ip, size);
+				ip += size;
+				op += size;
+				break;
+			case RLEBlock:
+				if (ip >= iend || (size_t)(oend - op) < size)
+					return 0;
+				memset(op, *ip++, size);
+				op += size;
+				break;
+			case CompressedBlock:
+				if ((size_t)(iend - ip) < size || !decodeBlock(ip, ip + size, *context, frame, op, oend))
+					return 0;
+				ip += size;
+				break;
+			default:
+				return 0;
+			}
+		}
+		// Checksum is not verified
+		if (checksum)
+		{
+			if (iend - ip < 4)
+				return 0;
+			ip += 4;
+		}
+		if (contentSizeSize > 0 && (uint64_t)(op - frame) != contentSize)
+			return 0;
+	}
+	return op - dst;
+}
+
+uint32_t ChunkedPayload::getChunkCount(size_t rawSize)
+{
+	return (uint32_t)((rawSize + chunkSize - 1) / chunkSize);
+}
+
+std::vector<uint8_t> ChunkedPayload::compress(Codec codec, const uint8_t* raw, size_t rawSize, uint32_t chunk)
+{
+	const uint8_t* source = raw + (size_t)chunk * chunkSize;
+	size_t sourceSize = std::min(chunkSize, rawSize - (size_t)chunk * chunkSize);
+	std::vector<uint8_t> compressed;
+	size_t size = 0;
+	if (codec == Codec::LZ4)
+	{
+		compressed.resize(LZ4::compressBound(sourceSize));
+		size = LZ4::compress(source, sourceSize, compressed.data(), compressed.size());
+	}
+	else if (codec == Codec::Zstd)
+	{
+		compressed.resize(Zstd::compressBound(sourceSize));
+		size = Zstd::compress(source, sourceSize, compressed.data(), compressed.size());
+	}
+	if (size == 0 || size >= sourceSize)
+		compressed.assign(source, source + sourceSize);
+	else
+		compressed.resize(size);
+	return compressed;
+}
+
+std::vector<uint8_t> ChunkedPayload::join(const std::vector<std::vector<uint8_t>>& chunks)
+{
+	std::vector<uint8_t> payload(chunks.size() * sizeof(uint32_t));
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		uint32_t size = (uint32_t)chunks[i].size();
+		memcpy(payload.data() + i * sizeof(uint32_t), &size, sizeof(uint32_t));
+	}
+	for (const std::vector<uint8_t>& chunk : chunks)
+		payload.insert(payload.end(), chunk.begin(), chunk.end());
+	return payload;
+}
+
+bool ChunkedPayload::check(const uint8_t* payload, size_t size, size_t rawSize)
+{
+	// Every chunk has a size in the table, a corrupted raw size can't overflow the chunk count
+	if (rawSize / chunkSize > size / sizeof(uint32_t))
+		return false;
+	uint32_t chunkCount = getChunkCount(rawSize);
+	if ((size_t)chunkCount * sizeof(uint32_t) > size)
+		return false;
+	size_t offset = chunkCount * sizeof(uint32_t);
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		uint32_t chunkSize;
+		memcpy(&chunkSize, payload + i * sizeof(uint32_t), sizeof(uint32_t));
+		if (chunkSize > size - offset)
+			return false;
+		offset += chunkSize;
+	}
+	return offset == size;
+}
+
+bool ChunkedPayload::split(Codec codec, const uint8_t* payload, size_t size, uint8_t* destination, size_t rawSize, std::vector<Chunk>& chunks)
+{
+	if (!check(payload, size, rawSize))
+		return false;
+	uint32_t chunkCount = getChunkCount(rawSize);
+	size_t offset = chunkCount * sizeof(uint32_t);
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		uint32_t chunkSize;
+		memcpy(&chunkSize, payload + i * sizeof(uint32_t), sizeof(uint32_t));
+		size_t rawOffset = (size_t)i * ChunkedPayload::chunkSize;
+		chunks.push_back(Chunk{ codec, payload + offset, chunkSize, destination + rawOffset, std::min(ChunkedPayload::chunkSize, rawSize - rawOffset) });
+		offset += chunkSize;
+	}
+	return true;
+}
+
+bool ChunkedPayload::decompress(const Chunk& chunk)
+{
+	// Chunks that did not shrink are stored raw.
+	if (chunk.sourceSize == chunk.destinationSize)
+	{
+		memcpy(chunk.destination, chunk.source, chunk.sourceSize);
+		return true;
+	}
+	if (chunk.codec == Codec::LZ4)
+		return LZ4::decompress(chunk.source, chunk.sourceSize, chunk.destination, chunk.destinationSize) == chunk.destinationSize;
+	if (chunk.codec == Codec::Zstd)
+		return Zstd::decompress(chunk.source, chunk.sourceSize, chunk.destination, chunk.destinationSize) == chunk.destinationSize;
+	return false;
+}
+
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <vector>
+
+namespace app {
+
+// Codec of a library payload, chosen at import
+enum class Codec : uint32_t {
+	None, // Payloads are uploaded straight from the mapping
+	LZ4, // Fastest to decompress
+	Zstd, // Smaller than LZ4, slower to decompress
+};
+
+// LZ4 block format codec, compatible with the reference implementation.
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+struct LZ4 {
+	// Worst case compressed size of incompressible data
+	static size_t compressBound(size_t size);
+	// Compress source to destination, return compressed size or 0 if destination is too small
+	static size_t compress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity);
+	// Decompress source to destination, return decompressed size or 0 if source is malformed or destination is too small
+	static size_t decompress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity);
+};
+
+// Zstandard frame format codec, compatible with the reference implementation.
+// Frames are written in a single segment with Huffman coded literals & FSE coded sequences, without checksum.
+// Any frame without dictionary is read, checksums are skipped.
+// https://www.rfc-editor.org/rfc/rfc8878
+struct Zstd {
+	// Worst case compressed size of incompressible data
+	static size_t compressBound(size_t size);
+	// Compress source to destination, return compressed size or 0 if destination is too small
+	static size_t compress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity);
+	// Decompress source to destination, return decompressed size or 0 if source is malformed or destination is too small
+	static size_t decompress(const void* source, size_t sourceSize, void* destination, size_t destinationCapacity);
+};
+
+// Payloads split in chunks compressed independently, so that they are decompressed in parallel.
+// A compressed payload starts with the stored size of each chunk, chunks that did not shrink are stored raw.
+struct ChunkedPayload {
+	static constexpr size_t chunkSize = 64 * 1024;
+
+	// Chunk decompressed to its part of the payload
+	struct Chunk {
+		Codec codec;
+		const uint8_t* source;
+		size_t sourceSize;
+		uint8_t* destination;
+		size_t destinationSize;
+	};
+
+	static uint32_t getChunkCount(size_t rawSize);
+	// Compress a chunk of a raw payload, chunks are compressed in parallel then joined
+	static std::vector<uint8_t> compress(Codec codec, const uint8_t* raw, size_t rawSize, uint32_t chunk);
+	// Compressed payload of chunks, after their size table
+	static std::vector<uint8_t> join(const std::vector<std::vector<uint8_t>>& chunks);
+	// Check the size table of a compressed payload against its size, before allocating its destination
+	static bool check(const uint8_t* payload, size_t size, size_t rawSize);
+	// List chunks of a compressed payload decompressing to destination, false if the payload is truncated
+	static bool split(Codec codec, const uint8_t* payload, size_t size, uint8_t* destination, size_t rawSize, std::vector<Chunk>& chunks);
+	// Decompress a chunk, false if it is corrupted
+	static bool decompress(const Chunk& chunk);
+};
+
+};
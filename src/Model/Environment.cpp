@@ -0,0 +1,540 @@
+#include "Environment.h"
+
+#include "WorkerPool.h"
+#include "MipChain.h"
+#include "BinaryFile.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace app {
+
+using namespace aka;
+
+static constexpr float PI = 3.14159265358979f;
+
+// Equirectangular image of RGBA floats
+struct EquirectangularLevel {
+	uint32_t width;
+	uint32_t height;
+	std::vector<float> pixels;
+};
+
+static vec3f getDirection(float u, float v)
+{
+	float phi = (u - 0.5f) * 2.f * PI;
+	float theta = (v - 0.5f) * PI;
+	return vec3f(std::cos(theta) * std::cos(phi), std::sin(theta), std::cos(theta) * std::sin(phi));
+}
+
+// Bilinear sample of the RGBA pixels at equirectangular coordinates, wrapping horizontally & clamping vertically
+static Float4 sample(const EquirectangularLevel& level, float u, float v)
+{
+	float x = u * level.width - 0.5f;
+	float y = std::min(std::max(v * level.height - 0.5f, 0.f), (float)(level.height - 1));
+	float fx = std::floor(x);
+	float fy = std::floor(y);
+	int32_t width = (int32_t)level.width;
+	uint32_t x0 = (uint32_t)((((int32_t)fx % width) + width) % width);
+	uint32_t x1 = (x0 + 1) % level.width;
+	uint32_t y0 = (uint32_t)fy;
+	uint32_t y1 = std::min(y0 + 1, level.height - 1);
+	Float4 p00 = Float4::load(&level.pixels[(y0 * level.width + x0) * 4]);
+	Float4 p10 = Float4::load(&level.pixels[(y0 * level.width + x1) * 4]);
+	Float4 p01 = Float4::load(&level.pixels[(y1 * level.width + x0) * 4]);
+	Float4 p11 = Float4::load(&level.pixels[(y1 * level.width + x1) * 4]);
+	Float4 tx = Float4::splat(x - fx);
+	Float4 top = p00 + (p10 - p00) * tx;
+	Float4 bottom = p01 + (p11 - p01) * tx;
+	return top + (bottom - top) * Float4::splat(y - fy);
+}
+
+// Trilinear sample of the source mip chain
+static Float4 sampleLod(const std::vector<EquirectangularLevel>& levels, float u, float v, float lod)
+{
+	lod = std::min(std::max(lod, 0.f), (float)(levels.size() - 1));
+	uint32_t l0 = (uint32_t)lod;
+	uint32_t l1 = std::min(l0 + 1, (uint32_t)levels.size() - 1);
+	Float4 c0 = sample(levels[l0], u, v);
+	Float4 c1 = sample(levels[l1], u, v);
+	return c0 + (c1 - c0) * Float4::splat(lod - (float)l0);
+}
+
+static Float4 sampleLod(const std::vector<EquirectangularLevel>& levels, const vec3f& direction, float lod)
+{
+	float u = std::atan2(direction.z, direction.x) / (2.f * PI) + 0.5f;
+	float v = std::asin(std::min(std::max(direction.y, -1.f), 1.f)) / PI + 0.5f;
+	return sampleLod(levels, u, v, lod);
+}
+
+// atan2 of four values, odd polynomial on [0, 1] within 1e-5 radians of std::atan2
+static Float4 atan2(const Float4& y, const Float4& x)
+{
+	const Float4 zero = Float4::splat(0.f);
+	Float4 ax = Float4::abs(x);
+	Float4 ay = Float4::abs(y);
+	Float4 t = Float4::min(ax, ay) / Float4::max(Float4::max(ax, ay), Float4::splat(1e-30f));
+	Float4 t2 = t * t;
+	Float4 r = Float4::splat(-0.0117212f);
+	r = r * t2 + Float4::splat(0.05265332f);
+	r = r * t2 + Float4::splat(-0.11643287f);
+	r = r * t2 + Float4::splat(0.19354346f);
+	r = r * t2 + Float4::splat(-0.33262347f);
+	r = (r * t2 + Float4::splat(0.99997726f)) * t;
+	r = Float4::select(ax < ay, Float4::splat(0.5f * PI) - r, r);
+	r = Float4::select(x < zero, Float4::splat(PI) - r, r);
+	return Float4::select(y < zero, zero - r, r);
+}
+
+// Equirectangular coordinates of four unit directions
+static void getCoordinates(const Float4& x, const Float4& y, const Float4& z, float* u, float* v)
+{
+	const Float4 one = Float4::splat(1.f);
+	Float4 sinTheta = Float4::min(Float4::max(y, Float4::splat(-1.f)), one);
+	Float4 cosTheta = Float4::sqrt(Float4::max(one - sinTheta * sinTheta, Float4::splat(0.f)));
+	const Float4 half = Float4::splat(0.5f);
+	(atan2(z, x) * Float4::splat(1.f / (2.f * PI)) + half).store(u);
+	(atan2(sinTheta, cosTheta) * Float4::splat(1.f / PI) + half).store(v);
+}
+
+// Low discrepancy sequence used to distribute samples
+static void hammersley(uint32_t i, uint32_t count, float& x, float& y)
+{
+	uint32_t bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	x = (float)i / (float)count;
+	y = (float)bits * 2.3283064365386963e-10f;
+}
+
+// Half vector around N = (0, 0, 1) distributed following GGX
+static vec3f importanceSampleGGX(float x, float y, float roughness)
+{
+	float a = roughness * roughness;
+	float phi = 2.f * PI * x;
+	float cosTheta = std::sqrt((1.f - y) / (1.f + (a * a - 1.f) * y));
+	float sinTheta = std::sqrt(1.f - cosTheta * cosTheta);
+	return vec3f(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+}
+
+// Tangent & bitangent of the frame around N that GGX samples are rotated to
+static void getTangentFrame(const vec3f& N, vec3f& tangent, vec3f& bitangent)
+{
+	vec3f up = std::abs(N.z) < 0.999f ? vec3f(0.f, 0.f, 1.f) : vec3f(1.f, 0.f, 0.f);
+	tangent = vec3f::normalize(vec3f(up.y * N.z - up.z * N.y, up.z * N.x - up.x * N.z, up.x * N.y - up.y * N.x));
+	bitangent = vec3f(N.y * tangent.z - N.z * tangent.y, N.z * tangent.x - N.x * tangent.z, N.x * tangent.y - N.y * tangent.x);
+}
+
+static float distributionGGX(float NdotH, float roughness)
+{
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float denom = NdotH * NdotH * (a2 - 1.f) + 1.f;
+	return a2 / (PI * denom * denom);
+}
+
+// Light directions of a GGX lobe around N = (0, 0, 1) assuming N = V = R, the same for every texel of a roughness.
+// Samples under the horizon are dropped, the lobe is padded to a multiple of 4 with samples of weight 0.
+struct GGXLobe {
+	std::vector<float> x, y, z; // z is NdotL, the weight of the sample
+	std::vector<float> lod; // Source mip covering the solid angle of the sample, never finer than baseLod
+};
+
+static GGXLobe getGGXLobe(const EquirectangularLevel& source, float roughness, uint32_t sampleCount, float baseLod)
+{
+	const float texelSolidAngle = 4.f * PI / ((float)source.width * source.height);
+	GGXLobe lobe;
+	for (uint32_t i = 0; i < sampleCount; i++)
+	{
+		float sx, sy;
+		hammersley(i, sampleCount, sx, sy);
+		vec3f H = importanceSampleGGX(sx, sy, roughness);
+		float NdotL = 2.f * H.z * H.z - 1.f;
+		if (NdotL <= 0.f)
+			continue;
+		float pdf = distributionGGX(H.z, roughness) / 4.f + 0.0001f;
+		float sampleSolidAngle = 1.f / (sampleCount * pdf);
+		lobe.x.push_back(2.f * H.z * H.x);
+		lobe.y.push_back(2.f * H.z * H.y);
+		lobe.z.push_back(NdotL);
+		lobe.lod.push_back(std::max(0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.f, baseLod));
+	}
+	while (lobe.z.size() % 4 != 0)
+	{
+		lobe.x.push_back(0.f);
+		lobe.y.push_back(0.f);
+		lobe.z.push_back(0.f);
+		lobe.lod.push_back(baseLod);
+	}
+	return lobe;
+}
+
+// Radiance around N convolved with a GGX lobe.
+// Four samples are rotated around N & mapped to the source at once, their RGBA texels are blended as one vector.
+static Float4 prefilterGGX(const std::vector<EquirectangularLevel>& levels, const GGXLobe& lobe, const vec3f& N)
+{
+	vec3f T, B;
+	getTangentFrame(N, T, B);
+	const Float4 tx = Float4::splat(T.x), ty = Float4::splat(T.y), tz = Float4::splat(T.z);
+	const Float4 bx = Float4::splat(B.x), by = Float4::splat(B.y), bz = Float4::splat(B.z);
+	const Float4 nx = Float4::splat(N.x), ny = Float4::splat(N.y), nz = Float4::splat(N.z);
+	Float4 color = Float4::splat(0.f);
+	Float4 weight = Float4::splat(0.f);
+	float u[4], v[4];
+	for (size_t i = 0; i < lobe.z.size(); i += 4)
+	{
+		Float4 x = Float4::load(&lobe.x[i]);
+		Float4 y = Float4::load(&lobe.y[i]);
+		Float4 z = Float4::load(&lobe.z[i]);
+		getCoordinates(tx * x + bx * y + nx * z, ty * x + by * y + ny * z, tz * x + bz * y + nz * z, u, v);
+		for (size_t j = 0; j < 4; j++)
+			color = color + sampleLod(levels, u[j], v[j], lobe.lod[i + j]) * Float4::splat(lobe.z[i + j]);
+		weight = weight + z;
+	}
+	float total = weight.sum();
+	return total > 0.f ? color / Float4::splat(total) : Float4::splat(0.f);
+}
+
+// Real spherical harmonics basis up to band 2
+static void evaluateSH(const vec3f& d, float* basis)
+{
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * d.y;
+	basis[2] = 0.488603f * d.z;
+	basis[3] = 0.488603f * d.x;
+	basis[4] = 1.092548f * d.x * d.y;
+	basis[5] = 1.092548f * d.y * d.z;
+	basis[6] = 0.315392f * (3.f * d.z * d.z - 1.f);
+	basis[7] = 1.092548f * d.x * d.z;
+	basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+// Basis of four directions at once, given by their components
+static void evaluateSH(const Float4& x, const Float4& y, const Float4& z, Float4* basis)
+{
+	basis[0] = Float4::splat(0.282095f);
+	basis[1] = Float4::splat(0.488603f) * y;
+	basis[2] = Float4::splat(0.488603f) * z;
+	basis[3] = Float4::splat(0.488603f) * x;
+	basis[4] = Float4::splat(1.092548f) * x * y;
+	basis[5] = Float4::splat(1.092548f) * y * z;
+	basis[6] = Float4::splat(0.315392f) * (Float4::splat(3.f) * z * z - Float4::splat(1.f));
+	basis[7] = Float4::splat(1.092548f) * x * z;
+	basis[8] = Float4::splat(0.546274f) * (x * x - y * y);
+}
+
+// Equirectangular image & its mip chain
+static std::vector<EquirectangularLevel> getLevels(const float* pixels, uint32_t width, uint32_t height)
+{
+	std::vector<EquirectangularLevel> levels(MipChain::levelCount(width, height));
+	levels[0] = EquirectangularLevel{ width, height, std::vector<float>(pixels, pixels + (size_t)width * height * 4) };
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const EquirectangularLevel& previous = levels[level - 1];
+		EquirectangularLevel& current = levels[level];
+		current.width = std::max(previous.width / 2, 1U);
+		current.height = std::max(previous.height / 2, 1U);
+		current.pixels.resize((size_t)current.width * current.height * 4);
+		MipChain::downsample(current.pixels.data(), current.width, current.height, previous.pixels.data(), previous.width, previous.height, 4);
+	}
+	return levels;
+}
+
+// Direction of a cubemap texel, s & t in [-1, 1] with t going down
+static vec3f getFaceDirection(uint32_t face, float s, float t)
+{
+	switch (face)
+	{
+	default:
+	case 0: return vec3f(1.f, -t, -s); // px
+	case 1: return vec3f(s, 1.f, t); // py
+	case 2: return vec3f(s, -t, 1.f); // pz
+	case 3: return vec3f(-1.f, -t, s); // nx
+	case 4: return vec3f(s, -1.f, -t); // ny
+	case 5: return vec3f(-s, -t, -1.f); // nz
+	}
+}
+
+std::vector<std::vector<std::vector<float>>> Environment::toCubemap(const float* pixels, uint32_t width, uint32_t height, uint32_t size, bool mips)
+{
+	std::vector<EquirectangularLevel> levels = getLevels(pixels, width, height);
+	std::vector<std::vector<std::vector<float>>> cubemap(mips ? MipChain::levelCount(size, size) : 1);
+	// Faces are small next to the source & lobes are read from its mips, fewer samples than prefiltered are enough.
+	const uint32_t sampleCount = 64;
+	WorkerPool pool;
+	for (uint32_t level = 0; level < cubemap.size(); level++)
+	{
+		uint32_t levelSize = std::max(size >> level, 1U);
+		std::vector<std::vector<float>>& faces = cubemap[level];
+		faces.assign(6, std::vector<float>((size_t)levelSize * levelSize * 4));
+		if (level >= roughnessLevelCount)
+		{
+			uint32_t previousSize = std::max(size >> (level - 1), 1U);
+			for (uint32_t face = 0; face < 6; face++)
+				MipChain::downsample(faces[face].data(), levelSize, levelSize, cubemap[level - 1][face].data(), previousSize, previousSize, 4);
+			continue;
+		}
+		float roughness = (float)level / (float)(roughnessLevelCount - 1);
+		// Four faces cover the width of the source, never sample finer than a face texel.
+		float baseLod = std::max(std::log2((float)width / (4.f * levelSize)), 0.f);
+		GGXLobe lobe = getGGXLobe(levels[0], roughness, sampleCount, baseLod);
+		pool.parallelFor(6 * levelSize, [&](size_t row) {
+			uint32_t face = (uint32_t)(row / levelSize);
+			uint32_t y = (uint32_t)(row % levelSize);
+			float t = 2.f * ((float)y + 0.5f) / levelSize - 1.f;
+			for (uint32_t x = 0; x < levelSize; x++)
+			{
+				float s = 2.f * ((float)x + 0.5f) / levelSize - 1.f;
+				float* pixel = &faces[face][((size_t)y * levelSize + x) * 4];
+				vec3f N = vec3f::normalize(getFaceDirection(face, s, t));
+				if (level == 0)
+					sampleLod(levels, N, baseLod).store(pixel);
+				else
+					prefilterGGX(levels, lobe, N).store(pixel);
+				pixel[3] = 1.f;
+			}
+		});
+	}
+	return cubemap;
+}
+
+Environment Environment::compute(const float* pixels, uint32_t width, uint32_t height)
+{
+	Environment environment{};
+	WorkerPool pool;
+
+	// Source mip chain so that wide lobes sample a filtered radiance instead of aliasing.
+	std::vector<EquirectangularLevel> levels = getLevels(pixels, width, height);
+
+	// --- Irradiance
+	// Low frequency only, project a level small enough to keep it cheap.
+	size_t shLevel = 0;
+	while (shLevel + 1 < levels.size() && levels[shLevel].width > 256)
+		shLevel++;
+	const EquirectangularLevel& shSource = levels[shLevel];
+	std::vector<float> rows((size_t)shSource.height * shCount * 3, 0.f);
+	// Directions of the columns, scaled by the cosine of the latitude of each row.
+	std::vector<float> cosPhi(shSource.width), sinPhi(shSource.width);
+	for (uint32_t x = 0; x < shSource.width; x++)
+	{
+		float phi = (((float)x + 0.5f) / shSource.width - 0.5f) * 2.f * PI;
+		cosPhi[x] = std::cos(phi);
+		sinPhi[x] = std::sin(phi);
+	}
+	pool.parallelFor(shSource.height, [&](size_t y) {
+		float theta = (((float)y + 0.5f) / shSource.height - 0.5f) * PI;
+		float cosTheta = std::cos(theta);
+		float sinTheta = std::sin(theta);
+		// Solid angle of the texels of the row
+		float solidAngle = (2.f * PI / shSource.width) * (PI / shSource.height) * cosTheta;
+		// Four texels at a time, each coefficient & channel summed in its own lanes.
+		Float4 sums[shCount * 3];
+		for (Float4& sum : sums)
+			sum = Float4::splat(0.f);
+		uint32_t x = 0;
+		for (; x + 4 <= shSource.width; x += 4)
+		{
+			Float4 basis[shCount];
+			evaluateSH(Float4::splat(cosTheta) * Float4::load(&cosPhi[x]), Float4::splat(sinTheta), Float4::splat(cosTheta) * Float4::load(&sinPhi[x]), basis);
+			const float* pixels = &shSource.pixels[(y * shSource.width + x) * 4];
+			Float4 r = Float4::load(pixels), g = Float4::load(pixels + 4), b = Float4::load(pixels + 8), a = Float4::load(pixels + 12);
+			Float4::transpose(r, g, b, a);
+			for (uint32_t i = 0; i < shCount; i++)
+			{
+				sums[i * 3 + 0] = sums[i * 3 + 0] + r * basis[i];
+				sums[i * 3 + 1] = sums[i * 3 + 1] + g * basis[i];
+				sums[i * 3 + 2] = sums[i * 3 + 2] + b * basis[i];
+			}
+		}
+		float* row = &rows[y * shCount * 3];
+		for (uint32_t i = 0; i < shCount * 3; i++)
+			row[i] = sums[i].sum() * solidAngle;
+		// Remaining texels of rows narrower than a multiple of four
+		float basis[shCount];
+		for (; x < shSource.width; x++)
+		{
+			evaluateSH(vec3f(cosTheta * cosPhi[x], sinTheta, cosTheta * sinPhi[x]), basis);
+			const float* pixel = &shSource.pixels[(y * shSource.width + x) * 4];
+			for (uint32_t i = 0; i < shCount; i++)
+				for (uint32_t c = 0; c < 3; c++)
+					row[i * 3 + c] += pixel[c] * basis[i] * solidAngle;
+		}
+	});
+	// Cosine lobe convolution per band, divided by pi to get the diffuse radiance.
+	const float bands[shCount] = { 1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	for (uint32_t i = 0; i < shCount; i++)
+	{
+		float sum[3] = { 0.f, 0.f, 0.f };
+		for (uint32_t y = 0; y < shSource.height; y++)
+			for (uint32_t c = 0; c < 3; c++)
+				sum[c] += rows[(y * shCount + i) * 3 + c];
+		environment.sh[i] = vec4f(sum[0] * bands[i], sum[1] * bands[i], sum[2] * bands[i], 0.f);
+	}
+
+	// --- Prefiltered radiance
+	const uint32_t sampleCount = 256;
+	environment.prefiltered.resize(MipChain::levelCount(prefilteredWidth, prefilteredWidth / 2));
+	for (uint32_t level = 0; level < environment.prefiltered.size(); level++)
+	{
+		uint32_t w = std::max(prefilteredWidth >> level, 1U);
+		uint32_t h = std::max((prefilteredWidth / 2) >> level, 1U);
+		std::vector<float>& output = environment.prefiltered[level];
+		output.resize((size_t)w * h * 4);
+		if (level >= roughnessLevelCount)
+		{
+			uint32_t pw = std::max(prefilteredWidth >> (level - 1), 1U);
+			uint32_t ph = std::max((prefilteredWidth / 2) >> (level - 1), 1U);
+			MipChain::downsample(output.data(), w, h, environment.prefiltered[level - 1].data(), pw, ph, 4);
+			continue;
+		}
+		float roughness = (float)level / (float)(roughnessLevelCount - 1);
+		// Never sample finer than the output resolution
+		float baseLod = std::max(std::log2((float)width / (float)w), 0.f);
+		GGXLobe lobe = getGGXLobe(levels[0], roughness, sampleCount, baseLod);
+		pool.parallelFor(h, [&](size_t y) {
+			for (uint32_t x = 0; x < w; x++)
+			{
+				vec3f N = getDirection(((float)x + 0.5f) / w, ((float)y + 0.5f) / h);
+				float* pixel = &output[(y * w + x) * 4];
+				if (level == 0)
+					sampleLod(levels, N, baseLod).store(pixel);
+				else
+					prefilterGGX(levels, lobe, N).store(pixel);
+				pixel[3] = 1.f;
+			}
+		});
+	}
+
+	// --- BRDF LUT
+	const uint32_t brdfSampleCount = 512;
+	environment.brdf.resize(brdfSize * brdfSize * 4);
+	static_assert(brdfSize % 4 == 0, "BRDF LUT rows are integrated four texels at a time");
+	pool.parallelFor(brdfSize, [&](size_t y) {
+		float roughness = ((float)y + 0.5f) / brdfSize;
+		// Half vectors only depend on the roughness of the row, rotated around N = (0, 0, 1).
+		const vec3f N(0.f, 0.f, 1.f);
+		vec3f T, B;
+		getTangentFrame(N, T, B);
+		std::vector<vec3f> halfVectors(brdfSampleCount);
+		for (uint32_t i = 0; i < brdfSampleCount; i++)
+		{
+			float sx, sy;
+			hammersley(i, brdfSampleCount, sx, sy);
+			vec3f H = importanceSampleGGX(sx, sy, roughness);
+			halfVectors[i] = vec3f(T.x * H.x + B.x * H.y + N.x * H.z, T.y * H.x + B.y * H.y + N.y * H.z, T.z * H.x + B.z * H.y + N.z * H.z);
+		}
+		// Four NdotV at once, V = (sqrt(1 - NdotV^2), 0, NdotV). Samples under the horizon get NdotL = 0, so a weight of 0.
+		// Smith geometry term with the k remapping used for image based lighting.
+		const Float4 zero = Float4::splat(0.f);
+		const Float4 one = Float4::splat(1.f);
+		const Float4 k = Float4::splat(roughness * roughness / 2.f);
+		for (uint32_t x = 0; x < brdfSize; x += 4)
+		{
+			float v[4], s[4];
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				v[j] = ((float)(x + j) + 0.5f) / brdfSize;
+				s[j] = std::sqrt(1.f - v[j] * v[j]);
+			}
+			Float4 NdotV = Float4::load(v);
+			Float4 Vx = Float4::load(s);
+			Float4 geometryV = NdotV / (NdotV * (one - k) + k);
+			Float4 scale = zero;
+			Float4 bias = zero;
+			for (const vec3f& H : halfVectors)
+			{
+				Float4 Hz = Float4::splat(H.z);
+				Float4 VdotH = Float4::max(Vx * Float4::splat(H.x) + NdotV * Hz, zero);
+				Float4 NdotL = Float4::max(Float4::splat(2.f) * VdotH * Hz - NdotV, zero);
+				Float4 geometry = geometryV * (NdotL / (NdotL * (one - k) + k));
+				Float4 visibility = geometry * VdotH / (Float4::splat(std::max(H.z, 0.f)) * NdotV);
+				Float4 f = one - VdotH;
+				Float4 fresnel = f * f * f * f * f;
+				scale = scale + (one - fresnel) * visibility;
+				bias = bias + fresnel * visibility;
+			}
+			float scales[4], biases[4];
+			scale.store(scales);
+			bias.store(biases);
+			for (uint32_t j = 0; j < 4; j++)
+			{
+				float* pixel = &environment.brdf[(y * brdfSize + x + j) * 4];
+				pixel[0] = scales[j] / brdfSampleCount;
+				pixel[1] = biases[j] / brdfSampleCount;
+				pixel[2] = 0.f;
+				pixel[3] = 1.f;
+			}
+		}
+	});
+	return environment;
+}
+
+Path Environment::getPath(const String& name)
+{
+	return Path("library/environment/") + name + ".env";
+}
+
+static const char environmentMagic[4] = { 'A', 'K', 'E', 'V' };
+
+struct EnvironmentHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t hash; // Hash of the source map & its import settings
+	uint32_t levelCount;
+	uint32_t padding;
+};
+
+bool Environment::save(const Path& path, uint64_t hash) const
+{
+	BinaryWriter writer;
+	EnvironmentHeader header{};
+	memcpy(header.magic, environmentMagic, sizeof(environmentMagic));
+	header.version = version;
+	header.hash = hash;
+	header.levelCount = (uint32_t)prefiltered.size();
+	writer.write(&header, 1);
+	writer.write(sh, shCount);
+	for (const std::vector<float>& level : prefiltered)
+		writer.write(level.data(), level.size());
+	writer.write(brdf.data(), brdf.size());
+	return writer.save(path);
+}
+
+bool Environment::load(const Path& path, uint64_t hash)
+{
+	if (!OS::File::exist(path))
+		return false;
+	Blob blob;
+	if (!OS::File::read(path, &blob))
+		return false;
+	BinaryReader reader{ (const uint8_t*)blob.data(), blob.size(), 0 };
+	EnvironmentHeader header;
+	if (!reader.read(&header, 1) || memcmp(header.magic, environmentMagic, sizeof(environmentMagic)) != 0)
+		return false;
+	if (header.version != version || header.hash != hash)
+		return false;
+	if (header.levelCount != MipChain::levelCount(prefilteredWidth, prefilteredWidth / 2) || !reader.read(sh, shCount))
+		return false;
+	prefiltered.resize(header.levelCount);
+	for (uint32_t level = 0; level < header.levelCount; level++)
+	{
+		uint32_t w = std::max(prefilteredWidth >> level, 1U);
+		uint32_t h = std::max((prefilteredWidth / 2) >> level, 1U);
+		prefiltered[level].resize((size_t)w * h * 4);
+		if (!reader.read(prefiltered[level].data(), prefiltered[level].size()))
+			return false;
+	}
+	brdf.resize(brdfSize * brdfSize * 4);
+	if (!reader.read(brdf.data(), brdf.size()) || !reader.end())
+	{
+		Logger::warn("Invalid environment file ", path);
+		return false;
+	}
+	return true;
+}
+
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <vector>
+
+namespace app {
+
+// Image based lighting of an equirectangular radiance map, precomputed on the CPU & cached in the library.
+// Equirectangular maps are indexed with u = atan(z, x) / 2pi + 0.5 & v = asin(y) / pi + 0.5.
+struct Environment {
+	static constexpr uint32_t version = 2;
+	static constexpr uint32_t shCount = 9;
+	static constexpr uint32_t prefilteredWidth = 128; // Height is half the width
+	static constexpr uint32_t roughnessLevelCount = 5; // Roughness from 0 to 1 over the first mips
+	static constexpr uint32_t brdfSize = 64;
+
+	// Irradiance as spherical harmonics, convolved with the cosine lobe & divided by pi.
+	// Stored as vec4 to match std140 arrays.
+	aka::vec4f sh[shCount];
+	// RGBA32F radiance prefiltered with GGX, full mip chain. Levels past the roughness levels are downsampled.
+	std::vector<std::vector<float>> prefiltered;
+	// RGBA32F split sum scale & bias in rg, indexed by NdotV in u & roughness in v.
+	std::vector<float> brdf;
+
+	// Process linear RGBA32F equirectangular pixels on worker threads
+	static Environment compute(const float* pixels, uint32_t width, uint32_t height);
+	// Resample linear RGBA32F equirectangular pixels to a cubemap & its full mip chain if requested on worker threads, indexed by level then face.
+	// Levels are prefiltered like prefiltered : roughness from 0 to 1 over the first mips, downsampled past them.
+	// Faces are ordered px, py, pz, nx, ny, nz like cubemaps stored in the library.
+	static std::vector<std::vector<std::vector<float>>> toCubemap(const float* pixels, uint32_t width, uint32_t height, uint32_t size, bool mips);
+
+	// Path of a cached environment in the library, cached by the import of its equirectangular map
+	static aka::Path getPath(const aka::String& name);
+	bool save(const aka::Path& path, uint64_t hash) const;
+	// Load a cached environment, fail if it was computed from another source or with another version.
+	bool load(const aka::Path& path, uint64_t hash);
+};
+
+};
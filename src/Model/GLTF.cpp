@@ -0,0 +1,451 @@
+#include "GLTF.h"
+
+#include "json.hpp"
+
+#include <algorithm>
+
+namespace app {
+
+using namespace aka;
+
+static const uint32_t glbMagic = 0x46546C67; // glTF
+static const uint32_t glbChunkJSON = 0x4E4F534A;
+static const uint32_t glbChunkBIN = 0x004E4942;
+
+struct GLBHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t length;
+};
+
+struct GLBChunk {
+	uint32_t length;
+	uint32_t type;
+};
+
+// Range of bytes of a buffer or buffer view
+struct BufferRange {
+	const uint8_t* data;
+	size_t size;
+	uint32_t stride; // 0 if tightly packed
+};
+
+static size_t getComponentSize(GLTF::ComponentType type)
+{
+	switch (type)
+	{
+	case GLTF::ComponentType::Byte:
+	case GLTF::ComponentType::UnsignedByte: return 1;
+	case GLTF::ComponentType::Short:
+	case GLTF::ComponentType::UnsignedShort: return 2;
+	case GLTF::ComponentType::UnsignedInt:
+	case GLTF::ComponentType::Float: return 4;
+	default: return 0;
+	}
+}
+
+static uint32_t getComponentCount(const std::string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	if (type == "MAT2") return 4;
+	if (type == "MAT3") return 9;
+	if (type == "MAT4") return 16;
+	return 0;
+}
+
+// Decode percent encoded characters of an URI
+static std::string decodeUri(const std::string& uri)
+{
+	std::string decoded;
+	decoded.reserve(uri.size());
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2]))
+		{
+			decoded.push_back((char)std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+			i += 2;
+		}
+		else
+			decoded.push_back(uri[i]);
+	}
+	return decoded;
+}
+
+void GLTF::Accessor::read(uint32_t index, float* values, uint32_t count) const
+{
+	const uint8_t* element = data + (size_t)index * stride;
+	count = std::min(count, componentCount);
+	switch (componentType)
+	{
+	case ComponentType::Float:
+		memcpy(values, element, count * sizeof(float));
+		break;
+	case ComponentType::UnsignedByte:
+		for (uint32_t i = 0; i < count; i++)
+			values[i] = normalized ? element[i] / 255.f : (float)element[i];
+		break;
+	case ComponentType::Byte:
+		for (uint32_t i = 0; i < count; i++)
+			values[i] = normalized ? std::max(((int8_t)element[i]) / 127.f, -1.f) : (float)(int8_t)element[i];
+		break;
+	case ComponentType::UnsignedShort:
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint16_t value;
+			memcpy(&value, element + i * sizeof(uint16_t), sizeof(uint16_t));
+			values[i] = normalized ? value / 65535.f : (float)value;
+		}
+		break;
+	case ComponentType::Short:
+		for (uint32_t i = 0; i < count; i++)
+		{
+			int16_t value;
+			memcpy(&value, element + i * sizeof(int16_t), sizeof(int16_t));
+			values[i] = normalized ? std::max(value / 32767.f, -1.f) : (float)value;
+		}
+		break;
+	case ComponentType::UnsignedInt:
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t value;
+			memcpy(&value, element + i * sizeof(uint32_t), sizeof(uint32_t));
+			values[i] = (float)value;
+		}
+		break;
+	}
+}
+
+uint32_t GLTF::Accessor::readIndex(uint32_t index) const
+{
+	const uint8_t* element = data + (size_t)index * stride;
+	switch (componentType)
+	{
+	case ComponentType::UnsignedByte:
+		return *element;
+	case ComponentType::UnsignedShort: {
+		uint16_t value;
+		memcpy(&value, element, sizeof(uint16_t));
+		return value;
+	}
+	case ComponentType::UnsignedInt: {
+		uint32_t value;
+		memcpy(&value, element, sizeof(uint32_t));
+		return value;
+	}
+	default:
+		return 0;
+	}
+}
+
+bool GLTF::supports(const Path& path)
+{
+	std::string str = path.cstr();
+	size_t dot = str.find_last_of('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = str.substr(dot);
+	for (char& c : extension)
+		c = (char)tolower(c);
+	return extension == ".gltf" || extension == ".glb";
+}
+
+// Check that an accessor can be read as attribute or indices by the importer
+static bool isFloat(const GLTF::Accessor& accessor, uint32_t componentCount)
+{
+	return accessor.componentType == GLTF::ComponentType::Float && accessor.componentCount == componentCount;
+}
+
+static bool isNormalized(const GLTF::Accessor& accessor, uint32_t minComponentCount, uint32_t maxComponentCount)
+{
+	if (accessor.componentCount < minComponentCount || accessor.componentCount > maxComponentCount)
+		return false;
+	if (accessor.componentType == GLTF::ComponentType::Float)
+		return true;
+	return accessor.normalized && (accessor.componentType == GLTF::ComponentType::UnsignedByte || accessor.componentType == GLTF::ComponentType::UnsignedShort);
+}
+
+static bool isIndex(const GLTF::Accessor& accessor)
+{
+	return accessor.componentCount == 1 && (accessor.componentType == GLTF::ComponentType::UnsignedByte || accessor.componentType == GLTF::ComponentType::UnsignedShort || accessor.componentType == GLTF::ComponentType::UnsignedInt);
+}
+
+bool GLTF::load(const Path& path)
+{
+	*this = GLTF{};
+	Path directory = path.up();
+	std::unique_ptr<MappedFile> file = std::make_unique<MappedFile>();
+	if (!file->open(path))
+	{
+		Logger::error("Failed to open glTF ", path);
+		return false;
+	}
+	// GLB stores the JSON chunk followed by an optional binary chunk used as first buffer.
+	const char* jsonData = (const char*)file->data();
+	size_t jsonSize = file->size();
+	BufferRange glbBuffer{ nullptr, 0, 0 };
+	const GLBHeader* header = (const GLBHeader*)file->data();
+	if (file->size() >= sizeof(GLBHeader) && header->magic == glbMagic)
+	{
+		size_t offset = sizeof(GLBHeader);
+		const GLBChunk* json = (const GLBChunk*)(file->data() + offset);
+		if (header->version != 2 || offset + sizeof(GLBChunk) > file->size() || json->type != glbChunkJSON || offset + sizeof(GLBChunk) + json->length > file->size())
+		{
+			Logger::error("Invalid GLB ", path);
+			return false;
+		}
+		jsonData = (const char*)(json + 1);
+		jsonSize = json->length;
+		offset += sizeof(GLBChunk) + json->length;
+		if (offset + sizeof(GLBChunk) <= file->size())
+		{
+			const GLBChunk* bin = (const GLBChunk*)(file->data() + offset);
+			if (bin->type == glbChunkBIN && offset + sizeof(GLBChunk) + bin->length <= file->size())
+				glbBuffer = BufferRange{ (const uint8_t*)(bin + 1), bin->length, 0 };
+		}
+	}
+	m_files.push_back(std::move(file));
+
+	try
+	{
+		nlohmann::json json = nlohmann::json::parse(jsonData, jsonData + jsonSize);
+		if (json.contains("extensionsRequired") && json["extensionsRequired"].size() > 0)
+		{
+			Logger::warn("glTF requires extensions : ", json["extensionsRequired"].dump());
+			return false;
+		}
+		// Buffers
+		std::vector<BufferRange> buffers;
+		for (const nlohmann::json& buffer : json.value("buffers", nlohmann::json::array()))
+		{
+			size_t byteLength = buffer["byteLength"].get<size_t>();
+			if (!buffer.contains("uri"))
+			{
+				if (glbBuffer.data == nullptr || glbBuffer.size < byteLength)
+					return false;
+				buffers.push_back(BufferRange{ glbBuffer.data, byteLength, 0 });
+				continue;
+			}
+			std::string uri = buffer["uri"].get<std::string>();
+			if (uri.compare(0, 5, "data:") == 0)
+			{
+				Logger::warn("glTF embedded buffers not supported");
+				return false;
+			}
+			std::unique_ptr<MappedFile> bin = std::make_unique<MappedFile>();
+			files.push_back(Path(directory + decodeUri(uri).c_str()));
+			if (!bin->open(files.back()) || bin->size() < byteLength)
+			{
+				Logger::error("Failed to open glTF buffer ", uri);
+				return false;
+			}
+			buffers.push_back(BufferRange{ bin->data(), byteLength, 0 });
+			m_files.push_back(std::move(bin));
+		}
+		// Buffer views
+		std::vector<BufferRange> views;
+		for (const nlohmann::json& view : json.value("bufferViews", nlohmann::json::array()))
+		{
+			uint32_t buffer = view["buffer"].get<uint32_t>();
+			size_t byteOffset = view.value("byteOffset", (size_t)0);
+			size_t byteLength = view["byteLength"].get<size_t>();
+			if (buffer >= buffers.size() || byteOffset + byteLength > buffers[buffer].size)
+				return false;
+			views.push_back(BufferRange{ buffers[buffer].data + byteOffset, byteLength, view.value("byteStride", 0U) });
+		}
+		// Accessors
+		for (const nlohmann::json& accessor : json.value("accessors", nlohmann::json::array()))
+		{
+			if (!accessor.contains("bufferView") || accessor.contains("sparse"))
+			{
+				Logger::warn("glTF sparse accessors not supported");
+				return false;
+			}
+			uint32_t view = accessor["bufferView"].get<uint32_t>();
+			if (view >= views.size())
+				return false;
+			Accessor a;
+			a.count = accessor["count"].get<uint32_t>();
+			a.componentType = (ComponentType)accessor["componentType"].get<uint32_t>();
+			a.componentCount = getComponentCount(accessor["type"].get<std::string>());
+			a.normalized = accessor.value("normalized", false);
+			size_t elementSize = getComponentSize(a.componentType) * a.componentCount;
+			if (elementSize == 0)
+				return false;
+			a.stride = views[view].stride > 0 ? views[view].stride : (uint32_t)elementSize;
+			size_t byteOffset = accessor.value("byteOffset", (size_t)0);
+			if (a.count > 0 && byteOffset + (size_t)a.stride * (a.count - 1) + elementSize > views[view].size)
+				return false;
+			a.data = views[view].data + byteOffset;
+			accessors.push_back(a);
+		}
+		// Meshes
+		for (const nlohmann::json& mesh : json.value("meshes", nlohmann::json::array()))
+		{
+			Mesh m;
+			m.name = mesh.value("name", std::string()).c_str();
+			for (const nlohmann::json& primitive : mesh["primitives"])
+			{
+				if (primitive.value("mode", 4U) != 4U)
+				{
+					Logger::warn("glTF primitives other than triangles not supported");
+					return false;
+				}
+				const nlohmann::json& attributes = primitive["attributes"];
+				Primitive p;
+				p.position = attributes.value("POSITION", -1);
+				p.normal = attributes.value("NORMAL", -1);
+				p.texcoord = attributes.value("TEXCOORD_0", -1);
+				p.color = attributes.value("COLOR_0", -1);
+				p.indices = primitive.value("indices", -1);
+				p.material = primitive.value("material", -1);
+				for (int32_t accessor : { p.position, p.normal, p.texcoord, p.color, p.indices })
+					if (accessor >= (int32_t)accessors.size())
+						return false;
+				if (p.position < 0 || !isFloat(accessors[p.position], 3) ||
+					(p.normal >= 0 && !isFloat(accessors[p.normal], 3)) ||
+					(p.texcoord >= 0 && !isNormalized(accessors[p.texcoord], 2, 2)) ||
+					(p.color >= 0 && !isNormalized(accessors[p.color], 3, 4)) ||
+					(p.indices >= 0 && !isIndex(accessors[p.indices])))
+				{
+					Logger::warn("glTF attribute format not supported");
+					return false;
+				}
+				uint32_t vertexCount = accessors[p.position].count;
+				for (int32_t accessor : { p.normal, p.texcoord, p.color })
+					if (accessor >= 0 && accessors[accessor].count != vertexCount)
+						return false;
+				m.primitives.push_back(p);
+			}
+			meshes.push_back(m);
+		}
+		// Images & textures
+		for (const nlohmann::json& image : json.value("images", nlohmann::json::array()))
+		{
+			std::string uri = image.value("uri", std::string());
+			if (uri.empty() || uri.compare(0, 5, "data:") == 0)
+			{
+				Logger::warn("glTF embedded images not supported");
+				return false;
+			}
+			images.push_back(Path(directory + decodeUri(uri).c_str()));
+		}
+		std::vector<int32_t> textures;
+		for (const nlohmann::json& texture : json.value("textures", nlohmann::json::array()))
+		{
+			int32_t source = texture.value("source", -1);
+			textures.push_back(source < (int32_t)images.size() ? source : -1);
+		}
+		auto getTexture = [&](const nlohmann::json& material, const char* name) -> int32_t {
+			if (!material.contains(name))
+				return -1;
+			int32_t texture = material[name].value("index", -1);
+			return (texture >= 0 && texture < (int32_t)textures.size()) ? textures[texture] : -1;
+		};
+		// Materials
+		for (const nlohmann::json& material : json.value("materials", nlohmann::json::array()))
+		{
+			Material m;
+			nlohmann::json pbr = material.value("pbrMetallicRoughness", nlohmann::json::object());
+			std::vector<float> baseColor = pbr.value("baseColorFactor", std::vector<float>{ 1.f, 1.f, 1.f, 1.f });
+			for (uint32_t i = 0; i < 4; i++)
+				m.baseColor[i] = i < baseColor.size() ? baseColor[i] : 1.f;
+			m.doubleSided = material.value("doubleSided", false);
+			m.baseColorTexture = getTexture(pbr, "baseColorTexture");
+			m.metallicRoughnessTexture = getTexture(pbr, "metallicRoughnessTexture");
+			m.normalTexture = getTexture(material, "normalTexture");
+			materials.push_back(m);
+		}
+		// Nodes
+		for (const nlohmann::json& node : json.value("nodes", nlohmann::json::array()))
+		{
+			Node n;
+			n.name = node.value("name", std::string()).c_str();
+			n.mesh = node.value("mesh", -1);
+			if (n.mesh >= (int32_t)meshes.size())
+				return false;
+			n.children = node.value("children", std::vector<uint32_t>());
+			if (node.contains("matrix"))
+			{
+				std::vector<float> matrix = node["matrix"].get<std::vector<float>>();
+				if (matrix.size() != 16)
+					return false;
+				memcpy(n.transform, matrix.data(), sizeof(n.transform));
+			}
+			else
+			{
+				// T * R * S
+				std::vector<float> t = node.value("translation", std::vector<float>{ 0.f, 0.f, 0.f });
+				std::vector<float> r = node.value("rotation", std::vector<float>{ 0.f, 0.f, 0.f, 1.f });
+				std::vector<float> s = node.value("scale", std::vector<float>{ 1.f, 1.f, 1.f });
+				if (t.size() != 3 || r.size() != 4 || s.size() != 3)
+					return false;
+				float x = r[0], y = r[1], z = r[2], w = r[3];
+				float rotation[9] = {
+					1.f - 2.f * (y * y + z * z), 2.f * (x * y + z * w), 2.f * (x * z - y * w),
+					2.f * (x * y - z * w), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + x * w),
+					2.f * (x * z + y * w), 2.f * (y * z - x * w), 1.f - 2.f * (x * x + y * y),
+				};
+				for (uint32_t col = 0; col < 3; col++)
+				{
+					for (uint32_t row = 0; row < 3; row++)
+						n.transform[col * 4 + row] = rotation[col * 3 + row] * s[col];
+					n.transform[col * 4 + 3] = 0.f;
+				}
+				n.transform[12] = t[0];
+				n.transform[13] = t[1];
+				n.transform[14] = t[2];
+				n.transform[15] = 1.f;
+			}
+			nodes.push_back(n);
+		}
+		// Nodes must form disjoint trees : a node has at most one parent & scenes only list roots.
+		// Trees walked from roots are then free of cycles, which importers rely on to recurse.
+		std::vector<bool> child(nodes.size(), false);
+		for (const Node& node : nodes)
+		{
+			for (uint32_t c : node.children)
+			{
+				if (c >= nodes.size() || child[c])
+				{
+					Logger::error("glTF node hierarchy is not a forest of trees");
+					return false;
+				}
+				child[c] = true;
+			}
+		}
+		// Default scene, or every root node if there is none
+		const nlohmann::json& scenes = json.value("scenes", nlohmann::json::array());
+		if (scenes.size() > 0)
+		{
+			uint32_t sceneIndex = std::min(json.value("scene", 0U), (uint32_t)scenes.size() - 1);
+			scene = scenes[sceneIndex].value("nodes", std::vector<uint32_t>());
+			std::vector<bool> listed(nodes.size(), false);
+			for (uint32_t node : scene)
+			{
+				if (node >= nodes.size() || child[node] || listed[node])
+				{
+					Logger::error("glTF scene lists a node that is not a root");
+					return false;
+				}
+				listed[node] = true;
+			}
+		}
+		else
+		{
+			for (uint32_t i = 0; i < nodes.size(); i++)
+				if (!child[i])
+					scene.push_back(i);
+		}
+	}
+	catch (const nlohmann::json::exception& e)
+	{
+		Logger::error("Failed to parse glTF ", path, " : ", e.what());
+		return false;
+	}
+	return true;
+}
+
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "MappedFile.h"
+
+#include <memory>
+
+namespace app {
+
+// glTF 2.0 document read without assimp. Binary buffers are memory mapped and accessors point into the mappings.
+// Documents relying on features not handled here (embedded images, sparse accessors, required extensions...) fail to load.
+// https://registry.khronos.org/glTF/specs/2.0/glTF-2.0.html
+struct GLTF {
+	enum class ComponentType : uint32_t {
+		Byte = 5120,
+		UnsignedByte = 5121,
+		Short = 5122,
+		UnsignedShort = 5123,
+		UnsignedInt = 5125,
+		Float = 5126,
+	};
+	struct Accessor {
+		const uint8_t* data; // First element
+		uint32_t count;
+		ComponentType componentType;
+		uint32_t componentCount; // 1 for scalars up to 16 for mat4
+		uint32_t stride; // Bytes between elements
+		bool normalized;
+
+		// Read components of an element as floats, normalizing integers if needed
+		void read(uint32_t index, float* values, uint32_t count) const;
+		// Read an integer scalar element
+		uint32_t readIndex(uint32_t index) const;
+	};
+	struct Primitive {
+		int32_t position;
+		int32_t normal; // -1 if absent
+		int32_t texcoord; // -1 if absent
+		int32_t color; // -1 if absent
+		int32_t indices; // -1 if not indexed
+		int32_t material; // -1 if absent
+	};
+	struct Mesh {
+		aka::String name;
+		std::vector<Primitive> primitives;
+	};
+	struct Node {
+		aka::String name;
+		float transform[16]; // Column major local transform
+		int32_t mesh; // -1 if absent
+		std::vector<uint32_t> children;
+	};
+	struct Material {
+		float baseColor[4];
+		bool doubleSided;
+		// Indices in images, -1 if absent
+		int32_t baseColorTexture;
+		int32_t normalTexture;
+		int32_t metallicRoughnessTexture;
+	};
+
+	std::vector<Accessor> accessors;
+	std::vector<Mesh> meshes;
+	std::vector<Node> nodes;
+	std::vector<Material> materials;
+	std::vector<aka::Path> images;
+	std::vector<aka::Path> files; // External buffers read by the document
+	std::vector<uint32_t> scene; // Root nodes of the default scene
+
+	// Return true if the path has a glTF extension
+	static bool supports(const aka::Path& path);
+	// Load a .gltf or .glb document, return false if it is invalid or not supported
+	bool load(const aka::Path& path);
+private:
+	std::vector<std::unique_ptr<MappedFile>> m_files;
+};
+
+};
@@ -0,0 +1,31 @@
+#include "GraphicFormat.h"
+
+namespace app {
+
+using namespace aka;
+
+size_t GraphicFormat::getPixelSize(TextureFormat format)
+{
+	switch (format)
+	{
+	case TextureFormat::R8: return 1;
+	case TextureFormat::RG8: return 2;
+	case TextureFormat::RGBA8: return 4;
+	case TextureFormat::RGBA16F: return 8;
+	case TextureFormat::RGBA32F: return 16;
+	default: return 0;
+	}
+}
+
+uint32_t GraphicFormat::getIndexSize(IndexFormat format)
+{
+	switch (format)
+	{
+	case IndexFormat::UnsignedByte: return 1;
+	case IndexFormat::UnsignedShort: return 2;
+	default:
+	case IndexFormat::UnsignedInt: return 4;
+	}
+}
+
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+namespace app {
+
+// Sizes of the formats stored in the library
+struct GraphicFormat {
+	// Size in bytes of a pixel of uncompressed formats, 0 if not supported
+	static size_t getPixelSize(aka::TextureFormat format);
+	static uint32_t getIndexSize(aka::IndexFormat format);
+};
+
+};
@@ -0,0 +1,281 @@
+#include "ImportCache.h"
+
+#include "json.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+namespace app {
+
+using namespace aka;
+
+static const uint32_t cacheVersion = 3;
+
+ImportCache::ImportCache(const Path& path) :
+	m_path(path)
+{
+}
+
+static void readResources(const nlohmann::json& json, const char* type, std::map<std::string, std::string>& resources)
+{
+	if (json.find(type) == json.end())
+		return;
+	for (auto& resource : json[type].items())
+		resources[resource.key()] = resource.value().get<std::string>();
+}
+
+static nlohmann::json writeResources(const std::map<std::string, std::string>& resources)
+{
+	nlohmann::json json = nlohmann::json::object();
+	for (auto& resource : resources)
+		json[resource.first] = resource.second;
+	return json;
+}
+
+void ImportCache::load()
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_hashes.clear();
+	m_origins.clear();
+	m_files.clear();
+	m_buffers.clear();
+	m_meshes.clear();
+	m_textures.clear();
+	m_sources.clear();
+	if (!OS::File::exist(m_path))
+		return;
+	try
+	{
+		String s;
+		OS::File::read(m_path, &s);
+		nlohmann::json json = nlohmann::json::parse(s.cstr());
+		if (json["version"].get<uint32_t>() != cacheVersion)
+		{
+			Logger::warn("Import cache outdated, assets will be rebuilt.");
+			return;
+		}
+		for (auto& asset : json["assets"].items())
+			m_hashes[asset.key()] = asset.value().get<uint64_t>();
+		readResources(json, "origins", m_origins);
+		nlohmann::json files = json.value("files", nlohmann::json::object());
+		for (auto& file : files.items())
+			m_files[file.key()] = FileStamp{ file.value()["time"].get<uint64_t>(), file.value()["size"].get<uint64_t>(), file.value()["hash"].get<uint64_t>() };
+		const nlohmann::json& library = json["library"];
+		readResources(library, "buffers", m_buffers);
+		readResources(library, "meshes", m_meshes);
+		readResources(library, "textures", m_textures);
+		nlohmann::json sources = json.value("sources", nlohmann::json::object());
+		for (auto& source : sources.items())
+			m_sources[source.key()] = std::make_pair(source.value()["files"].get<std::vector<std::string>>(), source.value()["outputs"].get<std::vector<std::string>>());
+	}
+	catch (const nlohmann::json::exception& e)
+	{
+		Logger::error("Failed to read import cache : ", e.what());
+		m_hashes.clear();
+		m_origins.clear();
+		m_files.clear();
+		m_buffers.clear();
+		m_meshes.clear();
+		m_textures.clear();
+		m_sources.clear();
+	}
+}
+
+bool ImportCache::save() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	nlohmann::json json = nlohmann::json::object();
+	json["version"] = cacheVersion;
+	json["assets"] = nlohmann::json::object();
+	for (auto& asset : m_hashes)
+		json["assets"][asset.first] = asset.second;
+	json["origins"] = writeResources(m_origins);
+	json["files"] = nlohmann::json::object();
+	for (auto& file : m_files)
+	{
+		json["files"][file.first]["time"] = file.second.time;
+		json["files"][file.first]["size"] = file.second.size;
+		json["files"][file.first]["hash"] = file.second.hash;
+	}
+	json["library"]["buffers"] = writeResources(m_buffers);
+	json["library"]["meshes"] = writeResources(m_meshes);
+	json["library"]["textures"] = writeResources(m_textures);
+	json["sources"] = nlohmann::json::object();
+	for (auto& source : m_sources)
+	{
+		json["sources"][source.first]["files"] = source.second.first;
+		json["sources"][source.first]["outputs"] = source.second.second;
+	}
+	return OS::File::write(m_path, json.dump(4));
+}
+
+bool ImportCache::contains(const String& name) const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_hashes.find(name.cstr()) != m_hashes.end();
+}
+
+bool ImportCache::valid(const String& name, uint64_t hash) const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto it = m_hashes.find(name.cstr());
+	return it != m_hashes.end() && it->second == hash;
+}
+
+bool ImportCache::conflict(const String& name, uint64_t hash, const String& origin) const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto it = m_hashes.find(name.cstr());
+	if (it == m_hashes.end() || it->second == hash)
+		return false;
+	auto itOrigin = m_origins.find(name.cstr());
+	return itOrigin == m_origins.end() || itOrigin->second != origin.cstr();
+}
+
+void ImportCache::set(const String& name, uint64_t hash)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_hashes[name.cstr()] = hash;
+}
+
+void ImportCache::set(const String& name, uint64_t hash, const String& origin)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_hashes[name.cstr()] = hash;
+	m_origins[name.cstr()] = origin.cstr();
+}
+
+void ImportCache::erase(const String& name)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_hashes.erase(name.cstr());
+	m_origins.erase(name.cstr());
+}
+
+std::unique_lock<std::recursive_mutex> ImportCache::lock() const
+{
+	return std::unique_lock<std::recursive_mutex>(m_mutex);
+}
+
+void ImportCache::addBuffer(const String& name, const Path& path)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_buffers[name.cstr()] = path.cstr();
+}
+
+void ImportCache::addMesh(const String& name, const Path& path)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_meshes[name.cstr()] = path.cstr();
+}
+
+void ImportCache::addTexture(const String& name, const Path& path)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_textures[name.cstr()] = path.cstr();
+}
+
+void ImportCache::removeMesh(const String& name)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_meshes.erase(name.cstr());
+}
+
+std::map<std::string, std::string> ImportCache::getBuffers() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_buffers;
+}
+
+std::map<std::string, std::string> ImportCache::getMeshes() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_meshes;
+}
+
+std::map<std::string, std::string> ImportCache::getTextures() const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	return m_textures;
+}
+
+void ImportCache::setSource(const String& name, const std::vector<std::string>& files, const std::vector<std::string>& outputs)
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	m_sources[name.cstr()] = std::make_pair(files, outputs);
+}
+
+bool ImportCache::getSource(const String& name, std::vector<std::string>& files, std::vector<std::string>& outputs) const
+{
+	std::lock_guard<std::recursive_mutex> guard(m_mutex);
+	auto it = m_sources.find(name.cstr());
+	if (it == m_sources.end())
+		return false;
+	files = it->second.first;
+	outputs = it->second.second;
+	return true;
+}
+
+uint64_t ImportCache::hash(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t ImportCache::hashFile(const Path& path, uint64_t seed)
+{
+	// Large sources are hashed in chunks instead of being read at once.
+	std::ifstream file(path.cstr(), std::ios::binary);
+	if (!file)
+		return 0;
+	uint64_t h = seed;
+	std::vector<char> chunk(64 * 1024);
+	while (file)
+	{
+		file.read(chunk.data(), chunk.size());
+		h = hash(chunk.data(), (size_t)file.gcount(), h);
+	}
+	return file.bad() ? 0 : h;
+}
+
+uint64_t ImportCache::hashSource(const Path& path, uint64_t seed)
+{
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path.cstr(), error);
+	if (error)
+		return 0;
+	uint64_t size = std::filesystem::file_size(path.cstr(), error);
+	if (error)
+		return 0;
+	FileStamp stamp{ (uint64_t)time.time_since_epoch().count(), size, 0 };
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		auto it = m_files.find(path.cstr());
+		if (it != m_files.end() && it->second.time == stamp.time && it->second.size == stamp.size)
+			stamp.hash = it->second.hash;
+	}
+	if (stamp.hash == 0)
+	{
+		stamp.hash = hashFile(path);
+		if (stamp.hash == 0)
+			return 0;
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		m_files[path.cstr()] = stamp;
+	}
+	return hash(&stamp.hash, sizeof(uint64_t), seed);
+}
+
+String ImportCache::uniqueName(const String& name, uint64_t hash)
+{
+	char suffix[18];
+	snprintf(suffix, sizeof(suffix), "-%08x", (uint32_t)(hash ^ (hash >> 32)));
+	return name + suffix;
+}
+
+};
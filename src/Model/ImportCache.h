@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace app {
+
+// Content hashes of imported assets, persisted next to the library manifest.
+// Assets whose source content and import settings did not change are not rebuilt.
+// Library files written by an import are recorded so that headless imports can be loaded later.
+// A cache can be shared by concurrent imports.
+class ImportCache
+{
+public:
+	ImportCache(const aka::Path& path);
+
+	// Read cache from disk, an absent cache is empty
+	void load();
+	// Write cache to disk
+	bool save() const;
+
+	// Return true if an asset was imported under this name
+	bool contains(const aka::String& name) const;
+	// Return true if asset was imported from the same content
+	bool valid(const aka::String& name, uint64_t hash) const;
+	// Return true if an other content was imported under this name from another origin.
+	// A changed content from the same origin is not a conflict, it overwrites the asset in place.
+	bool conflict(const aka::String& name, uint64_t hash, const aka::String& origin) const;
+	// Record the content of an imported asset
+	void set(const aka::String& name, uint64_t hash);
+	// Record the content of an imported asset & the source it was imported from
+	void set(const aka::String& name, uint64_t hash, const aka::String& origin);
+	// Forget an asset that failed to import
+	void erase(const aka::String& name);
+	// Lock the cache for a sequence of queries & updates that must not interleave with other imports
+	std::unique_lock<std::recursive_mutex> lock() const;
+
+	// Record a library file written by an import
+	void addBuffer(const aka::String& name, const aka::Path& path);
+	void addMesh(const aka::String& name, const aka::Path& path);
+	void addTexture(const aka::String& name, const aka::Path& path);
+	// Forget a library file an import no longer writes
+	void removeMesh(const aka::String& name);
+	// Library files recorded by imports, by resource name
+	std::map<std::string, std::string> getBuffers() const;
+	std::map<std::string, std::string> getMeshes() const;
+	std::map<std::string, std::string> getTextures() const;
+	// Record the files a scene import read besides its source & the library files it relies on
+	void setSource(const aka::String& name, const std::vector<std::string>& files, const std::vector<std::string>& outputs);
+	// Return false if no source was recorded under this name
+	bool getSource(const aka::String& name, std::vector<std::string>& files, std::vector<std::string>& outputs) const;
+
+	// FNV-1a 64 bits hash, seed allow to chain multiple calls
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+	// Hash of a file content streamed from disk, 0 if it can't be read
+	static uint64_t hashFile(const aka::Path& path, uint64_t seed = 14695981039346656037ULL);
+	// Hash of a source file like hashFile, reusing the recorded hash while its modification time & size are unchanged
+	uint64_t hashSource(const aka::Path& path, uint64_t seed = 14695981039346656037ULL);
+	// Name of a conflicting asset made unique by its hash
+	static aka::String uniqueName(const aka::String& name, uint64_t hash);
+private:
+	aka::Path m_path;
+	// Content hash of a source file at a given modification time & size
+	struct FileStamp {
+		uint64_t time;
+		uint64_t size;
+		uint64_t hash;
+	};
+	std::map<std::string, uint64_t> m_hashes;
+	std::map<std::string, std::string> m_origins; // Source an asset was imported from
+	std::map<std::string, FileStamp> m_files;
+	std::map<std::string, std::string> m_buffers;
+	std::map<std::string, std::string> m_meshes;
+	std::map<std::string, std::string> m_textures;
+	std::map<std::string, std::pair<std::vector<std::string>, std::vector<std::string>>> m_sources; // Files read & library files
+	mutable std::recursive_mutex m_mutex;
+};
+
+};
@@ -1,36 +1,599 @@
 #include "Importer.h"
+#include "WorkerPool.h"
+#include "MeshOptimizer.h"
+#include "MipChain.h"
+#include "ImportCache.h"
+#include "GLTF.h"
+#include "Environment.h"
+#include "GraphicFormat.h"
+#include "LibraryLoader.h"
+#include "BufferFile.h"
+#include "TextureFile.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/pbrmaterial.h>
 
+#include <set>
+#include <map>
+
 namespace app {
 
-struct AssimpImporter {
-	AssimpImporter(const Path& directory, const aiScene* scene, aka::World& world);
+// TODO move to engine.
+struct Vertex {
+	point3f position;
+	norm3f normal;
+	uv2f uv;
+	color4f color;
+};
+
+// Packed vertex, 16 bytes instead of 48.
+struct PackedVertex {
+	uint16_t position[4]; // unorm16 within mesh bounds, w unused, see QuantizationUniformBuffer
+	uint16_t normal[2]; // unorm16 octahedral
+	uint16_t uv[2]; // half
+};
+
+static uint8_t quantizeUnorm8(float value)
+{
+	return (uint8_t)(clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+static uint16_t quantizeUnorm16(float value)
+{
+	return (uint16_t)(clamp(value, 0.f, 1.f) * 65535.f + 0.5f);
+}
+
+// Convert a float to half float bits, rounding to nearest.
+static uint16_t packHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+	uint32_t sign = (bits >> 16) & 0x8000;
+	int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x007fffff;
+	if (((bits >> 23) & 0xff) == 0xff) // Inf & NaN
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	if (exponent >= 31) // Overflow
+		return (uint16_t)(sign | 0x7c00);
+	if (exponent <= 0) // Denormal
+	{
+		if (exponent < -10)
+			return (uint16_t)sign;
+		mantissa |= 0x00800000;
+		uint32_t shift = (uint32_t)(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+		return (uint16_t)(sign | half);
+	}
+	uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000) // Carry in exponent is still valid
+		half++;
+	return (uint16_t)half;
+}
+
+// Octahedral encoding of a direction in [-1, 1]
+static void encodeOctahedral(float x, float y, float z, float& u, float& v)
+{
+	float length = abs(x) + abs(y) + abs(z);
+	u = (length == 0.f) ? 0.f : x / length;
+	v = (length == 0.f) ? 0.f : y / length;
+	if (z < 0.f)
+	{
+		float ou = (1.f - abs(v)) * (u >= 0.f ? 1.f : -1.f);
+		float ov = (1.f - abs(u)) * (v >= 0.f ? 1.f : -1.f);
+		u = ou;
+		v = ov;
+	}
+}
+
+static void packVertex(const Vertex& vertex, const aabbox<>& bounds, PackedVertex& packed)
+{
+	// Position relative to mesh bounds, dequantized by renderer.
+	vec3f extent = bounds.max - bounds.min;
+	packed.position[0] = quantizeUnorm16((extent.x == 0.f) ? 0.f : (vertex.position.x - bounds.min.x) / extent.x);
+	packed.position[1] = quantizeUnorm16((extent.y == 0.f) ? 0.f : (vertex.position.y - bounds.min.y) / extent.y);
+	packed.position[2] = quantizeUnorm16((extent.z == 0.f) ? 0.f : (vertex.position.z - bounds.min.z) / extent.z);
+	packed.position[3] = 0;
+	float u, v;
+	encodeOctahedral(vertex.normal.x, vertex.normal.y, vertex.normal.z, u, v);
+	packed.normal[0] = quantizeUnorm16(u * 0.5f + 0.5f);
+	packed.normal[1] = quantizeUnorm16(v * 0.5f + 0.5f);
+	packed.uv[0] = packHalf(vertex.uv.u);
+	packed.uv[1] = packHalf(vertex.uv.v);
+}
+
+// Tangent with bitangent sign, bitangent = sign * cross(normal, tangent)
+struct Tangent {
+	float x, y, z, w;
+};
+
+// Packed tangent, octahedral unorm16 & unorm15 with bitangent sign in lowest bit.
+struct PackedTangent {
+	uint16_t tangent[2];
+};
+
+static void packTangent(const Tangent& tangent, PackedTangent& packed)
+{
+	float u, v;
+	encodeOctahedral(tangent.x, tangent.y, tangent.z, u, v);
+	packed.tangent[0] = quantizeUnorm16(u * 0.5f + 0.5f);
+	packed.tangent[1] = (uint16_t)((uint16_t)(clamp(v * 0.5f + 0.5f, 0.f, 1.f) * 32767.f + 0.5f) << 1) | (tangent.w < 0.f ? 1 : 0);
+}
+
+// Generate tangents : triangle tangents are projected on the tangent plane of each corner & accumulated on vertices
+// weighted by corner angle, orthogonalized against vertex normal and bitangent is rebuilt from the sign in shader.
+// Vertices shared by triangles of opposite uv winding are split so that each one has a single handedness.
+// This follows the per corner weighting of MikkTSpace but is not MikkTSpace : vertices are not split where tangents
+// of a same handedness diverge, so normal maps baked against MikkTSpace may differ around sharp uv distortions.
+static void generateTangents(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<Tangent>& tangents)
+{
+	// Accumulated tangent & bitangent per vertex and handedness
+	struct Frame {
+		float t[3];
+		float b[3];
+		bool used;
+	};
+	size_t vertexCount = vertices.size();
+	std::vector<Frame> frames(vertexCount * 2, Frame{});
+	std::vector<uint8_t> handedness(indices.size() / 3);
+	for (size_t f = 0; f < indices.size() / 3; f++)
+	{
+		const uint32_t* triangle = &indices[3 * f];
+		const Vertex& v0 = vertices[triangle[0]];
+		const Vertex& v1 = vertices[triangle[1]];
+		const Vertex& v2 = vertices[triangle[2]];
+		float e1[3] = { v1.position.x - v0.position.x, v1.position.y - v0.position.y, v1.position.z - v0.position.z };
+		float e2[3] = { v2.position.x - v0.position.x, v2.position.y - v0.position.y, v2.position.z - v0.position.z };
+		float du1 = v1.uv.u - v0.uv.u, dv1 = v1.uv.v - v0.uv.v;
+		float du2 = v2.uv.u - v0.uv.u, dv2 = v2.uv.v - v0.uv.v;
+		float area = du1 * dv2 - du2 * dv1;
+		handedness[f] = (area < 0.f) ? 1 : 0;
+		float scale = (area == 0.f) ? 0.f : 1.f / area;
+		float t[3], b[3];
+		for (size_t k = 0; k < 3; k++)
+		{
+			t[k] = (e1[k] * dv2 - e2[k] * dv1) * scale;
+			b[k] = (e2[k] * du1 - e1[k] * du2) * scale;
+		}
+		float tLength = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+		float bLength = sqrtf(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+		if (tLength == 0.f || bLength == 0.f)
+			continue;
+		for (size_t c = 0; c < 3; c++)
+		{
+			// Corner angle weight
+			const point3f& p = vertices[triangle[c]].position;
+			const point3f& p1 = vertices[triangle[(c + 1) % 3]].position;
+			const point3f& p2 = vertices[triangle[(c + 2) % 3]].position;
+			vec3f a = vec3f(p1.x - p.x, p1.y - p.y, p1.z - p.z);
+			vec3f d = vec3f(p2.x - p.x, p2.y - p.y, p2.z - p.z);
+			float lengths = a.norm() * d.norm();
+			float weight = (lengths == 0.f) ? 0.f : acos(clamp((a.x * d.x + a.y * d.y + a.z * d.z) / lengths, -1.f, 1.f));
+			// Triangle frame is projected on the tangent plane of the corner normal before accumulation, like MikkTSpace.
+			const norm3f& n = vertices[triangle[c]].normal;
+			float dt = (n.x * t[0] + n.y * t[1] + n.z * t[2]) / tLength;
+			float db = (n.x * b[0] + n.y * b[1] + n.z * b[2]) / bLength;
+			float ct[3] = { t[0] / tLength - n.x * dt, t[1] / tLength - n.y * dt, t[2] / tLength - n.z * dt };
+			float cb[3] = { b[0] / bLength - n.x * db, b[1] / bLength - n.y * db, b[2] / bLength - n.z * db };
+			float ctLength = sqrtf(ct[0] * ct[0] + ct[1] * ct[1] + ct[2] * ct[2]);
+			float cbLength = sqrtf(cb[0] * cb[0] + cb[1] * cb[1] + cb[2] * cb[2]);
+			Frame& frame = frames[2 * triangle[c] + handedness[f]];
+			for (size_t k = 0; k < 3; k++)
+			{
+				frame.t[k] += (ctLength > 0.f ? ct[k] / ctLength : 0.f) * weight;
+				frame.b[k] += (cbLength > 0.f ? cb[k] / cbLength : 0.f) * weight;
+			}
+			frame.used = true;
+		}
+	}
+	// Split vertices used with both handedness
+	std::vector<uint32_t> splitVertex(vertexCount, ~0U);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		if (frames[2 * v].used && frames[2 * v + 1].used)
+		{
+			splitVertex[v] = (uint32_t)vertices.size();
+			vertices.push_back(vertices[v]);
+		}
+	}
+	for (size_t f = 0; f < indices.size() / 3; f++)
+		if (handedness[f] == 1)
+			for (size_t c = 0; c < 3; c++)
+				if (splitVertex[indices[3 * f + c]] != ~0U)
+					indices[3 * f + c] = splitVertex[indices[3 * f + c]];
+	// Orthogonalize frames
+	tangents.resize(vertices.size());
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const Frame* frame[2] = { &frames[2 * v], &frames[2 * v + 1] };
+		uint32_t target[2] = { (uint32_t)v, (splitVertex[v] != ~0U) ? splitVertex[v] : (uint32_t)v };
+		for (size_t h = 0; h < 2; h++)
+		{
+			if (h == 1 && !frame[1]->used)
+				break;
+			if (h == 0 && !frame[0]->used && frame[1]->used)
+				continue;
+			const norm3f& n = vertices[v].normal;
+			float t[3];
+			float d = n.x * frame[h]->t[0] + n.y * frame[h]->t[1] + n.z * frame[h]->t[2];
+			t[0] = frame[h]->t[0] - n.x * d;
+			t[1] = frame[h]->t[1] - n.y * d;
+			t[2] = frame[h]->t[2] - n.z * d;
+			float length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+			if (length < 1e-6f)
+			{
+				// No usable uv, any direction orthogonal to normal.
+				if (abs(n.x) < 0.9f) { t[0] = 0.f; t[1] = n.z; t[2] = -n.y; }
+				else { t[0] = -n.z; t[1] = 0.f; t[2] = n.x; }
+				length = sqrtf(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+			}
+			Tangent& tangent = tangents[target[h]];
+			tangent.x = t[0] / length;
+			tangent.y = t[1] / length;
+			tangent.z = t[2] / length;
+			// Sign of bitangent relative to cross(normal, tangent)
+			float c[3] = {
+				n.y * tangent.z - n.z * tangent.y,
+				n.z * tangent.x - n.x * tangent.z,
+				n.x * tangent.y - n.y * tangent.x
+			};
+			tangent.w = (c[0] * frame[h]->b[0] + c[1] * frame[h]->b[1] + c[2] * frame[h]->b[2] < 0.f) ? -1.f : 1.f;
+		}
+	}
+}
+
+// Buffer written to the library, kept in memory to be uploaded without reading it back.
+struct ImportedBuffer {
+	String name;
+	Path path;
+	BufferStorage storage;
+};
+
+// Mesh converted from a source scene.
+struct ImportedMesh {
+	String name;
+	aabbox<> bounds;
+	std::vector<Vertex> vertices; // Source vertices, released once saved
+	std::vector<uint32_t> indices; // Source triangle list, released once saved
+	uint64_t hash; // Content hash of source mesh & import settings
+	bool import; // Mesh need to be written to the library
+	bool saved; // Mesh was successfully written to the library
+	bool sourceColors; // Source mesh has vertex colors
+	bool colors; // Mesh has a packed color stream
+	bool tangents; // Mesh has a packed tangent stream
+	bool depth; // Mesh has a position only stream
+	uint32_t lodCount; // Number of simplified LODs written
+	size_t meshletCount; // Number of meshlets written
+	size_t vertexCount; // Vertex count before welding
+	size_t uniqueVertexCount; // Vertex count after welding
+	VertexCacheStatistics before; // Vertex cache statistics before optimization
+	VertexCacheStatistics after; // Vertex cache statistics after optimization
+	std::vector<ImportedBuffer> buffers; // Buffers written, in dependency order of the meshes
+};
+
+enum class TextureSlot {
+	Albedo,
+	Normal,
+	Material,
+};
+
+// Texture referenced by a material of the source scene.
+struct TextureReference {
+	Path path;
+	TextureSlot slot;
+};
+
+// Material of a mesh entity, independent of the source format.
+struct ImportedMaterial {
+	bool valid; // False if the mesh has no material
+	color4f color;
+	bool doubleSided;
+	bool hasTexture[3]; // Indexed by TextureSlot
+	Path textures[3];
+};
+
+// Texture decoded from a material.
+struct ImportedTexture {
+	String name;
+	Path path;
+	TextureSlot slot; // Slot referencing the texture, a texture referenced by several slots is imported per slot
+	TextureFormat format; // Format of the pixels, decoded format of blocks
+	uint64_t hash; // Content hash of source file & storage format
+	bool import; // Texture need to be written to the library
+	std::vector<TextureData::Image> levels; // Mip levels in format, as uploaded
+	TextureData data; // Images written to the library, levels or their blocks
+	bool saved; // Texture was successfully written to the library
+};
+
+// Convert a decoded RGBA image (RGBA8 or RGBA32F for HDR) to the bytes of its storage format.
+// RG8 keeps the two channels of normal maps, z being rebuilt in shader. RGBA16F halves HDR images.
+static TextureData::Image convertImage(const Image& image, TextureFormat format)
+{
+	uint32_t pixelCount = image.width() * image.height();
+	TextureData::Image converted{ image.width(), image.height(), std::vector<uint8_t>(pixelCount * GraphicFormat::getPixelSize(format)) };
+	switch (format)
+	{
+	case TextureFormat::RG8: {
+		const uint8_t* src = (const uint8_t*)image.data();
+		for (uint32_t i = 0; i < pixelCount; i++)
+		{
+			converted.bytes[2 * i + 0] = src[4 * i + 0];
+			converted.bytes[2 * i + 1] = src[4 * i + 1];
+		}
+		break;
+	}
+	case TextureFormat::RGBA16F: {
+		const float* src = (const float*)image.data();
+		for (uint32_t i = 0; i < 4 * pixelCount; i++)
+		{
+			uint16_t half = packHalf(src[i]);
+			memcpy(&converted.bytes[2 * i], &half, sizeof(uint16_t));
+		}
+		break;
+	}
+	default:
+		memcpy(converted.bytes.data(), image.data(), converted.bytes.size());
+		break;
+	}
+	return converted;
+}
+
+// Storage format of a material texture
+static TextureFormat getTextureFormat(TextureSlot slot, const ImportSettings& settings)
+{
+	if ((settings.twoChannelNormalMaps || settings.blockCompression) && slot == TextureSlot::Normal)
+		return TextureFormat::RG8;
+	return TextureFormat::RGBA8;
+}
+
+// Block format of a material texture, from its decoded base level :
+// BC1 for opaque albedo, BC3 for albedo with alpha, BC5 for two channels normal maps & BC7 for the three channels of material maps.
+static BlockFormat getBlockFormat(TextureSlot slot, const TextureData::Image& level)
+{
+	switch (slot)
+	{
+	case TextureSlot::Albedo:
+		for (size_t i = 3; i < level.bytes.size(); i += 4)
+			if (level.bytes[i] != 255)
+				return BlockFormat::BC3;
+		return BlockFormat::BC1;
+	case TextureSlot::Normal:
+		return BlockFormat::BC5;
+	default:
+		return BlockFormat::BC7;
+	}
+}
+
+// Generate the full mip chain of a decoded RGBA8 or RGBA32F image with MipChain.
+// Colors are filtered in linear space when srgb is set, alpha is always linear.
+static std::vector<Image> generateMips(Image image, bool hdr, bool srgb)
+{
+	// sRGB to linear of every 8 bits value
+	static const struct SrgbTable {
+		SrgbTable() {
+			for (uint32_t i = 0; i < 256; i++)
+				values[i] = MipChain::srgbToLinear(i / 255.f);
+		}
+		float values[256];
+	} srgbToLinear;
+	uint32_t width = image.width();
+	uint32_t height = image.height();
+	uint32_t levelCount = MipChain::levelCount(width, height);
+	std::vector<float> pixels((size_t)width * height * 4);
+	if (hdr)
+	{
+		memcpy(pixels.data(), image.data(), pixels.size() * sizeof(float));
+	}
+	else
+	{
+		const uint8_t* src = (const uint8_t*)image.data();
+		for (size_t i = 0; i < pixels.size(); i++)
+			pixels[i] = (srgb && i % 4 != 3) ? srgbToLinear.values[src[i]] : src[i] / 255.f;
+	}
+	std::vector<Image> levels;
+	levels.reserve(levelCount);
+	levels.push_back(std::move(image));
+	std::vector<float> mip;
+	for (uint32_t level = 1; level < levelCount; level++)
+	{
+		uint32_t mipWidth = max(width / 2, 1U);
+		uint32_t mipHeight = max(height / 2, 1U);
+		mip.resize((size_t)mipWidth * mipHeight * 4);
+		MipChain::downsample(mip.data(), mipWidth, mipHeight, pixels.data(), width, height, 4);
+		if (hdr)
+		{
+			Image levelImage(mipWidth, mipHeight, 4, ImageFormat::Float);
+			memcpy(levelImage.data(), mip.data(), mip.size() * sizeof(float));
+			levels.push_back(std::move(levelImage));
+		}
+		else
+		{
+			Image levelImage(mipWidth, mipHeight, 4, ImageFormat::UnsignedByte);
+			uint8_t* dst = (uint8_t*)levelImage.data();
+			for (size_t i = 0; i < mip.size(); i++)
+			{
+				float value = clamp(mip[i], 0.f, 1.f); // Lanczos lobes might ring
+				if (srgb && i % 4 != 3)
+					value = MipChain::linearToSrgb(value);
+				dst[i] = (uint8_t)(value * 255.f + 0.5f);
+			}
+			levels.push_back(std::move(levelImage));
+		}
+		pixels.swap(mip);
+		width = mipWidth;
+		height = mipHeight;
+	}
+	return levels;
+}
+
+// Rows of blocks of an image encoded by a job. Bands are small enough to spread a single large texture over every worker.
+struct BlockBand {
+	BlockFormat format;
+	const TextureData::Image* pixels;
+	TextureData::Image* blocks;
+	uint32_t firstRow;
+	uint32_t lastRow;
+};
+
+static const uint32_t blockBandRows = 16;
+
+// Allocate the blocks of the levels in data & list their bands to encode. Levels must outlive the bands.
+static void addBlockBands(const std::vector<TextureData::Image>& levels, BlockFormat format, TextureData& data, std::vector<BlockBand>& bands)
+{
+	data.block = format;
+	data.format = BlockCompression::getDecodedFormat(format);
+	data.images.resize(levels.size());
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		TextureData::Image& image = data.images[i];
+		image.width = levels[i].width;
+		image.height = levels[i].height;
+		image.bytes.assign(BlockCompression::getImageSize(format, image.width, image.height), 0);
+		uint32_t rowCount = (image.height + 3) / 4;
+		for (uint32_t row = 0; row < rowCount; row += blockBandRows)
+			bands.push_back(BlockBand{ format, &levels[i], &image, row, std::min(row + blockBandRows, rowCount) });
+	}
+}
+
+static void encodeBlockBands(WorkerPool& pool, const std::vector<BlockBand>& bands)
+{
+	pool.parallelFor(bands.size(), [&](size_t i) {
+		const BlockBand& band = bands[i];
+		BlockCompression::encode(band.format, band.pixels->bytes.data(), band.pixels->width, band.pixels->height, band.firstRow, band.lastRow, band.blocks->bytes.data());
+	});
+}
+
+// Replace levels by their stored blocks once decoded, so that the texture created at import is the one loaded later.
+static void decodeBlocks(const TextureData& data, std::vector<TextureData::Image>& levels)
+{
+	for (size_t i = 0; i < levels.size() && i < data.images.size(); i++)
+		BlockCompression::decode(data.block, data.images[i].bytes.data(), levels[i].width, levels[i].height, levels[i].bytes.data());
+}
+
+// Serialize a 2D texture to the library, the blocks already encoded in data or its levels. Levels are stored, not the flag generating them.
+static bool saveTexture2D(const Path& libPath, TextureData& data, const std::vector<TextureData::Image>& levels, TextureFormat format, TextureFlag flags, Codec codec)
+{
+	data.type = TextureType::Texture2D;
+	data.flags = LibraryLoader::getLevelFlags(flags, 1);
+	if (data.block == BlockFormat::None)
+	{
+		data.format = format;
+		data.images = levels;
+	}
+	bool saved = TextureFile::save(libPath, data, codec);
+	data.images.clear();
+	return saved;
+}
+
+// Create a texture from decoded mip levels and add it to resource manager without reading back the library file.
+static Texture::Ptr registerTexture2D(const String& name, const Path& libPath, const std::vector<TextureData::Image>& levels, TextureFormat format, TextureFlag flags)
+{
+	if (levels.empty())
+		return nullptr;
+	std::vector<const void*> data(levels.size());
+	size_t size = 0;
+	for (size_t level = 0; level < levels.size(); level++)
+	{
+		data[level] = levels[level].bytes.data();
+		size += levels[level].bytes.size();
+	}
+	Texture::Ptr texture = LibraryLoader::createTexture2D(levels[0].width, levels[0].height, data, format, flags);
+	if (texture == nullptr)
+		return nullptr;
+	LibraryLoader::registerResource<Texture>(name, libPath, texture, size);
+	return texture;
+}
+
+// Decode, filter & convert an image to its mip levels in storage format.
+static std::vector<TextureData::Image> prepareTexture2D(Image image, TextureFormat format, TextureFlag flags, bool hdr, bool srgb)
+{
+	std::vector<Image> images;
+	if (((int)flags & (int)TextureFlag::GenerateMips) != 0)
+		images = generateMips(std::move(image), hdr, srgb);
+	else
+		images.push_back(std::move(image));
+	std::vector<TextureData::Image> levels;
+	levels.reserve(images.size());
+	for (const Image& level : images)
+		levels.push_back(convertImage(level, format));
+	return levels;
+}
+
+static Buffer::Ptr registerBuffer(const String& name, const Path& libPath, const BufferStorage& storage)
+{
+	Buffer::Ptr buffer = LibraryLoader::createBuffer(storage);
+	if (buffer == nullptr)
+		return nullptr;
+	LibraryLoader::registerResource<Buffer>(name, libPath, buffer, storage.bytes.size());
+	return buffer;
+}
+
+// Resource manager can't remove resources, a released mesh is left with a null resource.
+static void releaseMesh(const String& name)
+{
+	for (auto& element : Application::resource()->allocator<Mesh>())
+		if (element.first == name)
+			element.second.resource = nullptr;
+}
+
+// Conversion of a source scene to library assets & entities, shared by every source format.
+// Front ends convert their meshes to triangle lists, list their textures and build the entities.
+// Headless importers have no world, they only write the library without creating resources nor entities.
+struct SceneImporter {
+	SceneImporter(const Path& path, aka::World* world, ImportCache& cache, const ImportSettings& settings);
+	virtual ~SceneImporter() {}
 
 	void process();
-	void processNode(Entity parent, aiNode* node);
-	Entity processMesh(aiMesh* mesh);
+	// Convert the source meshes only, return the number of vertices read
+	size_t convert();
+	void processMeshes();
+	void processTextures();
+	// Source files read for textures & library files of the imported meshes & textures, once processed
+	void getFiles(std::vector<std::string>& sources, std::vector<std::string>& outputs) const;
 
-	Texture::Ptr loadTexture(const Path& path, TextureFlag flags);
+	Texture::Ptr loadTexture(const Path& path, TextureSlot slot);
+protected:
+	// Fill m_meshes with names & triangle lists, with meshes indices in node order.
+	virtual void convertMeshes(std::vector<uint32_t>& order) = 0;
+	// List every texture referenced by the materials.
+	virtual void gatherTextures(std::vector<TextureReference>& textures) = 0;
+	// Create entities of the scene hierarchy under root.
+	virtual void processScene(Entity root) = 0;
+	Entity createMeshEntity(uint32_t meshIndex, const ImportedMaterial& material);
 private:
+	// Return the handle of the material in the world table, adding it on first use.
+	MaterialHandle addMaterial(const ImportedMaterial& material);
+	bool saveMesh(ImportedMesh& imported) const;
+	template <typename T> bool exists(const String& name, const Path& libPath) const;
+protected:
+	Path m_path; // Scene file, origin of its meshes
 	Path m_directory;
-	const aiScene* m_assimpScene;
-	aka::World& m_world;
+	aka::World* m_world;
+	ImportSettings m_settings;
+	std::vector<ImportedMesh> m_meshes;
+	std::map<std::pair<std::string, TextureSlot>, String> m_textureNames; // Source path & slot to imported texture name
+	std::map<std::string, std::vector<Entity>> m_instances; // Mesh & material pair to entities referencing it
+	ImportCache& m_cache;
 private:
+	std::map<std::string, MaterialHandle> m_materials; // Source material to material table entry
 	Texture::Ptr m_missingColorTexture;
 	Texture::Ptr m_blankColorTexture;
 	Texture::Ptr m_missingNormalTexture;
 	Texture::Ptr m_missingRoughnessTexture;
 };
 
-AssimpImporter::AssimpImporter(const Path& directory, const aiScene* scene, aka::World& world) :
-	m_directory(directory),
-	m_assimpScene(scene),
-	m_world(world)
+SceneImporter::SceneImporter(const Path& path, aka::World* world, ImportCache& cache, const ImportSettings& settings) :
+	m_path(path),
+	m_directory(path.up()),
+	m_world(world),
+	m_settings(settings),
+	m_cache(cache)
 {
+	if (m_world == nullptr)
+		return;
 	uint8_t bytesMissingColor[4] = { 255, 0, 255, 255 };
 	uint8_t bytesBlankColor[4] = { 255, 255, 255, 255 };
 	uint8_t bytesNormal[4] = { 128,128,255,255 };
@@ -41,11 +604,897 @@ AssimpImporter::AssimpImporter(const Path& directory, const aiScene* scene, aka:
 	m_missingRoughnessTexture = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::ShaderResource, bytesRoughness);
 }
 
-void AssimpImporter::process()
+void SceneImporter::process()
 {
-	Entity root = m_world.createEntity(OS::File::basename(m_directory));
+	processMeshes();
+	processTextures();
+	if (m_world == nullptr)
+		return;
+	Entity root = m_world->createEntity(OS::File::basename(m_directory));
 	root.add<Transform3DComponent>(Transform3DComponent{ mat4f::identity() });
 	root.add<Hierarchy3DComponent>(Hierarchy3DComponent{ Entity::null(), mat4f::identity() });
+	processScene(root);
+	// Entities sharing a mesh & material are drawn with instanced draws.
+	size_t instanceCount = 0, groupCount = 0;
+	for (const std::pair<const std::string, std::vector<Entity>>& instances : m_instances)
+	{
+		if (instances.second.size() <= 1)
+			continue;
+		for (Entity entity : instances.second)
+			entity.add<InstancedComponent>();
+		instanceCount += instances.second.size();
+		groupCount++;
+	}
+	if (groupCount > 0)
+		Logger::info("Tagged ", instanceCount, " entities as instances of ", groupCount, " mesh & material pairs");
+	if (m_settings.batchMeshes)
+		Scene::batchMeshes(*m_world);
+}
+
+size_t SceneImporter::convert()
+{
+	std::vector<uint32_t> meshes;
+	convertMeshes(meshes);
+	size_t vertexCount = 0;
+	for (uint32_t meshIndex : meshes)
+		vertexCount += m_meshes[meshIndex].vertices.size();
+	return vertexCount;
+}
+
+// Return true if an asset is already in the library.
+// Headless imports have no resources loaded, the cache & the library file are checked instead.
+template <typename T>
+bool SceneImporter::exists(const String& name, const Path& libPath) const
+{
+	if (m_world == nullptr)
+		return m_cache.contains(name) && OS::File::exist(libPath);
+	return Application::resource()->has<T>(name);
+}
+
+void SceneImporter::getFiles(std::vector<std::string>& sources, std::vector<std::string>& outputs) const
+{
+	for (const ImportedMesh& imported : m_meshes)
+		outputs.push_back(std::string("library/mesh/") + imported.name.cstr() + ".mesh");
+	std::set<std::string> paths;
+	for (const auto& texture : m_textureNames)
+	{
+		if (paths.insert(texture.first.first).second)
+			sources.push_back(texture.first.first);
+		outputs.push_back(std::string("library/texture/") + texture.second.cstr() + ".tex");
+	}
+}
+
+// Bump when the importer output change to invalidate cached assets.
+static const uint64_t importerVersion = 10;
+
+// Hash of the settings affecting mesh output
+static uint64_t hashMeshSettings(const ImportSettings& settings)
+{
+	uint64_t hash = ImportCache::hash(&importerVersion, sizeof(importerVersion));
+	hash = ImportCache::hash(&settings.weldVertices, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.optimizeVertexCache, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.optimizeOverdraw, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.packVertices, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.generateTangents, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.lodCount, sizeof(settings.lodCount), hash);
+	hash = ImportCache::hash(&settings.lodTargetError, sizeof(float), hash);
+	hash = ImportCache::hash(&settings.buildMeshlets, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.depthStream, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.bufferCodec, sizeof(Codec), hash);
+	return hash;
+}
+
+// Hash of the converted streams of a mesh, so that a scene hashes the same whatever its front end.
+static uint64_t hashMesh(const ImportedMesh& mesh, uint64_t seed)
+{
+	size_t vertexCount = mesh.vertices.size();
+	uint64_t hash = ImportCache::hash(&vertexCount, sizeof(size_t), seed);
+	hash = ImportCache::hash(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex), hash);
+	hash = ImportCache::hash(&mesh.sourceColors, sizeof(bool), hash);
+	return ImportCache::hash(mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), hash);
+}
+
+void SceneImporter::processMeshes()
+{
+	// Meshes are converted in node order so that meshes sharing a name resolve to the same one as a serial import.
+	std::vector<uint32_t> meshes;
+	convertMeshes(meshes);
+
+	// Hash converted content on workers, unchanged meshes are not rebuilt.
+	WorkerPool pool;
+	uint64_t settingsHash = hashMeshSettings(m_settings);
+	pool.parallelFor(meshes.size(), [&](size_t i) {
+		m_meshes[meshes[i]].hash = hashMesh(m_meshes[meshes[i]], settingsHash);
+	});
+
+	Path bufferDirectory = "library/buffer/";
+	if (!OS::Directory::exist(bufferDirectory))
+		OS::Directory::create(bufferDirectory);
+	Path meshDirectory = "library/mesh/";
+	if (!OS::Directory::exist(meshDirectory))
+		OS::Directory::create(meshDirectory);
+
+	std::map<std::string, uint64_t> names; // Source name to first content imported under it
+	std::set<std::string> imports;
+	std::unique_lock<std::recursive_mutex> lock = m_cache.lock();
+	for (uint32_t meshIndex : meshes)
+	{
+		ImportedMesh& imported = m_meshes[meshIndex];
+		// Different contents sharing a name in this scene, or imported under it from another source, get a name suffixed by their hash.
+		// A mesh that changed in this scene since its last import is overwritten in place.
+		auto it = names.insert(std::make_pair(imported.name.cstr(), imported.hash)).first;
+		bool unknown = exists<Mesh>(imported.name, meshDirectory + imported.name + ".mesh") && !m_cache.contains(imported.name);
+		if (it->second != imported.hash || m_cache.conflict(imported.name, imported.hash, m_path.cstr()) || unknown)
+			imported.name = ImportCache::uniqueName(imported.name, imported.hash);
+		bool cached = exists<Mesh>(imported.name, meshDirectory + imported.name + ".mesh") && m_cache.valid(imported.name, imported.hash);
+		imported.import = !cached && imports.insert(imported.name.cstr()).second;
+		// Reserve the name right away so that concurrent imports do not write the same files.
+		if (imported.import && m_world == nullptr)
+			m_cache.set(imported.name, imported.hash, m_path.cstr());
+		imported.saved = false;
+		imported.colors = false;
+		imported.tangents = false;
+		imported.depth = false;
+		imported.lodCount = 0;
+		imported.meshletCount = 0;
+	}
+	lock.unlock();
+
+	// Optimization & serialization do not rely on graphic context, run them on workers.
+	pool.parallelFor(meshes.size(), [&](size_t i) {
+		ImportedMesh& imported = m_meshes[meshes[i]];
+		for (const Vertex& vertex : imported.vertices)
+			imported.bounds.include(vertex.position);
+		if (imported.import)
+			imported.saved = saveMesh(imported);
+		imported.vertices.clear();
+		imported.vertices.shrink_to_fit();
+		imported.indices.clear();
+		imported.indices.shrink_to_fit();
+		// Headless imports never upload, release bytes early.
+		if (m_world == nullptr)
+		{
+			for (ImportedBuffer& buffer : imported.buffers)
+			{
+				buffer.storage.bytes.clear();
+				buffer.storage.bytes.shrink_to_fit();
+			}
+		}
+	});
+
+	// Resources need the graphic context, load them on main thread.
+	ResourceManager* resource = (m_world != nullptr) ? Application::resource() : nullptr;
+	size_t uploadedBytes = 0;
+	for (uint32_t meshIndex : meshes)
+	{
+		ImportedMesh& imported = m_meshes[meshIndex];
+		if (!imported.import)
+			continue;
+		if (!imported.saved)
+		{
+			Logger::error("Failed to save mesh ", imported.name);
+			m_cache.erase(imported.name);
+			continue;
+		}
+		m_cache.set(imported.name, imported.hash, m_path.cstr());
+		for (const ImportedBuffer& buffer : imported.buffers)
+			m_cache.addBuffer(buffer.name, buffer.path);
+		m_cache.addMesh(imported.name, meshDirectory + imported.name + ".mesh");
+		for (uint32_t lod = 1; lod <= imported.lodCount; lod++)
+		{
+			String lodName = Scene::getLodName(imported.name, lod);
+			m_cache.addMesh(lodName, meshDirectory + lodName + ".mesh");
+		}
+		// Depth meshes of a previous import would draw a stale position stream, forget them.
+		for (uint32_t lod = 0; lod <= StaticMeshComponent::maxLodCount; lod++)
+		{
+			String depthName = Scene::getDepthName(lod == 0 ? imported.name : Scene::getLodName(imported.name, lod));
+			if (imported.depth && lod <= imported.lodCount)
+				m_cache.addMesh(depthName, meshDirectory + depthName + ".mesh");
+			else
+				m_cache.removeMesh(depthName);
+		}
+		if (m_settings.weldVertices)
+			Logger::info("Mesh ", imported.name, " welded ", imported.vertexCount, " -> ", imported.uniqueVertexCount, " vertices, saved ", (imported.vertexCount - imported.uniqueVertexCount) * sizeof(Vertex), " bytes");
+		if (m_settings.optimizeVertexCache)
+			Logger::info("Mesh ", imported.name, " ACMR : ", imported.before.acmr, " -> ", imported.after.acmr, ", ATVR : ", imported.before.atvr, " -> ", imported.after.atvr);
+		if (imported.lodCount > 0)
+			Logger::info("Mesh ", imported.name, " generated ", imported.lodCount, " LODs");
+		if (imported.meshletCount > 0)
+			Logger::info("Mesh ", imported.name, " split in ", imported.meshletCount, " meshlets");
+		if (resource == nullptr)
+		{
+			imported.buffers.clear();
+			continue;
+		}
+		// Upload buffers from the bytes that were just saved instead of reading them back from disk.
+		for (ImportedBuffer& buffer : imported.buffers)
+		{
+			if (registerBuffer(buffer.name, buffer.path, buffer.storage) == nullptr)
+				Logger::error("Failed to create buffer ", buffer.name);
+			uploadedBytes += buffer.storage.bytes.size();
+		}
+		imported.buffers.clear();
+		resource->load<Mesh>(imported.name, meshDirectory + imported.name + ".mesh");
+		for (uint32_t lod = 1; lod <= imported.lodCount; lod++)
+		{
+			String lodName = Scene::getLodName(imported.name, lod);
+			resource->load<Mesh>(lodName, meshDirectory + lodName + ".mesh");
+		}
+		for (uint32_t lod = 0; lod <= StaticMeshComponent::maxLodCount; lod++)
+		{
+			String depthName = Scene::getDepthName(lod == 0 ? imported.name : Scene::getLodName(imported.name, lod));
+			if (imported.depth && lod <= imported.lodCount)
+				resource->load<Mesh>(depthName, meshDirectory + depthName + ".mesh");
+			else if (resource->has<Mesh>(depthName))
+				releaseMesh(depthName);
+		}
+	}
+	if (uploadedBytes > 0)
+		Logger::info("Uploaded ", uploadedBytes, " bytes of mesh buffers from import memory, 0 bytes read back");
+}
+
+bool SceneImporter::saveMesh(ImportedMesh& imported) const
+{
+	std::vector<Vertex> vertices = std::move(imported.vertices);
+	std::vector<uint32_t> indices = std::move(imported.indices);
+	// Weld identical vertices
+	imported.vertexCount = vertices.size();
+	if (m_settings.weldVertices)
+	{
+		std::vector<uint32_t> remap(vertices.size());
+		size_t vertexCount = MeshOptimizer::generateVertexRemap(remap.data(), indices.data(), indices.size(), vertices.data(), vertices.size(), sizeof(Vertex));
+		std::vector<Vertex> uniqueVertices(vertexCount);
+		MeshOptimizer::remapVertexBuffer(uniqueVertices.data(), vertices.data(), vertices.size(), sizeof(Vertex), remap.data());
+		MeshOptimizer::remapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+		vertices.swap(uniqueVertices);
+	}
+	imported.uniqueVertexCount = vertices.size();
+	// Optimize for post transform cache, overdraw and vertex fetch
+	if (m_settings.optimizeVertexCache)
+	{
+		imported.before = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+		std::vector<uint32_t> optimizedIndices(indices.size());
+		MeshOptimizer::optimizeVertexCache(optimizedIndices.data(), indices.data(), indices.size(), vertices.size());
+		if (m_settings.optimizeOverdraw)
+			MeshOptimizer::optimizeOverdraw(indices.data(), optimizedIndices.data(), indices.size(), &vertices[0].position.x, vertices.size(), sizeof(Vertex), 1.05f);
+		else
+			indices.swap(optimizedIndices);
+		std::vector<Vertex> optimizedVertices(vertices.size());
+		size_t vertexCount = MeshOptimizer::optimizeVertexFetch(optimizedVertices.data(), indices.data(), indices.size(), vertices.data(), vertices.size(), sizeof(Vertex));
+		optimizedVertices.resize(vertexCount);
+		vertices.swap(optimizedVertices);
+		imported.after = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+	}
+	// Tangents are generated last as they might split vertices on handedness seams.
+	std::vector<Tangent> tangents;
+	imported.tangents = m_settings.generateTangents || m_settings.packVertices;
+	if (imported.tangents)
+		generateTangents(vertices, indices, tangents);
+	// Import resources
+	Path bufferDirectory = "library/buffer/";
+	Path meshDirectory = "library/mesh/";
+	// Index buffer
+	String indexBufferName = imported.name + "-indices";
+	String indexBufferFileName = indexBufferName + ".buffer";
+	Path indexBufferPath = bufferDirectory + indexBufferFileName;
+	{
+		BufferStorage indexBuffer;
+		indexBuffer.type = BufferType::Index;
+		indexBuffer.access = BufferCPUAccess::None;
+		indexBuffer.usage = BufferUsage::Immutable;
+		indexBuffer.bytes.resize(indices.size() * sizeof(uint32_t));
+		memcpy(indexBuffer.bytes.data(), indices.data(), indexBuffer.bytes.size());
+		if (!BufferFile::save(indexBufferPath, indexBuffer, m_settings.bufferCodec))
+			return false;
+		imported.buffers.push_back(ImportedBuffer{ indexBufferName, indexBufferPath, std::move(indexBuffer) });
+	}
+
+	// Vertex buffer
+	String vertexBufferName = imported.name + "-vertices";
+	String vertexBufferFileName = vertexBufferName + ".buffer";
+	Path vertexBufferPath = bufferDirectory + vertexBufferFileName;
+	uint32_t vertexCount = (uint32_t)vertices.size();
+	MeshStorage storage;
+	if (m_settings.packVertices)
+	{
+		uint32_t vertexBufferSize = (uint32_t)(vertices.size() * sizeof(PackedVertex));
+		{
+			BufferStorage vertexBuffer;
+			vertexBuffer.type = BufferType::Vertex;
+			vertexBuffer.access = BufferCPUAccess::None;
+			vertexBuffer.usage = BufferUsage::Immutable;
+			vertexBuffer.bytes.resize(vertexBufferSize);
+			PackedVertex* packedVertices = (PackedVertex*)vertexBuffer.bytes.data();
+			for (size_t i = 0; i < vertices.size(); i++)
+				packVertex(vertices[i], imported.bounds, packedVertices[i]);
+			if (!BufferFile::save(vertexBufferPath, vertexBuffer, m_settings.bufferCodec))
+				return false;
+			imported.buffers.push_back(ImportedBuffer{ vertexBufferName, vertexBufferPath, std::move(vertexBuffer) });
+		}
+		// Positions are expanded by the renderer with the quantization stored next to the mesh.
+		{
+			String quantizationBufferName = Scene::getQuantizationName(imported.name);
+			Path quantizationBufferPath = bufferDirectory + quantizationBufferName + ".buffer";
+			QuantizationUniformBuffer quantization = Scene::getQuantization(imported.bounds);
+			BufferStorage quantizationBuffer;
+			quantizationBuffer.type = BufferType::Uniform;
+			quantizationBuffer.access = BufferCPUAccess::None;
+			quantizationBuffer.usage = BufferUsage::Immutable;
+			quantizationBuffer.bytes.resize(sizeof(QuantizationUniformBuffer));
+			memcpy(quantizationBuffer.bytes.data(), &quantization, sizeof(QuantizationUniformBuffer));
+			if (!BufferFile::save(quantizationBufferPath, quantizationBuffer, m_settings.bufferCodec))
+				return false;
+			imported.buffers.push_back(ImportedBuffer{ quantizationBufferName, quantizationBufferPath, std::move(quantizationBuffer) });
+		}
+		storage.vertices.push_back(MeshStorage::Vertex {
+			VertexAttribute{ VertexSemantic::Position, VertexFormat::UnsignedShort, VertexType::Vec4 },
+			vertexBufferName,
+			vertexCount, // count
+			offsetof(PackedVertex, position), // offset
+			0,
+			vertexBufferSize, // size
+			sizeof(PackedVertex), // stride
+		});
+		storage.vertices.push_back(MeshStorage::Vertex {
+			VertexAttribute{ VertexSemantic::Normal, VertexFormat::UnsignedShort, VertexType::Vec2 },
+			vertexBufferName,
+			vertexCount, // count
+			offsetof(PackedVertex, normal), // offset
+			0,
+			vertexBufferSize, // size
+			sizeof(PackedVertex), // stride
+		});
+		storage.vertices.push_back(MeshStorage::Vertex {
+			VertexAttribute{ VertexSemantic::TexCoord0, VertexFormat::UnsignedShort, VertexType::Vec2 },
+			vertexBufferName,
+			vertexCount, // count
+			offsetof(PackedVertex, uv), // offset
+			0,
+			vertexBufferSize, // size
+			sizeof(PackedVertex), // stride
+		});
+		// Color stream is only stored if the mesh has vertex colors.
+		imported.colors = imported.sourceColors;
+		if (imported.colors)
+		{
+			String colorBufferName = imported.name + "-colors";
+			String colorBufferFileName = colorBufferName + ".buffer";
+			Path colorBufferPath = bufferDirectory + colorBufferFileName;
+			uint32_t colorBufferSize = vertexCount * 4;
+			{
+				BufferStorage colorBuffer;
+				colorBuffer.type = BufferType::Vertex;
+				colorBuffer.access = BufferCPUAccess::None;
+				colorBuffer.usage = BufferUsage::Immutable;
+				colorBuffer.bytes.resize(colorBufferSize);
+				for (size_t i = 0; i < vertices.size(); i++)
+				{
+					colorBuffer.bytes[4 * i + 0] = quantizeUnorm8(vertices[i].color.r);
+					colorBuffer.bytes[4 * i + 1] = quantizeUnorm8(vertices[i].color.g);
+					colorBuffer.bytes[4 * i + 2] = quantizeUnorm8(vertices[i].color.b);
+					colorBuffer.bytes[4 * i + 3] = quantizeUnorm8(vertices[i].color.a);
+				}
+				if (!BufferFile::save(colorBufferPath, colorBuffer, m_settings.bufferCodec))
+					return false;
+				imported.buffers.push_back(ImportedBuffer{ colorBufferName, colorBufferPath, std::move(colorBuffer) });
+			}
+			storage.vertices.push_back(MeshStorage::Vertex {
+				VertexAttribute{ VertexSemantic::Color0, VertexFormat::UnsignedByte, VertexType::Vec4 },
+				colorBufferName,
+				vertexCount, // count
+				0, // offset
+				0,
+				colorBufferSize, // size
+				4, // stride
+			});
+		}
+	}
+	else
+	{
+		uint32_t vertexBufferSize = (uint32_t)(vertices.size() * sizeof(Vertex));
+		{
+			BufferStorage vertexBuffer;
+			vertexBuffer.type = BufferType::Vertex;
+			vertexBuffer.access = BufferCPUAccess::None;
+			vertexBuffer.usage = BufferUsage::Immutable;
+			vertexBuffer.bytes.resize(vertexBufferSize);
+			memcpy(vertexBuffer.bytes.data(), vertices.data(), vertexBuffer.bytes.size());
+			if (!BufferFile::save(vertexBufferPath, vertexBuffer, m_settings.bufferCodec))
+				return false;
+			imported.buffers.push_back(ImportedBuffer{ vertexBufferName, vertexBufferPath, std::move(vertexBuffer) });
+		}
+		storage.vertices = { {
+			MeshStorage::Vertex {
+				VertexAttribute{ VertexSemantic::Position, VertexFormat::Float, VertexType::Vec3 },
+				vertexBufferName,
+				vertexCount, // count
+				offsetof(Vertex, position), // offset
+				0,
+				vertexBufferSize, // size
+				sizeof(Vertex), // stride
+			},
+			MeshStorage::Vertex {
+				VertexAttribute{ VertexSemantic::Normal, VertexFormat::Float, VertexType::Vec3 },
+				vertexBufferName,
+				vertexCount, // count
+				offsetof(Vertex, normal), // offset
+				0,
+				vertexBufferSize, // size
+				sizeof(Vertex), // stride
+			},
+			MeshStorage::Vertex {
+				VertexAttribute{ VertexSemantic::TexCoord0, VertexFormat::Float, VertexType::Vec2 },
+				vertexBufferName,
+				vertexCount, // count
+				offsetof(Vertex, uv), // offset
+				0,
+				vertexBufferSize, // size
+				sizeof(Vertex), // stride
+			},
+			MeshStorage::Vertex {
+				VertexAttribute{ VertexSemantic::Color0, VertexFormat::Float, VertexType::Vec4 },
+				vertexBufferName,
+				vertexCount, // count
+				offsetof(Vertex, color), // offset
+				0,
+				vertexBufferSize, // size
+				sizeof(Vertex), // stride
+			}
+		} };
+	}
+
+	// Position only stream for depth & shadow passes, which do not fetch other attributes.
+	imported.depth = m_settings.depthStream;
+	MeshStorage depthStorage;
+	if (imported.depth)
+	{
+		String positionBufferName = imported.name + "-positions";
+		Path positionBufferPath = bufferDirectory + positionBufferName + ".buffer";
+		VertexAttribute attribute = m_settings.packVertices ? VertexAttribute{ VertexSemantic::Position, VertexFormat::UnsignedShort, VertexType::Vec4 } : VertexAttribute{ VertexSemantic::Position, VertexFormat::Float, VertexType::Vec3 };
+		uint32_t positionStride = m_settings.packVertices ? sizeof(PackedVertex::position) : sizeof(Vertex::position);
+		uint32_t positionBufferSize = vertexCount * positionStride;
+		BufferStorage positionBuffer;
+		positionBuffer.type = BufferType::Vertex;
+		positionBuffer.access = BufferCPUAccess::None;
+		positionBuffer.usage = BufferUsage::Immutable;
+		positionBuffer.bytes.resize(positionBufferSize);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (m_settings.packVertices)
+			{
+				PackedVertex packed;
+				packVertex(vertices[i], imported.bounds, packed);
+				memcpy(positionBuffer.bytes.data() + i * positionStride, packed.position, positionStride);
+			}
+			else
+			{
+				memcpy(positionBuffer.bytes.data() + i * positionStride, &vertices[i].position, positionStride);
+			}
+		}
+		if (!BufferFile::save(positionBufferPath, positionBuffer, m_settings.bufferCodec))
+			return false;
+		imported.buffers.push_back(ImportedBuffer{ positionBufferName, positionBufferPath, std::move(positionBuffer) });
+		depthStorage.vertices.push_back(MeshStorage::Vertex {
+			attribute,
+			positionBufferName,
+			vertexCount, // count
+			0, // offset
+			0,
+			positionBufferSize, // size
+			positionStride, // stride
+		});
+	}
+
+	if (imported.tangents)
+	{
+		String tangentBufferName = imported.name + "-tangents";
+		String tangentBufferFileName = tangentBufferName + ".buffer";
+		Path tangentBufferPath = bufferDirectory + tangentBufferFileName;
+		uint32_t tangentBufferSize = (uint32_t)(tangents.size() * sizeof(PackedTangent));
+		{
+			BufferStorage tangentBuffer;
+			tangentBuffer.type = BufferType::Vertex;
+			tangentBuffer.access = BufferCPUAccess::None;
+			tangentBuffer.usage = BufferUsage::Immutable;
+			tangentBuffer.bytes.resize(tangentBufferSize);
+			PackedTangent* packedTangents = (PackedTangent*)tangentBuffer.bytes.data();
+			for (size_t i = 0; i < tangents.size(); i++)
+				packTangent(tangents[i], packedTangents[i]);
+			if (!BufferFile::save(tangentBufferPath, tangentBuffer, m_settings.bufferCodec))
+				return false;
+			imported.buffers.push_back(ImportedBuffer{ tangentBufferName, tangentBufferPath, std::move(tangentBuffer) });
+		}
+		storage.vertices.push_back(MeshStorage::Vertex {
+			VertexAttribute{ VertexSemantic::Tangent, VertexFormat::UnsignedShort, VertexType::Vec2 },
+			tangentBufferName,
+			vertexCount, // count
+			0, // offset
+			0,
+			tangentBufferSize, // size
+			sizeof(PackedTangent), // stride
+		});
+	}
+
+	// Mesh
+	String meshFileName = imported.name + ".mesh";
+	Path meshPath = meshDirectory + meshFileName;
+	storage.indexBufferName = indexBufferName;
+	storage.indexBufferOffset = 0;
+	storage.indexCount = (uint32_t)indices.size();
+	storage.indexFormat = IndexFormat::UnsignedInt;
+	if (!storage.save(meshPath))
+		return false;
+	depthStorage.indexBufferName = indexBufferName;
+	depthStorage.indexBufferOffset = 0;
+	depthStorage.indexCount = (uint32_t)indices.size();
+	depthStorage.indexFormat = IndexFormat::UnsignedInt;
+	if (imported.depth && !depthStorage.save(meshDirectory + Scene::getDepthName(imported.name) + ".mesh"))
+		return false;
+
+	// Meshlets are only worth culling for meshes larger than a single one.
+	if (m_settings.buildMeshlets && indices.size() / 3 > MeshOptimizer::meshletMaxTriangles)
+	{
+		MeshletStorage meshletStorage;
+		MeshOptimizer::buildMeshlets(meshletStorage.meshlets, indices.data(), indices.size(), &vertices[0].position.x, vertices.size(), sizeof(Vertex), MeshOptimizer::meshletMaxVertices, MeshOptimizer::meshletMaxTriangles);
+		if (!meshletStorage.save(Scene::getMeshletPath(imported.name)))
+			return false;
+		imported.meshletCount = meshletStorage.meshlets.size();
+	}
+
+	// LODs share the vertex buffers of the base mesh, with their own index buffer.
+	uint32_t lodCount = min(m_settings.lodCount, StaticMeshComponent::maxLodCount);
+	std::vector<uint32_t> lodIndices(indices.size());
+	size_t previousIndexCount = indices.size();
+	for (uint32_t lod = 1; lod <= lodCount; lod++)
+	{
+		size_t targetIndexCount = (indices.size() >> lod) / 3 * 3;
+		size_t lodIndexCount = MeshOptimizer::simplify(lodIndices.data(), indices.data(), indices.size(), &vertices[0].position.x, vertices.size(), sizeof(Vertex), targetIndexCount, m_settings.lodTargetError);
+		// Stop when simplification is stuck on error limit or locked vertices.
+		if (lodIndexCount == 0 || lodIndexCount > previousIndexCount * 9 / 10)
+			break;
+		previousIndexCount = lodIndexCount;
+		if (m_settings.optimizeVertexCache)
+		{
+			std::vector<uint32_t> optimizedIndices(lodIndexCount);
+			MeshOptimizer::optimizeVertexCache(optimizedIndices.data(), lodIndices.data(), lodIndexCount, vertices.size());
+			memcpy(lodIndices.data(), optimizedIndices.data(), lodIndexCount * sizeof(uint32_t));
+		}
+		String lodName = Scene::getLodName(imported.name, lod);
+		String lodIndexBufferName = lodName + "-indices";
+		{
+			BufferStorage indexBuffer;
+			indexBuffer.type = BufferType::Index;
+			indexBuffer.access = BufferCPUAccess::None;
+			indexBuffer.usage = BufferUsage::Immutable;
+			indexBuffer.bytes.resize(lodIndexCount * sizeof(uint32_t));
+			memcpy(indexBuffer.bytes.data(), lodIndices.data(), indexBuffer.bytes.size());
+			Path lodIndexBufferPath = bufferDirectory + lodIndexBufferName + ".buffer";
+			if (!BufferFile::save(lodIndexBufferPath, indexBuffer, m_settings.bufferCodec))
+				return false;
+			imported.buffers.push_back(ImportedBuffer{ lodIndexBufferName, lodIndexBufferPath, std::move(indexBuffer) });
+		}
+		storage.indexBufferName = lodIndexBufferName;
+		storage.indexCount = (uint32_t)lodIndexCount;
+		if (!storage.save(meshDirectory + lodName + ".mesh"))
+			return false;
+		depthStorage.indexBufferName = lodIndexBufferName;
+		depthStorage.indexCount = (uint32_t)lodIndexCount;
+		if (imported.depth && !depthStorage.save(meshDirectory + Scene::getDepthName(lodName) + ".mesh"))
+			return false;
+		imported.lodCount = lod;
+	}
+	return true;
+}
+
+Entity SceneImporter::createMeshEntity(uint32_t meshIndex, const ImportedMaterial& material)
+{
+	ResourceManager* resource = Application::resource();
+	const ImportedMesh& imported = m_meshes[meshIndex];
+	Entity e = m_world->createEntity(imported.name);
+	e.add<MeshComponent>();
+	MeshComponent& meshComponent = e.get<MeshComponent>();
+
+	meshComponent.bounds = imported.bounds;
+	meshComponent.submesh.mesh = resource->get<Mesh>(imported.name);
+	meshComponent.submesh.type = PrimitiveType::Triangles;
+	meshComponent.submesh.count = meshComponent.submesh.mesh->getIndexCount();
+	meshComponent.submesh.offset = 0;
+	Scene::loadLods(meshComponent);
+	Scene::loadMeshlets(meshComponent);
+
+	MaterialHandle handle = addMaterial(material);
+	e.add<MaterialComponent>(MaterialComponent{ handle });
+	m_instances[std::to_string(meshIndex) + "|" + std::to_string(handle)].push_back(e);
+	return e;
+}
+
+MaterialHandle SceneImporter::addMaterial(const ImportedMaterial& material)
+{
+	// Identical source materials share a single entry of the material table.
+	std::string key = "none";
+	if (material.valid)
+	{
+		key = std::to_string(material.color.r) + "," + std::to_string(material.color.g) + "," + std::to_string(material.color.b) + "," + std::to_string(material.color.a);
+		key += material.doubleSided ? "|double" : "|single";
+		for (uint32_t slot = 0; slot < 3; slot++)
+			key += std::string("|") + (material.hasTexture[slot] ? material.textures[slot].cstr() : "");
+	}
+	auto it = m_materials.find(key);
+	if (it != m_materials.end())
+		return it->second;
+
+	MaterialAsset asset;
+	asset.name = OS::File::basename(m_directory) + "-material" + String(std::to_string(m_materials.size()).c_str());
+	if (material.valid)
+	{
+		TextureSampler defaultSampler = TextureSampler::trilinear;
+		asset.color = material.color;
+		asset.doubleSided = material.doubleSided;
+		if (material.hasTexture[(int)TextureSlot::Albedo])
+		{
+			asset.albedo.texture = loadTexture(material.textures[(int)TextureSlot::Albedo], TextureSlot::Albedo);
+			asset.albedo.sampler = defaultSampler;
+			if (asset.albedo.texture == nullptr)
+				asset.albedo.texture = m_missingColorTexture;
+		}
+		else
+		{
+			asset.albedo.texture = m_blankColorTexture;
+			asset.albedo.sampler = defaultSampler;
+		}
+		if (material.hasTexture[(int)TextureSlot::Normal])
+		{
+			asset.normal.texture = loadTexture(material.textures[(int)TextureSlot::Normal], TextureSlot::Normal);
+			asset.normal.sampler = defaultSampler;
+			if (asset.normal.texture == nullptr)
+				asset.normal.texture = m_missingNormalTexture;
+		}
+		else
+		{
+			asset.normal.texture = m_missingNormalTexture;
+			asset.normal.sampler = defaultSampler;
+		}
+		if (material.hasTexture[(int)TextureSlot::Material])
+		{
+			asset.material.texture = loadTexture(material.textures[(int)TextureSlot::Material], TextureSlot::Material);
+			asset.material.sampler = defaultSampler;
+			if (asset.material.texture == nullptr)
+				asset.material.texture = m_missingRoughnessTexture;
+		}
+		else
+		{
+			asset.material.texture = m_missingRoughnessTexture;
+			asset.material.sampler = defaultSampler;
+		}
+	}
+	else
+	{
+		// No material !
+		asset.color = color4f(1.f);
+		asset.doubleSided = true;
+		asset.albedo.texture = m_blankColorTexture;
+		asset.albedo.sampler = TextureSampler::nearest;
+		asset.normal.texture = m_missingNormalTexture;
+		asset.normal.sampler = TextureSampler::nearest;
+		asset.material.texture = m_missingRoughnessTexture;
+		asset.material.sampler = TextureSampler::nearest;
+	}
+	MaterialHandle handle = Scene::getMaterials(*m_world).add(asset);
+	m_materials.insert(std::make_pair(key, handle));
+	return handle;
+}
+
+void SceneImporter::processTextures()
+{
+	// Gather every unique texture referenced by the materials, per slot as slots have their own format & filtering
+	std::vector<TextureReference> references;
+	gatherTextures(references);
+	std::vector<ImportedTexture> textures;
+	std::set<std::pair<std::string, TextureSlot>> keys;
+	for (const TextureReference& reference : references)
+	{
+		if (!keys.insert(std::make_pair(std::string(reference.path.cstr()), reference.slot)).second)
+			continue;
+		textures.push_back(ImportedTexture{ OS::File::name(reference.path), reference.path, reference.slot, getTextureFormat(reference.slot, m_settings), 0, false, {}, {}, false });
+	}
+
+	// Hash source files on workers, unchanged textures are not rebuilt. Files with the modification time & size of their last import are not read.
+	TextureFlag flags = TextureFlag::ShaderResource | TextureFlag::GenerateMips;
+	WorkerPool pool;
+	pool.parallelFor(textures.size(), [&](size_t i) {
+		ImportedTexture& texture = textures[i];
+		uint64_t hash = ImportCache::hash(&importerVersion, sizeof(importerVersion));
+		hash = ImportCache::hash(&texture.format, sizeof(TextureFormat), hash);
+		hash = ImportCache::hash(&flags, sizeof(TextureFlag), hash);
+		hash = ImportCache::hash(&texture.slot, sizeof(TextureSlot), hash);
+		hash = ImportCache::hash(&m_settings.textureCodec, sizeof(Codec), hash);
+		hash = ImportCache::hash(&m_settings.blockCompression, sizeof(bool), hash);
+		texture.hash = m_cache.hashSource(texture.path, hash);
+	});
+
+	String directory = "library/texture/";
+	if (!OS::Directory::exist(directory))
+		OS::Directory::create(directory);
+
+	std::map<std::string, uint64_t> names; // Source name to first content imported under it
+	std::set<std::string> imports;
+	std::unique_lock<std::recursive_mutex> lock = m_cache.lock();
+	for (ImportedTexture& texture : textures)
+	{
+		// A changed source file overwrites the texture it was imported to.
+		auto it = names.insert(std::make_pair(texture.name.cstr(), texture.hash)).first;
+		bool unknown = exists<Texture>(texture.name, directory + texture.name + ".tex") && !m_cache.contains(texture.name);
+		if (it->second != texture.hash || m_cache.conflict(texture.name, texture.hash, texture.path.cstr()) || unknown)
+			texture.name = ImportCache::uniqueName(texture.name, texture.hash);
+		bool cached = exists<Texture>(texture.name, directory + texture.name + ".tex") && m_cache.valid(texture.name, texture.hash);
+		// Same content under different paths share the same texture
+		texture.import = !cached && imports.insert(texture.name.cstr()).second;
+		if (texture.import && m_world == nullptr)
+			m_cache.set(texture.name, texture.hash, texture.path.cstr());
+		m_textureNames[std::make_pair(std::string(texture.path.cstr()), texture.slot)] = texture.name;
+	}
+	lock.unlock();
+
+	// Decode & generate mips on workers.
+	pool.parallelFor(textures.size(), [&](size_t i) {
+		ImportedTexture& texture = textures[i];
+		if (texture.import)
+			texture.levels = prepareTexture2D(Image::load(texture.path), texture.format, flags, false, texture.slot == TextureSlot::Albedo);
+	});
+
+	// Block compress every level in bands of block rows, spread over workers whatever the texture sizes.
+	if (m_settings.blockCompression)
+	{
+		std::vector<BlockBand> bands;
+		for (ImportedTexture& texture : textures)
+			if (texture.import && !texture.levels.empty() && texture.levels[0].width > 0)
+				addBlockBands(texture.levels, getBlockFormat(texture.slot, texture.levels[0]), texture.data, bands);
+		encodeBlockBands(pool, bands);
+	}
+
+	// Serialize on workers. Blocks are decoded back to the uploaded levels, the texture created now is the one loaded later.
+	pool.parallelFor(textures.size(), [&](size_t i) {
+		ImportedTexture& texture = textures[i];
+		if (!texture.import || texture.levels.empty() || texture.levels[0].width == 0)
+			return;
+		if (m_world != nullptr && texture.data.block != BlockFormat::None)
+			decodeBlocks(texture.data, texture.levels);
+		texture.saved = saveTexture2D(directory + texture.name + ".tex", texture.data, texture.levels, texture.format, flags, m_settings.textureCodec);
+		if (m_world == nullptr)
+			texture.levels.clear();
+	});
+
+	// Upload decoded pixels directly, without reading back the library file.
+	for (ImportedTexture& texture : textures)
+	{
+		if (!texture.import)
+			continue;
+		if (!texture.saved)
+		{
+			Logger::error("Failed to import texture2D ", texture.path);
+			m_cache.erase(texture.name);
+			continue;
+		}
+		Path libPath = directory + texture.name + ".tex";
+		if (m_world != nullptr && registerTexture2D(texture.name, libPath, texture.levels, texture.format, flags) == nullptr)
+		{
+			Logger::error("Failed to create texture2D ", texture.name);
+			continue;
+		}
+		m_cache.set(texture.name, texture.hash, texture.path.cstr());
+		m_cache.addTexture(texture.name, libPath);
+	}
+}
+
+Texture::Ptr SceneImporter::loadTexture(const Path& path, TextureSlot slot)
+{
+	ResourceManager* resource = Application::resource();
+	// Textures were imported by processTextures, missing ones failed to import.
+	auto it = m_textureNames.find(std::make_pair(std::string(path.cstr()), slot));
+	if (it != m_textureNames.end() && resource->has<Texture>(it->second))
+		return resource->get<Texture>(it->second);
+	return nullptr;
+}
+
+// Scene read by assimp, any format it supports.
+struct AssimpImporter : SceneImporter {
+	AssimpImporter(const Path& path, const aiScene* scene, aka::World* world, ImportCache& cache, const ImportSettings& settings);
+protected:
+	void convertMeshes(std::vector<uint32_t>& order) override;
+	void gatherTextures(std::vector<TextureReference>& textures) override;
+	void processScene(Entity root) override;
+private:
+	static bool getTexture(const aiMaterial* material, TextureSlot slot, aiString& path);
+	void collectMeshes(const aiNode* node, std::vector<uint32_t>& meshes, std::vector<bool>& visited);
+	static void convertMesh(const aiMesh* mesh, ImportedMesh& imported);
+	void processNode(Entity parent, aiNode* node);
+	Entity processMesh(unsigned int meshIndex);
+private:
+	const aiScene* m_assimpScene;
+};
+
+AssimpImporter::AssimpImporter(const Path& path, const aiScene* scene, aka::World* world, ImportCache& cache, const ImportSettings& settings) :
+	SceneImporter(path, world, cache, settings),
+	m_assimpScene(scene)
+{
+}
+
+void AssimpImporter::collectMeshes(const aiNode* node, std::vector<uint32_t>& meshes, std::vector<bool>& visited)
+{
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+	{
+		unsigned int meshIndex = node->mMeshes[i];
+		if (visited[meshIndex])
+			continue;
+		visited[meshIndex] = true;
+		meshes.push_back(meshIndex);
+	}
+	for (unsigned int i = 0; i < node->mNumChildren; i++)
+		collectMeshes(node->mChildren[i], meshes, visited);
+}
+
+void AssimpImporter::convertMeshes(std::vector<uint32_t>& order)
+{
+	std::vector<bool> visited(m_assimpScene->mNumMeshes, false);
+	collectMeshes(m_assimpScene->mRootNode, order, visited);
+	m_meshes.resize(m_assimpScene->mNumMeshes);
+	WorkerPool pool;
+	pool.parallelFor(order.size(), [&](size_t i) {
+		convertMesh(m_assimpScene->mMeshes[order[i]], m_meshes[order[i]]);
+	});
+}
+
+void AssimpImporter::convertMesh(const aiMesh* mesh, ImportedMesh& imported)
+{
+	AKA_ASSERT(mesh->HasPositions(), "Mesh need positions");
+	AKA_ASSERT(mesh->HasNormals(), "Mesh needs normals");
+
+	imported.name = mesh->mName.C_Str();
+	imported.sourceColors = mesh->HasVertexColors(0);
+	std::vector<Vertex>& vertices = imported.vertices;
+	std::vector<uint32_t>& indices = imported.indices;
+	vertices.resize(mesh->mNumVertices);
+	// process vertices
+	for (unsigned int i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex& vertex = vertices[i];
+		// process vertex positions, normals and texture coordinates
+		vertex.position.x = mesh->mVertices[i].x;
+		vertex.position.y = mesh->mVertices[i].y;
+		vertex.position.z = mesh->mVertices[i].z;
+
+		vertex.normal.x = mesh->mNormals[i].x;
+		vertex.normal.y = mesh->mNormals[i].y;
+		vertex.normal.z = mesh->mNormals[i].z;
+		if (mesh->HasTextureCoords(0))
+		{
+			vertex.uv.u = mesh->mTextureCoords[0][i].x;
+			vertex.uv.v = mesh->mTextureCoords[0][i].y;
+		}
+		else
+			vertex.uv = uv2f(0.f);
+		if (mesh->HasVertexColors(0))
+		{
+			vertex.color.r = mesh->mColors[0][i].r;
+			vertex.color.g = mesh->mColors[0][i].g;
+			vertex.color.b = mesh->mColors[0][i].b;
+			vertex.color.a = mesh->mColors[0][i].a;
+		}
+		else
+			vertex.color = color4f(1.f);
+	}
+	// process indices
+	for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		for (unsigned int j = 0; j < face.mNumIndices; j++)
+			indices.push_back(face.mIndices[j]);
+	}
+}
+
+void AssimpImporter::processScene(Entity root)
+{
 	processNode(root, m_assimpScene->mRootNode);
 }
 
@@ -66,340 +1515,316 @@ void AssimpImporter::processNode(Entity parent, aiNode* node)
 	}
 	else
 	{
-		inverseParentTransform = mat4f::identity();
+		inverseParentTransform = mat4f::identity();
+	}
+	// process all the node's meshes (if any)
+	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+	{
+		Entity e = processMesh(node->mMeshes[i]);
+		e.add<Transform3DComponent>(Transform3DComponent{ transform });
+		e.add<Hierarchy3DComponent>(Hierarchy3DComponent{ parent, inverseParentTransform });
+	}
+	if (node->mNumChildren > 0)
+	{
+		Entity entity = m_world->createEntity(node->mName.C_Str());
+		entity.add<Hierarchy3DComponent>(Hierarchy3DComponent{ parent, inverseParentTransform });
+		entity.add<Transform3DComponent>(Transform3DComponent{ transform });
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			processNode(entity, node->mChildren[i]);
+	}
+}
+
+Entity AssimpImporter::processMesh(unsigned int meshIndex)
+{
+	aiMesh* mesh = m_assimpScene->mMeshes[meshIndex];
+	ImportedMaterial material{};
+	material.valid = mesh->mMaterialIndex >= 0;
+	if (material.valid)
+	{
+		//aiTextureType_EMISSION_COLOR = 14,
+		//aiTextureType_METALNESS = 15,
+		//aiTextureType_DIFFUSE_ROUGHNESS = 16,
+		//aiTextureType_AMBIENT_OCCLUSION = 17,
+		aiMaterial* sourceMaterial = m_assimpScene->mMaterials[mesh->mMaterialIndex];
+		aiColor4D c;
+		sourceMaterial->Get(AI_MATKEY_COLOR_DIFFUSE, c);
+		sourceMaterial->Get(AI_MATKEY_TWOSIDED, material.doubleSided);
+		material.color = color4f(c.r, c.g, c.b, c.a);
+		for (TextureSlot slot : { TextureSlot::Albedo, TextureSlot::Normal, TextureSlot::Material })
+		{
+			aiString str;
+			material.hasTexture[(int)slot] = getTexture(sourceMaterial, slot, str);
+			if (material.hasTexture[(int)slot])
+				material.textures[(int)slot] = Path(m_directory + str.C_Str());
+		}
+	}
+	return createMeshEntity(meshIndex, material);
+}
+
+bool AssimpImporter::getTexture(const aiMaterial* material, TextureSlot slot, aiString& path)
+{
+	// Texture types to look for, by order of preference.
+	static const aiTextureType types[3][2] = {
+		{ aiTextureType_BASE_COLOR, aiTextureType_DIFFUSE }, // Albedo
+		{ aiTextureType_NORMAL_CAMERA, aiTextureType_NORMALS }, // Normal
+		{ aiTextureType_UNKNOWN, aiTextureType_SHININESS }, // Material, GLTF pbr texture is retrieved as unknown (?)
+	};
+	for (aiTextureType type : types[(int)slot])
+	{
+		// Ignore others textures for now.
+		if (material->GetTextureCount(type) > 0)
+			return material->GetTexture(type, 0, &path) == aiReturn_SUCCESS;
+	}
+	return false;
+}
+
+void AssimpImporter::gatherTextures(std::vector<TextureReference>& textures)
+{
+	for (unsigned int iMaterial = 0; iMaterial < m_assimpScene->mNumMaterials; iMaterial++)
+	{
+		const aiMaterial* material = m_assimpScene->mMaterials[iMaterial];
+		for (TextureSlot slot : { TextureSlot::Albedo, TextureSlot::Normal, TextureSlot::Material })
+		{
+			aiString str;
+			if (getTexture(material, slot, str))
+				textures.push_back(TextureReference{ Path(m_directory + str.C_Str()), slot });
+		}
 	}
-	// process all the node's meshes (if any)
-	for (unsigned int i = 0; i < node->mNumMeshes; i++)
+}
+
+// glTF 2.0 read directly from its mapped buffers, converted to the same conventions as assimp post processes.
+// Each primitive is imported as its own mesh.
+struct GLTFImporter : SceneImporter {
+	GLTFImporter(const Path& path, const GLTF& gltf, aka::World* world, ImportCache& cache, const ImportSettings& settings);
+protected:
+	void convertMeshes(std::vector<uint32_t>& order) override;
+	void gatherTextures(std::vector<TextureReference>& textures) override;
+	void processScene(Entity root) override;
+private:
+	void collectMeshes(uint32_t nodeIndex, std::vector<uint32_t>& meshes, std::vector<bool>& visited);
+	void convertPrimitive(const GLTF::Primitive& primitive, ImportedMesh& imported) const;
+	void processNode(Entity parent, uint32_t nodeIndex);
+	ImportedMaterial getMaterial(int32_t materialIndex) const;
+private:
+	const GLTF& m_gltf;
+	std::vector<uint32_t> m_meshOffsets; // Index of the first primitive of each glTF mesh in m_meshes
+};
+
+GLTFImporter::GLTFImporter(const Path& path, const GLTF& gltf, aka::World* world, ImportCache& cache, const ImportSettings& settings) :
+	SceneImporter(path, world, cache, settings),
+	m_gltf(gltf)
+{
+	uint32_t offset = 0;
+	for (const GLTF::Mesh& mesh : m_gltf.meshes)
 	{
-		Entity e = processMesh(m_assimpScene->mMeshes[node->mMeshes[i]]);
-		e.add<Transform3DComponent>(Transform3DComponent{ transform });
-		e.add<Hierarchy3DComponent>(Hierarchy3DComponent{ parent, inverseParentTransform });
+		m_meshOffsets.push_back(offset);
+		offset += (uint32_t)mesh.primitives.size();
 	}
-	if (node->mNumChildren > 0)
+}
+
+void GLTFImporter::collectMeshes(uint32_t nodeIndex, std::vector<uint32_t>& meshes, std::vector<bool>& visited)
+{
+	const GLTF::Node& node = m_gltf.nodes[nodeIndex];
+	if (node.mesh >= 0 && !visited[node.mesh])
 	{
-		Entity entity = m_world.createEntity(node->mName.C_Str());
-		entity.add<Hierarchy3DComponent>(Hierarchy3DComponent{ parent, inverseParentTransform });
-		entity.add<Transform3DComponent>(Transform3DComponent{ transform });
-		for (unsigned int i = 0; i < node->mNumChildren; i++)
-			processNode(entity, node->mChildren[i]);
+		visited[node.mesh] = true;
+		for (uint32_t p = 0; p < m_gltf.meshes[node.mesh].primitives.size(); p++)
+			meshes.push_back(m_meshOffsets[node.mesh] + p);
 	}
+	for (uint32_t child : node.children)
+		collectMeshes(child, meshes, visited);
 }
 
-// TODO move to engine.
-struct Vertex {
-	point3f position;
-	norm3f normal;
-	uv2f uv;
-	color4f color;
-}; 
-
-Entity AssimpImporter::processMesh(aiMesh* mesh)
+void GLTFImporter::convertMeshes(std::vector<uint32_t>& order)
 {
-	AKA_ASSERT(mesh->HasPositions(), "Mesh need positions");
-	AKA_ASSERT(mesh->HasNormals(), "Mesh needs normals");
-
-	ResourceManager* resource = Application::resource();
-	String meshName = mesh->mName.C_Str();
-	Entity e = m_world.createEntity(meshName);
-	e.add<MeshComponent>();
-	e.add<MaterialComponent>();
-	MeshComponent& meshComponent = e.get<MeshComponent>();
-	MaterialComponent& materialComponent = e.get<MaterialComponent>();
-
-	if (!resource->has<Mesh>(meshName))
-	{
-		std::vector<Vertex> vertices(mesh->mNumVertices);
-		std::vector<uint32_t> indices;
-		// process vertices
-		for (unsigned int i = 0; i < mesh->mNumVertices; i++)
-		{
-			Vertex& vertex = vertices[i];
-			// process vertex positions, normals and texture coordinates
-			vertex.position.x = mesh->mVertices[i].x;
-			vertex.position.y = mesh->mVertices[i].y;
-			vertex.position.z = mesh->mVertices[i].z;
-			meshComponent.bounds.include(vertex.position);
-
-			vertex.normal.x = mesh->mNormals[i].x;
-			vertex.normal.y = mesh->mNormals[i].y;
-			vertex.normal.z = mesh->mNormals[i].z;
-			if (mesh->HasTextureCoords(0))
-			{
-				vertex.uv.u = mesh->mTextureCoords[0][i].x;
-				vertex.uv.v = mesh->mTextureCoords[0][i].y;
-			}
-			else
-				vertex.uv = uv2f(0.f);
-			if (mesh->HasVertexColors(0))
-			{
-				vertex.color.r = mesh->mColors[0][i].r;
-				vertex.color.g = mesh->mColors[0][i].g;
-				vertex.color.b = mesh->mColors[0][i].b;
-				vertex.color.a = mesh->mColors[0][i].a;
-			}
-			else
-				vertex.color = color4f(1.f);
-			mesh->mTangents;
-			mesh->mBitangents;
-		}
-		// process indices
-		for (unsigned int i = 0; i < mesh->mNumFaces; i++)
-		{
-			aiFace face = mesh->mFaces[i];
-			for (unsigned int j = 0; j < face.mNumIndices; j++)
-				indices.push_back(face.mIndices[j]);
-		}
-		// Import resources
-		Path bufferDirectory = "library/buffer/";
-		if (!OS::Directory::exist(bufferDirectory))
-			OS::Directory::create(bufferDirectory);
-		Path meshDirectory = "library/mesh/";
-		if (!OS::Directory::exist(bufferDirectory))
-			OS::Directory::create(bufferDirectory);
-		// Index buffer
-		String indexBufferName = meshName + "-indices";
-		String indexBufferFileName = indexBufferName + ".buffer";
-		Path indexBufferPath = bufferDirectory + indexBufferFileName;
-		{
-			BufferStorage indexBuffer;
-			indexBuffer.type = BufferType::Index;
-			indexBuffer.access = BufferCPUAccess::None;
-			indexBuffer.usage = BufferUsage::Immutable;
-			indexBuffer.bytes.resize(indices.size() * sizeof(uint32_t));
-			memcpy(indexBuffer.bytes.data(), indices.data(), indexBuffer.bytes.size());
-			if (!indexBuffer.save(indexBufferPath))
-				Logger::error("Failed to save buffer");
-		}
-		Buffer::Ptr indexBuffer = resource->load<Buffer>(indexBufferName, indexBufferPath).resource;
-		
-		// Vertex buffer
-		String vertexBufferName = meshName + "-vertices";
-		String vertexBufferFileName = vertexBufferName + ".buffer";
-		Path vertexBufferPath = bufferDirectory + vertexBufferFileName;
+	std::vector<bool> visited(m_gltf.meshes.size(), false);
+	for (uint32_t node : m_gltf.scene)
+		collectMeshes(node, order, visited);
+	std::vector<const GLTF::Primitive*> primitives;
+	for (uint32_t meshIndex = 0; meshIndex < m_gltf.meshes.size(); meshIndex++)
+	{
+		const GLTF::Mesh& mesh = m_gltf.meshes[meshIndex];
+		String name = mesh.name;
+		if (name.cstr()[0] == '\0')
+			name = String("mesh") + std::to_string(meshIndex).c_str();
+		for (uint32_t p = 0; p < mesh.primitives.size(); p++)
 		{
-			BufferStorage vertexBuffer;
-			vertexBuffer.type = BufferType::Vertex;
-			vertexBuffer.access = BufferCPUAccess::None;
-			vertexBuffer.usage = BufferUsage::Immutable;
-			vertexBuffer.bytes.resize(vertices.size() * sizeof(Vertex));
-			memcpy(vertexBuffer.bytes.data(), vertices.data(), vertexBuffer.bytes.size());
-			if (!vertexBuffer.save(vertexBufferPath))
-				Logger::error("Failed to save buffer");
-		}
-		Buffer::Ptr vertexBuffer = resource->load<Buffer>(vertexBufferName, vertexBufferPath).resource;
-
-		// Mesh
-		String meshFileName = meshName + ".mesh";
-		Path meshPath = meshDirectory + meshFileName;
-		{
-			uint32_t vertexCount = (uint32_t)vertices.size();
-			uint32_t vertexBufferSize = (uint32_t)(vertices.size() * sizeof(Vertex));
-			MeshStorage storage;
-			storage.vertices = { {
-				MeshStorage::Vertex {
-					VertexAttribute{ VertexSemantic::Position, VertexFormat::Float, VertexType::Vec3 },
-					vertexBufferName,
-					vertexCount, // count
-					offsetof(Vertex, position), // offset
-					0,
-					vertexBufferSize, // size
-					sizeof(Vertex), // stride
-				},
-				MeshStorage::Vertex {
-					VertexAttribute{ VertexSemantic::Normal, VertexFormat::Float, VertexType::Vec3 },
-					vertexBufferName,
-					vertexCount, // count
-					offsetof(Vertex, normal), // offset
-					0,
-					vertexBufferSize, // size
-					sizeof(Vertex), // stride
-				},
-				MeshStorage::Vertex {
-					VertexAttribute{ VertexSemantic::TexCoord0, VertexFormat::Float, VertexType::Vec2 },
-					vertexBufferName,
-					vertexCount, // count
-					offsetof(Vertex, uv), // offset
-					0,
-					vertexBufferSize, // size
-					sizeof(Vertex), // stride
-				},
-				MeshStorage::Vertex {
-					VertexAttribute{ VertexSemantic::Color0, VertexFormat::Float, VertexType::Vec4 },
-					vertexBufferName,
-					vertexCount, // count
-					offsetof(Vertex, color), // offset
-					0,
-					vertexBufferSize, // size
-					sizeof(Vertex), // stride
-				}
-			} };
-			storage.indexBufferName = indexBufferName;
-			storage.indexBufferOffset = 0;
-			storage.indexCount = (uint32_t)indices.size();
-			storage.indexFormat = IndexFormat::UnsignedInt;
-			if (!storage.save(meshPath))
-				Logger::error("Failed to save mesh");
-			resource->load<Mesh>(meshName, meshPath);
+			primitives.push_back(&mesh.primitives[p]);
+			m_meshes.emplace_back();
+			m_meshes.back().name = (mesh.primitives.size() > 1) ? name + "-" + std::to_string(p).c_str() : name;
 		}
 	}
+	WorkerPool pool;
+	pool.parallelFor(order.size(), [&](size_t i) {
+		convertPrimitive(*primitives[order[i]], m_meshes[order[i]]);
+	});
+}
 
-	meshComponent.submesh.mesh = resource->get<Mesh>(meshName);
-	meshComponent.submesh.type = PrimitiveType::Triangles;
-	meshComponent.submesh.count = meshComponent.submesh.mesh->getIndexCount();
-	meshComponent.submesh.offset = 0;
-	
-	// process material
-	if (mesh->mMaterialIndex >= 0)
+void GLTFImporter::convertPrimitive(const GLTF::Primitive& primitive, ImportedMesh& imported) const
+{
+	const GLTF::Accessor& positions = m_gltf.accessors[primitive.position];
+	std::vector<Vertex>& vertices = imported.vertices;
+	std::vector<uint32_t>& indices = imported.indices;
+	imported.sourceColors = primitive.color >= 0;
+	vertices.resize(positions.count);
+	for (uint32_t i = 0; i < positions.count; i++)
 	{
-		//aiTextureType_EMISSION_COLOR = 14,
-		//aiTextureType_METALNESS = 15,
-		//aiTextureType_DIFFUSE_ROUGHNESS = 16,
-		//aiTextureType_AMBIENT_OCCLUSION = 17,
-		aiMaterial* material = m_assimpScene->mMaterials[mesh->mMaterialIndex];
-		TextureSampler defaultSampler = TextureSampler::trilinear;
-		TextureFlag flags = TextureFlag::ShaderResource | TextureFlag::GenerateMips;
-		aiColor4D c;
-		material->Get(AI_MATKEY_COLOR_DIFFUSE, c);
-		material->Get(AI_MATKEY_TWOSIDED, materialComponent.doubleSided);
-		materialComponent.color = color4f(c.r, c.g, c.b, c.a);
-		if (material->GetTextureCount(aiTextureType_BASE_COLOR) > 0)
-		{
-			aiTextureType type = aiTextureType_BASE_COLOR;
-			for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
-			{
-				aiString str;
-				material->GetTexture(type, i, &str);
-				materialComponent.albedo.texture = loadTexture(Path(m_directory + str.C_Str()), flags);
-				materialComponent.albedo.sampler = defaultSampler;
-				if (materialComponent.albedo.texture == nullptr)
-					materialComponent.albedo.texture = m_missingColorTexture;
-				break; // Ignore others textures for now.
-			}
-		}
-		else if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0)
-		{
-			aiTextureType type = aiTextureType_DIFFUSE;
-			for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
-			{
-				aiString str;
-				material->GetTexture(type, i, &str);
-				materialComponent.albedo.texture = loadTexture(Path(m_directory + str.C_Str()), flags);
-				materialComponent.albedo.sampler = defaultSampler;
-				if (materialComponent.albedo.texture == nullptr)
-					materialComponent.albedo.texture = m_missingColorTexture;
-				break; // Ignore others textures for now.
-			}
-		}
+		Vertex& vertex = vertices[i];
+		positions.read(i, &vertex.position.x, 3);
+		if (primitive.normal >= 0)
+			m_gltf.accessors[primitive.normal].read(i, &vertex.normal.x, 3);
 		else
+			vertex.normal = norm3f(0.f);
+		if (primitive.texcoord >= 0)
 		{
-			materialComponent.albedo.texture = m_blankColorTexture;
-			materialComponent.albedo.sampler = defaultSampler;
-		}
-		if (material->GetTextureCount(aiTextureType_NORMAL_CAMERA) > 0)
-		{
-			aiTextureType type = aiTextureType_NORMAL_CAMERA;
-			for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
-			{
-				aiString str;
-				material->GetTexture(type, i, &str);
-				materialComponent.normal.texture = loadTexture(Path(m_directory + str.C_Str()), flags);
-				materialComponent.normal.sampler = defaultSampler;
-				if (materialComponent.normal.texture == nullptr)
-					materialComponent.normal.texture = m_missingNormalTexture;
-				break; // Ignore others textures for now.
-			}
-		}
-		else if (material->GetTextureCount(aiTextureType_NORMALS) > 0)
-		{
-			aiTextureType type = aiTextureType_NORMALS;
-			for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
-			{
-				aiString str;
-				material->GetTexture(type, i, &str);
-				materialComponent.normal.texture = loadTexture(Path(m_directory + str.C_Str()), flags);
-				materialComponent.normal.sampler = defaultSampler;
-				if (materialComponent.normal.texture == nullptr)
-					materialComponent.normal.texture = m_missingNormalTexture;
-				break; // Ignore others textures for now.
-			}
+			m_gltf.accessors[primitive.texcoord].read(i, &vertex.uv.u, 2);
+#if !defined(AKA_ORIGIN_TOP_LEFT)
+			// glTF origin is top left
+			vertex.uv.v = 1.f - vertex.uv.v;
+#endif
 		}
 		else
+			vertex.uv = uv2f(0.f);
+		vertex.color = color4f(1.f);
+		if (primitive.color >= 0)
+			m_gltf.accessors[primitive.color].read(i, &vertex.color.r, 4);
+#if defined(GEOMETRY_LEFT_HANDED)
+		vertex.position.z = -vertex.position.z;
+		vertex.normal.z = -vertex.normal.z;
+#endif
+	}
+	if (primitive.indices >= 0)
+	{
+		const GLTF::Accessor& accessor = m_gltf.accessors[primitive.indices];
+		indices.resize(accessor.count / 3 * 3);
+		for (uint32_t i = 0; i < indices.size(); i++)
+			indices[i] = std::min(accessor.readIndex(i), positions.count - 1);
+	}
+	else
+	{
+		indices.resize(positions.count / 3 * 3);
+		for (uint32_t i = 0; i < indices.size(); i++)
+			indices[i] = i;
+	}
+#if defined(GEOMETRY_LEFT_HANDED)
+	// Mirroring z flips the winding
+	for (size_t i = 0; i < indices.size(); i += 3)
+		std::swap(indices[i + 1], indices[i + 2]);
+#endif
+	if (primitive.normal < 0)
+	{
+		// Smooth normals weighted by triangle area, as aiProcess_GenSmoothNormals
+		std::vector<vec3f> normals(vertices.size(), vec3f(0.f));
+		for (size_t i = 0; i < indices.size(); i += 3)
 		{
-			materialComponent.normal.texture = m_missingNormalTexture;
-			materialComponent.normal.sampler = defaultSampler;
-		}
-
-		if (material->GetTextureCount(aiTextureType_UNKNOWN) > 0) // GLTF pbr texture is retrieved this way (?)
-		{
-			aiTextureType type = aiTextureType_UNKNOWN;
-			for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
-			{
-				aiString str;
-				material->GetTexture(type, 0, &str);
-				materialComponent.material.texture = loadTexture(Path(m_directory + str.C_Str()), flags);
-				materialComponent.material.sampler = defaultSampler;
-				if (materialComponent.material.texture == nullptr)
-					materialComponent.material.texture = m_missingRoughnessTexture;
-				break; // Ignore others textures for now.
-			}
-		}
-		else if (material->GetTextureCount(aiTextureType_SHININESS) > 0)
-		{
-			aiTextureType type = aiTextureType_SHININESS;
-			for (unsigned int i = 0; i < material->GetTextureCount(type); i++)
-			{
-				aiString str;
-				material->GetTexture(type, i, &str);
-				materialComponent.material.texture = loadTexture(Path(m_directory + str.C_Str()), flags);
-				materialComponent.material.sampler = defaultSampler;
-				if (materialComponent.material.texture == nullptr)
-					materialComponent.material.texture = m_missingRoughnessTexture;
-				break; // Ignore others textures for now.
-			}
+			const point3f& p0 = vertices[indices[i + 0]].position;
+			const point3f& p1 = vertices[indices[i + 1]].position;
+			const point3f& p2 = vertices[indices[i + 2]].position;
+			vec3f e1 = vec3f(p1.x - p0.x, p1.y - p0.y, p1.z - p0.z);
+			vec3f e2 = vec3f(p2.x - p0.x, p2.y - p0.y, p2.z - p0.z);
+			vec3f n = vec3f(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+			for (size_t c = 0; c < 3; c++)
+				normals[indices[i + c]] = normals[indices[i + c]] + n;
 		}
-		else
+		for (size_t v = 0; v < vertices.size(); v++)
 		{
-			materialComponent.material.texture = m_missingRoughnessTexture;
-			materialComponent.material.sampler = defaultSampler;
+			float length = normals[v].norm();
+			if (length > 0.f)
+				vertices[v].normal = norm3f(normals[v].x / length, normals[v].y / length, normals[v].z / length);
+			else
+				vertices[v].normal = norm3f(0.f, 1.f, 0.f);
 		}
 	}
-	else
+}
+
+ImportedMaterial GLTFImporter::getMaterial(int32_t materialIndex) const
+{
+	ImportedMaterial material{};
+	material.valid = materialIndex >= 0 && materialIndex < (int32_t)m_gltf.materials.size();
+	if (!material.valid)
+		return material;
+	const GLTF::Material& gltfMaterial = m_gltf.materials[materialIndex];
+	material.color = color4f(gltfMaterial.baseColor[0], gltfMaterial.baseColor[1], gltfMaterial.baseColor[2], gltfMaterial.baseColor[3]);
+	material.doubleSided = gltfMaterial.doubleSided;
+	int32_t textures[3] = { gltfMaterial.baseColorTexture, gltfMaterial.normalTexture, gltfMaterial.metallicRoughnessTexture };
+	for (uint32_t slot = 0; slot < 3; slot++)
 	{
-		// No material !
-		materialComponent.color = color4f(1.f);
-		materialComponent.doubleSided = true;
-		materialComponent.albedo.texture = m_blankColorTexture;
-		materialComponent.albedo.sampler = TextureSampler::nearest;
-		materialComponent.normal.texture = m_missingNormalTexture;
-		materialComponent.normal.sampler = TextureSampler::nearest;
-		materialComponent.material.texture = m_missingRoughnessTexture;
-		materialComponent.material.sampler = TextureSampler::nearest;
+		material.hasTexture[slot] = textures[slot] >= 0;
+		if (material.hasTexture[slot])
+			material.textures[slot] = m_gltf.images[textures[slot]];
 	}
-	return e;
+	return material;
 }
 
-Texture::Ptr AssimpImporter::loadTexture(const Path& path, TextureFlag flags)
+void GLTFImporter::gatherTextures(std::vector<TextureReference>& textures)
 {
-	ResourceManager* resource = Application::resource();
-	String name = OS::File::name(path);
-	if (resource->has<Texture>(name))
-		return resource->get<Texture>(name);
-	if (Importer::importTexture2D(name, path, flags))
+	for (int32_t materialIndex = 0; materialIndex < (int32_t)m_gltf.materials.size(); materialIndex++)
+	{
+		ImportedMaterial material = getMaterial(materialIndex);
+		for (TextureSlot slot : { TextureSlot::Albedo, TextureSlot::Normal, TextureSlot::Material })
+			if (material.hasTexture[(int)slot])
+				textures.push_back(TextureReference{ material.textures[(int)slot], slot });
+	}
+}
+
+void GLTFImporter::processScene(Entity root)
+{
+	for (uint32_t node : m_gltf.scene)
+		processNode(root, node);
+}
+
+void GLTFImporter::processNode(Entity parent, uint32_t nodeIndex)
+{
+	const GLTF::Node& node = m_gltf.nodes[nodeIndex];
+	const float* m = node.transform;
+#if defined(GEOMETRY_LEFT_HANDED)
+	// S * M * S with S mirroring z, as aiProcess_MakeLeftHanded
+	float s[4] = { 1.f, 1.f, -1.f, 1.f };
+#else
+	float s[4] = { 1.f, 1.f, 1.f, 1.f };
+#endif
+	mat4f transform = mat4f(
+		col4f(m[0] * s[0] * s[0], m[1] * s[1] * s[0], m[2] * s[2] * s[0], m[3] * s[3] * s[0]),
+		col4f(m[4] * s[0] * s[1], m[5] * s[1] * s[1], m[6] * s[2] * s[1], m[7] * s[3] * s[1]),
+		col4f(m[8] * s[0] * s[2], m[9] * s[1] * s[2], m[10] * s[2] * s[2], m[11] * s[3] * s[2]),
+		col4f(m[12] * s[0] * s[3], m[13] * s[1] * s[3], m[14] * s[2] * s[3], m[15] * s[3] * s[3])
+	);
+	mat4f inverseParentTransform;
+	if (parent.valid())
 	{
-		return resource->get<Texture>(name);
+		mat4f parentTransform = parent.get<Transform3DComponent>().transform;
+		transform = parentTransform * transform;
+		inverseParentTransform = mat4f::inverse(parentTransform);
 	}
 	else
 	{
-		Logger::error("Failed to import texture2D");
-		return nullptr;
+		inverseParentTransform = mat4f::identity();
+	}
+	if (node.mesh >= 0)
+	{
+		const GLTF::Mesh& mesh = m_gltf.meshes[node.mesh];
+		for (uint32_t p = 0; p < mesh.primitives.size(); p++)
+		{
+			Entity e = createMeshEntity(m_meshOffsets[node.mesh] + p, getMaterial(mesh.primitives[p].material));
+			e.add<Transform3DComponent>(Transform3DComponent{ transform });
+			e.add<Hierarchy3DComponent>(Hierarchy3DComponent{ parent, inverseParentTransform });
+		}
+	}
+	if (node.children.size() > 0)
+	{
+		Entity entity = m_world->createEntity(node.name);
+		entity.add<Hierarchy3DComponent>(Hierarchy3DComponent{ parent, inverseParentTransform });
+		entity.add<Transform3DComponent>(Transform3DComponent{ transform });
+		for (uint32_t child : node.children)
+			processNode(entity, child);
 	}
 }
 
-bool Importer::importScene(const Path& path, aka::World& world)
+static const aiScene* readScene(Assimp::Importer& assimpImporter, const Path& path)
 {
-	Assimp::Importer assimpImporter;
 	const aiScene* aiScene = assimpImporter.ReadFile(path.cstr(),
 		aiProcess_Triangulate |
+		// Tangents are generated after welding & optimization, see generateTangents
 		//aiProcess_CalcTangentSpace |
 #if defined(AKA_ORIGIN_TOP_LEFT)
 		aiProcess_FlipUVs |
@@ -412,56 +1837,205 @@ bool Importer::importScene(const Path& path, aka::World& world)
 	if (!aiScene || aiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !aiScene->mRootNode)
 	{
 		Logger::error("[assimp] ", assimpImporter.GetErrorString());
-		return false;
+		return nullptr;
+	}
+	return aiScene;
+}
+
+// Import with the native glTF loader when possible, assimp otherwise.
+// Hash of a scene source, the files it read & the settings affecting the library, 0 if a file can't be read
+static uint64_t hashSceneSource(ImportCache& cache, const Path& path, const std::vector<std::string>& files, const ImportSettings& settings)
+{
+	uint64_t hash = hashMeshSettings(settings);
+	hash = ImportCache::hash(&settings.twoChannelNormalMaps, sizeof(bool), hash);
+	hash = ImportCache::hash(&settings.textureCodec, sizeof(Codec), hash);
+	hash = ImportCache::hash(&settings.blockCompression, sizeof(bool), hash);
+	hash = cache.hashSource(path, hash);
+	for (const std::string& file : files)
+	{
+		if (hash == 0)
+			return 0;
+		hash = cache.hashSource(Path(file.c_str()), hash);
+	}
+	return hash;
+}
+
+static bool importSceneFile(const Path& path, aka::World* world, ImportCache& cache, const ImportSettings& settings)
+{
+	Time start = Time::now();
+	// Headless imports of an unchanged glTF scene are skipped before reading it, only the modification time & size of its files are checked.
+	// Imports with a world need its entities & files read by assimp are not all known : these scenes are always read,
+	// their unchanged meshes & textures are still not rebuilt.
+	String sourceName = String("scene/") + path.cstr();
+	bool native = settings.nativeGLTF && GLTF::supports(path);
+	std::vector<std::string> files, outputs;
+	if (world == nullptr && native && cache.getSource(sourceName, files, outputs))
+	{
+		uint64_t hash = hashSceneSource(cache, path, files, settings);
+		bool upToDate = hash != 0 && cache.valid(sourceName, hash);
+		for (const std::string& output : outputs)
+			upToDate = upToDate && OS::File::exist(Path(output.c_str()));
+		if (upToDate)
+		{
+			Logger::info("Skipped ", path, ", unchanged since last import");
+			return true;
+		}
 	}
-	Path directory = path.up();
-	AssimpImporter importer(directory, aiScene, world);
+	if (native)
+	{
+		GLTF gltf;
+		if (gltf.load(path))
+		{
+			GLTFImporter importer(path, gltf, world, cache, settings);
+			importer.process();
+			if (world == nullptr)
+			{
+				files.clear();
+				outputs.clear();
+				for (const Path& file : gltf.files)
+					files.push_back(file.cstr());
+				importer.getFiles(files, outputs);
+				cache.setSource(sourceName, files, outputs);
+				cache.set(sourceName, hashSceneSource(cache, path, files, settings));
+			}
+			Logger::info("Imported ", path, " with glTF loader in ", (Time::now() - start).milliseconds(), "ms");
+			return true;
+		}
+		Logger::info("glTF loader does not support ", path, ", falling back to assimp");
+	}
+	Assimp::Importer assimpImporter;
+	const aiScene* aiScene = readScene(assimpImporter, path);
+	if (aiScene == nullptr)
+		return false;
+	AssimpImporter importer(path, aiScene, world, cache, settings);
 	importer.process();
+	Logger::info("Imported ", path, " with assimp in ", (Time::now() - start).milliseconds(), "ms");
 	return true;
 }
 
+bool Importer::importScene(const Path& path, aka::World& world, const ImportSettings& settings)
+{
+	ImportCache cache("library/import.json");
+	cache.load();
+	if (!importSceneFile(path, &world, cache, settings))
+		return false;
+	if (!cache.save())
+		Logger::error("Failed to save import cache");
+	return true;
+}
+
+bool Importer::bakeScene(const Path& path, ImportCache& cache, const ImportSettings& settings)
+{
+	return importSceneFile(path, nullptr, cache, settings);
+}
+
+size_t Importer::readSceneMeshes(const Path& path, bool nativeGLTF)
+{
+	// Never loaded nor saved, importers only read it when processing meshes.
+	ImportCache cache("library/import.json");
+	if (nativeGLTF)
+	{
+		GLTF gltf;
+		if (!GLTF::supports(path) || !gltf.load(path))
+			return 0;
+		GLTFImporter importer(path, gltf, nullptr, cache, ImportSettings{});
+		return importer.convert();
+	}
+	Assimp::Importer assimpImporter;
+	const aiScene* aiScene = readScene(assimpImporter, path);
+	if (aiScene == nullptr)
+		return 0;
+	AssimpImporter importer(path, aiScene, nullptr, cache, ImportSettings{});
+	return importer.convert();
+}
+
 bool Importer::importMesh(const aka::String& name, const aka::Path& path)
 {
 	return false;
 }
 
-bool Importer::importTexture2D(const aka::String& name, const aka::Path& path, TextureFlag flags)
+// Import a single 2D texture in the library. An unchanged source is loaded from the library, a changed one overwrites it in place.
+// Block compressed textures are stored in BC7, or BC6H for HDR.
+static bool importTexture2DFile(const String& name, const Path& path, TextureFlag flags, bool hdr, bool blockCompression)
 {
 	ResourceManager* resource = Application::resource();
-	// TODO use devil as importer to support a wider range of format ?
-	// Exporter would be a standalone exe to not overwhelm the engine with assimp, devil include...
-	// Or a library that include aka, assimp, devil...
-	// Use it as library for a project. 
-	// AkaImporter.h
-	if (!resource->has<Texture>(name))
-	{
-		String directory = "library/texture/";
-		if (!OS::Directory::exist(directory))
-			OS::Directory::create(directory);
-		String libPath = directory + name + ".tex";
-
-		// Convert and save
-		TextureStorage storage;
-		storage.type = TextureType::Texture2D;
-		storage.flags = flags;
-		storage.format = TextureFormat::RGBA8;
-		storage.images.push_back(Image::load(path));
+	String directory = "library/texture/";
+	if (!OS::Directory::exist(directory))
+		OS::Directory::create(directory);
+	String libPath = directory + name + ".tex";
+	TextureFormat format = hdr ? TextureFormat::RGBA16F : TextureFormat::RGBA8;
 
-		// blabla
-		if (!storage.save(libPath))
-			return false;
-		// Load
-		if (resource->load<Texture>(name, libPath).resource == nullptr)
+	ImportCache cache("library/import.json");
+	cache.load();
+	uint64_t hash = ImportCache::hash(&importerVersion, sizeof(importerVersion));
+	hash = ImportCache::hash(&format, sizeof(TextureFormat), hash);
+	hash = ImportCache::hash(&flags, sizeof(TextureFlag), hash);
+	hash = ImportCache::hash(&blockCompression, sizeof(bool), hash);
+	hash = cache.hashSource(path, hash);
+	if (hash == 0)
+	{
+		Logger::error("Failed to read ", path);
+		return false;
+	}
+	if (cache.valid(name, hash) && OS::File::exist(libPath))
+	{
+		if (!cache.save())
+			Logger::warn("Failed to save import cache");
+		if (resource->has<Texture>(name))
+			return true;
+		Resource<Texture> texture = LibraryLoader::loadTexture(libPath);
+		if (texture.resource == nullptr)
 			return false;
+		LibraryLoader::registerResource<Texture>(name, libPath, texture.resource, texture.size);
+		return true;
 	}
-	else
+	if (cache.conflict(name, hash, path.cstr()) || (resource->has<Texture>(name) && !cache.contains(name)))
 	{
 		Logger::warn("Texture already imported : ", name);
+		return true;
+	}
+
+	// Convert and save
+	std::vector<TextureData::Image> levels = prepareTexture2D(hdr ? Image::loadHDR(path) : Image::load(path), format, flags, hdr, !hdr);
+	if (levels.empty() || levels[0].width == 0)
+		return false;
+	TextureData data;
+	if (blockCompression)
+	{
+		WorkerPool pool;
+		std::vector<BlockBand> bands;
+		addBlockBands(levels, hdr ? BlockFormat::BC6H : BlockFormat::BC7, data, bands);
+		encodeBlockBands(pool, bands);
+		decodeBlocks(data, levels);
 	}
+	if (!saveTexture2D(libPath, data, levels, format, flags, Codec::None))
+		return false;
+	// Load
+	if (registerTexture2D(name, libPath, levels, format, flags) == nullptr)
+		return false;
+	cache.set(name, hash, path.cstr());
+	cache.addTexture(name, libPath);
+	if (!cache.save())
+		Logger::warn("Failed to save import cache");
 	return true;
 }
 
-bool Importer::importTexture2DHDR(const aka::String& name, const aka::Path& path, TextureFlag flags)
+bool Importer::importTexture2D(const aka::String& name, const aka::Path& path, TextureFlag flags, bool blockCompression)
+{
+	// TODO use devil as importer to support a wider range of format ?
+	// Exporter would be a standalone exe to not overwhelm the engine with assimp, devil include...
+	// Or a library that include aka, assimp, devil...
+	// Use it as library for a project. 
+	// AkaImporter.h
+	return importTexture2DFile(name, path, flags, false, blockCompression);
+}
+
+bool Importer::importTexture2DHDR(const aka::String& name, const aka::Path& path, TextureFlag flags, bool blockCompression)
+{
+	return importTexture2DFile(name, path, flags, true, blockCompression);
+}
+
+bool Importer::importTextureCubemap(const aka::String& name, const aka::Path& px, const aka::Path& py, const aka::Path& pz, const aka::Path& nx, const aka::Path& ny, const aka::Path& nz, TextureFlag flags)
 {
 	ResourceManager* resource = Application::resource();
 	if (!resource->has<Texture>(name))
@@ -472,18 +2046,21 @@ bool Importer::importTexture2DHDR(const aka::String& name, const aka::Path& path
 		String libPath = directory + name + ".tex";
 
 		// Convert and save
-		TextureStorage storage;
-		storage.type = TextureType::Texture2D;
-		storage.flags = flags;
-		storage.format = TextureFormat::RGBA32F;
-		storage.images.push_back(Image::loadHDR(path));
+		TextureData data;
+		data.type = TextureType::TextureCubeMap;
+		data.flags = LibraryLoader::getLevelFlags(flags, 1);
+		data.format = TextureFormat::RGBA8;
+		for (const Path& face : { px, py, pz, nx, ny, nz })
+			data.images.push_back(convertImage(Image::load(face), TextureFormat::RGBA8));
 
 		// blabla
-		if (!storage.save(libPath))
+		if (!TextureFile::save(libPath, data))
 			return false;
 		// Load
-		if (resource->load<Texture>(name, libPath).resource == nullptr)
+		Resource<Texture> cubemap = LibraryLoader::loadTexture(libPath);
+		if (cubemap.resource == nullptr)
 			return false;
+		LibraryLoader::registerResource<Texture>(name, libPath, cubemap.resource, cubemap.size);
 	}
 	else
 	{
@@ -492,40 +2069,139 @@ bool Importer::importTexture2DHDR(const aka::String& name, const aka::Path& path
 	return true;
 }
 
-bool Importer::importTextureCubemap(const aka::String& name, const aka::Path& px, const aka::Path& py, const aka::Path& pz, const aka::Path& nx, const aka::Path& ny, const aka::Path& nz, TextureFlag flags)
+// Resample a decoded equirectangular RGBA8 or RGBA32F (hdr) image to a cubemap, write it to the library & load it.
+// Its environment lighting is computed from the same pixels & cached with the same hash.
+// Conversion is skipped when the library holds a cubemap & an environment converted from the same content.
+static bool importEquirectangular(ImportCache& cache, const String& name, uint64_t hash, const std::function<Image(void)>& decode, bool hdr, uint32_t size, TextureFlag flags, Environment* environment, bool blockCompression)
 {
 	ResourceManager* resource = Application::resource();
-	if (!resource->has<Texture>(name))
-	{
-		String directory = "library/texture/";
-		if (!OS::Directory::exist(directory))
-			OS::Directory::create(directory);
-		String libPath = directory + name + ".tex";
-
-		// Convert and save
-		TextureStorage storage;
-		storage.type = TextureType::TextureCubeMap;
-		storage.flags = flags;
-		storage.format = TextureFormat::RGBA8;
-		storage.images.push_back(Image::load(px));
-		storage.images.push_back(Image::load(py));
-		storage.images.push_back(Image::load(pz));
-		storage.images.push_back(Image::load(nx));
-		storage.images.push_back(Image::load(ny));
-		storage.images.push_back(Image::load(nz));
+	String directory = "library/texture/";
+	if (!OS::Directory::exist(directory))
+		OS::Directory::create(directory);
+	String libPath = directory + name + ".tex";
+	Path environmentPath = Environment::getPath(name);
+	hash = ImportCache::hash(&importerVersion, sizeof(importerVersion), hash);
+	hash = ImportCache::hash(&size, sizeof(uint32_t), hash);
+	hash = ImportCache::hash(&flags, sizeof(TextureFlag), hash);
+	hash = ImportCache::hash(&blockCompression, sizeof(bool), hash);
 
-		// blabla
-		if (!storage.save(libPath))
-			return false;
-		// Load
-		if (resource->load<Texture>(name, libPath).resource == nullptr)
+	bool converted = cache.valid(name, hash) && OS::File::exist(libPath);
+	Environment computed;
+	Environment& lighting = environment != nullptr ? *environment : computed;
+	bool lit = lighting.load(environmentPath, hash);
+	if (!converted || !lit)
+	{
+		Image image = decode();
+		if (image.width() == 0 || image.height() == 0)
 			return false;
+		// Lighting is computed from linear radiance, LDR sources are sRGB encoded.
+		std::vector<float> pixels((size_t)image.width() * image.height() * 4);
+		if (hdr)
+			memcpy(pixels.data(), image.data(), pixels.size() * sizeof(float));
+		else
+			for (size_t i = 0; i < pixels.size(); i++)
+				pixels[i] = (i % 4 == 3) ? ((const uint8_t*)image.data())[i] / 255.f : MipChain::srgbToLinear(((const uint8_t*)image.data())[i] / 255.f);
+		if (!converted)
+		{
+			// Mips are prefiltered with GGX, one roughness per level, so that reflections can sample the skybox by roughness.
+			bool mips = ((int)flags & (int)TextureFlag::GenerateMips) != 0;
+			std::vector<std::vector<std::vector<float>>> cubemap = Environment::toCubemap(pixels.data(), image.width(), image.height(), size, mips);
+
+			// Skybox values are displayed as is, LDR faces are encoded back to sRGB & not filtered as sRGB.
+			// Faces of every level follow each other, level by level.
+			TextureFormat format = hdr ? TextureFormat::RGBA16F : TextureFormat::RGBA8;
+			std::vector<TextureData::Image> faces;
+			for (size_t level = 0; level < cubemap.size(); level++)
+			{
+				uint32_t levelSize = std::max(size >> level, 1U);
+				for (const std::vector<float>& face : cubemap[level])
+				{
+					TextureData::Image faceImage{ levelSize, levelSize, std::vector<uint8_t>(face.size() * (hdr ? sizeof(uint16_t) : 1)) };
+					for (size_t i = 0; i < face.size(); i++)
+					{
+						if (hdr)
+						{
+							uint16_t half = packHalf(face[i]);
+							memcpy(&faceImage.bytes[2 * i], &half, sizeof(uint16_t));
+						}
+						else
+						{
+							faceImage.bytes[i] = quantizeUnorm8((i % 4 == 3) ? face[i] : MipChain::linearToSrgb(face[i]));
+						}
+					}
+					faces.push_back(std::move(faceImage));
+				}
+			}
+			TextureData data;
+			if (blockCompression)
+			{
+				WorkerPool pool;
+				std::vector<BlockBand> bands;
+				addBlockBands(faces, hdr ? BlockFormat::BC6H : BlockFormat::BC7, data, bands);
+				encodeBlockBands(pool, bands);
+			}
+			else
+			{
+				data.format = format;
+				data.images = std::move(faces);
+			}
+			data.type = TextureType::TextureCubeMap;
+			data.flags = LibraryLoader::getLevelFlags(flags, cubemap.size());
+			if (!TextureFile::save(libPath, data))
+				return false;
+			cache.set(name, hash);
+			cache.addTexture(name, libPath);
+			Logger::info("Converted ", name, " to a ", size, "x", size, " cubemap");
+		}
+		if (!lit)
+		{
+			lighting = Environment::compute(pixels.data(), image.width(), image.height());
+			if (!OS::Directory::exist("library/environment/"))
+				OS::Directory::create("library/environment/");
+			if (!lighting.save(environmentPath, hash))
+				Logger::warn("Failed to cache environment ", environmentPath);
+		}
 	}
-	else
+	// Load, stored levels are uploaded by the library loader as the resource manager only uploads the base level of cubemaps.
+	if (converted && resource->has<Texture>(name))
+		return true;
+	Resource<Texture> cubemap = LibraryLoader::loadTexture(libPath);
+	if (cubemap.resource == nullptr)
+		return false;
+	LibraryLoader::registerResource<Texture>(name, libPath, cubemap.resource, cubemap.size);
+	return true;
+}
+
+bool Importer::importTextureEquirectangular(const aka::String& name, const aka::Path& path, uint32_t size, TextureFlag flags, Environment* environment, bool blockCompression)
+{
+	std::string extension = path.cstr();
+	extension = extension.substr(std::min(extension.find_last_of('.'), extension.size()));
+	for (char& c : extension)
+		c = (char)tolower(c);
+	bool hdr = extension == ".hdr";
+	ImportCache cache("library/import.json");
+	cache.load();
+	uint64_t hash = cache.hashSource(path);
+	if (hash == 0)
 	{
-		Logger::warn("Texture already imported : ", name);
+		Logger::error("Failed to read ", path);
+		return false;
 	}
-	return true;
+	bool imported = importEquirectangular(cache, name, hash, [&]() { return hdr ? Image::loadHDR(path) : Image::load(path); }, hdr, size, flags, environment, blockCompression);
+	if (!cache.save())
+		Logger::warn("Failed to save import cache");
+	return imported;
+}
+
+bool Importer::importTextureEquirectangular(const aka::String& name, const aka::Image& image, bool hdr, uint32_t size, TextureFlag flags, Environment* environment, bool blockCompression)
+{
+	ImportCache cache("library/import.json");
+	cache.load();
+	uint64_t hash = ImportCache::hash(image.data(), (size_t)image.width() * image.height() * 4 * (hdr ? sizeof(float) : 1));
+	bool imported = importEquirectangular(cache, name, hash, [&]() { return image; }, hdr, size, flags, environment, blockCompression);
+	if (!cache.save())
+		Logger::warn("Failed to save import cache");
+	return imported;
 }
 
 bool Importer::importAudio(const aka::String& name, const aka::Path& path)
@@ -1,20 +1,72 @@
 #pragma once
 
 #include "Model.h"
+#include "ImportCache.h"
+#include "Environment.h"
+#include "Compression.h"
 
 namespace app {
 
+// Settings used when importing a scene
+struct ImportSettings {
+	// Weld bitwise identical vertices and remap indices
+	bool weldVertices = true;
+	// Reorder triangles for post transform vertex cache & vertices for fetch locality
+	bool optimizeVertexCache = true;
+	// Reorder triangles clusters to reduce overdraw, at the cost of a slightly worse vertex cache
+	bool optimizeOverdraw = false;
+	// Store vertices as unorm16 positions within mesh bounds, octahedral normals, half uvs and an optional RGBA8 color stream
+	bool packVertices = false;
+	// Generate a packed tangent stream for normal mapping without derivatives. Packed vertices always have tangents.
+	bool generateTangents = true;
+	// Number of simplified LODs generated per mesh, up to StaticMeshComponent::maxLodCount
+	uint32_t lodCount = 3;
+	// Maximum simplification error of LODs, relative to mesh extent
+	float lodTargetError = 0.05f;
+	// Split meshes in meshlets with bounds for per cluster culling
+	bool buildMeshlets = true;
+	// Write a position only stream drawn by shadow passes, at 12 bytes per vertex (8 packed) on top of the vertices.
+	// Only worth it when shadow passes are vertex fetch bound.
+	bool depthStream = false;
+	// Store normal maps in RG8, shaders reconstruct z. Other textures stay RGBA8.
+	bool twoChannelNormalMaps = true;
+	// Store material textures block compressed : BC1 for opaque albedo, BC3 for albedo with alpha, BC5 for normal maps & BC7 for material maps.
+	// Aka has no block compressed format, blocks are decoded at load : files are 4 to 8 times smaller, uploaded textures are not.
+	bool blockCompression = false;
+	// Read .gltf & .glb with the native loader, falling back to assimp for features it does not handle
+	bool nativeGLTF = true;
+	// Merge imported meshes with the static meshes of the world in shared vertex & index buffers
+	bool batchMeshes = true;
+	// Codec of library buffer & texture files, stored per file. Raw files are uploaded straight from a mapping,
+	// compressed ones are decompressed on workers at load : LZ4 decompresses fastest, Zstd is smaller.
+	Codec bufferCodec = Codec::None;
+	Codec textureCodec = Codec::None;
+};
+
 struct Importer {
-	// Import a scene using assimp and convert it to a scene.json and add assets to resource manager
-	static bool importScene(const Path& path, aka::World& world);
+	// Import a scene using the native glTF loader or assimp and convert it to a scene.json and add assets to resource manager
+	static bool importScene(const Path& path, aka::World& world, const ImportSettings& settings = ImportSettings{});
+	// Import a scene assets to the library only, without graphic context, resources nor entities.
+	// Concurrent bakes must share the same cache, which is loaded & saved by the caller.
+	static bool bakeScene(const Path& path, ImportCache& cache, const ImportSettings& settings = ImportSettings{});
+	// Read a scene & convert its meshes to triangle lists only, without baking them nor touching the library.
+	// Times the part of an import done by the native glTF loader or assimp. Return the number of vertices read, 0 on failure.
+	static size_t readSceneMeshes(const Path& path, bool nativeGLTF);
 	// Import a mesh and add it to resource manager
 	static bool importMesh(const aka::String& name, const aka::Path& path);
-	// Import a texture and add it to resource manager
-	static bool importTexture2D(const aka::String& name, const aka::Path& path, TextureFlag flags);
-	// Import an HDR texture and add it to resource manager
-	static bool importTexture2DHDR(const aka::String& name, const aka::Path& path, TextureFlag flags);
+	// Import a texture and add it to resource manager. With GenerateMips, levels are generated & stored at import.
+	// Block compressed textures are stored in BC7.
+	static bool importTexture2D(const aka::String& name, const aka::Path& path, TextureFlag flags, bool blockCompression = false);
+	// Import an HDR texture and add it to resource manager. Block compressed HDR textures are stored in BC6H.
+	static bool importTexture2DHDR(const aka::String& name, const aka::Path& path, TextureFlag flags, bool blockCompression = false);
 	// Import a cubemap and add it to resource manager
 	static bool importTextureCubemap(const aka::String& name, const aka::Path& px, const aka::Path& py, const aka::Path& pz, const aka::Path& nx, const aka::Path& ny, const aka::Path& nz, TextureFlag flags);
+	// Convert an equirectangular image (.hdr or LDR) to a cubemap and add it to resource manager.
+	// Its environment lighting is cached in the library & filled if requested.
+	// Conversion is skipped if the library cubemap was converted from the same content. Block compressed faces are stored in BC7, or BC6H for .hdr.
+	static bool importTextureEquirectangular(const aka::String& name, const aka::Path& path, uint32_t size, TextureFlag flags, Environment* environment = nullptr, bool blockCompression = false);
+	// Convert a decoded sRGB RGBA8 or linear RGBA32F (hdr) equirectangular image to a cubemap and add it to resource manager.
+	static bool importTextureEquirectangular(const aka::String& name, const aka::Image& image, bool hdr, uint32_t size, TextureFlag flags, Environment* environment = nullptr, bool blockCompression = false);
 	// Import an audio and add it to resource manager
 	static bool importAudio(const aka::String& name, const aka::Path& path);
 	// Import a font and add it to resource manager
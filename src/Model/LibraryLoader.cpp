@@ -0,0 +1,422 @@
+#include "LibraryLoader.h"
+
+#include "Model.h"
+#include "ImportCache.h"
+#include "GraphicFormat.h"
+#include "WorkerPool.h"
+#include "json.hpp"
+
+#include <set>
+#include <atomic>
+
+namespace app {
+
+using namespace aka;
+
+// Library file read & decoded by a worker
+template <typename T>
+struct LibraryFile {
+	String name;
+	Path path;
+	T storage;
+	bool loaded;
+};
+
+// Queue an indexed library file if its resource is not resident yet, or was released after batching
+template <typename T, typename S>
+static void queueLibraryFile(const std::map<std::string, std::string>& indexed, const String& name, std::set<std::string>& queued, std::vector<LibraryFile<S>>& files)
+{
+	ResourceManager* resource = Application::resource();
+	if (resource->has<T>(name) && resource->get<T>(name) != nullptr)
+		return;
+	auto it = indexed.find(name.cstr());
+	if (it == indexed.end() || !queued.insert(it->first).second)
+		return;
+	files.push_back(LibraryFile<S>{ name, Path(it->second.c_str()), S{}, false });
+}
+
+// Manifest entries map names to an object holding the library path of the resource
+static void indexManifest(const nlohmann::json& json, const char* type, std::map<std::string, std::string>& files)
+{
+	if (json.find(type) == json.end())
+		return;
+	for (auto& element : json[type].items())
+	{
+		const nlohmann::json& value = element.value();
+		if (value.is_object() && value.find("path") != value.end())
+			files[element.key()] = value["path"].get<std::string>();
+		else if (value.is_string())
+			files[element.key()] = value.get<std::string>();
+	}
+}
+
+void LibraryLoader::index(const Path& manifest)
+{
+	if (!OS::File::exist(manifest))
+		return;
+	try
+	{
+		String s;
+		OS::File::read(manifest, &s);
+		nlohmann::json json = nlohmann::json::parse(s.cstr());
+		indexManifest(json, "buffers", m_buffers);
+		indexManifest(json, "meshes", m_meshes);
+		indexManifest(json, "textures", m_textures);
+		indexManifest(json, "fonts", m_fonts);
+	}
+	catch (const nlohmann::json::exception& e)
+	{
+		Logger::error("Failed to read library manifest : ", e.what());
+	}
+}
+
+void LibraryLoader::index(const ImportCache& cache)
+{
+	// Imports are more recent than the manifest that was saved before them.
+	for (auto& buffer : cache.getBuffers())
+		m_buffers[buffer.first] = buffer.second;
+	for (auto& mesh : cache.getMeshes())
+		m_meshes[mesh.first] = mesh.second;
+	for (auto& texture : cache.getTextures())
+		m_textures[texture.first] = texture.second;
+}
+
+void LibraryLoader::load()
+{
+	std::vector<String> meshes;
+	std::vector<String> textures;
+	std::vector<String> fonts;
+	for (auto& mesh : m_meshes)
+		meshes.push_back(mesh.first.c_str());
+	for (auto& texture : m_textures)
+		textures.push_back(texture.first.c_str());
+	for (auto& font : m_fonts)
+		fonts.push_back(font.first.c_str());
+	load(meshes, textures, fonts);
+}
+
+void LibraryLoader::load(const std::vector<String>& meshNames, const std::vector<String>& textureNames, const std::vector<String>& fontNames)
+{
+	ResourceManager* resource = Application::resource();
+	WorkerPool pool;
+
+	// Meshes are written with their LODs, position only streams & quantization, load them together.
+	std::set<std::string> queuedMeshes;
+	std::vector<LibraryFile<MeshStorage>> meshes;
+	std::set<std::string> queuedBuffers;
+	std::vector<LibraryFile<BufferStorage>> buffers;
+	for (const String& name : meshNames)
+	{
+		queueLibraryFile<Mesh>(m_meshes, name, queuedMeshes, meshes);
+		queueLibraryFile<Buffer>(m_buffers, Scene::getQuantizationName(name), queuedBuffers, buffers);
+		queueLibraryFile<Mesh>(m_meshes, Scene::getDepthName(name), queuedMeshes, meshes);
+		for (uint32_t lod = 1; lod <= StaticMeshComponent::maxLodCount; lod++)
+		{
+			String lodName = Scene::getLodName(name, lod);
+			queueLibraryFile<Mesh>(m_meshes, lodName, queuedMeshes, meshes);
+			queueLibraryFile<Mesh>(m_meshes, Scene::getDepthName(lodName), queuedMeshes, meshes);
+		}
+	}
+	// Mesh files are small, they are read first to find the buffers they reference.
+	pool.parallelFor(meshes.size(), [&](size_t i) {
+		meshes[i].loaded = meshes[i].storage.load(meshes[i].path);
+	});
+	for (const LibraryFile<MeshStorage>& mesh : meshes)
+	{
+		if (!mesh.loaded)
+			continue;
+		for (const MeshStorage::Vertex& vertex : mesh.storage.vertices)
+		{
+			const auto& [attribute, bufferName, count, offset, bufferOffset, size, stride] = vertex;
+			queueLibraryFile<Buffer>(m_buffers, bufferName, queuedBuffers, buffers);
+		}
+		queueLibraryFile<Buffer>(m_buffers, mesh.storage.indexBufferName, queuedBuffers, buffers);
+	}
+	std::set<std::string> queuedTextures;
+	std::vector<LibraryFile<TextureStorage>> textures;
+	for (const String& name : textureNames)
+		queueLibraryFile<Texture>(m_textures, name, queuedTextures, textures);
+
+	// Buffers & textures hold the payload, read & decode all of them concurrently.
+	// Library files are mapped & their pages faulted in here, raw payloads are then uploaded from the mapping.
+	// Compressed payloads are split in chunks, all of them are decompressed concurrently afterwards.
+	// Files written without header are read in storage.
+	std::vector<std::unique_ptr<BufferFile>> mapped(buffers.size());
+	std::vector<std::unique_ptr<TextureFile>> mappedTextures(textures.size());
+	std::vector<std::vector<ChunkedPayload::Chunk>> fileChunks(buffers.size() + textures.size());
+	size_t copiedBytes = BufferFile::copiedBytes();
+	pool.parallelFor(buffers.size() + textures.size(), [&](size_t i) {
+		if (i < buffers.size())
+		{
+			std::unique_ptr<BufferFile> file = std::make_unique<BufferFile>();
+			if (file->open(buffers[i].path))
+			{
+				buffers[i].loaded = file->split(fileChunks[i]);
+				if (file->codec() == Codec::None)
+				{
+					volatile uint8_t touched = 0;
+					for (size_t offset = 0; offset < file->size(); offset += 4096)
+						touched ^= file->data()[offset];
+				}
+				mapped[i] = std::move(file);
+			}
+			else
+				buffers[i].loaded = BufferFile::load(buffers[i].path, buffers[i].storage);
+		}
+		else
+		{
+			LibraryFile<TextureStorage>& texture = textures[i - buffers.size()];
+			std::unique_ptr<TextureFile> file = std::make_unique<TextureFile>();
+			if (file->open(texture.path))
+			{
+				texture.loaded = file->split(fileChunks[i]);
+				mappedTextures[i - buffers.size()] = std::move(file);
+			}
+			else
+				texture.loaded = texture.storage.load(texture.path);
+		}
+	});
+	std::vector<ChunkedPayload::Chunk> chunks;
+	std::vector<size_t> chunkFiles;
+	for (size_t i = 0; i < fileChunks.size(); i++)
+	{
+		chunks.insert(chunks.end(), fileChunks[i].begin(), fileChunks[i].end());
+		chunkFiles.insert(chunkFiles.end(), fileChunks[i].size(), i);
+	}
+	std::vector<std::atomic<bool>> corrupted(fileChunks.size());
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		if (!ChunkedPayload::decompress(chunks[i]))
+			corrupted[chunkFiles[i]] = true;
+	});
+	for (size_t i = 0; i < buffers.size(); i++)
+		buffers[i].loaded = buffers[i].loaded && !corrupted[i];
+	// Block compressed textures are decoded here, Aka can't upload blocks.
+	pool.parallelFor(textures.size(), [&](size_t i) {
+		if (mappedTextures[i] == nullptr)
+			return;
+		textures[i].loaded = textures[i].loaded && !corrupted[buffers.size() + i] && mappedTextures[i]->validate();
+		if (textures[i].loaded)
+			mappedTextures[i]->decode();
+	});
+
+	// Graphic resources are created on this thread, texture payloads are released once uploaded.
+	m_storages.clear();
+	m_mappings.clear();
+	size_t mappedBytes = 0;
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		LibraryFile<BufferStorage>& buffer = buffers[i];
+		Buffer::Ptr ptr = nullptr;
+		if (buffer.loaded)
+			ptr = (mapped[i] != nullptr) ? mapped[i]->create() : createBuffer(buffer.storage);
+		if (ptr == nullptr)
+		{
+			Logger::error("Failed to load buffer ", buffer.name);
+			continue;
+		}
+		if (mapped[i] != nullptr)
+		{
+			if (mapped[i]->codec() == Codec::None)
+				mappedBytes += mapped[i]->size();
+			registerResource<Buffer>(buffer.name, buffer.path, ptr, mapped[i]->size());
+			m_mappings[ptr.get()] = std::move(mapped[i]);
+		}
+		else
+		{
+			registerResource<Buffer>(buffer.name, buffer.path, ptr, buffer.storage.bytes.size());
+			m_storages[ptr.get()] = std::move(buffer.storage);
+		}
+	}
+	if (!buffers.empty())
+		Logger::info("Loaded ", buffers.size(), " buffers, ", mappedBytes, " bytes mapped, ", BufferFile::copiedBytes() - copiedBytes, " bytes copied or decompressed");
+	for (const LibraryFile<MeshStorage>& mesh : meshes)
+	{
+		Mesh::Ptr ptr = mesh.loaded ? createMesh(mesh.storage) : nullptr;
+		if (ptr == nullptr)
+		{
+			Logger::error("Failed to load mesh ", mesh.name);
+			continue;
+		}
+		registerResource<Mesh>(mesh.name, mesh.path, ptr, 0);
+	}
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		LibraryFile<TextureStorage>& texture = textures[i];
+		if (!texture.loaded)
+		{
+			Logger::error("Failed to load texture ", texture.name);
+			continue;
+		}
+		Texture::Ptr ptr = (mappedTextures[i] != nullptr) ? mappedTextures[i]->create() : createTexture(texture.storage);
+		if (ptr == nullptr)
+		{
+			// Other layouts are left to the resource manager.
+			resource->load<Texture>(texture.name, texture.path);
+			continue;
+		}
+		size_t size = 0;
+		if (mappedTextures[i] != nullptr)
+			size = mappedTextures[i]->size();
+		for (const Image& level : texture.storage.images)
+			size += level.width() * level.height() * GraphicFormat::getPixelSize(texture.storage.format);
+		registerResource<Texture>(texture.name, texture.path, ptr, size);
+		mappedTextures[i].reset();
+		texture.storage = TextureStorage();
+	}
+	// Fonts are rasterized by the resource manager.
+	for (const String& name : fontNames)
+	{
+		auto it = m_fonts.find(name.cstr());
+		if (it != m_fonts.end() && !resource->has<Font>(name))
+			resource->load<Font>(name, Path(it->second.c_str()));
+	}
+}
+
+bool LibraryLoader::readBuffer(const Buffer* buffer, BufferStorage& storage)
+{
+	auto mapping = m_mappings.find(buffer);
+	if (mapping != m_mappings.end())
+	{
+		mapping->second->read(storage);
+		m_mappings.erase(mapping);
+		return true;
+	}
+	auto it = m_storages.find(buffer);
+	if (it == m_storages.end())
+		return false;
+	storage = std::move(it->second);
+	m_storages.erase(it);
+	return true;
+}
+
+Buffer::Ptr LibraryLoader::createBuffer(const BufferStorage& storage)
+{
+	return Buffer::create(storage.type, storage.bytes.size(), storage.usage, storage.access, storage.bytes.data());
+}
+
+Mesh::Ptr LibraryLoader::createMesh(const MeshStorage& storage)
+{
+	ResourceManager* resource = Application::resource();
+	std::vector<VertexAccessor> accessors(storage.vertices.size());
+	for (size_t i = 0; i < storage.vertices.size(); i++)
+	{
+		// Fields in declaration order, as initialized by the importer
+		const auto& [attribute, bufferName, count, offset, bufferOffset, size, stride] = storage.vertices[i];
+		Buffer::Ptr buffer = resource->get<Buffer>(bufferName);
+		if (buffer == nullptr)
+			return nullptr;
+		accessors[i].attribute = attribute;
+		accessors[i].bufferView = VertexBufferView{ buffer, bufferOffset, size, stride };
+		accessors[i].offset = offset;
+		accessors[i].count = count;
+	}
+	Buffer::Ptr indexBuffer = resource->get<Buffer>(storage.indexBufferName);
+	if (indexBuffer == nullptr)
+		return nullptr;
+	uint32_t indexSize = storage.indexCount * GraphicFormat::getIndexSize(storage.indexFormat);
+	IndexAccessor indexAccessor{ storage.indexFormat, IndexBufferView{ indexBuffer, storage.indexBufferOffset, indexSize }, storage.indexCount };
+	Mesh::Ptr mesh = Mesh::create();
+	mesh->upload(accessors.data(), accessors.size(), indexAccessor);
+	return mesh;
+}
+
+Texture::Ptr LibraryLoader::createTexture(const TextureStorage& storage)
+{
+	if (storage.type == TextureType::TextureCubeMap)
+		return createTextureCubeMap(storage.images, storage.format, storage.flags);
+	if (storage.type != TextureType::Texture2D)
+		return nullptr;
+	return createTexture2D(storage.images, storage.format, storage.flags);
+}
+
+Texture::Ptr LibraryLoader::createTexture2D(const std::vector<Image>& levels, TextureFormat format, TextureFlag flags)
+{
+	if (levels.empty())
+		return nullptr;
+	std::vector<const void*> data(levels.size());
+	for (size_t level = 0; level < levels.size(); level++)
+		data[level] = levels[level].data();
+	return createTexture2D(levels[0].width(), levels[0].height(), data, format, flags);
+}
+
+Texture::Ptr LibraryLoader::createTexture2D(uint32_t width, uint32_t height, const std::vector<const void*>& levels, TextureFormat format, TextureFlag flags)
+{
+	if (GraphicFormat::getPixelSize(format) == 0 || levels.empty())
+		return nullptr;
+	Texture2D::Ptr texture = Texture2D::create(width, height, format, getLevelFlags(flags, levels.size()), nullptr);
+	if (texture == nullptr)
+		return nullptr;
+	for (uint32_t level = 0; level < levels.size(); level++)
+		texture->upload(levels[level], level);
+	return texture;
+}
+
+Texture::Ptr LibraryLoader::createTextureCubeMap(const std::vector<Image>& images, TextureFormat format, TextureFlag flags)
+{
+	if (images.empty())
+		return nullptr;
+	std::vector<const void*> data(images.size());
+	for (size_t image = 0; image < images.size(); image++)
+		data[image] = images[image].data();
+	return createTextureCubeMap(images[0].width(), images[0].height(), data, format, flags);
+}
+
+Texture::Ptr LibraryLoader::createTextureCubeMap(uint32_t width, uint32_t height, const std::vector<const void*>& images, TextureFormat format, TextureFlag flags)
+{
+	if (GraphicFormat::getPixelSize(format) == 0 || images.empty() || images.size() % 6 != 0)
+		return nullptr;
+	size_t levelCount = images.size() / 6;
+	TextureCubeMap::Ptr texture = TextureCubeMap::create(width, height, format, getLevelFlags(flags, levelCount), nullptr);
+	if (texture == nullptr)
+		return nullptr;
+	for (uint32_t level = 0; level < levelCount; level++)
+		texture->upload(&images[level * 6], level);
+	return texture;
+}
+
+TextureFlag LibraryLoader::getLevelFlags(TextureFlag flags, size_t levelCount)
+{
+	flags = (TextureFlag)((int)flags & ~(int)TextureFlag::GenerateMips);
+	if (levelCount > 1)
+		flags = flags | TextureFlag::GenerateMips;
+	return flags;
+}
+
+Resource<Texture> LibraryLoader::loadTexture(const Path& path)
+{
+	Texture::Ptr ptr = nullptr;
+	size_t size = 0;
+	TextureFile file;
+	if (file.open(path))
+	{
+		std::vector<ChunkedPayload::Chunk> chunks;
+		bool valid = file.split(chunks);
+		for (const ChunkedPayload::Chunk& chunk : chunks)
+			valid = valid && ChunkedPayload::decompress(chunk);
+		if (!valid || !file.validate())
+			return Resource<Texture>{};
+		file.decode();
+		ptr = file.create();
+		size = file.size();
+	}
+	else
+	{
+		TextureStorage storage;
+		if (!storage.load(path))
+			return Resource<Texture>{};
+		ptr = createTexture(storage);
+		for (const Image& level : storage.images)
+			size += level.width() * level.height() * GraphicFormat::getPixelSize(storage.format);
+	}
+	if (ptr == nullptr)
+		return Resource<Texture>::load(path);
+	Resource<Texture> res;
+	res.resource = ptr;
+	res.path = path;
+	res.size = size;
+	res.loaded = Time::now();
+	res.updated = res.loaded;
+	return res;
+}
+
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "BufferFile.h"
+#include "TextureFile.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace app {
+
+class ImportCache;
+
+// Load library files of resources on demand.
+// Files are read & decoded on workers, graphic resources are created on the calling thread
+// as the device is not shared with workers.
+class LibraryLoader
+{
+public:
+	// Index library files listed by the library manifest, nothing is loaded
+	void index(const aka::Path& manifest);
+	// Index library files written by imports, nothing is loaded
+	void index(const ImportCache& cache);
+
+	// Load indexed files of these meshes with their LODs & buffers, these textures & these fonts, if missing
+	void load(const std::vector<aka::String>& meshes, const std::vector<aka::String>& textures, const std::vector<aka::String>& fonts);
+	// Load every indexed file missing from the resource manager
+	void load();
+	// Move out the stored bytes of a buffer created by the last load, false if it has none.
+	// Mapped files & stored bytes are kept until then for batching, which can't read GPU buffers.
+	bool readBuffer(const aka::Buffer* buffer, aka::BufferStorage& storage);
+
+	// Create graphic resources from decoded library files, nullptr on failure
+	static aka::Buffer::Ptr createBuffer(const aka::BufferStorage& storage);
+	// Buffers of the mesh must be in the resource manager
+	static aka::Mesh::Ptr createMesh(const aka::MeshStorage& storage);
+	// Only 2D textures & cubemaps of uncompressed formats are supported
+	static aka::Texture::Ptr createTexture(const aka::TextureStorage& storage);
+	static aka::Texture::Ptr createTexture2D(const std::vector<aka::Image>& levels, aka::TextureFormat format, aka::TextureFlag flags);
+	static aka::Texture::Ptr createTexture2D(uint32_t width, uint32_t height, const std::vector<const void*>& levels, aka::TextureFormat format, aka::TextureFlag flags);
+	// Faces px, py, pz, nx, ny, nz of every level follow each other, level by level
+	static aka::Texture::Ptr createTextureCubeMap(const std::vector<aka::Image>& images, aka::TextureFormat format, aka::TextureFlag flags);
+	static aka::Texture::Ptr createTextureCubeMap(uint32_t width, uint32_t height, const std::vector<const void*>& images, aka::TextureFormat format, aka::TextureFlag flags);
+	// Flags to create a texture of levelCount stored levels. Mips are never generated from stored flags,
+	// GenerateMips only allocates the chain of a texture created without data, every level is then uploaded.
+	static aka::TextureFlag getLevelFlags(aka::TextureFlag flags, size_t levelCount);
+	// Read a texture library file with its stored levels, either format, resource is nullptr on failure
+	static aka::Resource<aka::Texture> loadTexture(const aka::Path& path);
+
+	// Add a resource created from a library file to the resource manager, replacing a released one
+	template <typename T>
+	static void registerResource(const aka::String& name, const aka::Path& path, typename T::Ptr ptr, size_t size);
+private:
+	std::map<std::string, std::string> m_buffers;
+	std::map<std::string, std::string> m_meshes;
+	std::map<std::string, std::string> m_textures;
+	std::map<std::string, std::string> m_fonts;
+	std::map<const aka::Buffer*, aka::BufferStorage> m_storages;
+	std::map<const aka::Buffer*, std::unique_ptr<BufferFile>> m_mappings;
+};
+
+template <typename T>
+void LibraryLoader::registerResource(const aka::String& name, const aka::Path& path, typename T::Ptr ptr, size_t size)
+{
+	aka::Resource<T> res;
+	res.resource = ptr;
+	res.path = path;
+	res.size = size;
+	res.loaded = aka::Time::now();
+	res.updated = res.loaded;
+	aka::ResourceManager* resource = aka::Application::resource();
+	if (!resource->has<T>(name))
+	{
+		resource->add<T>(name, res);
+		return;
+	}
+	for (auto& element : resource->allocator<T>())
+		if (element.first == name)
+			element.second = res;
+}
+
+};
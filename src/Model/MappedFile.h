@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+namespace app {
+
+// Read only memory mapping of a whole file.
+// Pages are loaded by the OS on first access, nothing is copied on open.
+class MappedFile
+{
+public:
+	MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	// Map the file, return false if it can't be opened
+	bool open(const aka::Path& path);
+	// Unmap the file, pointers to its data are invalidated
+	void close();
+
+	// Mapped bytes, null if not opened
+	const uint8_t* data() const { return m_data; }
+	// Size of the mapped file in bytes
+	size_t size() const { return m_size; }
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+#if defined(_WIN32)
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_file;
+#endif
+};
+
+};
@@ -0,0 +1,241 @@
+#include "MeshBatch.h"
+#include "GraphicFormat.h"
+#include "BufferFile.h"
+
+#include <map>
+#include <set>
+
+namespace app {
+
+using namespace aka;
+
+// Vertex streams of a mesh, interleaved attributes share a stream.
+struct MeshLayout {
+	std::vector<VertexBufferView> streams;
+	std::vector<uint32_t> attributeStreams; // Stream of each attribute
+	uint32_t vertexCount;
+	std::string key; // Equal for meshes whose vertices can be stored in the same buffers
+};
+
+static bool getLayout(Mesh& mesh, MeshLayout& layout)
+{
+	if (!mesh.isIndexed() || mesh.getVertexAttributeCount() == 0)
+		return false;
+	layout.vertexCount = mesh.getVertexCount(0);
+	for (uint32_t i = 0; i < mesh.getVertexAttributeCount(); i++)
+	{
+		const VertexBufferView& view = mesh.getVertexBuffer(i);
+		if (view.buffer == nullptr || mesh.getVertexCount(i) != layout.vertexCount)
+			return false;
+		uint32_t stream = 0;
+		while (stream < layout.streams.size() && (layout.streams[stream].buffer != view.buffer || layout.streams[stream].offset != view.offset || layout.streams[stream].stride != view.stride))
+			stream++;
+		if (stream == layout.streams.size())
+			layout.streams.push_back(view);
+		layout.attributeStreams.push_back(stream);
+		const VertexAttribute& attribute = mesh.getVertexAttribute(i);
+		layout.key += std::to_string((int)attribute.semantic) + "," + std::to_string((int)attribute.format) + "," + std::to_string((int)attribute.type) + ",";
+		layout.key += std::to_string(stream) + "," + std::to_string(mesh.getVertexOffset(i)) + "," + std::to_string(view.stride) + ";";
+	}
+	return true;
+}
+
+// Buffers loaded from a pack may have no library file, only existing .buffer files can be read back.
+static bool isBufferFile(const Path& path)
+{
+	std::string str = path.cstr();
+	return str.size() >= 7 && str.compare(str.size() - 7, 7, ".buffer") == 0 && OS::File::exist(path);
+}
+
+void MeshBatchTable::add(const std::vector<Mesh::Ptr>& meshes, const BufferReader& read)
+{
+	ResourceManager* resource = Application::resource();
+	std::map<const Buffer*, Path> paths;
+	for (auto& element : resource->allocator<Buffer>())
+		if (element.second.resource != nullptr && isBufferFile(element.second.path))
+			paths.insert(std::make_pair(element.second.resource.get(), element.second.path));
+	// Buffers are read once for all groups, LODs & depth meshes share buffers of their base mesh.
+	struct StoredBuffer {
+		bool loaded;
+		BufferStorage storage;
+	};
+	std::map<const Buffer*, StoredBuffer> stored;
+	auto load = [&](const Buffer::Ptr& buffer) -> const BufferStorage* {
+		auto it = stored.find(buffer.get());
+		if (it == stored.end())
+		{
+			it = stored.insert(std::make_pair(buffer.get(), StoredBuffer{ false, BufferStorage{} })).first;
+			it->second.loaded = read != nullptr && read(buffer.get(), it->second.storage);
+			if (!it->second.loaded)
+			{
+				auto path = paths.find(buffer.get());
+				it->second.loaded = path != paths.end() && BufferFile::load(path->second, it->second.storage);
+			}
+		}
+		return it->second.loaded ? &it->second.storage : nullptr;
+	};
+
+	struct Group {
+		std::vector<Mesh::Ptr> meshes;
+		std::vector<MeshLayout> layouts;
+	};
+	std::map<std::string, Group> groups;
+	std::set<const Mesh*> visited;
+	for (const Mesh::Ptr& mesh : meshes)
+	{
+		if (mesh == nullptr || contains(mesh.get()) || !visited.insert(mesh.get()).second)
+			continue;
+		MeshLayout layout;
+		if (!getLayout(*mesh, layout))
+			continue;
+		Group& group = groups[layout.key];
+		group.meshes.push_back(mesh);
+		group.layouts.push_back(std::move(layout));
+	}
+
+	std::set<const Buffer*> moved; // Buffers of meshes moved to shared buffers
+	for (std::pair<const std::string, Group>& pair : groups)
+	{
+		Group& group = pair.second;
+		if (group.meshes.size() < 2)
+			continue;
+		size_t streamCount = group.layouts[0].streams.size();
+		std::vector<std::vector<uint8_t>> streams(streamCount);
+		std::vector<uint32_t> indices;
+		uint32_t vertexCount = 0;
+		// Vertex streams already copied, to the first vertex of their copy
+		std::map<std::vector<std::pair<const Buffer*, uint32_t>>, uint32_t> baseVertices;
+		std::vector<std::pair<size_t, uint32_t>> batched; // Mesh in group & its first index
+		for (size_t iMesh = 0; iMesh < group.meshes.size(); iMesh++)
+		{
+			Mesh::Ptr& mesh = group.meshes[iMesh];
+			const MeshLayout& layout = group.layouts[iMesh];
+			// Ranges are checked before copying so that an invalid mesh is skipped entirely.
+			IndexBufferView indexView = mesh->getIndexBuffer();
+			uint32_t indexSize = GraphicFormat::getIndexSize(mesh->getIndexFormat());
+			uint32_t indexCount = mesh->getIndexCount();
+			const BufferStorage* indexStorage = load(indexView.buffer);
+			if (indexStorage == nullptr)
+				continue;
+			if (indexView.offset + (size_t)indexCount * indexSize > indexStorage->bytes.size())
+			{
+				Logger::warn("Mesh indices out of stored buffer, not batched");
+				continue;
+			}
+			std::vector<std::pair<const Buffer*, uint32_t>> source;
+			for (const VertexBufferView& stream : layout.streams)
+				source.push_back(std::make_pair(stream.buffer.get(), stream.offset));
+			auto it = baseVertices.find(source);
+			if (it == baseVertices.end())
+			{
+				bool readable = true;
+				bool valid = true;
+				for (const VertexBufferView& stream : layout.streams)
+				{
+					const BufferStorage* storage = load(stream.buffer);
+					readable &= storage != nullptr;
+					valid &= storage != nullptr && stream.offset + (size_t)layout.vertexCount * stream.stride <= storage->bytes.size();
+				}
+				if (!readable)
+					continue;
+				if (!valid)
+				{
+					Logger::warn("Mesh vertices out of stored buffer, not batched");
+					continue;
+				}
+				for (size_t iStream = 0; iStream < streamCount; iStream++)
+				{
+					const VertexBufferView& stream = layout.streams[iStream];
+					const uint8_t* bytes = load(stream.buffer)->bytes.data() + stream.offset;
+					streams[iStream].insert(streams[iStream].end(), bytes, bytes + (size_t)layout.vertexCount * stream.stride);
+				}
+				it = baseVertices.insert(std::make_pair(source, vertexCount)).first;
+				vertexCount += layout.vertexCount;
+			}
+			// Indices are rebased on the first vertex of the mesh within the shared buffers.
+			uint32_t baseVertex = it->second;
+			batched.push_back(std::make_pair(iMesh, (uint32_t)indices.size()));
+			const uint8_t* data = indexStorage->bytes.data() + indexView.offset;
+			for (uint32_t i = 0; i < indexCount; i++)
+			{
+				switch (indexSize)
+				{
+				case 1: indices.push_back(baseVertex + data[i]); break;
+				case 2: indices.push_back(baseVertex + ((const uint16_t*)data)[i]); break;
+				default: indices.push_back(baseVertex + ((const uint32_t*)data)[i]); break;
+				}
+			}
+		}
+		if (batched.size() < 2)
+			continue;
+
+		// Batch mesh has the attributes of the first mesh, pointing to the shared buffers.
+		const Mesh::Ptr& first = group.meshes[batched[0].first];
+		const MeshLayout& layout = group.layouts[batched[0].first];
+		std::vector<Buffer::Ptr> buffers(streamCount);
+		for (size_t iStream = 0; iStream < streamCount; iStream++)
+			buffers[iStream] = Buffer::create(BufferType::Vertex, (uint32_t)streams[iStream].size(), BufferUsage::Immutable, BufferCPUAccess::None, streams[iStream].data());
+		uint32_t indexBufferSize = (uint32_t)(indices.size() * sizeof(uint32_t));
+		Buffer::Ptr indexBuffer = Buffer::create(BufferType::Index, indexBufferSize, BufferUsage::Immutable, BufferCPUAccess::None, indices.data());
+		std::vector<VertexAccessor> accessors(first->getVertexAttributeCount());
+		for (uint32_t i = 0; i < first->getVertexAttributeCount(); i++)
+		{
+			uint32_t stream = layout.attributeStreams[i];
+			accessors[i].attribute = first->getVertexAttribute(i);
+			accessors[i].bufferView = VertexBufferView{ buffers[stream], 0, (uint32_t)streams[stream].size(), layout.streams[stream].stride };
+			accessors[i].offset = first->getVertexOffset(i);
+			accessors[i].count = vertexCount;
+		}
+		IndexAccessor indexAccessor{ IndexFormat::UnsignedInt, IndexBufferView{ indexBuffer, 0, indexBufferSize }, (uint32_t)indices.size() };
+		Mesh::Ptr batch = Mesh::create();
+		batch->upload(accessors.data(), accessors.size(), indexAccessor);
+		// Batched meshes draw their range of the shared buffers too, so that their own buffers can be released.
+		for (const std::pair<size_t, uint32_t>& entry : batched)
+		{
+			const Mesh::Ptr& mesh = group.meshes[entry.first];
+			for (const VertexBufferView& stream : group.layouts[entry.first].streams)
+				moved.insert(stream.buffer.get());
+			moved.insert(mesh->getIndexBuffer().buffer.get());
+			uint32_t indexCount = mesh->getIndexCount();
+			IndexAccessor range{ IndexFormat::UnsignedInt, IndexBufferView{ indexBuffer, entry.second * (uint32_t)sizeof(uint32_t), indexCount * (uint32_t)sizeof(uint32_t) }, indexCount };
+			mesh->upload(accessors.data(), accessors.size(), range);
+			m_entries.insert(std::make_pair(mesh.get(), Entry{ mesh, batch, entry.second }));
+		}
+		Logger::info("Batched ", batched.size(), " meshes in shared buffers of ", vertexCount, " vertices & ", indices.size(), " indices");
+	}
+	if (moved.empty())
+		return;
+
+	// Buffers still used by a mesh that was not batched are kept.
+	std::set<const Buffer*> used;
+	for (auto& element : resource->allocator<Mesh>())
+	{
+		const Mesh::Ptr& mesh = element.second.resource;
+		if (mesh == nullptr)
+			continue;
+		for (uint32_t i = 0; i < mesh->getVertexAttributeCount(); i++)
+			used.insert(mesh->getVertexBuffer(i).buffer.get());
+		if (mesh->isIndexed())
+			used.insert(mesh->getIndexBuffer().buffer.get());
+	}
+	size_t released = 0;
+	for (auto& element : resource->allocator<Buffer>())
+	{
+		const Buffer* buffer = element.second.resource.get();
+		if (buffer == nullptr || moved.find(buffer) == moved.end() || used.find(buffer) != used.end())
+			continue;
+		released += buffer->size();
+		element.second.resource = nullptr;
+	}
+	Logger::info("Released ", released, " bytes of buffers moved to batches");
+}
+
+SubMesh MeshBatchTable::get(const SubMesh& submesh) const
+{
+	auto it = m_entries.find(submesh.mesh.get());
+	if (it == m_entries.end())
+		return submesh;
+	return SubMesh{ it->second.batch, submesh.type, submesh.count, it->second.firstIndex + submesh.offset };
+}
+
+};
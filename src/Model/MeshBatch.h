@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <functional>
+#include <unordered_map>
+
+namespace app {
+
+// Static meshes merged into shared vertex & index buffers, one set per vertex layout.
+// Batched meshes only differ by their index range, which is what multi draw submission needs.
+struct MeshBatchTable {
+	// GPU buffers are not readable, read the stored bytes of a buffer. False if it has none.
+	using BufferReader = std::function<bool(const aka::Buffer* buffer, aka::BufferStorage& storage)>;
+
+	// Merge meshes sharing a layout into new shared buffers. Meshes already batched,
+	// alone in their layout or whose buffers can't be read are left as is.
+	// Buffers not given by the reader are read from their .buffer library file, buffers without one are skipped.
+	// Batched meshes are moved to the shared buffers & the buffers no mesh uses anymore are released,
+	// their library files are kept.
+	void add(const std::vector<aka::Mesh::Ptr>& meshes, const BufferReader& read = nullptr);
+	// Submesh drawing the same triangles from the shared buffers, or the submesh itself if its mesh is not batched.
+	aka::SubMesh get(const aka::SubMesh& submesh) const;
+	bool contains(const aka::Mesh* mesh) const { return m_entries.find(mesh) != m_entries.end(); }
+private:
+	struct Entry {
+		aka::Mesh::Ptr source; // Keep source alive so that its address is not reused
+		aka::Mesh::Ptr batch;
+		uint32_t firstIndex; // First index of the source mesh in the batch index buffer
+	};
+	std::unordered_map<const aka::Mesh*, Entry> m_entries;
+};
+
+};
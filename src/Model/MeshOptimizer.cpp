@@ -0,0 +1,644 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace app {
+
+// FNV-1a hash of a vertex
+static uint32_t hashVertex(const uint8_t* vertex, size_t vertexSize)
+{
+	uint32_t hash = 2166136261U;
+	for (size_t i = 0; i < vertexSize; i++)
+	{
+		hash ^= vertex[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+size_t MeshOptimizer::generateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	static const uint32_t empty = ~0U;
+	const uint8_t* data = (const uint8_t*)vertices;
+	for (size_t v = 0; v < vertexCount; v++)
+		remap[v] = empty;
+	// Open addressing hash table storing the first vertex of each unique value.
+	size_t tableSize = 1;
+	while (tableSize < vertexCount + vertexCount / 4)
+		tableSize *= 2;
+	std::vector<uint32_t> table(tableSize, empty);
+	size_t uniqueCount = 0;
+	size_t count = (indices == nullptr) ? vertexCount : indexCount;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t v = (indices == nullptr) ? (uint32_t)i : indices[i];
+		if (remap[v] != empty)
+			continue;
+		const uint8_t* vertex = data + v * vertexSize;
+		size_t bucket = hashVertex(vertex, vertexSize) & (tableSize - 1);
+		while (table[bucket] != empty && memcmp(data + table[bucket] * vertexSize, vertex, vertexSize) != 0)
+			bucket = (bucket + 1) & (tableSize - 1);
+		if (table[bucket] == empty)
+		{
+			table[bucket] = v;
+			remap[v] = (uint32_t)uniqueCount++;
+		}
+		else
+		{
+			remap[v] = remap[table[bucket]];
+		}
+	}
+	return uniqueCount;
+}
+
+void MeshOptimizer::remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap)
+{
+	AKA_ASSERT(destination != vertices, "In place remap not supported");
+	for (size_t v = 0; v < vertexCount; v++)
+		if (remap[v] != ~0U)
+			memcpy((uint8_t*)destination + remap[v] * vertexSize, (const uint8_t*)vertices + v * vertexSize, vertexSize);
+}
+
+void MeshOptimizer::remapIndexBuffer(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+{
+	for (size_t i = 0; i < indexCount; i++)
+		destination[i] = remap[(indices == nullptr) ? i : indices[i]];
+}
+
+VertexCacheStatistics MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	AKA_ASSERT(indexCount % 3 == 0, "Only triangle lists are supported");
+	// A vertex is in the FIFO if it was inserted less than cacheSize insertions ago.
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (timestamp - cacheTime[v] > cacheSize)
+		{
+			cacheTime[v] = timestamp++;
+			misses++;
+		}
+	}
+	VertexCacheStatistics stats;
+	size_t triangleCount = indexCount / 3;
+	stats.acmr = (triangleCount == 0) ? 0.f : misses / (float)triangleCount;
+	stats.atvr = (vertexCount == 0) ? 0.f : misses / (float)vertexCount;
+	return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+	AKA_ASSERT(indexCount % 3 == 0, "Only triangle lists are supported");
+	AKA_ASSERT(destination != indices, "In place optimization not supported");
+	size_t triangleCount = indexCount / 3;
+
+	// Build vertex to triangle adjacency
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++)
+		live[indices[i]]++;
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v + 1] = offsets[v] + live[v];
+	std::vector<uint32_t> adjacency(indexCount);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (size_t k = 0; k < 3; k++)
+			adjacency[fill[indices[3 * t + k]]++] = (uint32_t)t;
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	deadEnd.reserve(indexCount);
+	uint32_t timestamp = cacheSize + 1;
+	size_t cursor = 0;
+	size_t output = 0;
+
+	// Start from the first referenced vertex
+	int64_t fanning = -1;
+	while (fanning < 0 && cursor < vertexCount)
+	{
+		if (live[cursor] > 0)
+			fanning = (int64_t)cursor;
+		cursor++;
+	}
+	while (fanning >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (uint32_t j = offsets[fanning]; j < offsets[fanning + 1]; j++)
+		{
+			uint32_t t = adjacency[j];
+			if (emitted[t])
+				continue;
+			for (size_t k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[3 * t + k];
+				destination[output++] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (timestamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timestamp++;
+			}
+			emitted[t] = true;
+		}
+		// Select next fanning vertex among the candidates that will still be in cache after being fanned.
+		int64_t best = -1;
+		int64_t priority = -1;
+		for (uint32_t v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+			int64_t p = 0;
+			if (timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+				p = timestamp - cacheTime[v];
+			if (p > priority)
+			{
+				priority = p;
+				best = v;
+			}
+		}
+		if (best < 0)
+		{
+			// Dead end, pick most recent vertex with remaining triangles, or the next one in input order.
+			while (!deadEnd.empty() && best < 0)
+			{
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					best = v;
+			}
+			while (best < 0 && cursor < vertexCount)
+			{
+				if (live[cursor] > 0)
+					best = (int64_t)cursor;
+				cursor++;
+			}
+		}
+		fanning = best;
+	}
+	AKA_ASSERT(output == indexCount, "Some triangles were not emitted");
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, float threshold)
+{
+	AKA_ASSERT(indexCount % 3 == 0, "Only triangle lists are supported");
+	AKA_ASSERT(destination != indices, "In place optimization not supported");
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+	auto position = [&](uint32_t v) -> const float* {
+		return (const float*)((const uint8_t*)positions + v * positionStride);
+	};
+
+	// Compute cache misses per triangle
+	std::vector<uint32_t> misses(triangleCount, 0);
+	size_t totalMisses = 0;
+	{
+		std::vector<uint32_t> cacheTime(vertexCount, 0);
+		uint32_t timestamp = cacheSize + 1;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (size_t k = 0; k < 3; k++)
+			{
+				uint32_t v = indices[3 * t + k];
+				if (timestamp - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = timestamp++;
+					misses[t]++;
+				}
+			}
+			totalMisses += misses[t];
+		}
+	}
+	// Split in clusters. Hard boundaries are where the cache was flushed (every vertex missed),
+	// soft boundaries are where the cluster ACMR is already under the threshold so that reordering does not hurt cache much.
+	float acmr = totalMisses / (float)triangleCount;
+	std::vector<size_t> clusters;
+	size_t clusterStart = 0;
+	size_t clusterMisses = 0;
+	clusters.push_back(0);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		size_t clusterSize = t - clusterStart;
+		bool hard = misses[t] == 3;
+		bool soft = misses[t] >= 2 && clusterMisses <= threshold * acmr * clusterSize;
+		if (clusterSize > 0 && (hard || soft))
+		{
+			clusters.push_back(t);
+			clusterStart = t;
+			clusterMisses = 0;
+		}
+		clusterMisses += misses[t];
+	}
+	clusters.push_back(triangleCount);
+
+	// Compute area weighted centroid & normal of clusters and mesh
+	struct Cluster {
+		size_t start, end;
+		float centroid[3];
+		float normal[3];
+		float area;
+		float sortKey;
+	};
+	std::vector<Cluster> data(clusters.size() - 1);
+	float meshCentroid[3] = { 0.f, 0.f, 0.f };
+	float meshArea = 0.f;
+	for (size_t c = 0; c < data.size(); c++)
+	{
+		Cluster& cluster = data[c];
+		cluster = Cluster{ clusters[c], clusters[c + 1], { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f }, 0.f, 0.f };
+		for (size_t t = cluster.start; t < cluster.end; t++)
+		{
+			const float* p0 = position(indices[3 * t + 0]);
+			const float* p1 = position(indices[3 * t + 1]);
+			const float* p2 = position(indices[3 * t + 2]);
+			float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = {
+				e0[1] * e1[2] - e0[2] * e1[1],
+				e0[2] * e1[0] - e0[0] * e1[2],
+				e0[0] * e1[1] - e0[1] * e1[0]
+			};
+			float area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (size_t i = 0; i < 3; i++)
+			{
+				cluster.centroid[i] += (p0[i] + p1[i] + p2[i]) / 3.f * area;
+				cluster.normal[i] += n[i];
+			}
+			cluster.area += area;
+		}
+		for (size_t i = 0; i < 3; i++)
+			meshCentroid[i] += cluster.centroid[i];
+		meshArea += cluster.area;
+		float invArea = (cluster.area == 0.f) ? 0.f : 1.f / cluster.area;
+		for (size_t i = 0; i < 3; i++)
+			cluster.centroid[i] *= invArea;
+	}
+	float invMeshArea = (meshArea == 0.f) ? 0.f : 1.f / meshArea;
+	for (size_t i = 0; i < 3; i++)
+		meshCentroid[i] *= invMeshArea;
+
+	// Clusters facing outward occlude the others, draw them first.
+	for (Cluster& cluster : data)
+	{
+		float length = sqrt(cluster.normal[0] * cluster.normal[0] + cluster.normal[1] * cluster.normal[1] + cluster.normal[2] * cluster.normal[2]);
+		float invLength = (length == 0.f) ? 0.f : 1.f / length;
+		cluster.sortKey = 0.f;
+		for (size_t i = 0; i < 3; i++)
+			cluster.sortKey += (cluster.centroid[i] - meshCentroid[i]) * cluster.normal[i] * invLength;
+	}
+	std::stable_sort(data.begin(), data.end(), [](const Cluster& lhs, const Cluster& rhs) {
+		return lhs.sortKey > rhs.sortKey;
+	});
+	size_t output = 0;
+	for (const Cluster& cluster : data)
+		for (size_t t = cluster.start; t < cluster.end; t++)
+			for (size_t k = 0; k < 3; k++)
+				destination[output++] = indices[3 * t + k];
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+{
+	AKA_ASSERT(destination != vertices, "In place optimization not supported");
+	static const uint32_t unused = ~0U;
+	std::vector<uint32_t> remap(vertexCount, unused);
+	uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (remap[v] == unused)
+		{
+			remap[v] = next;
+			memcpy((uint8_t*)destination + next * vertexSize, (const uint8_t*)vertices + v * vertexSize, vertexSize);
+			next++;
+		}
+		indices[i] = remap[v];
+	}
+	return next;
+}
+
+// Quadric of squared distances to a set of planes
+struct Quadric {
+	float a2, b2, c2, d2, ab, ac, ad, bc, bd, cd;
+};
+
+static void addPlane(Quadric& q, float a, float b, float c, float d)
+{
+	q.a2 += a * a; q.b2 += b * b; q.c2 += c * c; q.d2 += d * d;
+	q.ab += a * b; q.ac += a * c; q.ad += a * d;
+	q.bc += b * c; q.bd += b * d; q.cd += c * d;
+}
+
+static void addQuadric(Quadric& q, const Quadric& r)
+{
+	q.a2 += r.a2; q.b2 += r.b2; q.c2 += r.c2; q.d2 += r.d2;
+	q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+	q.bc += r.bc; q.bd += r.bd; q.cd += r.cd;
+}
+
+static float quadricError(const Quadric& q, const float* p)
+{
+	float x = p[0], y = p[1], z = p[2];
+	float rx = q.a2 * x + q.ab * y + q.ac * z + q.ad;
+	float ry = q.ab * x + q.b2 * y + q.bc * z + q.bd;
+	float rz = q.ac * x + q.bc * y + q.c2 * z + q.cd;
+	float rw = q.ad * x + q.bd * y + q.cd * z + q.d2;
+	return fabsf(x * rx + y * ry + z * rz + rw);
+}
+
+static void triangleNormal(const float* p0, const float* p1, const float* p2, float* n)
+{
+	float e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	float e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+size_t MeshOptimizer::simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, size_t targetIndexCount, float targetError, float* resultError)
+{
+	if (destination != indices)
+		memcpy(destination, indices, indexCount * sizeof(uint32_t));
+	size_t stride = positionStride / sizeof(float);
+	// Normalize positions so that error is relative to mesh extent.
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		for (size_t k = 0; k < 3; k++)
+		{
+			minimum[k] = std::min(minimum[k], positions[v * stride + k]);
+			maximum[k] = std::max(maximum[k], positions[v * stride + k]);
+		}
+	}
+	float extent = std::max(maximum[0] - minimum[0], std::max(maximum[1] - minimum[1], maximum[2] - minimum[2]));
+	float scale = (extent > 0.f) ? 1.f / extent : 0.f;
+	std::vector<float> p(vertexCount * 3);
+	for (size_t v = 0; v < vertexCount; v++)
+		for (size_t k = 0; k < 3; k++)
+			p[3 * v + k] = (positions[v * stride + k] - minimum[k]) * scale;
+
+	// Lock vertices on attribute seams, which share their position with another vertex.
+	std::vector<uint8_t> locked(vertexCount, 0);
+	{
+		std::vector<uint32_t> positionRemap(vertexCount);
+		size_t positionCount = generateVertexRemap(positionRemap.data(), nullptr, 0, p.data(), vertexCount, 3 * sizeof(float));
+		std::vector<uint32_t> positionUsage(positionCount, 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			positionUsage[positionRemap[v]]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			locked[v] = positionUsage[positionRemap[v]] > 1;
+	}
+	// Lock vertices on open borders and non manifold edges.
+	{
+		std::vector<uint64_t> edges(indexCount);
+		for (size_t i = 0; i < indexCount; i++)
+		{
+			uint32_t a = indices[i];
+			uint32_t b = indices[i - i % 3 + (i + 1) % 3];
+			edges[i] = ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t j = i;
+			while (j < edges.size() && edges[j] == edges[i])
+				j++;
+			if (j - i != 2)
+			{
+				locked[(uint32_t)(edges[i] >> 32)] = 1;
+				locked[(uint32_t)(edges[i] & 0xffffffff)] = 1;
+			}
+			i = j;
+		}
+	}
+
+	// Accumulate triangle planes on their vertices.
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t t = 0; t < indexCount / 3; t++)
+	{
+		const float* p0 = &p[3 * indices[3 * t + 0]];
+		const float* p1 = &p[3 * indices[3 * t + 1]];
+		const float* p2 = &p[3 * indices[3 * t + 2]];
+		float n[3];
+		triangleNormal(p0, p1, p2, n);
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.f)
+			continue;
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		for (size_t k = 0; k < 3; k++)
+			addPlane(quadrics[indices[3 * t + k]], n[0], n[1], n[2], d);
+	}
+
+	struct Collapse {
+		uint32_t source;
+		uint32_t target;
+		float error;
+	};
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> offsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	float errorLimit = targetError * targetError;
+	float maxError = 0.f;
+	size_t count = indexCount;
+	// Collapse edges in passes of independent collapses, cheapest first.
+	while (count > targetIndexCount)
+	{
+		// Vertex to triangle adjacency
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < count; i++)
+			offsets[destination[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			offsets[v + 1] += offsets[v];
+		adjacency.resize(count);
+		{
+			std::vector<uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < count; i++)
+				adjacency[cursor[destination[i]]++] = (uint32_t)(i / 3);
+		}
+		// Cheapest direction of every edge
+		collapses.clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t a = destination[i];
+			uint32_t b = destination[i - i % 3 + (i + 1) % 3];
+			if (a > b || (locked[a] && locked[b]))
+				continue;
+			Quadric q = quadrics[a];
+			addQuadric(q, quadrics[b]);
+			float errorA = locked[a] ? FLT_MAX : quadricError(q, &p[3 * b]);
+			float errorB = locked[b] ? FLT_MAX : quadricError(q, &p[3 * a]);
+			if (errorA <= errorB)
+				collapses.push_back(Collapse{ a, b, errorA });
+			else
+				collapses.push_back(Collapse{ b, a, errorB });
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.error < rhs.error; });
+
+		// Each collapse remove about two triangles
+		size_t budget = (count - targetIndexCount) / 6 + 1;
+		size_t collapsed = 0;
+		std::fill(touched.begin(), touched.end(), 0);
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (uint32_t)v;
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.error > errorLimit || collapsed >= budget)
+				break;
+			if (touched[collapse.source] || touched[collapse.target])
+				continue;
+			// Reject collapses flipping a remaining triangle
+			bool flip = false;
+			for (uint32_t a = offsets[collapse.source]; a < offsets[collapse.source + 1] && !flip; a++)
+			{
+				const uint32_t* triangle = &destination[3 * adjacency[a]];
+				if (triangle[0] == collapse.target || triangle[1] == collapse.target || triangle[2] == collapse.target)
+					continue;
+				const float* before[3];
+				const float* after[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					before[k] = &p[3 * triangle[k]];
+					after[k] = (triangle[k] == collapse.source) ? &p[3 * collapse.target] : before[k];
+				}
+				float n0[3], n1[3];
+				triangleNormal(before[0], before[1], before[2], n0);
+				triangleNormal(after[0], after[1], after[2], n1);
+				flip = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.f;
+			}
+			if (flip)
+				continue;
+			remap[collapse.source] = collapse.target;
+			addQuadric(quadrics[collapse.target], quadrics[collapse.source]);
+			maxError = std::max(maxError, collapse.error);
+			for (uint32_t a = offsets[collapse.source]; a < offsets[collapse.source + 1]; a++)
+				for (size_t k = 0; k < 3; k++)
+					touched[destination[3 * adjacency[a] + k]] = 1;
+			collapsed++;
+		}
+		if (collapsed == 0)
+			break;
+		// Apply collapses & remove degenerate triangles
+		size_t output = 0;
+		for (size_t i = 0; i < count; i += 3)
+		{
+			uint32_t a = remap[destination[i + 0]];
+			uint32_t b = remap[destination[i + 1]];
+			uint32_t c = remap[destination[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			destination[output++] = a;
+			destination[output++] = b;
+			destination[output++] = c;
+		}
+		count = output;
+	}
+	if (resultError != nullptr)
+		*resultError = sqrtf(maxError);
+	return count;
+}
+
+static void computeMeshletBounds(Meshlet& meshlet, const uint32_t* indices, const float* positions, size_t stride)
+{
+	// Sphere around bounding box center
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = 0; i < meshlet.indexCount; i++)
+	{
+		const float* p = &positions[indices[meshlet.indexOffset + i] * stride];
+		for (size_t k = 0; k < 3; k++)
+		{
+			minimum[k] = std::min(minimum[k], p[k]);
+			maximum[k] = std::max(maximum[k], p[k]);
+		}
+	}
+	for (size_t k = 0; k < 3; k++)
+		meshlet.center[k] = (minimum[k] + maximum[k]) * 0.5f;
+	float radius = 0.f;
+	for (uint32_t i = 0; i < meshlet.indexCount; i++)
+	{
+		const float* p = &positions[indices[meshlet.indexOffset + i] * stride];
+		float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+		radius = std::max(radius, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+	}
+	meshlet.radius = sqrtf(radius);
+	// Normal cone from the average of triangle normals
+	std::vector<float> normals(meshlet.indexCount);
+	float axis[3] = { 0.f, 0.f, 0.f };
+	for (uint32_t t = 0; t < meshlet.indexCount / 3; t++)
+	{
+		const uint32_t* triangle = &indices[meshlet.indexOffset + 3 * t];
+		float* n = &normals[3 * t];
+		triangleNormal(&positions[triangle[0] * stride], &positions[triangle[1] * stride], &positions[triangle[2] * stride], n);
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float scale = (length == 0.f) ? 0.f : 1.f / length;
+		for (size_t k = 0; k < 3; k++)
+		{
+			n[k] *= scale;
+			axis[k] += n[k];
+		}
+	}
+	float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	float scale = (length == 0.f) ? 0.f : 1.f / length;
+	float minDot = 1.f;
+	for (uint32_t t = 0; t < meshlet.indexCount / 3; t++)
+	{
+		const float* n = &normals[3 * t];
+		minDot = std::min(minDot, (n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]) * scale);
+	}
+	for (size_t k = 0; k < 3; k++)
+		meshlet.coneAxis[k] = axis[k] * scale;
+	// Cone wider than an hemisphere can't be culled.
+	meshlet.coneCutoff = (minDot <= 0.f) ? 1.f : sqrtf(1.f - minDot * minDot);
+}
+
+void MeshOptimizer::buildMeshlets(std::vector<Meshlet>& meshlets, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, size_t maxVertices, size_t maxTriangles)
+{
+	AKA_ASSERT(maxVertices >= 3 && maxTriangles >= 1, "Invalid meshlet limits");
+	size_t stride = positionStride / sizeof(float);
+	// Meshlet in which each vertex was last counted
+	std::vector<uint32_t> used(vertexCount, ~0U);
+	meshlets.clear();
+	Meshlet meshlet{};
+	size_t meshletVertexCount = 0;
+	for (size_t t = 0; t < indexCount / 3; t++)
+	{
+		const uint32_t* triangle = &indices[3 * t];
+		uint32_t id = (uint32_t)meshlets.size();
+		size_t newVertices = (used[triangle[0]] != id) + (used[triangle[1]] != id) + (used[triangle[2]] != id);
+		if (meshletVertexCount + newVertices > maxVertices || meshlet.indexCount / 3 + 1 > maxTriangles)
+		{
+			computeMeshletBounds(meshlet, indices, positions, stride);
+			meshlets.push_back(meshlet);
+			meshlet = Meshlet{};
+			meshlet.indexOffset = (uint32_t)(3 * t);
+			meshletVertexCount = 0;
+			id++;
+		}
+		for (size_t k = 0; k < 3; k++)
+		{
+			if (used[triangle[k]] != id)
+			{
+				used[triangle[k]] = id;
+				meshletVertexCount++;
+			}
+		}
+		meshlet.indexCount += 3;
+	}
+	if (meshlet.indexCount > 0)
+	{
+		computeMeshletBounds(meshlet, indices, positions, stride);
+		meshlets.push_back(meshlet);
+	}
+}
+
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+namespace app {
+
+// Post transform vertex cache statistics of an index buffer
+struct VertexCacheStatistics {
+	float acmr; // Average cache miss ratio, transformed vertices per triangle (0.5 is optimal, 3 is worst)
+	float atvr; // Average transformed vertex ratio, transformed vertices per vertex (1 is optimal)
+};
+
+// Cluster of triangles stored as a contiguous range of the index buffer
+struct Meshlet {
+	uint32_t indexOffset;
+	uint32_t indexCount;
+	float center[3]; // Bounding sphere
+	float radius;
+	float coneAxis[3]; // Normal cone, backfacing when dot(center - eye, axis) >= cutoff * |center - eye| + radius
+	float coneCutoff; // 1 when the cone is too wide to be culled
+};
+
+// Triangle list optimizations. Indices are expected as uint32_t triangle lists.
+struct MeshOptimizer {
+	// Size of the simulated FIFO post transform cache
+	static constexpr uint32_t cacheSize = 16;
+	// Meshlet limits, matching common mesh shader limits
+	static constexpr uint32_t meshletMaxVertices = 64;
+	static constexpr uint32_t meshletMaxTriangles = 124;
+
+	// Generate a remap table welding bitwise identical vertices, in order of first reference by indices.
+	// Indices can be null for unindexed geometry. Unreferenced vertices are remapped to ~0U.
+	// Return the number of unique vertices.
+	static size_t generateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize);
+	// Write unique vertices to destination using a remap table generated by generateVertexRemap
+	static void remapVertexBuffer(void* destination, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap);
+	// Write remapped indices to destination. Indices can be null for unindexed geometry. Can be done in place.
+	static void remapIndexBuffer(uint32_t* destination, const uint32_t* indices, size_t indexCount, const uint32_t* remap);
+
+	// Simulate a FIFO post transform cache over the index buffer
+	static VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount);
+	// Reorder triangles for post transform vertex cache using Tipsify
+	// http://gfx.cs.princeton.edu/pubs/Sander_2007_%3ETR/tipsy.pdf
+	static void optimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+	// Reorder clusters of an index buffer already optimized for vertex cache so that outward facing clusters are drawn first.
+	// Threshold is the ACMR degradation allowed when splitting clusters (1.05 is 5% worst).
+	static void optimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, float threshold);
+	// Reorder vertices in the order they are referenced by indices and remap indices. Unreferenced vertices are removed.
+	// Return the number of vertices written to destination.
+	static size_t optimizeVertexFetch(void* destination, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize);
+
+	// Simplify a triangle list with quadric error edge collapses. Vertices collapse onto existing ones so that LODs share the vertex buffer.
+	// Target error is relative to mesh extent. Vertices on open borders and attribute seams are locked.
+	// Return the number of indices written to destination, with the relative error reached in resultError.
+	static size_t simplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+	// Split a triangle list in meshlets of consecutive triangles bounded in vertices & triangles, with their bounds.
+	// Best used on indices optimized for vertex cache, which are already spatially coherent.
+	static void buildMeshlets(std::vector<Meshlet>& meshlets, const uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, size_t maxVertices, size_t maxTriangles);
+};
+
+};
@@ -0,0 +1,145 @@
+#include "MipChain.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace app {
+
+static const float lanczosPi = 3.14159265358979323846f;
+static const float lanczosRadius = 3.f;
+
+static float sinc(float x)
+{
+	if (x == 0.f)
+		return 1.f;
+	x *= lanczosPi;
+	return std::sin(x) / x;
+}
+
+static float lanczos(float x)
+{
+	if (std::abs(x) >= lanczosRadius)
+		return 0.f;
+	return sinc(x) * sinc(x / lanczosRadius);
+}
+
+// Weights of every source sample contributing to each destination sample along an axis
+struct FilterAxis {
+	std::vector<uint32_t> first; // First source sample per destination sample
+	std::vector<uint32_t> count; // Number of source samples per destination sample
+	std::vector<float> weights; // Normalized weights, stride is maxCount
+	uint32_t maxCount;
+};
+
+static void computeFilterAxis(FilterAxis& axis, uint32_t srcSize, uint32_t dstSize)
+{
+	float scale = (float)srcSize / (float)dstSize;
+	float support = lanczosRadius * std::max(scale, 1.f);
+	axis.maxCount = (uint32_t)std::ceil(2.f * support) + 1;
+	axis.first.resize(dstSize);
+	axis.count.resize(dstSize);
+	axis.weights.assign(dstSize * axis.maxCount, 0.f);
+	for (uint32_t d = 0; d < dstSize; d++)
+	{
+		float center = ((float)d + 0.5f) * scale;
+		int32_t begin = std::max((int32_t)std::floor(center - support), 0);
+		int32_t end = std::min((int32_t)std::ceil(center + support), (int32_t)srcSize);
+		float* weights = &axis.weights[d * axis.maxCount];
+		float total = 0.f;
+		uint32_t count = 0;
+		for (int32_t s = begin; s < end && count < axis.maxCount; s++)
+		{
+			float w = lanczos(((float)s + 0.5f - center) / std::max(scale, 1.f));
+			weights[count++] = w;
+			total += w;
+		}
+		if (total != 0.f)
+			for (uint32_t i = 0; i < count; i++)
+				weights[i] /= total;
+		axis.first[d] = (uint32_t)begin;
+		axis.count[d] = count;
+	}
+}
+
+uint32_t MipChain::levelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	uint32_t size = std::max(width, height);
+	while (size > 1)
+	{
+		size /= 2;
+		levels++;
+	}
+	return levels;
+}
+
+void MipChain::downsample(float* destination, uint32_t dstWidth, uint32_t dstHeight, const float* source, uint32_t srcWidth, uint32_t srcHeight, uint32_t channels)
+{
+	FilterAxis horizontal, vertical;
+	computeFilterAxis(horizontal, srcWidth, dstWidth);
+	computeFilterAxis(vertical, srcHeight, dstHeight);
+	// Horizontal pass, RGBA pixels are filtered as one vector.
+	std::vector<float> temporary((size_t)dstWidth * srcHeight * channels, 0.f);
+	for (uint32_t y = 0; y < srcHeight; y++)
+	{
+		const float* srcRow = &source[(size_t)y * srcWidth * channels];
+		float* dstRow = &temporary[(size_t)y * dstWidth * channels];
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			const float* weights = &horizontal.weights[x * horizontal.maxCount];
+			const float* src = &srcRow[horizontal.first[x] * channels];
+			float* pixel = &dstRow[x * channels];
+			if (channels == 4)
+			{
+				Float4 sum = Float4::splat(0.f);
+				for (uint32_t i = 0; i < horizontal.count[x]; i++)
+					sum = sum + Float4::load(&src[i * 4]) * Float4::splat(weights[i]);
+				sum.store(pixel);
+				continue;
+			}
+			for (uint32_t i = 0; i < horizontal.count[x]; i++)
+				for (uint32_t c = 0; c < channels; c++)
+					pixel[c] += src[i * channels + c] * weights[i];
+		}
+	}
+	// Vertical pass, four floats of a row at a time summed over every tap.
+	size_t rowSize = (size_t)dstWidth * channels;
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		const float* weights = &vertical.weights[y * vertical.maxCount];
+		const float* srcRows = &temporary[vertical.first[y] * rowSize];
+		float* dstRow = &destination[y * rowSize];
+		size_t j = 0;
+		for (; j + 4 <= rowSize; j += 4)
+		{
+			Float4 sum = Float4::splat(0.f);
+			for (uint32_t i = 0; i < vertical.count[y]; i++)
+				sum = sum + Float4::load(&srcRows[i * rowSize + j]) * Float4::splat(weights[i]);
+			sum.store(&dstRow[j]);
+		}
+		for (; j < rowSize; j++)
+		{
+			float sum = 0.f;
+			for (uint32_t i = 0; i < vertical.count[y]; i++)
+				sum += srcRows[i * rowSize + j] * weights[i];
+			dstRow[j] = sum;
+		}
+	}
+}
+
+float MipChain::srgbToLinear(float value)
+{
+	if (value <= 0.04045f)
+		return value / 12.92f;
+	return std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+float MipChain::linearToSrgb(float value)
+{
+	if (value <= 0.0031308f)
+		return value * 12.92f;
+	return 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+};
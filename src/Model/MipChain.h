@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+namespace app {
+
+// CPU generation of texture mip chains on linear float pixels.
+struct MipChain {
+	// Number of levels of a full mip chain, down to 1x1
+	static uint32_t levelCount(uint32_t width, uint32_t height);
+	// Resample an image with a separable Lanczos 3 filter, scaled to the reduction ratio to avoid aliasing.
+	// Pixels are interleaved floats with channels components, expected in linear space.
+	static void downsample(float* destination, uint32_t dstWidth, uint32_t dstHeight, const float* source, uint32_t srcWidth, uint32_t srcHeight, uint32_t channels);
+
+	// sRGB transfer functions
+	static float srgbToLinear(float value);
+	static float linearToSrgb(float value);
+};
+
+};
@@ -1,4 +1,11 @@
 #include "Model.h"
+#include "SceneResources.h"
+#include "ImportCache.h"
+#include "BinaryFile.h"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
 
 // TODO move json serialization within aka. 
 #include "json.hpp"
@@ -20,6 +27,367 @@ Entity Scene::getMainCamera(World& world)
 	return cameraEntity;
 }
 
+MaterialHandle MaterialTable::add(const MaterialAsset& material)
+{
+	// Materials created with their textures are not found by loads.
+	m_materials.push_back(material);
+	m_keys.push_back(Key{});
+	return (MaterialHandle)(m_materials.size() - 1);
+}
+
+MaterialHandle MaterialTable::add(const MaterialAsset& material, const String textures[3])
+{
+	MaterialHandle handle = (MaterialHandle)m_materials.size();
+	m_materials.push_back(material);
+	m_keys.push_back(getKey(material, textures));
+	m_handles.insert(std::make_pair(m_keys.back().hash, handle));
+	return handle;
+}
+
+MaterialHandle MaterialTable::find(const String& name) const
+{
+	for (size_t i = 0; i < m_materials.size(); i++)
+		if (m_materials[i].name == name)
+			return (MaterialHandle)i;
+	return invalid;
+}
+
+static bool equal(const TextureSampler& lhs, const TextureSampler& rhs)
+{
+	return lhs.anisotropy == rhs.anisotropy && lhs.filterMin == rhs.filterMin && lhs.filterMag == rhs.filterMag &&
+		lhs.wrapU == rhs.wrapU && lhs.wrapV == rhs.wrapV && lhs.wrapW == rhs.wrapW && lhs.mipmapMode == rhs.mipmapMode;
+}
+
+MaterialTable::Key MaterialTable::getKey(const MaterialAsset& material, const String textures[3])
+{
+	// Fields are hashed one by one as structures might have padding, names with their terminator.
+	Key key;
+	key.hash = ImportCache::hash(material.name.cstr(), strlen(material.name.cstr()) + 1);
+	key.hash = ImportCache::hash(&material.color.r, sizeof(float), key.hash);
+	key.hash = ImportCache::hash(&material.color.g, sizeof(float), key.hash);
+	key.hash = ImportCache::hash(&material.color.b, sizeof(float), key.hash);
+	key.hash = ImportCache::hash(&material.color.a, sizeof(float), key.hash);
+	key.hash = ImportCache::hash(&material.doubleSided, sizeof(bool), key.hash);
+	const MaterialAsset::Texture* samplers[3] = { &material.albedo, &material.normal, &material.material };
+	for (uint32_t t = 0; t < 3; t++)
+	{
+		const TextureSampler& sampler = samplers[t]->sampler;
+		key.hash = ImportCache::hash(&sampler.anisotropy, sizeof(sampler.anisotropy), key.hash);
+		key.hash = ImportCache::hash(&sampler.filterMin, sizeof(sampler.filterMin), key.hash);
+		key.hash = ImportCache::hash(&sampler.filterMag, sizeof(sampler.filterMag), key.hash);
+		key.hash = ImportCache::hash(&sampler.wrapU, sizeof(sampler.wrapU), key.hash);
+		key.hash = ImportCache::hash(&sampler.wrapV, sizeof(sampler.wrapV), key.hash);
+		key.hash = ImportCache::hash(&sampler.wrapW, sizeof(sampler.wrapW), key.hash);
+		key.hash = ImportCache::hash(&sampler.mipmapMode, sizeof(sampler.mipmapMode), key.hash);
+		key.hash = ImportCache::hash(textures[t].cstr(), strlen(textures[t].cstr()) + 1, key.hash);
+		key.textures[t] = textures[t];
+	}
+	return key;
+}
+
+bool MaterialTable::equal(const MaterialAsset& lhs, const Key& lhsKey, const MaterialAsset& rhs, const Key& rhsKey)
+{
+	if (lhsKey.hash != rhsKey.hash || !(lhs.name == rhs.name) || lhs.doubleSided != rhs.doubleSided)
+		return false;
+	if (lhs.color.r != rhs.color.r || lhs.color.g != rhs.color.g || lhs.color.b != rhs.color.b || lhs.color.a != rhs.color.a)
+		return false;
+	const MaterialAsset::Texture* lhsTextures[3] = { &lhs.albedo, &lhs.normal, &lhs.material };
+	const MaterialAsset::Texture* rhsTextures[3] = { &rhs.albedo, &rhs.normal, &rhs.material };
+	for (uint32_t t = 0; t < 3; t++)
+		if (!app::equal(lhsTextures[t]->sampler, rhsTextures[t]->sampler) || !(lhsKey.textures[t] == rhsKey.textures[t]))
+			return false;
+	return true;
+}
+
+MaterialHandle MaterialTable::find(const MaterialAsset& material, const String textures[3]) const
+{
+	// Hash collisions are resolved by comparing the content.
+	Key key = getKey(material, textures);
+	auto range = m_handles.equal_range(key.hash);
+	MaterialHandle handle = invalid;
+	for (auto it = range.first; it != range.second; it++)
+		if (equal(m_materials[it->second], m_keys[it->second], material, key))
+			handle = min(handle, it->second);
+	return handle;
+}
+
+void MaterialTable::rollback(uint32_t count)
+{
+	for (uint32_t handle = count; handle < m_materials.size(); handle++)
+	{
+		auto range = m_handles.equal_range(m_keys[handle].hash);
+		for (auto it = range.first; it != range.second; it++)
+		{
+			if (it->second == handle)
+			{
+				m_handles.erase(it);
+				break;
+			}
+		}
+	}
+	if (count < m_materials.size())
+	{
+		m_materials.resize(count);
+		m_keys.resize(count);
+	}
+}
+
+MaterialTable& Scene::getMaterials(World& world)
+{
+	return world.registry().ctx_or_set<MaterialTable>();
+}
+
+MaterialHandle Scene::getDefaultMaterial(World& world)
+{
+	MaterialTable& materials = getMaterials(world);
+	MaterialHandle handle = materials.find("default");
+	if (handle != MaterialTable::invalid)
+		return handle;
+	uint8_t colorData[4]{ 255, 255, 255, 255 };
+	Texture2D::Ptr blank = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::None, colorData);
+	uint8_t normalData[4]{ 128, 128, 255, 255 };
+	Texture2D::Ptr normal = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::None, normalData);
+	TextureSampler s = TextureSampler::nearest;
+	return materials.add(MaterialAsset{ "default", color4f(1.f), true, {blank, s}, {normal, s}, {blank, s} });
+}
+
+MeshBatchTable& Scene::getMeshBatches(World& world)
+{
+	return world.registry().ctx_or_set<MeshBatchTable>();
+}
+
+void Scene::batchMeshes(World& world, const MeshBatchTable::BufferReader& read)
+{
+	std::vector<Mesh::Ptr> meshes;
+	world.registry().view<MeshComponent>().each([&](const MeshComponent& mesh) {
+		meshes.push_back(mesh.submesh.mesh);
+		meshes.push_back(mesh.depth.mesh);
+		for (uint32_t lod = 0; lod < mesh.lodCount; lod++)
+		{
+			meshes.push_back(mesh.lods[lod].mesh);
+			meshes.push_back(mesh.depthLods[lod].mesh);
+		}
+	});
+	getMeshBatches(world).add(meshes, read);
+}
+
+VertexLayout Scene::getVertexLayout(const Mesh::Ptr& mesh)
+{
+	if (mesh == nullptr || mesh->getVertexAttributeCount() == 0)
+		return VertexLayout::Default;
+	bool packed = mesh->getVertexAttribute(0).format == VertexFormat::UnsignedShort;
+	bool color = false;
+	bool tangent = false;
+	for (uint32_t i = 0; i < mesh->getVertexAttributeCount(); i++)
+	{
+		color |= mesh->getVertexAttribute(i).semantic == VertexSemantic::Color0;
+		tangent |= mesh->getVertexAttribute(i).semantic == VertexSemantic::Tangent;
+	}
+	if (packed)
+		return color ? VertexLayout::PackedColor : VertexLayout::Packed;
+	return tangent ? VertexLayout::Tangent : VertexLayout::Default;
+}
+
+QuantizationUniformBuffer Scene::getQuantization(const aabbox<>& bounds)
+{
+	QuantizationUniformBuffer quantization;
+	quantization.offset = vec3f(bounds.min.x, bounds.min.y, bounds.min.z);
+	quantization.scale = (bounds.max - bounds.min) / 65535.f;
+	return quantization;
+}
+
+String Scene::getQuantizationName(const String& mesh)
+{
+	return mesh + "-quantization";
+}
+
+String Scene::getLodName(const String& mesh, uint32_t lod)
+{
+	return mesh + "-lod" + String(std::to_string(lod).c_str());
+}
+
+String Scene::getDepthName(const String& mesh)
+{
+	return mesh + "-depth";
+}
+
+void Scene::loadLods(StaticMeshComponent& mesh)
+{
+	ResourceManager* resource = Application::resource();
+	mesh.lodCount = 0;
+	mesh.depth = SubMesh{};
+	mesh.quantization = nullptr;
+	if (mesh.submesh.mesh == nullptr)
+		return;
+	String name = resource->name<Mesh>(mesh.submesh.mesh);
+	VertexLayout layout = getVertexLayout(mesh.submesh.mesh);
+	if ((layout == VertexLayout::Packed || layout == VertexLayout::PackedColor) && resource->has<Buffer>(getQuantizationName(name)))
+		mesh.quantization = resource->get<Buffer>(getQuantizationName(name));
+	if ((layout == VertexLayout::Packed || layout == VertexLayout::PackedColor) && mesh.quantization == nullptr)
+		Logger::warn("Mesh ", name, " has no quantization, import it again to draw it");
+	for (uint32_t lod = 1; lod <= StaticMeshComponent::maxLodCount; lod++)
+	{
+		String lodName = getLodName(name, lod);
+		if (!resource->has<Mesh>(lodName))
+			break;
+		SubMesh& submesh = mesh.lods[mesh.lodCount++];
+		submesh.mesh = resource->get<Mesh>(lodName);
+		submesh.type = PrimitiveType::Triangles;
+		submesh.offset = 0;
+		submesh.count = submesh.mesh->getIndexCount();
+	}
+	// Position only streams are used only if every LOD has one, released ones were dropped by a later import.
+	auto hasDepth = [&](const String& depthName) {
+		return resource->has<Mesh>(depthName) && resource->get<Mesh>(depthName) != nullptr;
+	};
+	if (!hasDepth(getDepthName(name)))
+		return;
+	for (uint32_t lod = 0; lod < mesh.lodCount; lod++)
+		if (!hasDepth(getDepthName(getLodName(name, lod + 1))))
+			return;
+	mesh.depth = SubMesh{ resource->get<Mesh>(getDepthName(name)), mesh.submesh.type, mesh.submesh.count, mesh.submesh.offset };
+	for (uint32_t lod = 0; lod < mesh.lodCount; lod++)
+		mesh.depthLods[lod] = SubMesh{ resource->get<Mesh>(getDepthName(getLodName(name, lod + 1))), mesh.lods[lod].type, mesh.lods[lod].count, mesh.lods[lod].offset };
+}
+
+// Index of the LOD to use for a projected diameter in pixels, 0 for the full resolution submesh
+static uint32_t selectLodIndex(const StaticMeshComponent& mesh, float size, float bias)
+{
+	// Projected diameter under which the first LOD is used.
+	static const float lodScreenSize = 512.f;
+	if (mesh.lodCount == 0)
+		return 0;
+	float threshold = lodScreenSize * bias;
+	if (size >= threshold)
+		return 0;
+	// Every LOD halve triangle count, use a new one each time projected size halve.
+	uint32_t lod = (uint32_t)ceil(log2(threshold / size));
+	return min(lod, mesh.lodCount);
+}
+
+// Index of the LOD to use seen from eye through a perspective projection
+static uint32_t selectLodIndex(const StaticMeshComponent& mesh, const mat4f& transform, const point3f& eye, float pixelsPerUnit, float bias)
+{
+	if (mesh.lodCount == 0)
+		return 0;
+	aabbox<> bounds = transform * mesh.bounds;
+	float radius = (bounds.max - bounds.min).norm() * 0.5f;
+	float distance = (bounds.center() - eye).norm();
+	if (distance <= radius)
+		return 0;
+	return selectLodIndex(mesh, 2.f * radius * pixelsPerUnit / distance, bias);
+}
+
+static const SubMesh& getDepthLod(const StaticMeshComponent& mesh, uint32_t lod)
+{
+	if (mesh.depth.mesh == nullptr)
+		return (lod == 0) ? mesh.submesh : mesh.lods[lod - 1];
+	return (lod == 0) ? mesh.depth : mesh.depthLods[lod - 1];
+}
+
+const SubMesh& Scene::selectLod(const StaticMeshComponent& mesh, const mat4f& transform, const point3f& eye, float pixelsPerUnit, float bias)
+{
+	uint32_t lod = selectLodIndex(mesh, transform, eye, pixelsPerUnit, bias);
+	return (lod == 0) ? mesh.submesh : mesh.lods[lod - 1];
+}
+
+const SubMesh& Scene::selectDepthLod(const StaticMeshComponent& mesh, const mat4f& transform, const point3f& eye, float pixelsPerUnit, float bias)
+{
+	return getDepthLod(mesh, selectLodIndex(mesh, transform, eye, pixelsPerUnit, bias));
+}
+
+const SubMesh& Scene::selectDepthLod(const StaticMeshComponent& mesh, const mat4f& transform, float texelsPerUnit, float bias)
+{
+	if (mesh.lodCount == 0)
+		return getDepthLod(mesh, 0);
+	aabbox<> bounds = transform * mesh.bounds;
+	return getDepthLod(mesh, selectLodIndex(mesh, (bounds.max - bounds.min).norm() * texelsPerUnit, bias));
+}
+
+Path Scene::getMeshletPath(const String& mesh)
+{
+	return Path("library/mesh/") + mesh + ".meshlets";
+}
+
+static const char meshletMagic[4] = { 'A', 'K', 'M', 'L' };
+static const uint32_t meshletVersion = 1;
+
+struct MeshletHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t stride; // Size of a meshlet record
+};
+
+bool MeshletStorage::load(const Path& path)
+{
+	Blob blob;
+	if (!OS::File::read(path, &blob))
+		return false;
+	BinaryReader reader{ (const uint8_t*)blob.data(), blob.size(), 0 };
+	MeshletHeader header;
+	if (!reader.read(&header, 1) || memcmp(header.magic, meshletMagic, sizeof(meshletMagic)) != 0 || header.version != meshletVersion || header.stride != sizeof(Meshlet))
+		return false;
+	const Meshlet* data = reader.read<Meshlet>(header.count);
+	if (data == nullptr || !reader.end())
+		return false;
+	meshlets.assign(data, data + header.count);
+	return true;
+}
+
+bool MeshletStorage::save(const Path& path) const
+{
+	BinaryWriter writer;
+	MeshletHeader header{};
+	memcpy(header.magic, meshletMagic, sizeof(meshletMagic));
+	header.version = meshletVersion;
+	header.count = (uint32_t)meshlets.size();
+	header.stride = sizeof(Meshlet);
+	writer.write(&header, 1);
+	writer.write(meshlets.data(), meshlets.size());
+	return writer.save(path);
+}
+
+void Scene::loadMeshlets(StaticMeshComponent& mesh)
+{
+	ResourceManager* resource = Application::resource();
+	mesh.meshlets.clear();
+	if (mesh.submesh.mesh == nullptr)
+		return;
+	Path path = getMeshletPath(resource->name<Mesh>(mesh.submesh.mesh));
+	if (!OS::File::exist(path))
+		return;
+	MeshletStorage storage;
+	if (!storage.load(path))
+	{
+		Logger::warn("Invalid meshlets file ", path, ", reimport the mesh.");
+		return;
+	}
+	mesh.meshlets = std::move(storage.meshlets);
+}
+
+bool Scene::cullMeshlet(const Meshlet& meshlet, const frustum<>::planes& planes, const mat4f& transform, const point3f& eye, bool cone)
+{
+	vec4f center = transform * vec4f(meshlet.center[0], meshlet.center[1], meshlet.center[2], 1.f);
+	vec4f axis = transform * vec4f(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2], 0.f);
+	float scale = max(vec3f(transform.cols[0]).norm(), max(vec3f(transform.cols[1]).norm(), vec3f(transform.cols[2]).norm()));
+	float radius = meshlet.radius * scale;
+	// Frustum
+	aabbox<> bounds(point3f(center.x - radius, center.y - radius, center.z - radius), point3f(center.x + radius, center.y + radius, center.z + radius));
+	if (!planes.intersect(bounds))
+		return true;
+	// Backface cone, assuming transform without shear
+	if (!cone || meshlet.coneCutoff >= 1.f)
+		return false;
+	vec3f direction = vec3f(center.x - eye.x, center.y - eye.y, center.z - eye.z);
+	vec3f coneAxis = vec3f(axis.x, axis.y, axis.z);
+	float axisLength = coneAxis.norm();
+	if (axisLength == 0.f)
+		return false;
+	float d = (direction.x * coneAxis.x + direction.y * coneAxis.y + direction.z * coneAxis.z) / axisLength;
+	return d >= meshlet.coneCutoff * direction.norm() + radius;
+}
+
 Mesh::Ptr Scene::createCubeMesh(const point3f& position, float size)
 {
 	struct Vertex {
@@ -29,7 +397,6 @@ Mesh::Ptr Scene::createCubeMesh(const point3f& position, float size)
 		color4f color;
 	};
 	std::vector<Vertex> vertices;
-	//std::vector<uint32_t> indices;
 	// FRONT     BACK
 	// 2______3__4______5
 	// |      |  |      |
@@ -110,8 +477,15 @@ Mesh::Ptr Scene::createCubeMesh(const point3f& position, float size)
 		VertexAttribute{ VertexSemantic::TexCoord0, VertexFormat::Float, VertexType::Vec2},
 		VertexAttribute{ VertexSemantic::Color0, VertexFormat::Float, VertexType::Vec4}
 	};
+	// Weld shared face vertices
+	std::vector<uint32_t> remap(vertices.size());
+	size_t vertexCount = MeshOptimizer::generateVertexRemap(remap.data(), nullptr, vertices.size(), vertices.data(), vertices.size(), sizeof(Vertex));
+	std::vector<Vertex> uniqueVertices(vertexCount);
+	std::vector<uint32_t> indices(vertices.size());
+	MeshOptimizer::remapVertexBuffer(uniqueVertices.data(), vertices.data(), vertices.size(), sizeof(Vertex), remap.data());
+	MeshOptimizer::remapIndexBuffer(indices.data(), nullptr, indices.size(), remap.data());
 	Mesh::Ptr mesh = Mesh::create();
-	mesh->uploadInterleaved(att, 4, vertices.data(), (uint32_t)vertices.size());
+	mesh->uploadInterleaved(att, 4, uniqueVertices.data(), (uint32_t)uniqueVertices.size(), IndexFormat::UnsignedInt, indices.data(), (uint32_t)indices.size());
 	return mesh;
 }
 
@@ -197,36 +571,25 @@ Mesh::Ptr Scene::createSphereMesh(const point3f& position, float radius, uint32_
 Entity Scene::createSphereEntity(World& world, uint32_t segmentCount, uint32_t ringCount)
 {
 	Mesh::Ptr m = createSphereMesh(point3f(0.f), 1.f, segmentCount, ringCount);
-	uint8_t data[4]{ 255, 255, 255, 255 };
-	Texture2D::Ptr blank = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::None, data);
-	uint8_t n[4]{ 128, 128, 255, 255 };
-	Texture2D::Ptr normal = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::None, n);
-	TextureSampler s = TextureSampler::nearest;
 
 	mat4f id = mat4f::identity();
 	Entity mesh = world.createEntity("New uv sphere");
 	mesh.add<Transform3DComponent>(Transform3DComponent{ id });
 	mesh.add<Hierarchy3DComponent>(Hierarchy3DComponent{ Entity::null(), id });
 	mesh.add<MeshComponent>(MeshComponent{ SubMesh{ m, PrimitiveType::Triangles, (uint32_t)m->getIndexCount(), 0 }, aabbox<>(point3f(-1), point3f(1)) });
-	mesh.add<MaterialComponent>(MaterialComponent{ color4f(1.f), true, {blank, s}, {normal, s}, {blank, s} });
+	mesh.add<MaterialComponent>(MaterialComponent{ getDefaultMaterial(world) });
 	return mesh;
 }
 
 Entity Scene::createCubeEntity(World& world)
 {
-	uint8_t colorData[4]{ 255, 255, 255, 255 };
-	Texture2D::Ptr blank = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::None, colorData);
-	uint8_t normalData[4]{ 128, 128, 255, 255 };
-	Texture2D::Ptr normal = Texture2D::create(1, 1, TextureFormat::RGBA8, TextureFlag::None, normalData);
-	TextureSampler s = TextureSampler::nearest;
-
 	Mesh::Ptr m = createCubeMesh(point3f(0.f), 1.f);
 	mat4f id = mat4f::identity();
 	Entity mesh = world.createEntity("New cube");
 	mesh.add<Transform3DComponent>(Transform3DComponent{ id });
 	mesh.add<Hierarchy3DComponent>(Hierarchy3DComponent{ Entity::null(), id });
-	mesh.add<MeshComponent>(MeshComponent{ SubMesh{ m, PrimitiveType::Triangles, (uint32_t)m->getVertexCount(0), 0 }, aabbox<>(point3f(-1), point3f(1)) });
-	mesh.add<MaterialComponent>(MaterialComponent{ color4f(1.f), true, {blank, s}, {normal, s}, {blank, s} });
+	mesh.add<MeshComponent>(MeshComponent{ SubMesh{ m, PrimitiveType::Triangles, (uint32_t)m->getIndexCount(), 0 }, aabbox<>(point3f(-1), point3f(1)) });
+	mesh.add<MaterialComponent>(MaterialComponent{ getDefaultMaterial(world) });
 	return mesh;
 }
 
@@ -350,12 +713,11 @@ nlohmann::json serialize<MeshComponent>(const entt::registry& r, entt::entity e)
 	json["mesh"] = resource->name<Mesh>(m.submesh.mesh).cstr();
 	return json;
 }
-template <>
-nlohmann::json serialize<MaterialComponent>(const entt::registry& r, entt::entity e)
+nlohmann::json serializeMaterial(const MaterialAsset& m)
 {
 	ResourceManager* resource = Application::resource();
-	const MaterialComponent& m = r.get<MaterialComponent>(e);
 	nlohmann::json json = nlohmann::json::object();
+	json["name"] = m.name.cstr();
 	json["color"] = { m.color.r, m.color.g, m.color.b, m.color.a };
 	json["doublesided"] = m.doubleSided;
 
@@ -388,6 +750,14 @@ nlohmann::json serialize<MaterialComponent>(const entt::registry& r, entt::entit
 	return json;
 }
 template <>
+nlohmann::json serialize<MaterialComponent>(const entt::registry& r, entt::entity e)
+{
+	const MaterialComponent& m = r.get<MaterialComponent>(e);
+	nlohmann::json json = nlohmann::json::object();
+	json["id"] = m.material;
+	return json;
+}
+template <>
 nlohmann::json serialize<DirectionalLightComponent>(const entt::registry& r, entt::entity e)
 {
 	const DirectionalLightComponent& l = r.get<DirectionalLightComponent>(e);
@@ -462,10 +832,105 @@ nlohmann::json serialize<TextComponent>(const entt::registry& r, entt::entity e)
 	return json;
 }
 
+// Textures are bound once loaded, see addMaterial
+MaterialAsset parseMaterial(const nlohmann::json& component)
+{
+	MaterialAsset material;
+	if (component.find("name") != component.end())
+		material.name = component["name"].get<std::string>();
+	material.color = color4f(
+		component["color"][0].get<float>(), 
+		component["color"][1].get<float>(), 
+		component["color"][2].get<float>(), 
+		component["color"][3].get<float>()
+	);
+	material.doubleSided = component["doublesided"].get<bool>();
+	material.albedo.sampler.anisotropy = component["albedo"]["sampler"]["anisotropy"].get<float>();
+	material.albedo.sampler.wrapU = (TextureWrap)component["albedo"]["sampler"]["wrapU"].get<int>();
+	material.albedo.sampler.wrapV = (TextureWrap)component["albedo"]["sampler"]["wrapV"].get<int>();
+	material.albedo.sampler.wrapW = (TextureWrap)component["albedo"]["sampler"]["wrapW"].get<int>();
+	material.albedo.sampler.filterMin = (TextureFilter)component["albedo"]["sampler"]["filterMin"].get<int>();
+	material.albedo.sampler.filterMag = (TextureFilter)component["albedo"]["sampler"]["filterMag"].get<int>();
+	material.albedo.sampler.mipmapMode = (TextureMipMapMode)component["albedo"]["sampler"]["mipmapMode"].get<int>();
+
+	material.normal.sampler.anisotropy = component["normal"]["sampler"]["anisotropy"].get<float>();
+	material.normal.sampler.wrapU = (TextureWrap)component["normal"]["sampler"]["wrapU"].get<int>();
+	material.normal.sampler.wrapV = (TextureWrap)component["normal"]["sampler"]["wrapV"].get<int>();
+	material.normal.sampler.wrapW = (TextureWrap)component["normal"]["sampler"]["wrapW"].get<int>();
+	material.normal.sampler.filterMin = (TextureFilter)component["normal"]["sampler"]["filterMin"].get<int>();
+	material.normal.sampler.filterMag = (TextureFilter)component["normal"]["sampler"]["filterMag"].get<int>();
+	material.normal.sampler.mipmapMode = (TextureMipMapMode)component["normal"]["sampler"]["mipmapMode"].get<int>();
+
+	material.material.sampler.anisotropy = component["material"]["sampler"]["anisotropy"].get<float>();
+	material.material.sampler.wrapU = (TextureWrap)component["material"]["sampler"]["wrapU"].get<int>();
+	material.material.sampler.wrapV = (TextureWrap)component["material"]["sampler"]["wrapV"].get<int>();
+	material.material.sampler.wrapW = (TextureWrap)component["material"]["sampler"]["wrapW"].get<int>();
+	material.material.sampler.filterMin = (TextureFilter)component["material"]["sampler"]["filterMin"].get<int>();
+	material.material.sampler.filterMag = (TextureFilter)component["material"]["sampler"]["filterMag"].get<int>();
+	material.material.sampler.mipmapMode = (TextureMipMapMode)component["material"]["sampler"]["mipmapMode"].get<int>();
+	return material;
+}
+
+// Reuse an identical material of the table or add it, its textures are bound once loaded
+static MaterialHandle addMaterial(MaterialTable& materials, SceneResources& resources, const nlohmann::json& component)
+{
+	MaterialAsset material = parseMaterial(component);
+	String textures[3] = {
+		component["albedo"]["texture"].get<std::string>().c_str(),
+		component["normal"]["texture"].get<std::string>().c_str(),
+		component["material"]["texture"].get<std::string>().c_str(),
+	};
+	MaterialHandle handle = materials.find(material, textures);
+	if (handle != MaterialTable::invalid)
+		return handle;
+	handle = materials.add(material, textures);
+	resources.addTexture(handle, &MaterialAsset::albedo, textures[0]);
+	resources.addTexture(handle, &MaterialAsset::normal, textures[1]);
+	resources.addTexture(handle, &MaterialAsset::material, textures[2]);
+	return handle;
+}
+
 static uint16_t major = 0;
-static uint16_t minor = 2;
+static uint16_t minor = 3;
+
+// Scenes are stored in binary unless saved with a .json extension
+static bool isJSON(const Path& path)
+{
+	std::string str = path.cstr();
+	return str.size() >= 5 && str.compare(str.size() - 5, 5, ".json") == 0;
+}
 
 void Scene::save(const Path& path, const World& world)
+{
+	if (isJSON(path))
+		saveJSON(path, world);
+	else
+		saveBinary(path, world);
+}
+
+void Scene::load(World& world, const Path& path)
+{
+	// Static meshes are batched once their resources are resolved.
+	if (isJSON(path))
+		loadJSON(world, path);
+	else
+		loadBinary(world, path);
+}
+
+Path Scene::getStartupPath()
+{
+	// A JSON export edited by hand is newer than the binary it was exported from.
+	std::error_code error;
+	std::filesystem::file_time_type binary = std::filesystem::last_write_time("library/scene.bin", error);
+	if (error)
+		return "library/scene.json";
+	std::filesystem::file_time_type json = std::filesystem::last_write_time("library/scene.json", error);
+	if (!error && json > binary)
+		return "library/scene.json";
+	return "library/scene.bin";
+}
+
+bool Scene::saveJSON(const Path& path, const World& world)
 {
 	try
 	{
@@ -489,6 +954,11 @@ void Scene::save(const Path& path, const World& world)
 #else
 		json["asset"]["origin"] = "unknown";
 #endif
+		// --- Materials, entities reference them by index
+		json["materials"] = nlohmann::json::array();
+		if (const MaterialTable* materials = r.try_ctx<MaterialTable>())
+			for (MaterialHandle handle = 0; handle < materials->size(); handle++)
+				json["materials"].push_back(serializeMaterial(materials->get(handle)));
 		// --- Entities
 		json["entities"] = nlohmann::json::object();
 		r.each([&](entt::entity e) {
@@ -499,6 +969,7 @@ void Scene::save(const Path& path, const World& world)
 			if (r.has<Hierarchy3DComponent>(e))      entity["components"]["hierarchy"] = serialize<Hierarchy3DComponent>(r, e);
 			if (r.has<MeshComponent>(e))             entity["components"]["mesh"] = serialize<MeshComponent>(r, e);
 			if (r.has<MaterialComponent>(e))         entity["components"]["material"] = serialize<MaterialComponent>(r, e);
+			if (r.has<InstancedComponent>(e))        entity["components"]["instanced"] = nlohmann::json::object();
 			if (r.has<DirectionalLightComponent>(e)) entity["components"]["dirlight"] = serialize<DirectionalLightComponent>(r, e);
 			if (r.has<PointLightComponent>(e))       entity["components"]["pointlight"] = serialize<PointLightComponent>(r, e);
 			if (r.has<Camera3DComponent>(e))         entity["components"]["camera"] = serialize<Camera3DComponent>(r, e);
@@ -509,231 +980,371 @@ void Scene::save(const Path& path, const World& world)
 		if (!OS::File::write(path, json.dump()))
 		{
 			Logger::error("Failed to write scene.");
+			return false;
 		}
+		return true;
 	}
 	catch (const nlohmann::json::exception& e)
 	{
 		Logger::error("Failed to write JSON : ", e.what());
+		return false;
 	}
 }
 
-void Scene::load(World& world, const Path& path)
+// SAX handler rebuilding only the parts of a scene that are parsed at once:
+// the asset header, each material and each component. Memory does not grow with the scene.
+class SceneSAXHandler : public nlohmann::json_sax<nlohmann::json>
 {
-	try
+public:
+	std::function<bool(nlohmann::json&)> onAsset;
+	std::function<bool(nlohmann::json&)> onMaterial;
+	std::function<bool(const std::string&)> onEntity; // Called with the entity key when its object starts
+	std::function<bool(const std::string&, nlohmann::json&)> onComponent;
+
+	bool null() override { return value(nullptr); }
+	bool boolean(bool val) override { return value(val); }
+	bool number_integer(number_integer_t val) override { return value(val); }
+	bool number_unsigned(number_unsigned_t val) override { return value(val); }
+	bool number_float(number_float_t val, const string_t&) override { return value(val); }
+	bool string(string_t& val) override { return value(std::move(val)); }
+	bool binary(binary_t& val) override { return value(std::move(val)); }
+	bool start_object(std::size_t) override { return start(nlohmann::json::object(), false); }
+	bool end_object() override { return end(); }
+	bool start_array(std::size_t) override { return start(nlohmann::json::array(), true); }
+	bool end_array() override { return end(); }
+	bool key(string_t& val) override { m_key = val; return true; }
+	bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override
+	{
+		Logger::error("Failed to read JSON at ", position, " : ", e.what());
+		return false;
+	}
+private:
+	bool value(nlohmann::json&& val)
+	{
+		// Values outside of captured subtrees are skipped
+		if (m_stack.empty())
+			return true;
+		nlohmann::json* top = m_stack.back();
+		if (top->is_array())
+			top->push_back(std::move(val));
+		else
+			(*top)[m_key] = std::move(val);
+		return true;
+	}
+	bool start(nlohmann::json&& container, bool array)
 	{
-		ResourceManager* resource = Application::resource();
-		String s;
-		OS::File::read(path, &s);
-		if (s.length() == 0)
+		if (!m_stack.empty())
 		{
-			Logger::error("File ", path, "not valid.");
-			return;
+			nlohmann::json* top = m_stack.back();
+			if (top->is_array())
+			{
+				top->push_back(std::move(container));
+				m_stack.push_back(&top->back());
+			}
+			else
+			{
+				m_stack.push_back(&((*top)[m_key] = std::move(container)));
+			}
+			return true;
 		}
-		nlohmann::json json = nlohmann::json::parse(s.cstr());
-		std::string version = json["asset"]["version"].get<std::string>();
-		if (version != std::to_string(major) + "." + std::to_string(minor))
+		m_path.push_back((!m_arrays.empty() && m_arrays.back()) ? "[]" : m_key);
+		m_arrays.push_back(array);
+		// Path starts with the root object
+		if (isCaptured())
+		{
+			m_capture = std::move(container);
+			m_stack.push_back(&m_capture);
+		}
+		else if (m_path.size() == 3 && m_path[1] == "entities")
+		{
+			return onEntity(m_path[2]);
+		}
+		return true;
+	}
+	bool end()
+	{
+		bool result = true;
+		if (!m_stack.empty())
+		{
+			m_stack.pop_back();
+			if (!m_stack.empty())
+				return true;
+			if (m_path.size() == 2)
+				result = onAsset(m_capture);
+			else if (m_path.size() == 3)
+				result = onMaterial(m_capture);
+			else
+				result = onComponent(m_path[4], m_capture);
+			m_capture = nullptr;
+		}
+		m_path.pop_back();
+		m_arrays.pop_back();
+		return result;
+	}
+	bool isCaptured() const
+	{
+		if (m_path.size() == 2)
+			return m_path[1] == "asset";
+		if (m_path.size() == 3)
+			return m_path[1] == "materials" && m_path[2] == "[]";
+		return m_path.size() == 5 && m_path[1] == "entities" && m_path[3] == "components";
+	}
+private:
+	std::string m_key;
+	std::vector<std::string> m_path; // Keys of the containers above the captured subtree
+	std::vector<bool> m_arrays; // Containers of the path that are arrays
+	nlohmann::json m_capture;
+	std::vector<nlohmann::json*> m_stack; // Containers of the captured subtree
+};
+
+bool Scene::loadJSON(World& world, const Path& path)
+{
+	std::ifstream file(path.cstr(), std::ios::binary);
+	if (!file)
+	{
+		Logger::error("File ", path, "not valid.");
+		return false;
+	}
+	MaterialTable& materials = Scene::getMaterials(world);
+	uint32_t materialCount = materials.size();
+	std::string version;
+	std::vector<MaterialHandle> materialMap;
+	std::unordered_map<std::string, MaterialHandle> legacyMaterialMap;
+	std::unordered_map<uint32_t, entt::entity> entityMap;
+	std::vector<entt::entity> created;
+	// Keys are sorted when saved, references to entities & materials parsed later are resolved at the end.
+	std::vector<std::pair<entt::entity, uint32_t>> pendingParents;
+	std::vector<std::pair<entt::entity, uint32_t>> pendingMaterials;
+	entt::entity entity = entt::null;
+	// Meshes & textures are loaded at once after parsing.
+	SceneResources resources(world);
+
+	SceneSAXHandler handler;
+	handler.onAsset = [&](nlohmann::json& asset) -> bool {
+		version = asset["version"].get<std::string>();
+		if (version != std::to_string(major) + "." + std::to_string(minor) && version != "0.2")
 		{
 			Logger::error("Unsupported version : ", version);
-			return;
+			return false;
 		}
-		// --- Entities
-		std::unordered_map<uint32_t, entt::entity> entityMap;
-		for (auto& jsonEntityKV : json["entities"].items())
+		return true;
+	};
+	// --- Materials
+	handler.onMaterial = [&](nlohmann::json& material) -> bool {
+		materialMap.push_back(addMaterial(materials, resources, material));
+		return true;
+	};
+	// --- Entities
+	handler.onEntity = [&](const std::string& id) -> bool {
+		// TODO enforce tag component
+		entity = world.registry().create();
+		created.push_back(entity);
+		entityMap.insert(std::make_pair((uint32_t)std::stoi(id), entity));
+		return true;
+	};
+	handler.onComponent = [&](const std::string& name, nlohmann::json& component) -> bool {
+		if (name == "tag")
+		{
+			world.registry().emplace<TagComponent>(entity);
+			world.registry().get<TagComponent>(entity).name = component["name"].get<std::string>();
+		}
+		else if (name == "hierarchy")
+		{
+			world.registry().emplace<Hierarchy3DComponent>(entity);
+			Hierarchy3DComponent& h = world.registry().get<Hierarchy3DComponent>(entity);
+			// Parent might not be parsed yet, resolved once every entity exist.
+			h.parent = Entity::null();
+			if (!component["parent"].is_null())
+				pendingParents.push_back(std::make_pair(entity, component["parent"].get<uint32_t>()));
+			h.inverseTransform = mat4f::identity();
+		}
+		else if (name == "transform")
+		{
+			world.registry().emplace<Transform3DComponent>(entity);
+			AKA_ASSERT(component["matrix"].size() == 16, "Invalid matrix");
+			world.registry().get<Transform3DComponent>(entity).transform = mat4f(
+				col4f(component["matrix"][0], component["matrix"][1], component["matrix"][2], component["matrix"][3]),
+				col4f(component["matrix"][4], component["matrix"][5], component["matrix"][6], component["matrix"][7]),
+				col4f(component["matrix"][8], component["matrix"][9], component["matrix"][10], component["matrix"][11]),
+				col4f(component["matrix"][12], component["matrix"][13], component["matrix"][14], component["matrix"][15])
+			);
+		}
+		else if (name == "mesh")
+		{
+			world.registry().emplace<MeshComponent>(entity);
+			MeshComponent& mesh = world.registry().get<MeshComponent>(entity);
+			resources.addMesh(entity, component["mesh"].get<std::string>());
+			mesh.bounds.min = point3f(
+				component["bounds"]["min"][0].get<float>(),
+				component["bounds"]["min"][1].get<float>(),
+				component["bounds"]["min"][2].get<float>()
+			);
+			mesh.bounds.max = point3f(
+				component["bounds"]["max"][0].get<float>(),
+				component["bounds"]["max"][1].get<float>(),
+				component["bounds"]["max"][2].get<float>()
+			);
+		}
+		else if (name == "material")
 		{
-			uint32_t entityID = std::stoi(jsonEntityKV.key());
-			nlohmann::json& jsonEntity = jsonEntityKV.value();
-			// TODO enforce tag component
-			entt::entity entity = world.registry().create();
-			entityMap.insert(std::make_pair(entityID, entity));
-			for (auto& componentKV : jsonEntity["components"].items())
+			if (component.find("id") != component.end())
 			{
-				std::string name = componentKV.key();
-				nlohmann::json& component = componentKV.value();
-				if (name == "tag")
-				{
-					world.registry().emplace<TagComponent>(entity);
-					world.registry().get<TagComponent>(entity).name = component["name"].get<std::string>();
-				}
-				else if (name == "hierarchy")
-				{
-					world.registry().emplace<Hierarchy3DComponent>(entity);
-					Hierarchy3DComponent& h = world.registry().get<Hierarchy3DComponent>(entity);
-					nlohmann::json& jsonParent = component["parent"];
-					if (jsonParent.is_null())
-						h.parent = Entity::null();
-					else
-						h.parent = Entity(entityMap.find(component["parent"].get<uint32_t>())->second, &world);				
-					h.inverseTransform = mat4f::identity();
-				}
-				else if (name == "transform")
-				{
-					world.registry().emplace<Transform3DComponent>(entity);
-					AKA_ASSERT(component["matrix"].size() == 16, "Invalid matrix");
-					world.registry().get<Transform3DComponent>(entity).transform = mat4f(
-						col4f(component["matrix"][0], component["matrix"][1], component["matrix"][2], component["matrix"][3]),
-						col4f(component["matrix"][4], component["matrix"][5], component["matrix"][6], component["matrix"][7]),
-						col4f(component["matrix"][8], component["matrix"][9], component["matrix"][10], component["matrix"][11]),
-						col4f(component["matrix"][12], component["matrix"][13], component["matrix"][14], component["matrix"][15])
-					);
-				}
-				else if (name == "mesh")
-				{
-					world.registry().emplace<MeshComponent>(entity);
-					MeshComponent& mesh = world.registry().get<MeshComponent>(entity);
-					mesh.submesh.mesh = resource->get<Mesh>(component["mesh"].get<std::string>());
-					mesh.submesh.offset = 0;
-					mesh.submesh.count = mesh.submesh.mesh->getIndexCount();
-					mesh.submesh.type = PrimitiveType::Triangles;
-					mesh.bounds.min = point3f(
-						component["bounds"]["min"][0].get<float>(),
-						component["bounds"]["min"][1].get<float>(),
-						component["bounds"]["min"][2].get<float>()
-					);
-					mesh.bounds.max = point3f(
-						component["bounds"]["max"][0].get<float>(),
-						component["bounds"]["max"][1].get<float>(),
-						component["bounds"]["max"][2].get<float>()
-					);
-				}
-				else if (name == "material")
-				{
-					world.registry().emplace<MaterialComponent>(entity);
-					MaterialComponent& material = world.registry().get<MaterialComponent>(entity);
-					material.color = color4f(
-						component["color"][0].get<float>(), 
-						component["color"][1].get<float>(), 
-						component["color"][2].get<float>(), 
-						component["color"][3].get<float>()
-					);
-					material.doubleSided = component["doublesided"].get<bool>();
-					material.albedo.texture = resource->get<Texture>(component["albedo"]["texture"].get<std::string>());
-					material.albedo.sampler.anisotropy = component["albedo"]["sampler"]["anisotropy"].get<float>();
-					material.albedo.sampler.wrapU = (TextureWrap)component["albedo"]["sampler"]["wrapU"].get<int>();
-					material.albedo.sampler.wrapV = (TextureWrap)component["albedo"]["sampler"]["wrapV"].get<int>();
-					material.albedo.sampler.wrapW = (TextureWrap)component["albedo"]["sampler"]["wrapW"].get<int>();
-					material.albedo.sampler.filterMin = (TextureFilter)component["albedo"]["sampler"]["filterMin"].get<int>();
-					material.albedo.sampler.filterMag = (TextureFilter)component["albedo"]["sampler"]["filterMag"].get<int>();
-					material.albedo.sampler.mipmapMode = (TextureMipMapMode)component["albedo"]["sampler"]["mipmapMode"].get<int>();
-
-					material.normal.texture = resource->get<Texture>(component["normal"]["texture"].get<std::string>());
-					material.normal.sampler.anisotropy = component["normal"]["sampler"]["anisotropy"].get<float>();
-					material.normal.sampler.wrapU = (TextureWrap)component["normal"]["sampler"]["wrapU"].get<int>();
-					material.normal.sampler.wrapV = (TextureWrap)component["normal"]["sampler"]["wrapV"].get<int>();
-					material.normal.sampler.wrapW = (TextureWrap)component["normal"]["sampler"]["wrapW"].get<int>();
-					material.normal.sampler.filterMin = (TextureFilter)component["normal"]["sampler"]["filterMin"].get<int>();
-					material.normal.sampler.filterMag = (TextureFilter)component["normal"]["sampler"]["filterMag"].get<int>();
-					material.normal.sampler.mipmapMode = (TextureMipMapMode)component["normal"]["sampler"]["mipmapMode"].get<int>();
-
-					material.material.texture = resource->get<Texture>(component["material"]["texture"].get<std::string>());
-					material.material.sampler.anisotropy = component["material"]["sampler"]["anisotropy"].get<float>();
-					material.material.sampler.wrapU = (TextureWrap)component["material"]["sampler"]["wrapU"].get<int>();
-					material.material.sampler.wrapV = (TextureWrap)component["material"]["sampler"]["wrapV"].get<int>();
-					material.material.sampler.wrapW = (TextureWrap)component["material"]["sampler"]["wrapW"].get<int>();
-					material.material.sampler.filterMin = (TextureFilter)component["material"]["sampler"]["filterMin"].get<int>();
-					material.material.sampler.filterMag = (TextureFilter)component["material"]["sampler"]["filterMag"].get<int>();
-					material.material.sampler.mipmapMode = (TextureMipMapMode)component["material"]["sampler"]["mipmapMode"].get<int>();
-				}
-				else if (name == "pointlight")
-				{
-					world.registry().emplace<PointLightComponent>(entity);
-					PointLightComponent& light = world.registry().get<PointLightComponent>(entity);
-					light.color = color3f(component["color"][0].get<float>(), component["color"][1].get<float>(), component["color"][2].get<float>());
-					light.intensity = component["intensity"];
-					light.radius = 1.f;
-				}
-				else if (name == "dirlight")
-				{
-					world.registry().emplace<DirectionalLightComponent>(entity);
-					DirectionalLightComponent& light = world.registry().get<DirectionalLightComponent>(entity);
-					light.color = color3f(component["color"][0].get<float>(), component["color"][1].get<float>(), component["color"][2].get<float>());
-					light.direction = vec3f(component["direction"][0].get<float>(), component["direction"][1].get<float>(), component["direction"][2].get<float>());
-					light.intensity = component["intensity"];
-				}
-				else if (name == "camera")
-				{
-					world.registry().emplace<Camera3DComponent>(entity);
-					Camera3DComponent& camera = world.registry().get<Camera3DComponent>(entity);
-					// projection
-					if (component.find("perspective") != component.end())
-					{
-						auto persp = std::make_unique<CameraPerspective>();
-						persp->hFov = anglef::degree(component["perspective"]["fov"].get<float>());
-						persp->nearZ = component["perspective"]["near"].get<float>();
-						persp->farZ = component["perspective"]["far"].get<float>();
-						persp->ratio = component["perspective"]["ratio"].get<float>();
-						camera.projection = std::move(persp);
-					}
-					else if (component.find("orthographic") != component.end())
-					{
-						auto ortho = std::make_unique<CameraOrthographic>();
-						ortho->left = component["orthographic"]["left"].get<float>();
-						ortho->right = component["orthographic"]["right"].get<float>();
-						ortho->bottom = component["orthographic"]["bottom"].get<float>();
-						ortho->top = component["orthographic"]["top"].get<float>();
-						ortho->nearZ = component["orthographic"]["near"].get<float>();
-						ortho->farZ = component["orthographic"]["far"].get<float>();
-						camera.projection = std::move(ortho);
-					}
-					else
-					{
-						Logger::warn("No projection found for camera. Default to perspective");
-						auto persp = std::make_unique<CameraPerspective>();
-						persp->hFov = anglef::degree(60.f);
-						persp->nearZ = 0.1f;
-						persp->farZ = 100.f;
-						persp->ratio = 1.f;
-						camera.projection = std::move(persp);
-					}
-					// controller
-					if (component.find("arcball") != component.end())
-					{
-						nlohmann::json& a = component["arcball"];
-						auto arcball = std::make_unique<CameraArcball>();
-						arcball->position = point3f(a["position"][0].get<float>(), a["position"][1].get<float>(), a["position"][2].get<float>());
-						arcball->target = point3f(a["target"][0].get<float>(), a["target"][1].get<float>(), a["target"][2].get<float>());
-						arcball->up = norm3f(a["up"][0].get<float>(), a["up"][1].get<float>(), a["up"][2].get<float>());
-						arcball->speed = a["speed"].get<float>();
-						camera.controller = std::move(arcball);
-					}
-					else 
-					{
-						Logger::warn("No controller found for camera. Default to arcball.");
-						auto arcball = std::make_unique<CameraArcball>();
-						arcball->position = point3f(1.f);
-						arcball->target = point3f(0.f);
-						arcball->up = norm3f(0.f, 1.f, 0.f);
-						arcball->speed = 1.f;
-						camera.controller = std::move(arcball);
-					}
-					camera.view; // auto set
-				}
-				else if (name == "text")
-				{
-					world.registry().emplace<TextComponent>(entity);
-					TextComponent& text = world.registry().get<TextComponent>(entity);
-					text.font = resource->get<Font>(component["font"].get<std::string>());
-					text.color = color4f(
-						component["color"][0].get<float>(),
-						component["color"][1].get<float>(),
-						component["color"][2].get<float>(),
-						component["color"][3].get<float>()
-					);
-					text.sampler.anisotropy = component["sampler"]["anisotropy"].get<float>();
-					text.sampler.wrapU = (TextureWrap)component["sampler"]["wrapU"].get<int>();
-					text.sampler.wrapV = (TextureWrap)component["sampler"]["wrapV"].get<int>();
-					text.sampler.wrapW = (TextureWrap)component["sampler"]["wrapW"].get<int>();
-					text.sampler.filterMin = (TextureFilter)component["sampler"]["filterMin"].get<int>();
-					text.sampler.filterMag = (TextureFilter)component["sampler"]["filterMag"].get<int>();
-					text.sampler.mipmapMode = (TextureMipMapMode)component["sampler"]["mipmapMode"].get<int>();
-					text.text = component["text"].get<std::string>();
-				}
+				// Materials might follow entities, resolved once every material exist.
+				pendingMaterials.push_back(std::make_pair(entity, component["id"].get<uint32_t>()));
 			}
+			else
+			{
+				// Version 0.2 stores materials within entities, share identical ones.
+				std::string key = component.dump();
+				auto it = legacyMaterialMap.find(key);
+				if (it == legacyMaterialMap.end())
+					it = legacyMaterialMap.insert(std::make_pair(key, addMaterial(materials, resources, component))).first;
+				world.registry().emplace<MaterialComponent>(entity, MaterialComponent{ it->second });
+			}
+		}
+		else if (name == "instanced")
+		{
+			world.registry().emplace<InstancedComponent>(entity);
+		}
+		else if (name == "pointlight")
+		{
+			world.registry().emplace<PointLightComponent>(entity);
+			PointLightComponent& light = world.registry().get<PointLightComponent>(entity);
+			light.color = color3f(component["color"][0].get<float>(), component["color"][1].get<float>(), component["color"][2].get<float>());
+			light.intensity = component["intensity"];
+			light.radius = 1.f;
+		}
+		else if (name == "dirlight")
+		{
+			world.registry().emplace<DirectionalLightComponent>(entity);
+			DirectionalLightComponent& light = world.registry().get<DirectionalLightComponent>(entity);
+			light.color = color3f(component["color"][0].get<float>(), component["color"][1].get<float>(), component["color"][2].get<float>());
+			light.direction = vec3f(component["direction"][0].get<float>(), component["direction"][1].get<float>(), component["direction"][2].get<float>());
+			light.intensity = component["intensity"];
 		}
+		else if (name == "camera")
+		{
+			world.registry().emplace<Camera3DComponent>(entity);
+			Camera3DComponent& camera = world.registry().get<Camera3DComponent>(entity);
+			// projection
+			if (component.find("perspective") != component.end())
+			{
+				auto persp = std::make_unique<CameraPerspective>();
+				persp->hFov = anglef::degree(component["perspective"]["fov"].get<float>());
+				persp->nearZ = component["perspective"]["near"].get<float>();
+				persp->farZ = component["perspective"]["far"].get<float>();
+				persp->ratio = component["perspective"]["ratio"].get<float>();
+				camera.projection = std::move(persp);
+			}
+			else if (component.find("orthographic") != component.end())
+			{
+				auto ortho = std::make_unique<CameraOrthographic>();
+				ortho->left = component["orthographic"]["left"].get<float>();
+				ortho->right = component["orthographic"]["right"].get<float>();
+				ortho->bottom = component["orthographic"]["bottom"].get<float>();
+				ortho->top = component["orthographic"]["top"].get<float>();
+				ortho->nearZ = component["orthographic"]["near"].get<float>();
+				ortho->farZ = component["orthographic"]["far"].get<float>();
+				camera.projection = std::move(ortho);
+			}
+			else
+			{
+				Logger::warn("No projection found for camera. Default to perspective");
+				auto persp = std::make_unique<CameraPerspective>();
+				persp->hFov = anglef::degree(60.f);
+				persp->nearZ = 0.1f;
+				persp->farZ = 100.f;
+				persp->ratio = 1.f;
+				camera.projection = std::move(persp);
+			}
+			// controller
+			if (component.find("arcball") != component.end())
+			{
+				nlohmann::json& a = component["arcball"];
+				auto arcball = std::make_unique<CameraArcball>();
+				arcball->position = point3f(a["position"][0].get<float>(), a["position"][1].get<float>(), a["position"][2].get<float>());
+				arcball->target = point3f(a["target"][0].get<float>(), a["target"][1].get<float>(), a["target"][2].get<float>());
+				arcball->up = norm3f(a["up"][0].get<float>(), a["up"][1].get<float>(), a["up"][2].get<float>());
+				arcball->speed = a["speed"].get<float>();
+				camera.controller = std::move(arcball);
+			}
+			else 
+			{
+				Logger::warn("No controller found for camera. Default to arcball.");
+				auto arcball = std::make_unique<CameraArcball>();
+				arcball->position = point3f(1.f);
+				arcball->target = point3f(0.f);
+				arcball->up = norm3f(0.f, 1.f, 0.f);
+				arcball->speed = 1.f;
+				camera.controller = std::move(arcball);
+			}
+			camera.view; // auto set
+		}
+		else if (name == "text")
+		{
+			world.registry().emplace<TextComponent>(entity);
+			TextComponent& text = world.registry().get<TextComponent>(entity);
+			resources.addFont(entity, component["font"].get<std::string>());
+			text.color = color4f(
+				component["color"][0].get<float>(),
+				component["color"][1].get<float>(),
+				component["color"][2].get<float>(),
+				component["color"][3].get<float>()
+			);
+			text.sampler.anisotropy = component["sampler"]["anisotropy"].get<float>();
+			text.sampler.wrapU = (TextureWrap)component["sampler"]["wrapU"].get<int>();
+			text.sampler.wrapV = (TextureWrap)component["sampler"]["wrapV"].get<int>();
+			text.sampler.wrapW = (TextureWrap)component["sampler"]["wrapW"].get<int>();
+			text.sampler.filterMin = (TextureFilter)component["sampler"]["filterMin"].get<int>();
+			text.sampler.filterMag = (TextureFilter)component["sampler"]["filterMag"].get<int>();
+			text.sampler.mipmapMode = (TextureMipMapMode)component["sampler"]["mipmapMode"].get<int>();
+			text.text = component["text"].get<std::string>();
+		}
+		return true;
+	};
+	bool parsed = false;
+	try
+	{
+		parsed = nlohmann::json::sax_parse(file, &handler);
 	}
-	catch (const nlohmann::json::exception& e)
+	catch (const std::exception& e)
 	{
-		Logger::error("Failed to write JSON : ", e.what());
+		Logger::error("Failed to read JSON : ", e.what());
+	}
+	if (parsed && version.empty())
+	{
+		Logger::error("No version found in ", path);
+		parsed = false;
+	}
+	if (!parsed)
+	{
+		for (entt::entity e : created)
+			world.registry().destroy(e);
+		materials.rollback(materialCount);
+		return false;
+	}
+	for (const std::pair<entt::entity, uint32_t>& pending : pendingParents)
+	{
+		auto it = entityMap.find(pending.second);
+		if (it != entityMap.end())
+			world.registry().get<Hierarchy3DComponent>(pending.first).parent = Entity(it->second, &world);
+		else
+			Logger::warn("Parent ", pending.second, " not found, entity is detached.");
+	}
+	for (const std::pair<entt::entity, uint32_t>& pending : pendingMaterials)
+	{
+		MaterialHandle handle = MaterialTable::invalid;
+		if (pending.second < materialMap.size())
+			handle = materialMap[pending.second];
+		if (handle == MaterialTable::invalid)
+		{
+			Logger::warn("Invalid material ", pending.second, ", using default material.");
+			handle = Scene::getDefaultMaterial(world);
+		}
+		world.registry().emplace<MaterialComponent>(pending.first, MaterialComponent{ handle });
 	}
+	resources.resolve();
+	return true;
 }
 
 };
\ No newline at end of file
@@ -2,6 +2,11 @@
 
 #include <Aka/Aka.h>
 
+#include "MeshOptimizer.h"
+#include "MeshBatch.h"
+
+#include <unordered_map>
+
 namespace app {
 
 using namespace aka;
@@ -16,15 +21,34 @@ struct Hierarchy3DComponent {
 };
 
 struct StaticMeshComponent {
+	static constexpr uint32_t maxLodCount = 4;
 	SubMesh submesh;
 	aabbox<> bounds;
+	uint32_t lodCount; // Number of coarser LODs
+	SubMesh lods[maxLodCount]; // Each LOD has about half the triangles of the previous one
+	// Position only streams of submesh & LODs for depth & shadow passes, null meshes if not imported with one
+	SubMesh depth;
+	SubMesh depthLods[maxLodCount];
+	std::vector<Meshlet> meshlets; // Clusters of the full resolution submesh, in object space
+	// QuantizationUniformBuffer stored with packed meshes, shared by their LODs & position only streams. Null for other layouts.
+	Buffer::Ptr quantization;
 };
 
-struct OpaqueMaterialComponent {
+// Library file of the meshlets of a mesh, next to its .mesh file
+struct MeshletStorage {
+	std::vector<Meshlet> meshlets;
+
+	bool load(const Path& path);
+	bool save(const Path& path) const;
+};
+
+// Material stored once in the material table of a world and shared by the entities referencing it.
+struct MaterialAsset {
 	struct Texture {
 		aka::Texture::Ptr texture;
 		TextureSampler sampler;
 	};
+	String name;
 	color4f color;
 	bool doubleSided;
 	Texture albedo;
@@ -33,9 +57,72 @@ struct OpaqueMaterialComponent {
 	//Texture::Ptr emissive;
 };
 
+// Index of a material in the material table
+using MaterialHandle = uint32_t;
+
+// Materials of a world. Handles are never invalidated as materials are only removed by a failed load,
+// before any entity references them.
+struct MaterialTable {
+	static constexpr MaterialHandle invalid = ~0U;
+
+	// Add a material with its textures, never returned by find(material, textures)
+	MaterialHandle add(const MaterialAsset& material);
+	// Add a material whose albedo, normal & material textures have these names & are bound once loaded
+	MaterialHandle add(const MaterialAsset& material, const String textures[3]);
+	// Return the first material with this name or invalid
+	MaterialHandle find(const String& name) const;
+	// Return a material added with texture names, with the same name, settings & texture names, or invalid.
+	// Loads reuse them so that loading a scene again does not grow the table.
+	MaterialHandle find(const MaterialAsset& material, const String textures[3]) const;
+	// Remove materials added after the first count ones, by a load that failed
+	void rollback(uint32_t count);
+	bool valid(MaterialHandle handle) const { return handle < m_materials.size(); }
+	MaterialAsset& get(MaterialHandle handle) { return m_materials[handle]; }
+	const MaterialAsset& get(MaterialHandle handle) const { return m_materials[handle]; }
+	uint32_t size() const { return (uint32_t)m_materials.size(); }
+private:
+	// Content a material was added with, materials are found by its hash
+	struct Key {
+		uint64_t hash;
+		String textures[3];
+	};
+	static Key getKey(const MaterialAsset& material, const String textures[3]);
+	static bool equal(const MaterialAsset& lhs, const Key& lhsKey, const MaterialAsset& rhs, const Key& rhsKey);
+private:
+	std::vector<MaterialAsset> m_materials;
+	std::vector<Key> m_keys; // Indexed by handle
+	std::unordered_multimap<uint64_t, MaterialHandle> m_handles; // Key hash to materials
+};
+
+struct OpaqueMaterialComponent {
+	MaterialHandle material;
+};
+
+// Vertex layout of a mesh, used to select the program drawing it
+enum class VertexLayout {
+	Default, // Float position, normal, uv & color
+	Tangent, // Default with a packed tangent stream
+	Packed, // Unorm16 position within bounds, octahedral normal, half uv & packed tangent stream
+	PackedColor, // Packed with an additional RGBA8 color stream
+};
+
+// Expand unorm16 positions of packed meshes to object space, written by the importer next to the mesh.
+struct alignas(16) QuantizationUniformBuffer {
+	alignas(16) vec3f offset; // Min of the quantized bounds
+	alignas(16) vec3f scale; // Extent of the quantized bounds divided by 65535
+};
+
 using MeshComponent = StaticMeshComponent;
 using MaterialComponent = OpaqueMaterialComponent;
 
+// Tag of mesh entities sharing their mesh & material with others, drawn together with instanced draws.
+struct InstancedComponent {
+	// Instances per draw, size of the instance arrays of instanced shaders.
+	// Instance arrays are uniform blocks, which are only guaranteed to hold 16 KiB : 128 instances of 128 bytes.
+	static constexpr uint32_t batchSize = 128;
+	static constexpr uint32_t maxUniformBlockSize = 16384;
+};
+
 // CSM based directional light
 struct DirectionalLightComponent {
 	vec3f direction;
@@ -86,6 +173,36 @@ struct DirtyTransformComponent {};
 struct Scene
 {
 	static Entity getMainCamera(World& world);
+	// Material table of the world, created on first access
+	static MaterialTable& getMaterials(World& world);
+	// Material without textures, created once per world
+	static MaterialHandle getDefaultMaterial(World& world);
+	// Shared buffers of static meshes, created on first access
+	static MeshBatchTable& getMeshBatches(World& world);
+	// Merge meshes & LODs of mesh components not batched yet into shared buffers
+	static void batchMeshes(World& world, const MeshBatchTable::BufferReader& read = nullptr);
+	// Vertex layout
+	static VertexLayout getVertexLayout(const Mesh::Ptr& mesh);
+	// Quantization of the positions of a packed mesh within bounds
+	static QuantizationUniformBuffer getQuantization(const aabbox<>& bounds);
+	static String getQuantizationName(const String& mesh);
+	// LOD
+	static String getLodName(const String& mesh, uint32_t lod);
+	static String getDepthName(const String& mesh);
+	// Fill LODs, position only streams & quantization with resources named after the base mesh
+	static void loadLods(StaticMeshComponent& mesh);
+	// Select a LOD from the projected size of the bounding sphere, a greater bias selects coarser LODs
+	static const SubMesh& selectLod(const StaticMeshComponent& mesh, const mat4f& transform, const point3f& eye, float pixelsPerUnit, float bias);
+	// Select a LOD like selectLod, with its position only stream if any
+	static const SubMesh& selectDepthLod(const StaticMeshComponent& mesh, const mat4f& transform, const point3f& eye, float pixelsPerUnit, float bias);
+	// Select a depth LOD seen through an orthographic projection, where projected size does not depend on distance
+	static const SubMesh& selectDepthLod(const StaticMeshComponent& mesh, const mat4f& transform, float texelsPerUnit, float bias);
+	// Meshlets
+	static Path getMeshletPath(const String& mesh);
+	// Fill meshlets from the library file of the base mesh, if any
+	static void loadMeshlets(StaticMeshComponent& mesh);
+	// Return true if the meshlet is outside the frustum or, with cone, all its triangles face away from eye
+	static bool cullMeshlet(const Meshlet& meshlet, const frustum<>::planes& planes, const mat4f& transform, const point3f& eye, bool cone);
 	// Factory
 	static Mesh::Ptr createCubeMesh(const point3f& position, float size);
 	static Mesh::Ptr createSphereMesh(const point3f& position, float radius, uint32_t segmentCount, uint32_t ringCount);
@@ -96,8 +213,17 @@ struct Scene
 	static Entity createDirectionalLightEntity(World& world);
 	static Entity createArcballCameraEntity(World& world);
 
+	// Save or load a scene, binary unless the path has a .json extension. Loading batches static meshes.
 	static void save(const Path& path, const World& world);
 	static void load(World& world, const Path& path);
+	// Scene loaded at startup, the most recently written of library/scene.bin & library/scene.json
+	static Path getStartupPath();
+	// JSON scene, kept as interchange format
+	static bool saveJSON(const Path& path, const World& world);
+	static bool loadJSON(World& world, const Path& path);
+	// Versioned binary scene with one section per component type, memory mapped on load
+	static bool saveBinary(const Path& path, const World& world);
+	static bool loadBinary(World& world, const Path& path);
 };
 
 };
\ No newline at end of file
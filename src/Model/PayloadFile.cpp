@@ -0,0 +1,118 @@
+#include "PayloadFile.h"
+#include "BinaryFile.h"
+
+namespace app {
+
+using namespace aka;
+
+// Payload offset, a mapping starts on a page so the payload is aligned for any upload
+static const size_t payloadAlignment = 64;
+
+struct PayloadHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t headerSize; // Asset header following this one
+	uint32_t codec;
+	uint64_t size; // Payload size once decompressed
+	uint64_t storedSize; // Payload size in the file
+};
+
+static size_t getPayloadOffset(size_t headerSize)
+{
+	return (sizeof(PayloadHeader) + headerSize + payloadAlignment - 1) & ~(payloadAlignment - 1);
+}
+
+bool PayloadFile::save(const Path& path, const char magic[4], uint32_t version, const void* header, size_t headerSize, const uint8_t* payload, size_t size, Codec codec)
+{
+	std::vector<uint8_t> compressed;
+	if (codec != Codec::None && size > 0)
+	{
+		uint32_t chunkCount = ChunkedPayload::getChunkCount(size);
+		std::vector<std::vector<uint8_t>> chunks(chunkCount);
+		for (uint32_t i = 0; i < chunkCount; i++)
+			chunks[i] = ChunkedPayload::compress(codec, payload, size, i);
+		compressed = ChunkedPayload::join(chunks);
+	}
+	else
+	{
+		codec = Codec::None;
+	}
+	BinaryWriter writer;
+	PayloadHeader payloadHeader{};
+	memcpy(payloadHeader.magic, magic, sizeof(payloadHeader.magic));
+	payloadHeader.version = version;
+	payloadHeader.headerSize = (uint32_t)headerSize;
+	payloadHeader.codec = (uint32_t)codec;
+	payloadHeader.size = size;
+	payloadHeader.storedSize = (codec == Codec::None) ? size : compressed.size();
+	writer.write(&payloadHeader, 1);
+	writer.write((const uint8_t*)header, headerSize);
+	writer.align(payloadAlignment);
+	if (codec == Codec::None)
+		writer.write(payload, size);
+	else
+		writer.write(compressed.data(), compressed.size());
+	return writer.save(path);
+}
+
+bool PayloadFile::open(const Path& path, const char magic[4], uint32_t version, size_t headerSize)
+{
+	close();
+	if (!m_file.open(path))
+		return false;
+	BinaryReader reader{ m_file.data(), m_file.size(), 0 };
+	PayloadHeader header;
+	size_t offset = getPayloadOffset(headerSize);
+	bool valid = reader.read(&header, 1) && memcmp(header.magic, magic, sizeof(header.magic)) == 0 && header.version == version && header.headerSize == headerSize;
+	valid = valid && header.codec <= (uint32_t)Codec::Zstd && m_file.size() >= offset && header.storedSize == m_file.size() - offset;
+	valid = valid && (header.codec != (uint32_t)Codec::None || header.size == header.storedSize);
+	if (!valid)
+	{
+		close();
+		return false;
+	}
+	m_header = m_file.data() + sizeof(PayloadHeader);
+	m_codec = (Codec)header.codec;
+	m_stored = m_file.data() + offset;
+	m_storedSize = (size_t)header.storedSize;
+	m_size = (size_t)header.size;
+	m_data = (m_codec == Codec::None) ? m_stored : nullptr;
+	return true;
+}
+
+void PayloadFile::close()
+{
+	m_file.close();
+	m_header = nullptr;
+	m_data = nullptr;
+	m_stored = nullptr;
+	m_size = 0;
+	m_storedSize = 0;
+	m_codec = Codec::None;
+	std::vector<uint8_t>().swap(m_bytes);
+}
+
+bool PayloadFile::split(std::vector<ChunkedPayload::Chunk>& chunks)
+{
+	if (m_codec == Codec::None)
+		return m_stored != nullptr;
+	// A corrupted size must fail before allocating
+	if (m_stored == nullptr || !ChunkedPayload::check(m_stored, m_storedSize, m_size))
+		return false;
+	m_bytes.resize(m_size);
+	m_data = m_bytes.data();
+	return ChunkedPayload::split(m_codec, m_stored, m_storedSize, m_bytes.data(), m_size, chunks);
+}
+
+bool PayloadFile::decompress()
+{
+	std::vector<ChunkedPayload::Chunk> chunks;
+	if (!split(chunks))
+		return false;
+	for (const ChunkedPayload::Chunk& chunk : chunks)
+		if (!ChunkedPayload::decompress(chunk))
+			return false;
+	return true;
+}
+
+};
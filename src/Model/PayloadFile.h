@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "MappedFile.h"
+#include "Compression.h"
+
+#include <vector>
+
+namespace app {
+
+// Library file of a payload following a header of its asset type.
+// Raw payloads are aligned so that a mapping of the file is uploaded as is,
+// compressed payloads are split in chunks decompressed in parallel on the heap.
+class PayloadFile
+{
+public:
+	// Write the asset header & the payload, compressed with codec
+	static bool save(const aka::Path& path, const char magic[4], uint32_t version, const void* header, size_t headerSize, const uint8_t* payload, size_t size, Codec codec);
+
+	// Map the file, false if it can't be opened, is of another type or version, or is truncated
+	bool open(const aka::Path& path, const char magic[4], uint32_t version, size_t headerSize);
+	void close();
+	// Allocate the payload & list its chunks to decompress, nothing for raw payloads. False if the payload is corrupted.
+	bool split(std::vector<ChunkedPayload::Chunk>& chunks);
+	// Split & decompress every chunk on the calling thread, false if the payload is corrupted
+	bool decompress();
+
+	// Asset header, null if not opened
+	const void* header() const { return m_header; }
+	Codec codec() const { return m_codec; }
+	// Mapped payload, or decompressed payload once split & decompressed
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+private:
+	MappedFile m_file;
+	const void* m_header = nullptr;
+	const uint8_t* m_data = nullptr;
+	const uint8_t* m_stored = nullptr;
+	size_t m_size = 0;
+	size_t m_storedSize = 0;
+	Codec m_codec = Codec::None;
+	std::vector<uint8_t> m_bytes;
+};
+
+};
@@ -0,0 +1,649 @@
+#include "Model.h"
+#include "BinaryFile.h"
+#include "MappedFile.h"
+#include "SceneResources.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace app {
+
+using namespace aka;
+
+static const char sceneMagic[4] = { 'A', 'K', 'S', 'C' };
+static const uint32_t sceneVersion = 1;
+// Alignment of sections in the file, arrays within a section only hold 4 bytes elements.
+static const size_t sceneAlignment = 16;
+static const uint32_t sceneInvalidIndex = ~0U;
+
+enum class SceneSection : uint32_t {
+	Tag,
+	Transform,
+	Hierarchy,
+	Mesh,
+	Material,
+	Instanced,
+	DirectionalLight,
+	PointLight,
+	Camera,
+};
+
+struct SceneHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t entityCount;
+	uint32_t samplerCount;
+	uint32_t materialCount;
+	uint32_t sectionCount;
+	uint32_t stringSize;
+	uint32_t padding;
+	uint64_t samplerOffset;
+	uint64_t materialOffset;
+	uint64_t sectionOffset; // Section entries
+	uint64_t stringOffset; // Null terminated strings, referenced by offset
+};
+
+// Section payload starts with the index of its entities, followed by one array per field.
+struct SceneSectionEntry {
+	SceneSection type;
+	uint32_t count;
+	uint64_t offset;
+};
+
+// Samplers are shared by materials using the same settings
+struct SceneSampler {
+	float anisotropy;
+	uint32_t filterMin;
+	uint32_t filterMag;
+	uint32_t wrapU;
+	uint32_t wrapV;
+	uint32_t wrapW;
+	uint32_t mipmapMode;
+};
+
+struct SceneMaterial {
+	uint32_t name;
+	float color[4];
+	uint32_t doubleSided;
+	uint32_t textures[3]; // Albedo, normal & material texture names
+	uint32_t samplers[3];
+};
+
+enum class SceneProjection : uint32_t { Perspective, Orthographic, None };
+enum class SceneController : uint32_t { Arcball, None };
+
+// Cameras are rare, stored as records instead of arrays
+struct SceneCamera {
+	uint32_t active;
+	SceneProjection projection;
+	float projectionData[6]; // Perspective fov (degree), near, far, ratio. Orthographic left, right, bottom, top, near, far
+	SceneController controller;
+	float controllerData[10]; // Arcball position, target, up, speed
+};
+
+// Bytes of a scene being written, with its string table
+struct SceneWriter : BinaryWriter {
+	std::string strings;
+	std::unordered_map<std::string, uint32_t> stringOffsets;
+
+	void align()
+	{
+		BinaryWriter::align(sceneAlignment);
+	}
+	uint32_t string(const char* value)
+	{
+		auto it = stringOffsets.find(value);
+		if (it != stringOffsets.end())
+			return it->second;
+		uint32_t offset = (uint32_t)strings.size();
+		strings.append(value);
+		strings.push_back('\0');
+		stringOffsets.insert(std::make_pair(std::string(value), offset));
+		return offset;
+	}
+};
+
+static uint32_t addSampler(std::vector<SceneSampler>& samplers, const TextureSampler& sampler)
+{
+	SceneSampler s{};
+	s.anisotropy = sampler.anisotropy;
+	s.filterMin = (uint32_t)sampler.filterMin;
+	s.filterMag = (uint32_t)sampler.filterMag;
+	s.wrapU = (uint32_t)sampler.wrapU;
+	s.wrapV = (uint32_t)sampler.wrapV;
+	s.wrapW = (uint32_t)sampler.wrapW;
+	s.mipmapMode = (uint32_t)sampler.mipmapMode;
+	for (uint32_t i = 0; i < samplers.size(); i++)
+		if (memcmp(&samplers[i], &s, sizeof(SceneSampler)) == 0)
+			return i;
+	samplers.push_back(s);
+	return (uint32_t)samplers.size() - 1;
+}
+
+static TextureSampler getSampler(const SceneSampler& s)
+{
+	TextureSampler sampler;
+	sampler.anisotropy = s.anisotropy;
+	sampler.filterMin = (TextureFilter)s.filterMin;
+	sampler.filterMag = (TextureFilter)s.filterMag;
+	sampler.wrapU = (TextureWrap)s.wrapU;
+	sampler.wrapV = (TextureWrap)s.wrapV;
+	sampler.wrapW = (TextureWrap)s.wrapW;
+	sampler.mipmapMode = (TextureMipMapMode)s.mipmapMode;
+	return sampler;
+}
+
+static SceneCamera getCamera(const Camera3DComponent& c)
+{
+	SceneCamera camera{};
+	camera.active = c.active;
+	camera.projection = SceneProjection::None;
+	camera.controller = SceneController::None;
+	if (CameraPerspective* perspective = dynamic_cast<CameraPerspective*>(c.projection.get()))
+	{
+		camera.projection = SceneProjection::Perspective;
+		camera.projectionData[0] = perspective->hFov.degree();
+		camera.projectionData[1] = perspective->nearZ;
+		camera.projectionData[2] = perspective->farZ;
+		camera.projectionData[3] = perspective->ratio;
+	}
+	else if (CameraOrthographic* orthographic = dynamic_cast<CameraOrthographic*>(c.projection.get()))
+	{
+		camera.projection = SceneProjection::Orthographic;
+		camera.projectionData[0] = orthographic->left;
+		camera.projectionData[1] = orthographic->right;
+		camera.projectionData[2] = orthographic->bottom;
+		camera.projectionData[3] = orthographic->top;
+		camera.projectionData[4] = orthographic->nearZ;
+		camera.projectionData[5] = orthographic->farZ;
+	}
+	if (CameraArcball* arcball = dynamic_cast<CameraArcball*>(c.controller.get()))
+	{
+		camera.controller = SceneController::Arcball;
+		float data[10] = {
+			arcball->position.x, arcball->position.y, arcball->position.z,
+			arcball->target.x, arcball->target.y, arcball->target.z,
+			arcball->up.x, arcball->up.y, arcball->up.z,
+			arcball->speed
+		};
+		memcpy(camera.controllerData, data, sizeof(data));
+	}
+	return camera;
+}
+
+static void setCamera(Camera3DComponent& camera, const SceneCamera& c)
+{
+	camera.active = c.active != 0;
+	if (c.projection == SceneProjection::Orthographic)
+	{
+		auto ortho = std::make_unique<CameraOrthographic>();
+		ortho->left = c.projectionData[0];
+		ortho->right = c.projectionData[1];
+		ortho->bottom = c.projectionData[2];
+		ortho->top = c.projectionData[3];
+		ortho->nearZ = c.projectionData[4];
+		ortho->farZ = c.projectionData[5];
+		camera.projection = std::move(ortho);
+	}
+	else
+	{
+		auto persp = std::make_unique<CameraPerspective>();
+		bool valid = c.projection == SceneProjection::Perspective;
+		if (!valid)
+			Logger::warn("No projection found for camera. Default to perspective");
+		persp->hFov = anglef::degree(valid ? c.projectionData[0] : 60.f);
+		persp->nearZ = valid ? c.projectionData[1] : 0.1f;
+		persp->farZ = valid ? c.projectionData[2] : 100.f;
+		persp->ratio = valid ? c.projectionData[3] : 1.f;
+		camera.projection = std::move(persp);
+	}
+	auto arcball = std::make_unique<CameraArcball>();
+	if (c.controller == SceneController::Arcball)
+	{
+		arcball->position = point3f(c.controllerData[0], c.controllerData[1], c.controllerData[2]);
+		arcball->target = point3f(c.controllerData[3], c.controllerData[4], c.controllerData[5]);
+		arcball->up = norm3f(c.controllerData[6], c.controllerData[7], c.controllerData[8]);
+		arcball->speed = c.controllerData[9];
+	}
+	else
+	{
+		Logger::warn("No controller found for camera. Default to arcball.");
+		arcball->position = point3f(1.f);
+		arcball->target = point3f(0.f);
+		arcball->up = norm3f(0.f, 1.f, 0.f);
+		arcball->speed = 1.f;
+	}
+	camera.controller = std::move(arcball);
+}
+
+bool Scene::saveBinary(const Path& path, const World& world)
+{
+	ResourceManager* resource = Application::resource();
+	const entt::registry& r = world.registry();
+	// Entities are referenced by their index in the file
+	std::vector<entt::entity> entities;
+	std::unordered_map<entt::entity, uint32_t> indices;
+	r.each([&](entt::entity e) {
+		indices.insert(std::make_pair(e, (uint32_t)entities.size()));
+		entities.push_back(e);
+	});
+
+	SceneWriter writer;
+	SceneHeader header{};
+	memcpy(header.magic, sceneMagic, sizeof(sceneMagic));
+	header.version = sceneVersion;
+	header.entityCount = (uint32_t)entities.size();
+	writer.bytes.resize(sizeof(SceneHeader));
+
+	// --- Materials
+	std::vector<SceneSampler> samplers;
+	std::vector<SceneMaterial> materials;
+	if (const MaterialTable* table = r.try_ctx<MaterialTable>())
+	{
+		for (MaterialHandle handle = 0; handle < table->size(); handle++)
+		{
+			const MaterialAsset& asset = table->get(handle);
+			SceneMaterial material{};
+			material.name = writer.string(asset.name.cstr());
+			material.color[0] = asset.color.r;
+			material.color[1] = asset.color.g;
+			material.color[2] = asset.color.b;
+			material.color[3] = asset.color.a;
+			material.doubleSided = asset.doubleSided;
+			const MaterialAsset::Texture* textures[3] = { &asset.albedo, &asset.normal, &asset.material };
+			for (uint32_t i = 0; i < 3; i++)
+			{
+				material.textures[i] = writer.string(resource->name<Texture>(textures[i]->texture).cstr());
+				material.samplers[i] = addSampler(samplers, textures[i]->sampler);
+			}
+			materials.push_back(material);
+		}
+	}
+	writer.align();
+	header.samplerCount = (uint32_t)samplers.size();
+	header.samplerOffset = writer.bytes.size();
+	writer.write(samplers.data(), samplers.size());
+	writer.align();
+	header.materialCount = (uint32_t)materials.size();
+	header.materialOffset = writer.bytes.size();
+	writer.write(materials.data(), materials.size());
+
+	// --- Sections, components of a type are written field by field
+	std::vector<SceneSectionEntry> sections;
+	auto section = [&](SceneSection type, const std::vector<entt::entity>& owners) {
+		writer.align();
+		sections.push_back(SceneSectionEntry{ type, (uint32_t)owners.size(), writer.bytes.size() });
+		for (entt::entity e : owners)
+			writer.write(&indices[e], 1);
+	};
+	std::vector<entt::entity> tags, transforms, hierarchies, meshes, materialOwners, instanced, dirLights, pointLights, cameras;
+	for (entt::entity e : entities)
+	{
+		if (r.has<TagComponent>(e))              tags.push_back(e);
+		if (r.has<Transform3DComponent>(e))      transforms.push_back(e);
+		if (r.has<Hierarchy3DComponent>(e))      hierarchies.push_back(e);
+		if (r.has<MeshComponent>(e))             meshes.push_back(e);
+		if (r.has<MaterialComponent>(e))         materialOwners.push_back(e);
+		if (r.has<InstancedComponent>(e))        instanced.push_back(e);
+		if (r.has<DirectionalLightComponent>(e)) dirLights.push_back(e);
+		if (r.has<PointLightComponent>(e))       pointLights.push_back(e);
+		if (r.has<Camera3DComponent>(e))         cameras.push_back(e);
+	}
+	if (!tags.empty())
+	{
+		section(SceneSection::Tag, tags);
+		for (entt::entity e : tags)
+		{
+			uint32_t name = writer.string(r.get<TagComponent>(e).name.cstr());
+			writer.write(&name, 1);
+		}
+	}
+	if (!transforms.empty())
+	{
+		section(SceneSection::Transform, transforms);
+		for (entt::entity e : transforms)
+		{
+			// Local transform, like JSON scenes
+			mat4f local = r.get<Transform3DComponent>(e).transform;
+			if (r.has<Hierarchy3DComponent>(e))
+				local = r.get<Hierarchy3DComponent>(e).inverseTransform * local;
+			float matrix[16];
+			for (uint32_t c = 0; c < 4; c++)
+				for (uint32_t l = 0; l < 4; l++)
+					matrix[c * 4 + l] = local[c][l];
+			writer.write(matrix, 16);
+		}
+	}
+	if (!hierarchies.empty())
+	{
+		section(SceneSection::Hierarchy, hierarchies);
+		for (entt::entity e : hierarchies)
+		{
+			const Hierarchy3DComponent& h = r.get<Hierarchy3DComponent>(e);
+			uint32_t parent = sceneInvalidIndex;
+			if (h.parent.valid())
+			{
+				auto it = indices.find(h.parent.handle());
+				if (it != indices.end())
+					parent = it->second;
+			}
+			writer.write(&parent, 1);
+		}
+	}
+	if (!meshes.empty())
+	{
+		section(SceneSection::Mesh, meshes);
+		for (entt::entity e : meshes)
+		{
+			uint32_t name = writer.string(resource->name<Mesh>(r.get<MeshComponent>(e).submesh.mesh).cstr());
+			writer.write(&name, 1);
+		}
+		for (entt::entity e : meshes)
+			writer.write(&r.get<MeshComponent>(e).bounds.min.x, 3);
+		for (entt::entity e : meshes)
+			writer.write(&r.get<MeshComponent>(e).bounds.max.x, 3);
+	}
+	if (!materialOwners.empty())
+	{
+		section(SceneSection::Material, materialOwners);
+		for (entt::entity e : materialOwners)
+			writer.write(&r.get<MaterialComponent>(e).material, 1);
+	}
+	if (!instanced.empty())
+	{
+		section(SceneSection::Instanced, instanced);
+	}
+	if (!dirLights.empty())
+	{
+		section(SceneSection::DirectionalLight, dirLights);
+		for (entt::entity e : dirLights)
+			writer.write(&r.get<DirectionalLightComponent>(e).direction.x, 3);
+		for (entt::entity e : dirLights)
+			writer.write(&r.get<DirectionalLightComponent>(e).color.r, 3);
+		for (entt::entity e : dirLights)
+			writer.write(&r.get<DirectionalLightComponent>(e).intensity, 1);
+	}
+	if (!pointLights.empty())
+	{
+		section(SceneSection::PointLight, pointLights);
+		for (entt::entity e : pointLights)
+			writer.write(&r.get<PointLightComponent>(e).color.r, 3);
+		for (entt::entity e : pointLights)
+			writer.write(&r.get<PointLightComponent>(e).intensity, 1);
+	}
+	if (!cameras.empty())
+	{
+		section(SceneSection::Camera, cameras);
+		for (entt::entity e : cameras)
+		{
+			SceneCamera camera = getCamera(r.get<Camera3DComponent>(e));
+			writer.write(&camera, 1);
+		}
+	}
+	writer.align();
+	header.sectionCount = (uint32_t)sections.size();
+	header.sectionOffset = writer.bytes.size();
+	writer.write(sections.data(), sections.size());
+	writer.align();
+	header.stringSize = (uint32_t)writer.strings.size();
+	header.stringOffset = writer.bytes.size();
+	writer.write(writer.strings.data(), writer.strings.size());
+	memcpy(writer.bytes.data(), &header, sizeof(SceneHeader));
+
+	if (!writer.save(path))
+	{
+		Logger::error("Failed to write scene.");
+		return false;
+	}
+	return true;
+}
+
+bool Scene::loadBinary(World& world, const Path& path)
+{
+	MappedFile file;
+	if (!file.open(path) || file.size() < sizeof(SceneHeader))
+	{
+		Logger::error("File ", path, " not valid.");
+		return false;
+	}
+	SceneHeader header;
+	memcpy(&header, file.data(), sizeof(SceneHeader));
+	if (memcmp(header.magic, sceneMagic, sizeof(sceneMagic)) != 0 || header.version != sceneVersion)
+	{
+		Logger::error("Unsupported scene file : ", path);
+		return false;
+	}
+	BinaryReader reader{ file.data(), file.size(), header.stringOffset };
+	const char* strings = reader.read<char>(header.stringSize);
+	if (strings == nullptr || (header.stringSize > 0 && strings[header.stringSize - 1] != '\0'))
+	{
+		Logger::error("Invalid string table in ", path);
+		return false;
+	}
+	auto string = [&](uint32_t offset) -> const char* {
+		return offset < header.stringSize ? strings + offset : "";
+	};
+	reader.offset = header.samplerOffset;
+	const SceneSampler* samplers = reader.read<SceneSampler>(header.samplerCount);
+	reader.offset = header.materialOffset;
+	const SceneMaterial* sceneMaterials = reader.read<SceneMaterial>(header.materialCount);
+	reader.offset = header.sectionOffset;
+	const SceneSectionEntry* sections = reader.read<SceneSectionEntry>(header.sectionCount);
+	if (samplers == nullptr || sceneMaterials == nullptr || sections == nullptr)
+	{
+		Logger::error("Truncated scene file : ", path);
+		return false;
+	}
+	// A component type is stored in a single section
+	std::unordered_set<uint32_t> sectionTypes;
+	for (uint32_t i = 0; i < header.sectionCount; i++)
+	{
+		if (!sectionTypes.insert((uint32_t)sections[i].type).second)
+		{
+			Logger::error("Duplicate scene section ", (uint32_t)sections[i].type, " in ", path);
+			return false;
+		}
+	}
+
+	// Meshes & textures are loaded at once after parsing.
+	SceneResources resources(world);
+
+	// --- Materials
+	MaterialTable& materials = Scene::getMaterials(world);
+	uint32_t materialCount = materials.size();
+	std::vector<MaterialHandle> materialMap;
+	for (uint32_t i = 0; i < header.materialCount; i++)
+	{
+		const SceneMaterial& m = sceneMaterials[i];
+		MaterialAsset asset;
+		asset.name = string(m.name);
+		asset.color = color4f(m.color[0], m.color[1], m.color[2], m.color[3]);
+		asset.doubleSided = m.doubleSided != 0;
+		MaterialAsset::Texture MaterialAsset::* textures[3] = { &MaterialAsset::albedo, &MaterialAsset::normal, &MaterialAsset::material };
+		String textureNames[3];
+		for (uint32_t t = 0; t < 3; t++)
+		{
+			if (m.samplers[t] < header.samplerCount)
+				(asset.*textures[t]).sampler = getSampler(samplers[m.samplers[t]]);
+			textureNames[t] = string(m.textures[t]);
+		}
+		// Identical materials of a previous load are reused, with their textures already bound.
+		MaterialHandle handle = materials.find(asset, textureNames);
+		if (handle == MaterialTable::invalid)
+		{
+			handle = materials.add(asset, textureNames);
+			for (uint32_t t = 0; t < 3; t++)
+				resources.addTexture(handle, textures[t], textureNames[t]);
+		}
+		materialMap.push_back(handle);
+	}
+
+	// --- Entities, created at once so that sections can reference any of them
+	entt::registry& registry = world.registry();
+	std::vector<entt::entity> entities(header.entityCount);
+	registry.create(entities.begin(), entities.end());
+	// Last section owning each entity, an entity owns a component once
+	std::vector<uint32_t> ownerSection(header.entityCount, sceneInvalidIndex);
+	std::vector<entt::entity> owned;
+	for (uint32_t iSection = 0; iSection < header.sectionCount; iSection++)
+	{
+		const SceneSectionEntry& section = sections[iSection];
+		reader.offset = section.offset;
+		const uint32_t* owners = reader.read<uint32_t>(section.count);
+		if (owners == nullptr)
+		{
+			Logger::error("Truncated scene section in ", path);
+			registry.destroy(entities.begin(), entities.end());
+			materials.rollback(materialCount);
+			return false;
+		}
+		bool valid = true;
+		owned.resize(section.count);
+		for (uint32_t i = 0; i < section.count; i++)
+		{
+			valid = owners[i] < header.entityCount && ownerSection[owners[i]] != iSection;
+			if (!valid)
+				break;
+			ownerSection[owners[i]] = iSection;
+			owned[i] = entities[owners[i]];
+		}
+		if (!valid)
+		{
+			Logger::error("Invalid or duplicate entity in scene section of ", path);
+			registry.destroy(entities.begin(), entities.end());
+			materials.rollback(materialCount);
+			return false;
+		}
+		size_t count = section.count;
+		switch (section.type)
+		{
+		case SceneSection::Tag: {
+			const uint32_t* names = reader.read<uint32_t>(count);
+			if (names == nullptr)
+				break;
+			registry.insert<TagComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+				registry.get<TagComponent>(owned[i]).name = string(names[i]);
+			continue;
+		}
+		case SceneSection::Transform: {
+			const float* matrices = reader.read<float>(count * 16);
+			if (matrices == nullptr)
+				break;
+			registry.insert<Transform3DComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+			{
+				const float* m = matrices + i * 16;
+				registry.get<Transform3DComponent>(owned[i]).transform = mat4f(
+					col4f(m[0], m[1], m[2], m[3]),
+					col4f(m[4], m[5], m[6], m[7]),
+					col4f(m[8], m[9], m[10], m[11]),
+					col4f(m[12], m[13], m[14], m[15])
+				);
+			}
+			continue;
+		}
+		case SceneSection::Hierarchy: {
+			const uint32_t* parents = reader.read<uint32_t>(count);
+			if (parents == nullptr)
+				break;
+			registry.insert<Hierarchy3DComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+			{
+				Hierarchy3DComponent& h = registry.get<Hierarchy3DComponent>(owned[i]);
+				h.parent = parents[i] < header.entityCount ? Entity(entities[parents[i]], &world) : Entity::null();
+				h.inverseTransform = mat4f::identity();
+			}
+			continue;
+		}
+		case SceneSection::Mesh: {
+			const uint32_t* names = reader.read<uint32_t>(count);
+			const float* mins = reader.read<float>(count * 3);
+			const float* maxs = reader.read<float>(count * 3);
+			if (names == nullptr || mins == nullptr || maxs == nullptr)
+				break;
+			registry.insert<MeshComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+			{
+				MeshComponent& mesh = registry.get<MeshComponent>(owned[i]);
+				resources.addMesh(owned[i], string(names[i]));
+				mesh.bounds.min = point3f(mins[i * 3 + 0], mins[i * 3 + 1], mins[i * 3 + 2]);
+				mesh.bounds.max = point3f(maxs[i * 3 + 0], maxs[i * 3 + 1], maxs[i * 3 + 2]);
+			}
+			continue;
+		}
+		case SceneSection::Material: {
+			const uint32_t* ids = reader.read<uint32_t>(count);
+			if (ids == nullptr)
+				break;
+			registry.insert<MaterialComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+			{
+				MaterialHandle handle = ids[i] < materialMap.size() ? materialMap[ids[i]] : MaterialTable::invalid;
+				if (handle == MaterialTable::invalid)
+				{
+					Logger::warn("Invalid material for entity ", owners[i], ", using default material.");
+					handle = Scene::getDefaultMaterial(world);
+				}
+				registry.get<MaterialComponent>(owned[i]).material = handle;
+			}
+			continue;
+		}
+		case SceneSection::Instanced: {
+			registry.insert<InstancedComponent>(owned.begin(), owned.end());
+			continue;
+		}
+		case SceneSection::DirectionalLight: {
+			const float* directions = reader.read<float>(count * 3);
+			const float* colors = reader.read<float>(count * 3);
+			const float* intensities = reader.read<float>(count);
+			if (directions == nullptr || colors == nullptr || intensities == nullptr)
+				break;
+			registry.insert<DirectionalLightComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+			{
+				DirectionalLightComponent& light = registry.get<DirectionalLightComponent>(owned[i]);
+				light.direction = vec3f(directions[i * 3 + 0], directions[i * 3 + 1], directions[i * 3 + 2]);
+				light.color = color3f(colors[i * 3 + 0], colors[i * 3 + 1], colors[i * 3 + 2]);
+				light.intensity = intensities[i];
+			}
+			continue;
+		}
+		case SceneSection::PointLight: {
+			const float* colors = reader.read<float>(count * 3);
+			const float* intensities = reader.read<float>(count);
+			if (colors == nullptr || intensities == nullptr)
+				break;
+			registry.insert<PointLightComponent>(owned.begin(), owned.end());
+			for (size_t i = 0; i < count; i++)
+			{
+				PointLightComponent& light = registry.get<PointLightComponent>(owned[i]);
+				light.color = color3f(colors[i * 3 + 0], colors[i * 3 + 1], colors[i * 3 + 2]);
+				light.intensity = intensities[i];
+				light.radius = 1.f;
+			}
+			continue;
+		}
+		case SceneSection::Camera: {
+			const SceneCamera* records = reader.read<SceneCamera>(count);
+			if (records == nullptr)
+				break;
+			// Cameras own their projection & controller, they are not copyable
+			for (size_t i = 0; i < count; i++)
+				setCamera(registry.emplace<Camera3DComponent>(owned[i]), records[i]);
+			continue;
+		}
+		default:
+			Logger::warn("Unknown scene section ", (uint32_t)section.type, " skipped.");
+			continue;
+		}
+		Logger::error("Truncated scene section in ", path);
+		registry.destroy(entities.begin(), entities.end());
+		materials.rollback(materialCount);
+		return false;
+	}
+	resources.resolve();
+	return true;
+}
+
+};
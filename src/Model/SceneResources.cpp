@@ -0,0 +1,101 @@
+#include "SceneResources.h"
+
+#include "ImportCache.h"
+#include "LibraryLoader.h"
+
+namespace app {
+
+SceneResources::SceneResources(World& world) :
+	m_world(world)
+{
+}
+
+void SceneResources::addMesh(entt::entity entity, const String& name)
+{
+	m_meshes[name.cstr()].push_back(entity);
+}
+
+void SceneResources::addTexture(MaterialHandle material, MaterialAsset::Texture MaterialAsset::* slot, const String& name)
+{
+	m_textures[name.cstr()].push_back(std::make_pair(material, slot));
+}
+
+void SceneResources::addFont(entt::entity entity, const String& name)
+{
+	m_fonts[name.cstr()].push_back(entity);
+}
+
+void SceneResources::resolve()
+{
+	ResourceManager* resource = Application::resource();
+	std::vector<String> meshes;
+	std::vector<String> textures;
+	std::vector<String> fonts;
+	for (auto& mesh : m_meshes)
+		if (!resource->has<Mesh>(mesh.first.c_str()))
+			meshes.push_back(mesh.first.c_str());
+	for (auto& texture : m_textures)
+		if (!resource->has<Texture>(texture.first.c_str()))
+			textures.push_back(texture.first.c_str());
+	for (auto& font : m_fonts)
+		if (!resource->has<Font>(font.first.c_str()))
+			fonts.push_back(font.first.c_str());
+	// Resources that are not resident are loaded from the library manifest & files written by imports.
+	LibraryLoader loader;
+	if (meshes.size() > 0 || textures.size() > 0 || fonts.size() > 0)
+	{
+		Time start = Time::now();
+		ImportCache cache("library/import.json");
+		cache.load();
+		loader.index("library/library.json");
+		loader.index(cache);
+		loader.load(meshes, textures, fonts);
+		Logger::info("Loaded ", meshes.size(), " meshes, ", textures.size(), " textures & ", fonts.size(), " fonts of scene in ", (Time::now() - start).milliseconds(), "ms");
+	}
+
+	entt::registry& registry = m_world.registry();
+	// Instances share their mesh, LODs & meshlets are loaded once per mesh.
+	for (auto& mesh : m_meshes)
+	{
+		MeshComponent loaded;
+		loaded.submesh.mesh = resource->get<Mesh>(mesh.first.c_str());
+		if (loaded.submesh.mesh == nullptr)
+		{
+			Logger::warn("Mesh ", mesh.first, " not found.");
+			for (entt::entity entity : mesh.second)
+				registry.remove<MeshComponent>(entity);
+			continue;
+		}
+		loaded.submesh.offset = 0;
+		loaded.submesh.count = loaded.submesh.mesh->getIndexCount();
+		loaded.submesh.type = PrimitiveType::Triangles;
+		Scene::loadLods(loaded);
+		Scene::loadMeshlets(loaded);
+		for (entt::entity entity : mesh.second)
+		{
+			MeshComponent& component = registry.get<MeshComponent>(entity);
+			aabbox<> bounds = component.bounds;
+			component = loaded;
+			component.bounds = bounds;
+		}
+	}
+	MaterialTable& materials = Scene::getMaterials(m_world);
+	for (auto& texture : m_textures)
+	{
+		Texture::Ptr ptr = resource->get<Texture>(texture.first.c_str());
+		for (auto& reference : texture.second)
+			(materials.get(reference.first).*reference.second).texture = ptr;
+	}
+	for (auto& font : m_fonts)
+	{
+		Font::Ptr ptr = resource->get<Font>(font.first.c_str());
+		for (entt::entity entity : font.second)
+			registry.get<TextComponent>(entity).font = ptr;
+	}
+	// Static meshes are drawn from shared buffers, built from the buffers just read instead of reading them again.
+	Scene::batchMeshes(m_world, [&](const Buffer* buffer, BufferStorage& storage) {
+		return loader.readBuffer(buffer, storage);
+	});
+}
+
+};
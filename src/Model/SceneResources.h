@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "Model.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace app {
+
+// Resources referenced by a scene being loaded.
+// Loaders record references while parsing, the unique set of missing resources is then loaded at once
+// with files read concurrently, before resources are bound to components.
+class SceneResources
+{
+public:
+	SceneResources(World& world);
+
+	// Bind the mesh of a mesh component, bounds are set by the loader
+	void addMesh(entt::entity entity, const String& name);
+	// Bind a texture of a material
+	void addTexture(MaterialHandle material, MaterialAsset::Texture MaterialAsset::* slot, const String& name);
+	// Bind the font of a text component
+	void addFont(entt::entity entity, const String& name);
+	// Load resources missing from the resource manager from the library & bind every reference.
+	// Mesh components whose mesh can't be found are removed, others are batched.
+	void resolve();
+private:
+	World& m_world;
+	std::map<std::string, std::vector<entt::entity>> m_meshes;
+	std::map<std::string, std::vector<std::pair<MaterialHandle, MaterialAsset::Texture MaterialAsset::*>>> m_textures;
+	std::map<std::string, std::vector<entt::entity>> m_fonts;
+};
+
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define APP_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace app {
+
+// Four floats processed at once, with SSE2 on x86 & a scalar fallback elsewhere.
+// Used either as one RGBA32F pixel or as one component of four values laid out side by side.
+struct Float4 {
+#if defined(APP_SIMD_SSE2)
+	__m128 value;
+#else
+	float value[4];
+#endif
+
+	// Unaligned load & store of four floats
+	static Float4 load(const float* data);
+	void store(float* data) const;
+	static Float4 splat(float x);
+	static Float4 set(float x, float y, float z, float w);
+	// Sum of the four floats
+	float sum() const;
+	// Rows to columns, four RGBA pixels to their R, G, B & A components
+	static void transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3);
+	// Per lane choice of a comparison result, lhs where mask is set & rhs elsewhere
+	static Float4 select(const Float4& mask, const Float4& lhs, const Float4& rhs);
+	static Float4 min(const Float4& lhs, const Float4& rhs);
+	static Float4 max(const Float4& lhs, const Float4& rhs);
+	static Float4 abs(const Float4& x);
+	static Float4 sqrt(const Float4& x);
+};
+
+#if defined(APP_SIMD_SSE2)
+
+inline Float4 Float4::load(const float* data) { return Float4{ _mm_loadu_ps(data) }; }
+inline void Float4::store(float* data) const { _mm_storeu_ps(data, value); }
+inline Float4 Float4::splat(float x) { return Float4{ _mm_set1_ps(x) }; }
+inline Float4 Float4::set(float x, float y, float z, float w) { return Float4{ _mm_setr_ps(x, y, z, w) }; }
+inline float Float4::sum() const
+{
+	__m128 pairs = _mm_add_ps(value, _mm_movehl_ps(value, value));
+	return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+}
+inline void Float4::transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3) { _MM_TRANSPOSE4_PS(r0.value, r1.value, r2.value, r3.value); }
+inline Float4 operator+(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_add_ps(lhs.value, rhs.value) }; }
+inline Float4 operator-(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_sub_ps(lhs.value, rhs.value) }; }
+inline Float4 operator*(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_mul_ps(lhs.value, rhs.value) }; }
+inline Float4 operator/(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_div_ps(lhs.value, rhs.value) }; }
+inline Float4 operator<(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_cmplt_ps(lhs.value, rhs.value) }; }
+inline Float4 Float4::select(const Float4& mask, const Float4& lhs, const Float4& rhs) { return Float4{ _mm_or_ps(_mm_and_ps(mask.value, lhs.value), _mm_andnot_ps(mask.value, rhs.value)) }; }
+inline Float4 Float4::min(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_min_ps(lhs.value, rhs.value) }; }
+inline Float4 Float4::max(const Float4& lhs, const Float4& rhs) { return Float4{ _mm_max_ps(lhs.value, rhs.value) }; }
+inline Float4 Float4::abs(const Float4& x) { return Float4{ _mm_andnot_ps(_mm_set1_ps(-0.f), x.value) }; }
+inline Float4 Float4::sqrt(const Float4& x) { return Float4{ _mm_sqrt_ps(x.value) }; }
+
+#else
+
+inline Float4 Float4::load(const float* data) { return Float4{ { data[0], data[1], data[2], data[3] } }; }
+inline void Float4::store(float* data) const { for (int i = 0; i < 4; i++) data[i] = value[i]; }
+inline Float4 Float4::splat(float x) { return Float4{ { x, x, x, x } }; }
+inline Float4 Float4::set(float x, float y, float z, float w) { return Float4{ { x, y, z, w } }; }
+inline float Float4::sum() const { return (value[0] + value[2]) + (value[1] + value[3]); }
+inline void Float4::transpose(Float4& r0, Float4& r1, Float4& r2, Float4& r3)
+{
+	Float4* rows[4] = { &r0, &r1, &r2, &r3 };
+	for (int i = 0; i < 4; i++)
+		for (int j = i + 1; j < 4; j++)
+			std::swap(rows[i]->value[j], rows[j]->value[i]);
+}
+inline Float4 operator+(const Float4& lhs, const Float4& rhs) { return Float4{ { lhs.value[0] + rhs.value[0], lhs.value[1] + rhs.value[1], lhs.value[2] + rhs.value[2], lhs.value[3] + rhs.value[3] } }; }
+inline Float4 operator-(const Float4& lhs, const Float4& rhs) { return Float4{ { lhs.value[0] - rhs.value[0], lhs.value[1] - rhs.value[1], lhs.value[2] - rhs.value[2], lhs.value[3] - rhs.value[3] } }; }
+inline Float4 operator*(const Float4& lhs, const Float4& rhs) { return Float4{ { lhs.value[0] * rhs.value[0], lhs.value[1] * rhs.value[1], lhs.value[2] * rhs.value[2], lhs.value[3] * rhs.value[3] } }; }
+inline Float4 operator/(const Float4& lhs, const Float4& rhs) { return Float4{ { lhs.value[0] / rhs.value[0], lhs.value[1] / rhs.value[1], lhs.value[2] / rhs.value[2], lhs.value[3] / rhs.value[3] } }; }
+// Masks are 1 or 0 per lane, only meant for select
+inline Float4 operator<(const Float4& lhs, const Float4& rhs) { return Float4{ { lhs.value[0] < rhs.value[0] ? 1.f : 0.f, lhs.value[1] < rhs.value[1] ? 1.f : 0.f, lhs.value[2] < rhs.value[2] ? 1.f : 0.f, lhs.value[3] < rhs.value[3] ? 1.f : 0.f } }; }
+inline Float4 Float4::select(const Float4& mask, const Float4& lhs, const Float4& rhs) { return Float4{ { mask.value[0] != 0.f ? lhs.value[0] : rhs.value[0], mask.value[1] != 0.f ? lhs.value[1] : rhs.value[1], mask.value[2] != 0.f ? lhs.value[2] : rhs.value[2], mask.value[3] != 0.f ? lhs.value[3] : rhs.value[3] } }; }
+inline Float4 Float4::min(const Float4& lhs, const Float4& rhs) { return Float4{ { std::min(lhs.value[0], rhs.value[0]), std::min(lhs.value[1], rhs.value[1]), std::min(lhs.value[2], rhs.value[2]), std::min(lhs.value[3], rhs.value[3]) } }; }
+inline Float4 Float4::max(const Float4& lhs, const Float4& rhs) { return Float4{ { std::max(lhs.value[0], rhs.value[0]), std::max(lhs.value[1], rhs.value[1]), std::max(lhs.value[2], rhs.value[2]), std::max(lhs.value[3], rhs.value[3]) } }; }
+inline Float4 Float4::abs(const Float4& x) { return Float4{ { std::abs(x.value[0]), std::abs(x.value[1]), std::abs(x.value[2]), std::abs(x.value[3]) } }; }
+inline Float4 Float4::sqrt(const Float4& x) { return Float4{ { std::sqrt(x.value[0]), std::sqrt(x.value[1]), std::sqrt(x.value[2]), std::sqrt(x.value[3]) } }; }
+
+#endif
+
+};
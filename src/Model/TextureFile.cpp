@@ -0,0 +1,187 @@
+#include "TextureFile.h"
+#include "GraphicFormat.h"
+#include "LibraryLoader.h"
+
+namespace app {
+
+using namespace aka;
+
+static const char textureMagic[4] = { 'A', 'K', 'T', 'X' };
+static const uint32_t textureVersion = 2;
+// Alignment of images in the payload, enough for any pixel type.
+static const size_t imageAlignment = 64;
+
+struct TextureHeader {
+	uint32_t type;
+	uint32_t format; // Uploaded format, decoded format of blocks
+	uint32_t flags;
+	uint32_t imageCount;
+	uint32_t block; // BlockFormat of the images, None for pixels
+	uint32_t padding;
+};
+
+struct TextureImage {
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset; // Offset in payload, aligned on imageAlignment
+	uint64_t size;
+};
+
+static uint64_t alignImage(uint64_t offset)
+{
+	return (offset + imageAlignment - 1) & ~(uint64_t)(imageAlignment - 1);
+}
+
+bool TextureFile::save(const Path& path, const TextureData& data, Codec codec)
+{
+	std::vector<TextureImage> images(data.images.size());
+	uint64_t offset = alignImage(images.size() * sizeof(TextureImage));
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		images[i].width = data.images[i].width;
+		images[i].height = data.images[i].height;
+		images[i].offset = offset;
+		images[i].size = data.images[i].bytes.size();
+		offset = alignImage(offset + images[i].size);
+	}
+	std::vector<uint8_t> payload((size_t)offset, 0);
+	if (!images.empty())
+		memcpy(payload.data(), images.data(), images.size() * sizeof(TextureImage));
+	for (size_t i = 0; i < images.size(); i++)
+		memcpy(payload.data() + images[i].offset, data.images[i].bytes.data(), (size_t)images[i].size);
+	TextureHeader header{};
+	header.type = (uint32_t)data.type;
+	header.format = (uint32_t)data.format;
+	header.flags = (uint32_t)data.flags;
+	header.imageCount = (uint32_t)images.size();
+	header.block = (uint32_t)data.block;
+	return PayloadFile::save(path, textureMagic, textureVersion, &header, sizeof(TextureHeader), payload.data(), payload.size(), codec);
+}
+
+bool TextureFile::load(const Path& path, TextureData& data)
+{
+	TextureFile file;
+	if (!file.open(path) || !file.m_file.decompress() || !file.validate())
+		return false;
+	file.read(data);
+	return true;
+}
+
+bool TextureFile::open(const Path& path)
+{
+	if (!m_file.open(path, textureMagic, textureVersion, sizeof(TextureHeader)))
+		return false;
+	TextureHeader header;
+	memcpy(&header, m_file.header(), sizeof(TextureHeader));
+	m_type = (TextureType)header.type;
+	m_format = (TextureFormat)header.format;
+	m_flags = (TextureFlag)header.flags;
+	m_block = (BlockFormat)header.block;
+	m_imageCount = header.imageCount;
+	return true;
+}
+
+void TextureFile::close()
+{
+	m_file.close();
+	m_imageCount = 0;
+	m_block = BlockFormat::None;
+	std::vector<uint8_t>().swap(m_decoded);
+}
+
+bool TextureFile::split(std::vector<ChunkedPayload::Chunk>& chunks)
+{
+	return m_file.split(chunks);
+}
+
+bool TextureFile::validate() const
+{
+	size_t pixelSize = GraphicFormat::getPixelSize(m_format);
+	if (m_file.data() == nullptr || pixelSize == 0 || m_imageCount == 0 || m_imageCount > m_file.size() / sizeof(TextureImage))
+		return false;
+	if (m_block > BlockFormat::BC7 || (m_block != BlockFormat::None && BlockCompression::getDecodedFormat(m_block) != m_format))
+		return false;
+	uint32_t faceCount = (m_type == TextureType::TextureCubeMap) ? 6 : 1;
+	if (m_imageCount % faceCount != 0)
+		return false;
+	// Levels are uploaded with the size of the texture level, images must match it.
+	const TextureImage* images = (const TextureImage*)m_file.data();
+	for (uint32_t i = 0; i < m_imageCount; i++)
+	{
+		const TextureImage& image = images[i];
+		uint32_t level = i / faceCount;
+		uint32_t width = level < 32 ? max(images[0].width >> level, 1U) : 1U;
+		uint32_t height = level < 32 ? max(images[0].height >> level, 1U) : 1U;
+		uint64_t size = (m_block == BlockFormat::None) ? (uint64_t)width * height * pixelSize : BlockCompression::getImageSize(m_block, width, height);
+		if (image.width != width || image.height != height || image.size != size)
+			return false;
+		if (image.offset > m_file.size() || image.size > m_file.size() - image.offset)
+			return false;
+	}
+	return true;
+}
+
+void TextureFile::decode()
+{
+	if (m_block == BlockFormat::None)
+		return;
+	const TextureImage* images = (const TextureImage*)m_file.data();
+	m_decoded.resize(size());
+	size_t offset = 0;
+	for (uint32_t i = 0; i < m_imageCount; i++)
+	{
+		BlockCompression::decode(m_block, m_file.data() + images[i].offset, images[i].width, images[i].height, m_decoded.data() + offset);
+		offset += (size_t)images[i].width * images[i].height * GraphicFormat::getPixelSize(m_format);
+	}
+}
+
+Texture::Ptr TextureFile::create() const
+{
+	const TextureImage* images = (const TextureImage*)m_file.data();
+	std::vector<const void*> data(m_imageCount);
+	size_t offset = 0;
+	for (uint32_t i = 0; i < m_imageCount; i++)
+	{
+		if (m_block == BlockFormat::None)
+			data[i] = m_file.data() + images[i].offset;
+		else
+			data[i] = m_decoded.data() + offset;
+		offset += (size_t)images[i].width * images[i].height * GraphicFormat::getPixelSize(m_format);
+	}
+	if (m_block != BlockFormat::None && m_decoded.size() != offset)
+		return nullptr;
+	if (m_type == TextureType::TextureCubeMap)
+		return LibraryLoader::createTextureCubeMap(images[0].width, images[0].height, data, m_format, m_flags);
+	if (m_type != TextureType::Texture2D)
+		return nullptr;
+	return LibraryLoader::createTexture2D(images[0].width, images[0].height, data, m_format, m_flags);
+}
+
+void TextureFile::read(TextureData& data) const
+{
+	const TextureImage* images = (const TextureImage*)m_file.data();
+	data.type = m_type;
+	data.format = m_format;
+	data.block = m_block;
+	data.flags = m_flags;
+	data.images.resize(m_imageCount);
+	for (uint32_t i = 0; i < m_imageCount; i++)
+	{
+		const uint8_t* bytes = m_file.data() + images[i].offset;
+		data.images[i].width = images[i].width;
+		data.images[i].height = images[i].height;
+		data.images[i].bytes.assign(bytes, bytes + images[i].size);
+	}
+}
+
+size_t TextureFile::size() const
+{
+	const TextureImage* images = (const TextureImage*)m_file.data();
+	size_t pixelSize = GraphicFormat::getPixelSize(m_format);
+	size_t size = 0;
+	for (uint32_t i = 0; images != nullptr && i < m_imageCount && i < m_file.size() / sizeof(TextureImage); i++)
+		size += (size_t)images[i].width * images[i].height * pixelSize;
+	return size;
+}
+
+};
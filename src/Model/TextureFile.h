@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include "PayloadFile.h"
+#include "BlockCompression.h"
+
+namespace app {
+
+// Images of a texture as stored in the library, pixels in their upload format or blocks of a block compressed format.
+// Images are bytes whatever the pixel type, so that halves of RGBA16F don't go through an 8 bits or float aka::Image.
+struct TextureData {
+	struct Image {
+		uint32_t width;
+		uint32_t height;
+		std::vector<uint8_t> bytes;
+	};
+	aka::TextureType type = aka::TextureType::Texture2D;
+	aka::TextureFormat format = aka::TextureFormat::RGBA8; // Uploaded format, decoded format of blocks
+	BlockFormat block = BlockFormat::None;
+	aka::TextureFlag flags = aka::TextureFlag::None;
+	std::vector<Image> images; // Level by level, with faces px, py, pz, nx, ny, nz of cubemaps within a level
+};
+
+// Library file of a 2D texture or cubemap with its stored levels.
+// The payload starts with a table of its images, level by level with faces px, py, pz, nx, ny, nz of cubemaps within a level,
+// followed by their aligned pixels or blocks. Files written before the header are Aka texture storages, they are only read by the library loader.
+class TextureFile
+{
+public:
+	// Write the images with their header, the payload compressed with codec
+	static bool save(const aka::Path& path, const TextureData& data, Codec codec = Codec::None);
+	// Read the images as stored, blocks are not decoded. False for files without header.
+	static bool load(const aka::Path& path, TextureData& data);
+
+	// Map the file, false if it can't be opened or has no header
+	bool open(const aka::Path& path);
+	void close();
+	// Chunks of a compressed payload to decompress before create & read, false if the payload is corrupted
+	bool split(std::vector<ChunkedPayload::Chunk>& chunks);
+	// Check the image table against the payload once decompressed, false if the file is corrupted
+	bool validate() const;
+	// Decode the blocks of a validated block compressed file to its format, on the calling thread.
+	// Aka has no block compressed texture format, blocks are uploaded decoded. Nothing to do for other files.
+	void decode();
+	// Create the texture from the validated & decoded payload, nothing is copied on the heap for raw payloads.
+	// Only 2D textures & cubemaps are supported, nullptr otherwise.
+	aka::Texture::Ptr create() const;
+	// Copy the validated images as stored
+	void read(TextureData& data) const;
+
+	Codec codec() const { return m_file.codec(); }
+	BlockFormat block() const { return m_block; }
+	// Bytes of every image once uploaded
+	size_t size() const;
+private:
+	PayloadFile m_file;
+	aka::TextureType m_type;
+	aka::TextureFormat m_format;
+	aka::TextureFlag m_flags;
+	BlockFormat m_block = BlockFormat::None;
+	uint32_t m_imageCount = 0;
+	std::vector<uint8_t> m_decoded; // Decoded images of block compressed files, tightly packed
+};
+
+};
@@ -0,0 +1,76 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace app {
+
+WorkerPool::WorkerPool() :
+	WorkerPool(std::max(1U, std::thread::hardware_concurrency()))
+{
+}
+
+WorkerPool::WorkerPool(uint32_t threadCount) :
+	m_pending(0),
+	m_stop(false)
+{
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&WorkerPool::run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_taskCondition.notify_all();
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void WorkerPool::push(std::function<void(void)>&& task)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push(std::move(task));
+		m_pending++;
+	}
+	m_taskCondition.notify_one();
+}
+
+void WorkerPool::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_pending == 0; });
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)>& callback)
+{
+	for (size_t i = 0; i < count; i++)
+		push([&callback, i]() { callback(i); });
+	wait();
+}
+
+void WorkerPool::run()
+{
+	while (true)
+	{
+		std::function<void(void)> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskCondition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+			if (m_stop && m_tasks.empty())
+				return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending--;
+		}
+		m_doneCondition.notify_all();
+	}
+}
+
+};
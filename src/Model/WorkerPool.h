@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Aka/Aka.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <queue>
+
+namespace app {
+
+// Pool of worker threads used to process assets in parallel.
+// Tasks are run outside of the main thread and must not create any graphic resources.
+class WorkerPool
+{
+public:
+	// Create a pool with one worker per hardware thread
+	WorkerPool();
+	WorkerPool(uint32_t threadCount);
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+	~WorkerPool();
+
+	// Push a task to be run by a worker
+	void push(std::function<void(void)>&& task);
+	// Wait for every pushed task to be completed
+	void wait();
+	// Run callback for every index in [0, count[ and wait for completion
+	void parallelFor(size_t count, const std::function<void(size_t)>& callback);
+
+	// Number of workers in the pool
+	uint32_t count() const { return (uint32_t)m_workers.size(); }
+private:
+	void run();
+private:
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void(void)>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_taskCondition;
+	std::condition_variable m_doneCondition;
+	size_t m_pending;
+	bool m_stop;
+};
+
+};
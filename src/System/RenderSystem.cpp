@@ -1,6 +1,14 @@
 #include "RenderSystem.h"
 
 #include "../Model/Model.h"
+#include "../Model/Environment.h"
+#include "../Model/MipChain.h"
+#include "../Model/Importer.h"
+#include "../Model/LibraryLoader.h"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
 
 namespace app {
 
@@ -32,6 +40,10 @@ struct alignas(16) CameraUniformBuffer {
 	alignas(16) mat4f viewInverse;
 	alignas(16) mat4f projectionInverse;
 };
+struct alignas(16) EnvironmentUniformBuffer {
+	alignas(16) vec4f irradiance[Environment::shCount];
+	alignas(4) float prefilteredLevel; // Level of roughness 1
+};
 struct alignas(16) ViewportUniformBuffer {
 	alignas(8) vec2f viewport;
 	alignas(8) vec2f rcp;
@@ -43,6 +55,48 @@ struct alignas(16) ModelUniformBuffer {
 	alignas(16) vec3f normalMatrix2;
 	alignas(16) color4f color;
 };
+static_assert(sizeof(ModelUniformBuffer) * InstancedComponent::batchSize <= InstancedComponent::maxUniformBlockSize, "Instance uniform block exceeds the guaranteed uniform block size");
+
+// Visible entity drawn on its own, sorted by program & material to bind material textures once per material,
+// then by mesh so that draws from the same shared buffers follow each other.
+struct GBufferDraw {
+	VertexLayout layout;
+	MaterialHandle material;
+	const Transform3DComponent* transform;
+	const MeshComponent* mesh;
+	SubMesh submesh; // Selected LOD, from the shared buffers if batched
+	bool meshlets; // Full resolution submesh is selected, meshlets can be culled
+	bool operator<(const GBufferDraw& rhs) const
+	{
+		if (layout != rhs.layout)
+			return layout < rhs.layout;
+		if (material != rhs.material)
+			return material < rhs.material;
+		return submesh.mesh.get() < rhs.submesh.mesh.get();
+	}
+};
+
+// Instances sharing a submesh & material, drawn in batches of InstancedComponent::batchSize.
+// Each instance has the layout of ModelUniformBuffer.
+struct InstanceBatch {
+	VertexLayout layout;
+	SubMesh submesh;
+	Buffer::Ptr quantization; // Of packed meshes
+	std::vector<ModelUniformBuffer> instances;
+};
+// Material first so that batches sharing a material are drawn one after the other.
+using InstanceBatchKey = std::tuple<MaterialHandle, const Mesh*, uint32_t, uint32_t>;
+
+// Bind textures of a material table entry to a gbuffer program
+static void bindMaterial(const Material::Ptr& material, const MaterialAsset& asset)
+{
+	material->set("u_materialTexture", asset.material.sampler);
+	material->set("u_materialTexture", asset.material.texture);
+	material->set("u_colorTexture", asset.albedo.sampler);
+	material->set("u_colorTexture", asset.albedo.texture);
+	material->set("u_normalTexture", asset.normal.sampler);
+	material->set("u_normalTexture", asset.normal.texture);
+}
 
 void RenderSystem::onCreate(aka::World& world)
 {
@@ -51,6 +105,13 @@ void RenderSystem::onCreate(aka::World& world)
 
 	ProgramManager* program = Application::program();
 	m_gbufferMaterial = Material::create(program->get("gbuffer"));
+	m_gbufferTangentMaterial = Material::create(program->get("gbufferTangent"));
+	m_gbufferPackedMaterial = Material::create(program->get("gbufferPacked"));
+	m_gbufferPackedColorMaterial = Material::create(program->get("gbufferPackedColor"));
+	m_gbufferInstancedMaterial = Material::create(program->get("gbufferInstanced"));
+	m_gbufferTangentInstancedMaterial = Material::create(program->get("gbufferTangentInstanced"));
+	m_gbufferPackedInstancedMaterial = Material::create(program->get("gbufferPackedInstanced"));
+	m_gbufferPackedColorInstancedMaterial = Material::create(program->get("gbufferPackedColorInstanced"));
 	m_pointMaterial = Material::create(program->get("point"));
 	m_dirMaterial = Material::create(program->get("directional"));
 	m_ambientMaterial = Material::create(program->get("ambient"));
@@ -64,6 +125,7 @@ void RenderSystem::onCreate(aka::World& world)
 	m_cameraUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(CameraUniformBuffer), BufferUsage::Default, BufferCPUAccess::None);
 	m_viewportUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(ViewportUniformBuffer), BufferUsage::Default, BufferCPUAccess::None);
 	m_modelUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(ModelUniformBuffer), BufferUsage::Default, BufferCPUAccess::None); // This one change a lot. use dynamic
+	m_instanceUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(ModelUniformBuffer) * InstancedComponent::batchSize, BufferUsage::Default, BufferCPUAccess::None);
 	m_pointLightUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(PointLightUniformBuffer), BufferUsage::Default, BufferCPUAccess::None); // This one change a lot.
 	m_directionalLightUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(DirectionalLightUniformBuffer), BufferUsage::Default, BufferCPUAccess::None); // This one change a lot.
 
@@ -99,15 +161,54 @@ void RenderSystem::onCreate(aka::World& world)
 		 60,  60,  60, 255,  60,  60,  60, 255,  60,  60,  60, 255,  60,  60,  60, 255,
 		 30,  30,  30, 255,  30,  30,  30, 255,  30,  30,  30, 255,  30,  30,  30, 255,
 	};
-	Texture2D::Ptr equirectangularMap = Texture2D::create(4, 8, TextureFormat::RGBA8, TextureFlag::ShaderResource, data);
-	m_skybox = TextureCubeMap::generate(512, 512, TextureFormat::RGBA8, TextureFlag::ShaderResource, equirectangularMap, TextureFilter::Linear);
+	// Cubemap & its environment lighting are converted once & loaded from the library while the source does not change.
+	Image equirectangular(4, 8, 4, ImageFormat::UnsignedByte);
+	memcpy(equirectangular.data(), data, sizeof(data));
+	Environment environment;
+	if (Importer::importTextureEquirectangular("skybox", equirectangular, false, 512, TextureFlag::ShaderResource | TextureFlag::GenerateMips, &environment))
+	{
+		m_skybox = Application::resource()->get<Texture>("skybox");
+	}
+	else
+	{
+		Logger::error("Failed to import skybox, generating it on GPU");
+		Texture2D::Ptr equirectangularMap = Texture2D::create(4, 8, TextureFormat::RGBA8, TextureFlag::ShaderResource, data);
+		m_skybox = TextureCubeMap::generate(512, 512, TextureFormat::RGBA8, TextureFlag::ShaderResource, equirectangularMap, TextureFilter::Linear);
+		std::vector<float> radiance(sizeof(data));
+		for (size_t i = 0; i < radiance.size(); i++)
+			radiance[i] = (i % 4 == 3) ? data[i] / 255.f : MipChain::srgbToLinear(data[i] / 255.f);
+		environment = Environment::compute(radiance.data(), 4, 8);
+	}
 	m_skyboxSampler.filterMag = TextureFilter::Linear;
 	m_skyboxSampler.filterMin = TextureFilter::Linear;
+	m_skyboxSampler.mipmapMode = TextureMipMapMode::Linear;
 	m_skyboxSampler.wrapU = TextureWrap::ClampToEdge;
 	m_skyboxSampler.wrapV = TextureWrap::ClampToEdge;
 	m_skyboxSampler.wrapW = TextureWrap::ClampToEdge;
 	m_skyboxSampler.anisotropy = 1.f;
 
+	// --- Environment lighting of the skybox, precomputed by its import
+	TextureFlag prefilteredFlags = LibraryLoader::getLevelFlags(TextureFlag::ShaderResource, environment.prefiltered.size());
+	m_prefiltered = Texture2D::create(Environment::prefilteredWidth, Environment::prefilteredWidth / 2, TextureFormat::RGBA32F, prefilteredFlags, nullptr);
+	for (uint32_t level = 0; level < environment.prefiltered.size(); level++)
+		m_prefiltered->upload(environment.prefiltered[level].data(), level);
+	m_brdf = Texture2D::create(Environment::brdfSize, Environment::brdfSize, TextureFormat::RGBA32F, TextureFlag::ShaderResource, environment.brdf.data());
+	EnvironmentUniformBuffer environmentUBO;
+	for (uint32_t i = 0; i < Environment::shCount; i++)
+		environmentUBO.irradiance[i] = environment.sh[i];
+	environmentUBO.prefilteredLevel = (float)(Environment::roughnessLevelCount - 1);
+	m_environmentUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(EnvironmentUniformBuffer), BufferUsage::Immutable, BufferCPUAccess::None, &environmentUBO);
+	m_environmentSampler.filterMag = TextureFilter::Linear;
+	m_environmentSampler.filterMin = TextureFilter::Linear;
+	m_environmentSampler.mipmapMode = TextureMipMapMode::Linear;
+	m_environmentSampler.wrapU = TextureWrap::Repeat;
+	m_environmentSampler.wrapV = TextureWrap::ClampToEdge;
+	m_environmentSampler.wrapW = TextureWrap::ClampToEdge;
+	m_environmentSampler.anisotropy = 1.f;
+	m_brdfSampler = m_environmentSampler;
+	m_brdfSampler.mipmapMode = TextureMipMapMode::None;
+	m_brdfSampler.wrapU = TextureWrap::ClampToEdge;
+
 	float skyboxVertices[] = {
 		-1.0f,  1.0f, -1.0f,
 		-1.0f, -1.0f, -1.0f,
@@ -166,6 +267,14 @@ void RenderSystem::onDestroy(aka::World& world)
 	m_material.reset();
 	m_gbuffer.reset();
 	m_gbufferMaterial.reset();
+	m_gbufferTangentMaterial.reset();
+	m_gbufferPackedMaterial.reset();
+	m_gbufferPackedColorMaterial.reset();
+	m_instanceUniformBuffer.reset();
+	m_gbufferInstancedMaterial.reset();
+	m_gbufferTangentInstancedMaterial.reset();
+	m_gbufferPackedInstancedMaterial.reset();
+	m_gbufferPackedColorInstancedMaterial.reset();
 
 	// Lighing pass
 	m_quad.reset();
@@ -178,6 +287,9 @@ void RenderSystem::onDestroy(aka::World& world)
 	m_cube.reset();
 	m_skybox.reset();
 	m_skyboxMaterial.reset();
+	m_prefiltered.reset();
+	m_brdf.reset();
+	m_environmentUniformBuffer.reset();
 
 	// Post process pass
 	m_storageDepth.reset();
@@ -199,7 +311,19 @@ void RenderSystem::onRender(aka::World& world)
 	// --- Update Uniforms
 	m_gbufferMaterial->set("ModelUniformBuffer", m_modelUniformBuffer);
 	m_gbufferMaterial->set("CameraUniformBuffer", m_cameraUniformBuffer);
+	m_gbufferTangentMaterial->set("ModelUniformBuffer", m_modelUniformBuffer);
+	m_gbufferTangentMaterial->set("CameraUniformBuffer", m_cameraUniformBuffer);
+	m_gbufferPackedMaterial->set("ModelUniformBuffer", m_modelUniformBuffer);
+	m_gbufferPackedMaterial->set("CameraUniformBuffer", m_cameraUniformBuffer);
+	m_gbufferPackedColorMaterial->set("ModelUniformBuffer", m_modelUniformBuffer);
+	m_gbufferPackedColorMaterial->set("CameraUniformBuffer", m_cameraUniformBuffer);
+	for (const Material::Ptr& material : { m_gbufferInstancedMaterial, m_gbufferTangentInstancedMaterial, m_gbufferPackedInstancedMaterial, m_gbufferPackedColorInstancedMaterial })
+	{
+		material->set("InstanceUniformBuffer", m_instanceUniformBuffer);
+		material->set("CameraUniformBuffer", m_cameraUniformBuffer);
+	}
 	m_ambientMaterial->set("CameraUniformBuffer", m_cameraUniformBuffer);
+	m_ambientMaterial->set("EnvironmentUniformBuffer", m_environmentUniformBuffer);
 	m_dirMaterial->set("CameraUniformBuffer", m_cameraUniformBuffer);
 	m_dirMaterial->set("DirectionalLightUniformBuffer", m_directionalLightUniformBuffer);
 	m_pointMaterial->set("PointLightUniformBuffer", m_pointLightUniformBuffer);
@@ -241,13 +365,76 @@ void RenderSystem::onRender(aka::World& world)
 
 	m_gbuffer->clear(color4f(0.f), 1.f, 0, ClearMask::All);
 
-	renderableView.each([&](const Transform3DComponent& transform, const MeshComponent& mesh, const MaterialComponent& material) {
-		frustum<>::planes p = frustum<>::extract(projection * view);
+	// LOD selection parameters
+	point3f eye = point3f(cameraUBO.viewInverse.cols[3]);
+	float pixelsPerUnit = projection.cols[1].y * backbuffer->height() * 0.5f;
+
+	const MaterialTable& materials = Scene::getMaterials(world);
+	const MeshBatchTable& batches = Scene::getMeshBatches(world);
+	frustum<>::planes p = frustum<>::extract(projection * view);
+	std::vector<GBufferDraw> draws;
+	std::map<InstanceBatchKey, InstanceBatch> instanceBatches;
+	renderableView.each([&](entt::entity entity, const Transform3DComponent& transform, const MeshComponent& mesh, const MaterialComponent& material) {
 		// Check intersection in camera space
 		// https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
 		if (!p.intersect(transform.transform * mesh.bounds))
 			return;
+		if (!materials.valid(material.material))
+			return;
+
+		// Packed meshes are drawn with their own program & dequantized with the quantization of the mesh.
+		VertexLayout layout = Scene::getVertexLayout(mesh.submesh.mesh);
+		if ((layout == VertexLayout::Packed || layout == VertexLayout::PackedColor) && mesh.quantization == nullptr)
+			return;
+		const SubMesh& lod = Scene::selectLod(mesh, transform.transform, eye, pixelsPerUnit, 1.f);
+		SubMesh submesh = batches.get(lod);
 
+		// Instances are gathered per LOD & material and drawn afterward.
+		if (world.registry().has<InstancedComponent>(entity))
+		{
+			InstanceBatchKey key(material.material, submesh.mesh.get(), submesh.offset, submesh.count);
+			InstanceBatch& batch = instanceBatches[key];
+			if (batch.instances.empty())
+			{
+				batch.layout = layout;
+				batch.submesh = submesh;
+				batch.quantization = mesh.quantization;
+			}
+			ModelUniformBuffer instance;
+			instance.model = transform.transform;
+			mat3f normalMatrix = mat3f::transpose(mat3f::inverse(mat3f(transform.transform)));
+			instance.normalMatrix0 = vec3f(normalMatrix[0]);
+			instance.normalMatrix1 = vec3f(normalMatrix[1]);
+			instance.normalMatrix2 = vec3f(normalMatrix[2]);
+			instance.color = materials.get(material.material).color;
+			batch.instances.push_back(instance);
+			return;
+		}
+		draws.push_back(GBufferDraw{ layout, material.material, &transform, &mesh, submesh, &lod == &mesh.submesh });
+	});
+
+	// Textures are only bound when the program or the material changes.
+	std::sort(draws.begin(), draws.end());
+	const GBufferDraw* previous = nullptr;
+	for (const GBufferDraw& draw : draws)
+	{
+		const MaterialAsset& material = materials.get(draw.material);
+		if (previous == nullptr || previous->layout != draw.layout || previous->material != draw.material)
+		{
+			switch (draw.layout)
+			{
+			default:
+			case VertexLayout::Default: gbufferPass.material = m_gbufferMaterial; break;
+			case VertexLayout::Tangent: gbufferPass.material = m_gbufferTangentMaterial; break;
+			case VertexLayout::Packed: gbufferPass.material = m_gbufferPackedMaterial; break;
+			case VertexLayout::PackedColor: gbufferPass.material = m_gbufferPackedColorMaterial; break;
+			}
+			bindMaterial(gbufferPass.material, material);
+		}
+		previous = &draw;
+
+		const Transform3DComponent& transform = *draw.transform;
+		const MeshComponent& mesh = *draw.mesh;
 		ModelUniformBuffer modelUBO;
 		modelUBO.model = transform.transform;
 		mat3f normalMatrix = mat3f::transpose(mat3f::inverse(mat3f(transform.transform)));
@@ -256,18 +443,68 @@ void RenderSystem::onRender(aka::World& world)
 		modelUBO.normalMatrix2 = vec3f(normalMatrix[2]);
 		modelUBO.color = material.color;
 		m_modelUniformBuffer->upload(&modelUBO);
+		if (mesh.quantization != nullptr)
+			gbufferPass.material->set("QuantizationUniformBuffer", mesh.quantization);
 
-		gbufferPass.material->set("u_materialTexture", material.material.sampler);
-		gbufferPass.material->set("u_materialTexture", material.material.texture);
-		gbufferPass.material->set("u_colorTexture", material.albedo.sampler);
-		gbufferPass.material->set("u_colorTexture", material.albedo.texture);
-		gbufferPass.material->set("u_normalTexture", material.normal.sampler);
-		gbufferPass.material->set("u_normalTexture", material.normal.texture);
-
-		gbufferPass.submesh = mesh.submesh;
+		const SubMesh& submesh = draw.submesh;
+		gbufferPass.submesh = submesh;
+		if (!draw.meshlets || mesh.meshlets.size() <= 1)
+		{
+			gbufferPass.execute();
+			continue;
+		}
+		// Cull meshlets of full resolution mesh, merging contiguous visible ones in a single draw.
+		// Back faces of double sided materials are visible, only frustum culling applies.
+		uint32_t count = 0;
+		for (const Meshlet& meshlet : mesh.meshlets)
+		{
+			if (Scene::cullMeshlet(meshlet, p, transform.transform, eye, !material.doubleSided))
+				continue;
+			if (count > 0 && gbufferPass.submesh.offset + count == submesh.offset + meshlet.indexOffset)
+			{
+				count += meshlet.indexCount;
+				continue;
+			}
+			if (count > 0)
+			{
+				gbufferPass.submesh.count = count;
+				gbufferPass.execute();
+			}
+			gbufferPass.submesh.offset = submesh.offset + meshlet.indexOffset;
+			count = meshlet.indexCount;
+		}
+		if (count > 0)
+		{
+			gbufferPass.submesh.count = count;
+			gbufferPass.execute();
+		}
+	}
 
-		gbufferPass.execute();
-	});
+	// Instanced draws, one per batch of instances.
+	for (std::pair<const InstanceBatchKey, InstanceBatch>& pair : instanceBatches)
+	{
+		InstanceBatch& batch = pair.second;
+		switch (batch.layout)
+		{
+		default:
+		case VertexLayout::Default: gbufferPass.material = m_gbufferInstancedMaterial; break;
+		case VertexLayout::Tangent: gbufferPass.material = m_gbufferTangentInstancedMaterial; break;
+		case VertexLayout::Packed: gbufferPass.material = m_gbufferPackedInstancedMaterial; break;
+		case VertexLayout::PackedColor: gbufferPass.material = m_gbufferPackedColorInstancedMaterial; break;
+		}
+		bindMaterial(gbufferPass.material, materials.get(std::get<0>(pair.first)));
+		if (batch.quantization != nullptr)
+			gbufferPass.material->set("QuantizationUniformBuffer", batch.quantization);
+		gbufferPass.submesh = batch.submesh;
+		// Pad to whole batches as the instance buffer is uploaded entirely.
+		size_t instanceCount = batch.instances.size();
+		batch.instances.resize((instanceCount + InstancedComponent::batchSize - 1) / InstancedComponent::batchSize * InstancedComponent::batchSize);
+		for (size_t first = 0; first < instanceCount; first += InstancedComponent::batchSize)
+		{
+			m_instanceUniformBuffer->upload(&batch.instances[first]);
+			gbufferPass.execute((uint32_t)min(instanceCount - first, (size_t)InstancedComponent::batchSize));
+		}
+	}
 
 	// --- Lighting pass
 	static const mat4f projectionToTextureCoordinateMatrix(
@@ -305,8 +542,11 @@ void RenderSystem::onRender(aka::World& world)
 	lightingPass.material->set("u_positionTexture", m_position);
 	lightingPass.material->set("u_albedoTexture", m_albedo);
 	lightingPass.material->set("u_normalTexture", m_normal);
-	//lightingPass.material->set<Texture::Ptr>("u_materialTexture", m_material);
-	lightingPass.material->set("u_skyboxTexture", m_skybox);
+	lightingPass.material->set("u_materialTexture", m_material);
+	lightingPass.material->set("u_prefilteredTexture", m_environmentSampler);
+	lightingPass.material->set("u_prefilteredTexture", m_prefiltered);
+	lightingPass.material->set("u_brdfTexture", m_brdfSampler);
+	lightingPass.material->set("u_brdfTexture", m_brdf);
 
 	lightingPass.execute();
 
@@ -540,6 +780,20 @@ void RenderSystem::onReceive(const aka::ProgramReloadedEvent& e)
 {
 	if (e.name == "gbuffer")
 		m_gbufferMaterial = Material::create(e.program);
+	else if (e.name == "gbufferTangent")
+		m_gbufferTangentMaterial = Material::create(e.program);
+	else if (e.name == "gbufferPacked")
+		m_gbufferPackedMaterial = Material::create(e.program);
+	else if (e.name == "gbufferPackedColor")
+		m_gbufferPackedColorMaterial = Material::create(e.program);
+	else if (e.name == "gbufferInstanced")
+		m_gbufferInstancedMaterial = Material::create(e.program);
+	else if (e.name == "gbufferTangentInstanced")
+		m_gbufferTangentInstancedMaterial = Material::create(e.program);
+	else if (e.name == "gbufferPackedInstanced")
+		m_gbufferPackedInstancedMaterial = Material::create(e.program);
+	else if (e.name == "gbufferPackedColorInstanced")
+		m_gbufferPackedColorInstancedMaterial = Material::create(e.program);
 	else if (e.name == "point")
 		m_pointMaterial = Material::create(e.program);
 	else if (e.name == "directional")
@@ -43,6 +43,14 @@ private:
 	aka::Texture2D::Ptr m_material;
 	aka::Framebuffer::Ptr m_gbuffer;
 	aka::Material::Ptr m_gbufferMaterial;
+	aka::Material::Ptr m_gbufferTangentMaterial;
+	aka::Material::Ptr m_gbufferPackedMaterial;
+	aka::Material::Ptr m_gbufferPackedColorMaterial;
+	aka::Buffer::Ptr m_instanceUniformBuffer;
+	aka::Material::Ptr m_gbufferInstancedMaterial;
+	aka::Material::Ptr m_gbufferTangentInstancedMaterial;
+	aka::Material::Ptr m_gbufferPackedInstancedMaterial;
+	aka::Material::Ptr m_gbufferPackedColorInstancedMaterial;
 
 	// Lighing pass
 	aka::Mesh::Ptr m_quad;
@@ -54,10 +62,17 @@ private:
 
 	// Skybox
 	aka::Mesh::Ptr m_cube;
-	aka::TextureCubeMap::Ptr m_skybox;
+	aka::Texture::Ptr m_skybox;
 	aka::TextureSampler m_skyboxSampler;
 	aka::Material::Ptr m_skyboxMaterial;
 
+	// Environment lighting
+	aka::Texture2D::Ptr m_prefiltered;
+	aka::Texture2D::Ptr m_brdf;
+	aka::TextureSampler m_environmentSampler;
+	aka::TextureSampler m_brdfSampler;
+	aka::Buffer::Ptr m_environmentUniformBuffer;
+
 	// Text pass
 	aka::Material::Ptr m_textMaterial;
 
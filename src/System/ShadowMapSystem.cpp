@@ -2,13 +2,113 @@
 
 #include "../Model/Model.h"
 
+#include <map>
+#include <tuple>
+
 namespace app {
 
 using namespace aka;
 
+bool ShadowMapSystem::depthStreams = true;
+static ShadowPassStats shadowStats;
+
+const ShadowPassStats& ShadowMapSystem::stats()
+{
+	return shadowStats;
+}
+
+// Draw the submesh of the pass & count it in the stats
+static void drawShadow(RenderPass& pass, uint32_t instanceCount = 1)
+{
+	pass.execute(instanceCount);
+	shadowStats.drawCount++;
+	shadowStats.triangleCount += (size_t)pass.submesh.count / 3 * instanceCount;
+	shadowStats.vertexBytes += (size_t)pass.submesh.count * pass.submesh.mesh->getVertexBuffer(0).stride * instanceCount;
+}
+
+// Full vertex layout submesh of a depth LOD when position only streams are disabled
+static const SubMesh& getShadowLod(const StaticMeshComponent& mesh, const SubMesh& lod)
+{
+	if (ShadowMapSystem::depthStreams || mesh.depth.mesh == nullptr)
+		return lod;
+	if (&lod == &mesh.depth)
+		return mesh.submesh;
+	return mesh.lods[&lod - mesh.depthLods];
+}
+
 struct alignas(16) LightModelUniformBuffer {
 	alignas(16) mat4f model;
 };
+static_assert(sizeof(LightModelUniformBuffer) * InstancedComponent::batchSize <= InstancedComponent::maxUniformBlockSize, "Instance uniform block exceeds the guaranteed uniform block size");
+
+// Instances sharing a submesh, drawn in batches of InstancedComponent::batchSize.
+struct ShadowInstanceBatch {
+	bool packed;
+	SubMesh submesh;
+	Buffer::Ptr quantization; // Of packed meshes
+	std::vector<LightModelUniformBuffer> models;
+};
+using ShadowInstanceBatchKey = std::tuple<const Mesh*, uint32_t, uint32_t>;
+
+static void drawInstances(RenderPass& pass, std::map<ShadowInstanceBatchKey, ShadowInstanceBatch>& batches, const Buffer::Ptr& instanceUniformBuffer, const Material::Ptr& material, const Material::Ptr& packedMaterial)
+{
+	for (std::pair<const ShadowInstanceBatchKey, ShadowInstanceBatch>& pair : batches)
+	{
+		ShadowInstanceBatch& batch = pair.second;
+		pass.material = batch.packed ? packedMaterial : material;
+		if (batch.packed)
+			pass.material->set("QuantizationUniformBuffer", batch.quantization);
+		pass.submesh = batch.submesh;
+		// Pad to whole batches as the instance buffer is uploaded entirely.
+		size_t instanceCount = batch.models.size();
+		batch.models.resize((instanceCount + InstancedComponent::batchSize - 1) / InstancedComponent::batchSize * InstancedComponent::batchSize);
+		for (size_t first = 0; first < instanceCount; first += InstancedComponent::batchSize)
+		{
+			instanceUniformBuffer->upload(&batch.models[first]);
+			drawShadow(pass, (uint32_t)min(instanceCount - first, (size_t)InstancedComponent::batchSize));
+		}
+	}
+	batches.clear();
+}
+
+static void addInstance(std::map<ShadowInstanceBatchKey, ShadowInstanceBatch>& batches, const SubMesh& submesh, VertexLayout layout, const Buffer::Ptr& quantization, const mat4f& model)
+{
+	ShadowInstanceBatch& batch = batches[ShadowInstanceBatchKey(submesh.mesh.get(), submesh.offset, submesh.count)];
+	batch.packed = (layout == VertexLayout::Packed || layout == VertexLayout::PackedColor);
+	batch.submesh = submesh;
+	batch.quantization = quantization;
+	batch.models.push_back(LightModelUniformBuffer{ model });
+}
+
+// Draw the full resolution submesh of a mesh meshlet by meshlet, skipping the ones outside the light frustum.
+// Only frustum culling applies, directional lights have no eye point to test backface cones against.
+static void drawMeshlets(RenderPass& pass, const SubMesh& submesh, const StaticMeshComponent& mesh, const frustum<>::planes& planes, const mat4f& transform)
+{
+	pass.submesh = submesh;
+	uint32_t count = 0;
+	for (const Meshlet& meshlet : mesh.meshlets)
+	{
+		if (Scene::cullMeshlet(meshlet, planes, transform, point3f(0.f), false))
+			continue;
+		if (count > 0 && pass.submesh.offset + count == submesh.offset + meshlet.indexOffset)
+		{
+			count += meshlet.indexCount;
+			continue;
+		}
+		if (count > 0)
+		{
+			pass.submesh.count = count;
+			drawShadow(pass);
+		}
+		pass.submesh.offset = submesh.offset + meshlet.indexOffset;
+		count = meshlet.indexCount;
+	}
+	if (count > 0)
+	{
+		pass.submesh.count = count;
+		drawShadow(pass);
+	}
+}
 
 struct alignas(16) DirectionalLightUniformBuffer {
 	alignas(16) mat4f light;
@@ -53,6 +153,12 @@ void ShadowMapSystem::onCreate(aka::World& world)
 	ProgramManager* program = Application::program();
 	m_shadowMaterial = Material::create(program->get("shadowDirectional"));
 	m_shadowPointMaterial = Material::create(program->get("shadowPoint"));
+	m_shadowPackedMaterial = Material::create(program->get("shadowDirectionalPacked"));
+	m_shadowPointPackedMaterial = Material::create(program->get("shadowPointPacked"));
+	m_shadowInstancedMaterial = Material::create(program->get("shadowDirectionalInstanced"));
+	m_shadowPointInstancedMaterial = Material::create(program->get("shadowPointInstanced"));
+	m_shadowPackedInstancedMaterial = Material::create(program->get("shadowDirectionalPackedInstanced"));
+	m_shadowPointPackedInstancedMaterial = Material::create(program->get("shadowPointPackedInstanced"));
 
 	GraphicDevice* device = Application::graphic();
 	Backbuffer::Ptr backbuffer = device->backbuffer();
@@ -62,6 +168,7 @@ void ShadowMapSystem::onCreate(aka::World& world)
 	};
 	m_shadowFramebuffer = Framebuffer::create(shadowAttachments, 1);
 	m_modelUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(LightModelUniformBuffer), BufferUsage::Default, BufferCPUAccess::None);
+	m_instanceUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(LightModelUniformBuffer) * InstancedComponent::batchSize, BufferUsage::Default, BufferCPUAccess::None);
 	m_pointLightUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(PointLightUniformBuffer), BufferUsage::Default, BufferCPUAccess::None);
 	m_directionalLightUniformBuffer = Buffer::create(BufferType::Uniform, sizeof(DirectionalLightUniformBuffer), BufferUsage::Default, BufferCPUAccess::None);
 
@@ -130,15 +237,38 @@ void ShadowMapSystem::onRender(aka::World& world)
 	// TODO near far as ortho aswell
 	CameraPerspective* perspective = dynamic_cast<CameraPerspective*>(camera.projection.get());
 	AKA_ASSERT(perspective != nullptr, "Only support perspective camera for now.");
+	// Shadows are less sensitive to geometric detail, select coarser LODs than the main view.
+	// LODs are selected from the light as shadow maps are only rendered again when the light is dirty.
+	static const float shadowLodBias = 2.f;
 
 	m_shadowPointMaterial->set("LightModelUniformBuffer", m_modelUniformBuffer);
 	m_shadowPointMaterial->set("PointLightUniformBuffer", m_pointLightUniformBuffer);
 	m_shadowMaterial->set("LightModelUniformBuffer", m_modelUniformBuffer);
 	m_shadowMaterial->set("DirectionalLightUniformBuffer", m_directionalLightUniformBuffer);
+	m_shadowPointPackedMaterial->set("LightModelUniformBuffer", m_modelUniformBuffer);
+	m_shadowPointPackedMaterial->set("PointLightUniformBuffer", m_pointLightUniformBuffer);
+	m_shadowPackedMaterial->set("LightModelUniformBuffer", m_modelUniformBuffer);
+	m_shadowPackedMaterial->set("DirectionalLightUniformBuffer", m_directionalLightUniformBuffer);
+	for (const Material::Ptr& material : { m_shadowPointInstancedMaterial, m_shadowPointPackedInstancedMaterial })
+	{
+		material->set("LightInstanceUniformBuffer", m_instanceUniformBuffer);
+		material->set("PointLightUniformBuffer", m_pointLightUniformBuffer);
+	}
+	for (const Material::Ptr& material : { m_shadowInstancedMaterial, m_shadowPackedInstancedMaterial })
+	{
+		material->set("LightInstanceUniformBuffer", m_instanceUniformBuffer);
+		material->set("DirectionalLightUniformBuffer", m_directionalLightUniformBuffer);
+	}
+	std::map<ShadowInstanceBatchKey, ShadowInstanceBatch> instanceBatches;
+	const MeshBatchTable& batches = Scene::getMeshBatches(world);
 
 	// --- Shadow map system
 	auto pointLightUpdate = world.registry().view<DirtyLightComponent, PointLightComponent>();
 	auto dirLightUpdate = world.registry().view<DirtyLightComponent, DirectionalLightComponent>();
+	if (pointLightUpdate.begin() == pointLightUpdate.end() && dirLightUpdate.begin() == dirLightUpdate.end())
+		return;
+	Time start = Time::now();
+	shadowStats = ShadowPassStats{};
 	for (entt::entity e : pointLightUpdate)
 	{
 		Transform3DComponent& lightTransform = world.registry().get<Transform3DComponent>(e);
@@ -147,6 +277,8 @@ void ShadowMapSystem::onRender(aka::World& world)
 		// Generate shadow cascades
 		mat4f shadowProjection = mat4f::perspective(anglef::degree(90.f), 1.f, 0.1f, light.radius);
 		point3f lightPos = point3f(lightTransform.transform.cols[3]);
+		// Faces have a 90 degrees field of view
+		float pixelsPerUnit = light.shadowMap->height() * 0.5f;
 		light.worldToLightSpaceMatrix[0] = shadowProjection * mat4f::lookAtView(lightPos, lightPos + vec3f(1.0, 0.0, 0.0), norm3f(0.0, -1.0, 0.0));
 		light.worldToLightSpaceMatrix[1] = shadowProjection * mat4f::lookAtView(lightPos, lightPos + vec3f(-1.0, 0.0, 0.0), norm3f(0.0, -1.0, 0.0));
 		light.worldToLightSpaceMatrix[2] = shadowProjection * mat4f::lookAtView(lightPos, lightPos + vec3f(0.0, 1.0, 0.0), norm3f(0.0, 0.0, 1.0));
@@ -179,14 +311,37 @@ void ShadowMapSystem::onRender(aka::World& world)
 			// Set output target and clear it.
 			shadowPass.framebuffer->set(AttachmentType::Depth, light.shadowMap, AttachmentFlag::None, i);
 			m_shadowFramebuffer->clear(color4f(1.f), 1.f, 0, ClearMask::Depth);
-			view.each([&](const Transform3DComponent& transform, const MeshComponent& mesh) {
+			frustum<>::planes p = frustum<>::extract(light.worldToLightSpaceMatrix[i]);
+			view.each([&](entt::entity entity, const Transform3DComponent& transform, const MeshComponent& mesh) {
+				VertexLayout layout = Scene::getVertexLayout(mesh.submesh.mesh);
+				bool packed = (layout == VertexLayout::Packed || layout == VertexLayout::PackedColor);
+				if (packed && mesh.quantization == nullptr)
+					return;
+				const SubMesh& lod = getShadowLod(mesh, Scene::selectDepthLod(mesh, transform.transform, lightPos, pixelsPerUnit, shadowLodBias));
+				SubMesh submesh = batches.get(lod);
+				if (world.registry().has<InstancedComponent>(entity))
+				{
+					addInstance(instanceBatches, submesh, layout, mesh.quantization, transform.transform);
+					return;
+				}
+				shadowPass.material = packed ? m_shadowPointPackedMaterial : m_shadowPointMaterial;
+				if (packed)
+					shadowPass.material->set("QuantizationUniformBuffer", mesh.quantization);
 				modelUBO.model = transform.transform;
 				m_modelUniformBuffer->upload(&modelUBO);
-				shadowPass.submesh = mesh.submesh;
-				shadowPass.execute();
+				// Position only streams share the index buffer of the full resolution submesh, and so its meshlets.
+				if ((&lod == &mesh.submesh || &lod == &mesh.depth) && mesh.meshlets.size() > 1)
+				{
+					drawMeshlets(shadowPass, submesh, mesh, p, transform.transform);
+					return;
+				}
+				shadowPass.submesh = submesh;
+				drawShadow(shadowPass);
 			});
+			drawInstances(shadowPass, instanceBatches, m_instanceUniformBuffer, m_shadowPointInstancedMaterial, m_shadowPointPackedInstancedMaterial);
 		}
 		world.registry().remove<DirtyLightComponent>(e);
+		shadowStats.lightCount++;
 	}
 
 	for (entt::entity e : dirLightUpdate)
@@ -224,21 +379,47 @@ void ShadowMapSystem::onRender(aka::World& world)
 			DirectionalLightUniformBuffer lightUBO;
 			lightUBO.light = light.worldToLightSpaceMatrix[i];
 			m_directionalLightUniformBuffer->upload(&lightUBO);
+			// Cascades are orthographic, the first row of the matrix scales world units to half the map.
+			const mat4f& lightMatrix = light.worldToLightSpaceMatrix[i];
+			float texelsPerUnit = vec3f(lightMatrix.cols[0].x, lightMatrix.cols[1].x, lightMatrix.cols[2].x).norm() * light.shadowMap[i]->width() * 0.5f;
 
 			LightModelUniformBuffer modelUBO;
 			auto view = world.registry().view<Transform3DComponent, MeshComponent>();
-			view.each([&](const Transform3DComponent& transform, const MeshComponent& mesh) {
-				frustum<>::planes p = frustum<>::extract(light.worldToLightSpaceMatrix[i]);
+			frustum<>::planes p = frustum<>::extract(light.worldToLightSpaceMatrix[i]);
+			view.each([&](entt::entity entity, const Transform3DComponent& transform, const MeshComponent& mesh) {
 				if (!p.intersect(transform.transform * mesh.bounds))
 					return;
+				VertexLayout layout = Scene::getVertexLayout(mesh.submesh.mesh);
+				bool packed = (layout == VertexLayout::Packed || layout == VertexLayout::PackedColor);
+				if (packed && mesh.quantization == nullptr)
+					return;
+				const SubMesh& lod = getShadowLod(mesh, Scene::selectDepthLod(mesh, transform.transform, texelsPerUnit, shadowLodBias));
+				SubMesh submesh = batches.get(lod);
+				if (world.registry().has<InstancedComponent>(entity))
+				{
+					addInstance(instanceBatches, submesh, layout, mesh.quantization, transform.transform);
+					return;
+				}
+				shadowPass.material = packed ? m_shadowPackedMaterial : m_shadowMaterial;
+				if (packed)
+					shadowPass.material->set("QuantizationUniformBuffer", mesh.quantization);
 				modelUBO.model = transform.transform;
 				m_modelUniformBuffer->upload(&modelUBO);
-				shadowPass.submesh = mesh.submesh;
-				shadowPass.execute();
+				// Position only streams share the index buffer of the full resolution submesh, and so its meshlets.
+				if ((&lod == &mesh.submesh || &lod == &mesh.depth) && mesh.meshlets.size() > 1)
+				{
+					drawMeshlets(shadowPass, submesh, mesh, p, transform.transform);
+					return;
+				}
+				shadowPass.submesh = submesh;
+				drawShadow(shadowPass);
 			});
+			drawInstances(shadowPass, instanceBatches, m_instanceUniformBuffer, m_shadowInstancedMaterial, m_shadowPackedInstancedMaterial);
 		}
 		world.registry().remove<DirtyLightComponent>(e);
+		shadowStats.lightCount++;
 	}
+	shadowStats.cpuTime = (Time::now() - start).milliseconds();
 }
 
 void ShadowMapSystem::onReceive(const ProgramReloadedEvent& e)
@@ -247,6 +428,18 @@ void ShadowMapSystem::onReceive(const ProgramReloadedEvent& e)
 		m_shadowMaterial = Material::create(e.program);
 	else if (e.name == "shadowPoint")
 		m_shadowPointMaterial = Material::create(e.program);
+	else if (e.name == "shadowDirectionalPacked")
+		m_shadowPackedMaterial = Material::create(e.program);
+	else if (e.name == "shadowPointPacked")
+		m_shadowPointPackedMaterial = Material::create(e.program);
+	else if (e.name == "shadowDirectionalInstanced")
+		m_shadowInstancedMaterial = Material::create(e.program);
+	else if (e.name == "shadowPointInstanced")
+		m_shadowPointInstancedMaterial = Material::create(e.program);
+	else if (e.name == "shadowDirectionalPackedInstanced")
+		m_shadowPackedInstancedMaterial = Material::create(e.program);
+	else if (e.name == "shadowPointPackedInstanced")
+		m_shadowPointPackedInstancedMaterial = Material::create(e.program);
 }
 
 };
@@ -6,6 +6,15 @@
 
 namespace app {
 
+// Cost of the last shadow maps update, counted on the CPU as Aka has no GPU timer queries.
+struct ShadowPassStats {
+	uint32_t lightCount = 0;
+	uint32_t drawCount = 0;
+	size_t triangleCount = 0;
+	size_t vertexBytes = 0; // Indices drawn times the stride of the position stream, bytes fetched before the vertex cache
+	size_t cpuTime = 0; // Milliseconds spent recording the passes
+};
+
 class ShadowMapSystem : 
 	public aka::System,
 	public aka::EventListener<aka::ProgramReloadedEvent>
@@ -17,10 +26,21 @@ public:
 	void onRender(aka::World& world) override;
 
 	void onReceive(const aka::ProgramReloadedEvent& e) override;
+
+	// Draw position only streams when meshes have them, disabled to compare the cost of the full vertex layout
+	static bool depthStreams;
+	static const ShadowPassStats& stats();
 private:
 	aka::Framebuffer::Ptr m_shadowFramebuffer;
 	aka::Material::Ptr m_shadowMaterial;
 	aka::Material::Ptr m_shadowPointMaterial;
+	aka::Material::Ptr m_shadowPackedMaterial;
+	aka::Material::Ptr m_shadowPointPackedMaterial;
+	aka::Material::Ptr m_shadowInstancedMaterial;
+	aka::Material::Ptr m_shadowPointInstancedMaterial;
+	aka::Material::Ptr m_shadowPackedInstancedMaterial;
+	aka::Material::Ptr m_shadowPointPackedInstancedMaterial;
+	aka::Buffer::Ptr m_instanceUniformBuffer;
 	aka::Buffer::Ptr m_modelUniformBuffer;
 	aka::Buffer::Ptr m_pointLightUniformBuffer;
 	aka::Buffer::Ptr m_directionalLightUniformBuffer;
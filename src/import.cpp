@@ -0,0 +1,499 @@
+#include "Model/Importer.h"
+#include "Model/ImportCache.h"
+#include "Model/WorkerPool.h"
+#include "Model/BufferFile.h"
+#include "Model/TextureFile.h"
+#include "Model/GLTF.h"
+
+#include <filesystem>
+#include <chrono>
+#include <atomic>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+struct Settings {
+	uint32_t jobs;
+	aka::String directory;
+	app::ImportSettings import;
+	bool benchmarkBuffers;
+	bool benchmarkCodecs;
+	bool benchmarkGLTF;
+	std::vector<std::string> inputs;
+};
+
+// Peak resident memory of the process in bytes
+static size_t getPeakMemory()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#if defined(__APPLE__)
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+// Bytes copied on the heap to get the payload of every library buffer, read in storage & mapped.
+// Copies are counted by BufferFile as they happen, files without header are read in storage on both paths.
+static void benchmarkBuffers(const app::ImportCache& cache)
+{
+	std::map<std::string, std::string> buffers = cache.getBuffers();
+	size_t fileCount = 0;
+	size_t fileBytes = 0;
+	uint8_t checksum = 0;
+	// Pages are touched as an upload from the mapping would read them.
+	auto map = [&]() {
+		size_t copied = app::BufferFile::copiedBytes();
+		for (auto& buffer : buffers)
+		{
+			app::BufferFile file;
+			if (file.open(aka::Path(buffer.second.c_str())))
+			{
+				// Compressed files are decompressed on the heap, counted as copies.
+				std::vector<app::ChunkedPayload::Chunk> chunks;
+				bool valid = file.split(chunks);
+				for (const app::ChunkedPayload::Chunk& chunk : chunks)
+					valid = valid && app::ChunkedPayload::decompress(chunk);
+				for (size_t offset = 0; valid && offset < file.size(); offset += 4096)
+					checksum ^= file.data()[offset];
+				continue;
+			}
+			aka::BufferStorage storage;
+			if (app::BufferFile::load(aka::Path(buffer.second.c_str()), storage) && !storage.bytes.empty())
+				checksum ^= storage.bytes[0];
+		}
+		return app::BufferFile::copiedBytes() - copied;
+	};
+	auto read = [&]() {
+		size_t copied = app::BufferFile::copiedBytes();
+		fileCount = 0;
+		fileBytes = 0;
+		for (auto& buffer : buffers)
+		{
+			aka::BufferStorage storage;
+			if (!app::BufferFile::load(aka::Path(buffer.second.c_str()), storage))
+				continue;
+			fileCount++;
+			fileBytes += storage.bytes.size();
+		}
+		return app::BufferFile::copiedBytes() - copied;
+	};
+	// Both modes are timed with files in the page cache.
+	map();
+	auto start = std::chrono::steady_clock::now();
+	size_t storageCopied = read();
+	double storageMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	size_t mappedCopied = map();
+	double mappedMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	aka::Logger::info("Buffer load benchmark over ", fileCount, " files of ", fileBytes, " payload bytes (checksum ", (uint32_t)checksum, ")");
+	aka::Logger::info("\tStorage : ", storageCopied, " bytes copied, ", fileCount > 0 ? storageCopied / fileCount : 0, " per load, ", storageMilliseconds, "ms");
+	aka::Logger::info("\tMapped : ", mappedCopied, " bytes copied, ", fileCount > 0 ? mappedCopied / fileCount : 0, " per load, ", mappedMilliseconds, "ms");
+}
+
+static const char* getCodecName(app::Codec codec)
+{
+	switch (codec)
+	{
+	case app::Codec::LZ4: return "lz4";
+	case app::Codec::Zstd: return "zstd";
+	default: return "none";
+	}
+}
+
+static bool parseCodec(const char* name, app::Codec& codec)
+{
+	for (app::Codec value : { app::Codec::None, app::Codec::LZ4, app::Codec::Zstd })
+	{
+		if (strcmp(name, getCodecName(value)) == 0)
+		{
+			codec = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Stored size & load time of every library buffer & texture written with each codec.
+// Files are written to a temporary directory & loaded as the library loader does : mapped & split on workers,
+// then every chunk decompressed on workers. Files are in the page cache, so load time is decompression & page faults, not disk reads.
+static void benchmarkCodecs(const app::ImportCache& cache)
+{
+	std::vector<aka::BufferStorage> buffers;
+	std::vector<app::TextureData> textures;
+	for (auto& buffer : cache.getBuffers())
+	{
+		aka::BufferStorage storage;
+		if (app::BufferFile::load(aka::Path(buffer.second.c_str()), storage))
+			buffers.push_back(std::move(storage));
+	}
+	for (auto& texture : cache.getTextures())
+	{
+		app::TextureData data;
+		if (app::TextureFile::load(aka::Path(texture.second.c_str()), data))
+			textures.push_back(std::move(data));
+	}
+	std::error_code error;
+	std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "aka-codecs";
+	std::filesystem::create_directories(directory, error);
+	size_t fileCount = buffers.size() + textures.size();
+	auto getPath = [&](size_t i) {
+		return aka::Path((directory / (std::to_string(i) + (i < buffers.size() ? ".buffer" : ".tex"))).string().c_str());
+	};
+	app::WorkerPool pool;
+	aka::Logger::info("Codec benchmark over ", buffers.size(), " buffers & ", textures.size(), " textures, ", pool.count(), " workers");
+	for (app::Codec codec : { app::Codec::None, app::Codec::LZ4, app::Codec::Zstd })
+	{
+		std::atomic<uint32_t> failed(0);
+		pool.parallelFor(fileCount, [&](size_t i) {
+			bool saved = (i < buffers.size()) ? app::BufferFile::save(getPath(i), buffers[i], codec) : app::TextureFile::save(getPath(i), textures[i - buffers.size()], codec);
+			if (!saved)
+				failed++;
+		});
+		size_t storedBytes = 0;
+		for (size_t i = 0; i < fileCount; i++)
+			storedBytes += (size_t)std::filesystem::file_size(getPath(i).cstr(), error);
+
+		auto start = std::chrono::steady_clock::now();
+		std::vector<app::BufferFile> bufferFiles(buffers.size());
+		std::vector<app::TextureFile> textureFiles(textures.size());
+		std::vector<std::vector<app::ChunkedPayload::Chunk>> fileChunks(fileCount);
+		std::atomic<uint8_t> checksum(0);
+		pool.parallelFor(fileCount, [&](size_t i) {
+			bool valid = false;
+			const uint8_t* data = nullptr;
+			size_t size = 0;
+			if (i < buffers.size())
+			{
+				valid = bufferFiles[i].open(getPath(i)) && bufferFiles[i].split(fileChunks[i]);
+				data = bufferFiles[i].data();
+				size = bufferFiles[i].size();
+			}
+			else
+			{
+				valid = textureFiles[i - buffers.size()].open(getPath(i)) && textureFiles[i - buffers.size()].split(fileChunks[i]);
+			}
+			// Raw buffers are uploaded from the mapping, pages are touched as the upload would read them.
+			uint8_t touched = 0;
+			for (size_t offset = 0; valid && codec == app::Codec::None && data != nullptr && offset < size; offset += 4096)
+				touched ^= data[offset];
+			checksum ^= touched;
+			if (!valid)
+				failed++;
+		});
+		std::vector<app::ChunkedPayload::Chunk> chunks;
+		for (const std::vector<app::ChunkedPayload::Chunk>& file : fileChunks)
+			chunks.insert(chunks.end(), file.begin(), file.end());
+		pool.parallelFor(chunks.size(), [&](size_t i) {
+			if (!app::ChunkedPayload::decompress(chunks[i]))
+				failed++;
+		});
+		pool.parallelFor(textureFiles.size(), [&](size_t i) {
+			if (textureFiles[i].validate())
+				textureFiles[i].decode();
+			else
+				failed++;
+		});
+		double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		size_t payloadBytes = 0;
+		for (const app::BufferFile& file : bufferFiles)
+			payloadBytes += file.size();
+		for (const app::TextureFile& file : textureFiles)
+			payloadBytes += file.size();
+		aka::Logger::info("\t", getCodecName(codec), " : ", storedBytes, " bytes stored for ", payloadBytes, " payload bytes (",
+			payloadBytes > 0 ? 100.0 * storedBytes / payloadBytes : 0.0, "%), loaded in ", milliseconds, "ms (",
+			milliseconds > 0.0 ? payloadBytes / (milliseconds * 1000.0) : 0.0, " MB/s), ", chunks.size(), " chunks, ", (uint32_t)failed, " failures, checksum ", (uint32_t)checksum);
+	}
+	std::filesystem::remove_all(directory, error);
+}
+
+// Time of the glTF inputs read by the native loader & by assimp, then baked from scratch each way.
+// Reads convert meshes to triangle lists, the part of an import the native loader replaces. Bakes also weld, optimize,
+// build LODs & meshlets & convert textures, shared by both paths, in a temporary library with an empty cache.
+// Best of 3 runs, files are in the page cache.
+static void benchmarkGLTF(const std::vector<std::filesystem::path>& files, const app::ImportSettings& import)
+{
+	const uint32_t runCount = 3;
+	auto measure = [&](const std::function<bool(void)>& run) -> double {
+		double best = 0.0;
+		for (uint32_t i = 0; i < runCount; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			if (!run())
+				return -1.0;
+			double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			best = (i == 0) ? milliseconds : std::min(best, milliseconds);
+		}
+		return best;
+	};
+	std::error_code error;
+	std::filesystem::path project = std::filesystem::current_path(error);
+	std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "aka-gltf";
+	std::filesystem::create_directories(directory, error);
+	std::filesystem::current_path(directory, error);
+	double totals[4] = {};
+	uint32_t sceneCount = 0;
+	aka::Logger::info("glTF benchmark, native loader against assimp, best of ", runCount, " runs");
+	for (const std::filesystem::path& file : files)
+	{
+		aka::Path path(file.string().c_str());
+		if (!app::GLTF::supports(path))
+			continue;
+		size_t vertexCount = 0;
+		double readNative = measure([&]() { return (vertexCount = app::Importer::readSceneMeshes(path, true)) > 0; });
+		double readAssimp = measure([&]() { return app::Importer::readSceneMeshes(path, false) > 0; });
+		double bakes[2];
+		for (bool native : { true, false })
+		{
+			app::ImportSettings settings = import;
+			settings.nativeGLTF = native;
+			bakes[native ? 0 : 1] = measure([&]() {
+				std::filesystem::remove_all("library", error);
+				std::filesystem::create_directories("library", error);
+				app::ImportCache cache("library/import.json");
+				return app::Importer::bakeScene(path, cache, settings);
+			});
+		}
+		if (readNative < 0.0 || readAssimp < 0.0 || bakes[0] < 0.0 || bakes[1] < 0.0)
+		{
+			aka::Logger::warn("	", file.filename().string(), " : not read or baked by both paths, skipped");
+			continue;
+		}
+		aka::Logger::info("	", file.filename().string(), " : ", vertexCount, " vertices, read ", readNative, "ms native / ", readAssimp, "ms assimp (",
+			readAssimp / std::max(readNative, 0.001), "x), bake ", bakes[0], "ms native / ", bakes[1], "ms assimp (", bakes[1] / std::max(bakes[0], 0.001), "x)");
+		totals[0] += readNative;
+		totals[1] += readAssimp;
+		totals[2] += bakes[0];
+		totals[3] += bakes[1];
+		sceneCount++;
+	}
+	aka::Logger::info("	Total over ", sceneCount, " scenes : read ", totals[1] / std::max(totals[0], 0.001), "x faster, bake ", totals[3] / std::max(totals[2], 0.001), "x faster");
+	std::filesystem::current_path(project, error);
+	std::filesystem::remove_all(directory, error);
+}
+
+// Scene formats handled by assimp that are worth baking
+static bool isScene(const std::filesystem::path& path)
+{
+	std::string extension = path.extension().string();
+	for (char& c : extension)
+		c = (char)tolower(c);
+	for (const char* supported : { ".gltf", ".glb", ".obj", ".fbx", ".dae", ".3ds", ".blend", ".ply" })
+		if (extension == supported)
+			return true;
+	return false;
+}
+
+bool parse(int argc, char* argv[], Settings& settings)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--help") == 0)
+		{
+			std::cout << std::endl << "Usage : " << std::endl;
+			std::cout << "\t" << argv[0] << " [options] <file|directory>..." << std::endl;
+			std::cout << "Bake scenes assets into the library without opening a window." << std::endl;
+			std::cout << "Options are :" << std::endl;
+			std::cout << "\t" << "--help                  Print this message and exit.\n" << std::endl;
+			std::cout << "\t" << "-d | --directory <dir>  Project directory containing the library (./)." << std::endl;
+			std::cout << "\t" << "-j | --jobs <int>       Number of scenes imported in parallel (hardware threads)." << std::endl;
+			std::cout << "\t" << "--pack-vertices         Store packed vertices." << std::endl;
+			std::cout << "\t" << "--lods <int>            Number of LODs generated per mesh (3)." << std::endl;
+			std::cout << "\t" << "--no-meshlets           Do not split meshes in meshlets." << std::endl;
+			std::cout << "\t" << "--depth-stream          Store a position only stream for shadow passes." << std::endl;
+			std::cout << "\t" << "--assimp                Read glTF with assimp instead of the native loader." << std::endl;
+			std::cout << "\t" << "--block-compression     Store material textures in BC1, BC3, BC5 & BC7." << std::endl;
+			std::cout << "\t" << "--buffer-codec <codec>  Codec of library buffers, none, lz4 or zstd (none)." << std::endl;
+			std::cout << "\t" << "--texture-codec <codec> Codec of library textures, none, lz4 or zstd (none)." << std::endl;
+			std::cout << "\t" << "--benchmark-buffers     Report bytes copied to load library buffers, with or without mapping." << std::endl;
+			std::cout << "\t" << "--benchmark-codecs      Report stored size & load time of library buffers & textures for each codec." << std::endl;
+			std::cout << "\t" << "--benchmark-gltf        Report read & bake time of the glTF inputs with the native loader & with assimp." << std::endl;
+			std::cout << std::endl;
+			return false;
+		}
+		else if (strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0)
+		{
+			if (i == argc - 1)
+			{
+				aka::Logger::warn("No arguments for jobs");
+				return false;
+			}
+			try {
+				settings.jobs = std::max(1, std::stoi(argv[++i]));
+			} catch (const std::exception&) { aka::Logger::error("Could not parse integer for ", argv[i - 1]); }
+		}
+		else if (strcmp(argv[i], "--directory") == 0 || strcmp(argv[i], "-d") == 0)
+		{
+			if (i == argc - 1)
+			{
+				aka::Logger::warn("No arguments for directory");
+				return false;
+			}
+			settings.directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--lods") == 0)
+		{
+			if (i == argc - 1)
+			{
+				aka::Logger::warn("No arguments for lods");
+				return false;
+			}
+			try {
+				settings.import.lodCount = (uint32_t)std::stoi(argv[++i]);
+			} catch (const std::exception&) { aka::Logger::error("Could not parse integer for ", argv[i - 1]); }
+		}
+		else if (strcmp(argv[i], "--pack-vertices") == 0)
+		{
+			settings.import.packVertices = true;
+		}
+		else if (strcmp(argv[i], "--no-meshlets") == 0)
+		{
+			settings.import.buildMeshlets = false;
+		}
+		else if (strcmp(argv[i], "--depth-stream") == 0)
+		{
+			settings.import.depthStream = true;
+		}
+		else if (strcmp(argv[i], "--assimp") == 0)
+		{
+			settings.import.nativeGLTF = false;
+		}
+		else if (strcmp(argv[i], "--block-compression") == 0)
+		{
+			settings.import.blockCompression = true;
+		}
+		else if (strcmp(argv[i], "--buffer-codec") == 0 || strcmp(argv[i], "--texture-codec") == 0)
+		{
+			if (i == argc - 1)
+			{
+				aka::Logger::warn("No arguments for ", argv[i]);
+				return false;
+			}
+			app::Codec& codec = (strcmp(argv[i], "--buffer-codec") == 0) ? settings.import.bufferCodec : settings.import.textureCodec;
+			if (!parseCodec(argv[++i], codec))
+			{
+				aka::Logger::error("Unknown codec ", argv[i], " for ", argv[i - 1]);
+				return false;
+			}
+		}
+		else if (strcmp(argv[i], "--benchmark-buffers") == 0)
+		{
+			settings.benchmarkBuffers = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-codecs") == 0)
+		{
+			settings.benchmarkCodecs = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-gltf") == 0)
+		{
+			settings.benchmarkGLTF = true;
+		}
+		else
+		{
+			settings.inputs.push_back(argv[i]);
+		}
+	}
+	if (settings.inputs.empty() && !settings.benchmarkBuffers && !settings.benchmarkCodecs)
+	{
+		aka::Logger::error("No input to import, see --help");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	Settings settings{};
+	settings.jobs = std::max(1U, std::thread::hardware_concurrency());
+	settings.directory = "./";
+
+	if (!parse(argc, argv, settings))
+		return 1;
+
+	// Inputs are resolved before moving to the project directory
+	std::vector<std::filesystem::path> files;
+	for (const std::string& input : settings.inputs)
+	{
+		std::error_code error;
+		std::filesystem::path path = std::filesystem::absolute(input, error);
+		if (std::filesystem::is_directory(path, error))
+		{
+			for (const std::filesystem::directory_entry& entry : std::filesystem::recursive_directory_iterator(path, error))
+				if (entry.is_regular_file() && isScene(entry.path()))
+					files.push_back(entry.path());
+		}
+		else if (std::filesystem::is_regular_file(path, error))
+		{
+			files.push_back(path);
+		}
+		else
+		{
+			aka::Logger::error("Input not found : ", input);
+			return 1;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::current_path(settings.directory.cstr(), error);
+	if (error)
+	{
+		aka::Logger::error("Invalid project directory : ", settings.directory);
+		return 1;
+	}
+	std::filesystem::create_directories("library", error);
+
+	app::ImportCache cache("library/import.json");
+	cache.load();
+
+	// Peak memory is process wide, shared by concurrent bakes, so it is only reported for the run.
+	struct Result {
+		bool success;
+		double milliseconds;
+	};
+	std::vector<Result> results(files.size());
+	std::atomic<uint32_t> failed(0);
+	auto start = std::chrono::steady_clock::now();
+	{
+		app::WorkerPool pool(std::min<uint32_t>(settings.jobs, (uint32_t)std::max<size_t>(files.size(), 1)));
+		pool.parallelFor(files.size(), [&](size_t i) {
+			auto begin = std::chrono::steady_clock::now();
+			bool success = app::Importer::bakeScene(aka::Path(files[i].string().c_str()), cache, settings.import);
+			auto end = std::chrono::steady_clock::now();
+			results[i] = Result{ success, std::chrono::duration<double, std::milli>(end - begin).count() };
+			aka::Logger::info(success ? "Baked " : "Failed to bake ", files[i].string(), " in ", results[i].milliseconds, "ms");
+			if (!success)
+				failed++;
+		});
+	}
+	double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (!cache.save())
+	{
+		aka::Logger::error("Failed to save import cache");
+		return 1;
+	}
+	aka::Logger::info("Baked ", files.size() - failed, "/", files.size(), " scenes in ", total, "ms, peak memory ", getPeakMemory() / (1024 * 1024), "MB");
+	if (settings.benchmarkBuffers)
+		benchmarkBuffers(cache);
+	if (settings.benchmarkCodecs)
+		benchmarkCodecs(cache);
+	if (settings.benchmarkGLTF)
+		benchmarkGLTF(files, settings.import);
+	return failed > 0 ? 1 : 0;
+}
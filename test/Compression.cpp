@@ -0,0 +1,136 @@
+#include "Model/Compression.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace app;
+
+static int failures = 0;
+
+static void check(bool condition, const char* test, size_t size)
+{
+	if (condition)
+		return;
+	printf("%s failed for %zu bytes\n", test, size);
+	failures++;
+}
+
+// Compress then decompress, output must match input & fit in the bound
+template <typename Compressor>
+static void roundTrip(const std::vector<uint8_t>& input)
+{
+	std::vector<uint8_t> compressed(Compressor::compressBound(input.size()));
+	size_t compressedSize = Compressor::compress(input.data(), input.size(), compressed.data(), compressed.size());
+	check(compressedSize > 0, "Compress", input.size());
+	std::vector<uint8_t> output(input.size() + 1);
+	size_t outputSize = Compressor::decompress(compressed.data(), compressedSize, output.data(), input.size());
+	check(outputSize == input.size() && std::equal(input.begin(), input.end(), output.begin()), "Round trip", input.size());
+	// Too small destinations are reported, never overflowed
+	if (compressedSize > 1)
+		check(Compressor::compress(input.data(), input.size(), compressed.data(), compressedSize - 1) == 0, "Compress capacity", input.size());
+	if (input.size() > 0)
+		check(Compressor::decompress(compressed.data(), compressedSize, output.data(), input.size() - 1) == 0, "Decompress capacity", input.size());
+}
+
+// Corrupted & truncated payloads must fail or decode within bounds
+template <typename Compressor>
+static void corrupt(std::mt19937& rng)
+{
+	std::vector<uint8_t> input(64 * 1024);
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = (uint8_t)(rng() % 16);
+	std::vector<uint8_t> compressed(Compressor::compressBound(input.size()));
+	size_t compressedSize = Compressor::compress(input.data(), input.size(), compressed.data(), compressed.size());
+	std::vector<uint8_t> output(input.size());
+	for (uint32_t test = 0; test < 2000; test++)
+	{
+		std::vector<uint8_t> corrupted(compressed.begin(), compressed.begin() + compressedSize);
+		corrupted[rng() % corrupted.size()] ^= (uint8_t)(1 << (rng() % 8));
+		size_t size = rng() % (corrupted.size() + 1);
+		check(Compressor::decompress(corrupted.data(), size, output.data(), output.size()) <= output.size(), "Corrupted block", size);
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(42);
+	// Random, low entropy, repeated at a short offset (overlapping matches) & long runs (length continuations)
+	for (uint32_t test = 0; test < 400; test++)
+	{
+		size_t size = test < 32 ? test : rng() % (test % 16 == 0 ? 200000 : 4000);
+		std::vector<uint8_t> input(size);
+		for (size_t i = 0; i < size; i++)
+		{
+			switch (test % 4)
+			{
+			case 0: input[i] = (uint8_t)rng(); break;
+			case 1: input[i] = (uint8_t)(rng() % 4); break;
+			case 2: input[i] = (i >= 7 && rng() % 8 != 0) ? input[i - 7] : (uint8_t)rng(); break;
+			default: input[i] = (uint8_t)((i / 300) % 3); break;
+			}
+		}
+		roundTrip<LZ4>(input);
+		roundTrip<Zstd>(input);
+	}
+
+	// Block compressed by the reference liblz4 1.9.4 (LZ4_compress_default)
+	const char* text = "Aka asset pack chunk. Aka asset pack chunk. aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa end of chunk.";
+	const uint8_t reference[] = {
+		0xff, 0x07, 0x41, 0x6b, 0x61, 0x20, 0x61, 0x73, 0x73, 0x65, 0x74, 0x20, 0x70, 0x61, 0x63, 0x6b,
+		0x20, 0x63, 0x68, 0x75, 0x6e, 0x6b, 0x2e, 0x20, 0x16, 0x00, 0x03, 0x1f, 0x61, 0x01, 0x00, 0x18,
+		0xe0, 0x20, 0x65, 0x6e, 0x64, 0x20, 0x6f, 0x66, 0x20, 0x63, 0x68, 0x75, 0x6e, 0x6b, 0x2e,
+	};
+	std::vector<uint8_t> output(strlen(text));
+	size_t outputSize = LZ4::decompress(reference, sizeof(reference), output.data(), output.size());
+	check(outputSize == strlen(text) && memcmp(output.data(), text, outputSize) == 0, "Reference block", strlen(text));
+
+	// Frame compressed by the reference libzstd 1.5.4 (ZSTD_compress, level 19), with Huffman coded literals
+	const char* frameText = "Library buffers hold vertices, indices and quantization of imported meshes. Library textures hold every mip level "
+		"of imported images. Both are compressed in chunks decompressed in parallel on workers.";
+	const uint8_t referenceFrame[] = {
+		0x28, 0xb5, 0x2f, 0xfd, 0x20, 0xc8, 0x0d, 0x04, 0x00, 0x32, 0x89, 0x1a, 0x11, 0x90, 0x7d, 0x50,
+		0xfa, 0x43, 0xe9, 0x43, 0xb3, 0xd9, 0x1e, 0xe9, 0x2c, 0xc2, 0x4d, 0xee, 0x90, 0x03, 0x81, 0xce,
+		0x67, 0x13, 0x62, 0x7f, 0xd0, 0xdb, 0xb7, 0x46, 0x26, 0x89, 0x7f, 0x9c, 0xb2, 0x67, 0x95, 0xf1,
+		0xb7, 0xfc, 0x3c, 0x8d, 0x0e, 0x1a, 0xff, 0x49, 0x5c, 0x55, 0x28, 0x12, 0x71, 0xab, 0xfd, 0xfd,
+		0xe6, 0x71, 0x39, 0xd7, 0xf3, 0xef, 0xff, 0xb4, 0x35, 0x7f, 0xf5, 0x40, 0x5f, 0xd1, 0x77, 0x7e,
+		0xbe, 0x4e, 0x18, 0xdd, 0x72, 0x04, 0xfd, 0xc1, 0x55, 0xc9, 0x5e, 0xf5, 0x11, 0x2b, 0xfd, 0x3c,
+		0xe2, 0xe7, 0x2d, 0x07, 0xf4, 0xcd, 0xaa, 0xf3, 0xaf, 0x9f, 0x06, 0x95, 0xd3, 0xf9, 0x08, 0xd9,
+		0xe2, 0x7a, 0x92, 0x59, 0xd6, 0x08, 0x07, 0x00, 0x74, 0xca, 0x0b, 0x80, 0x0f, 0x02, 0xa2, 0xeb,
+		0xa9, 0x50, 0xe4, 0xed, 0x27, 0xd0, 0x13, 0x83, 0xf2, 0x04,
+	};
+	output.resize(strlen(frameText));
+	outputSize = Zstd::decompress(referenceFrame, sizeof(referenceFrame), output.data(), output.size());
+	check(outputSize == strlen(frameText) && memcmp(output.data(), frameText, outputSize) == 0, "Reference frame", strlen(frameText));
+
+	corrupt<LZ4>(rng);
+	corrupt<Zstd>(rng);
+
+	// Chunked payloads, with a last partial chunk & an incompressible chunk stored raw
+	std::vector<uint8_t> raw(ChunkedPayload::chunkSize * 3 + 1234);
+	for (size_t i = 0; i < raw.size(); i++)
+		raw[i] = i < ChunkedPayload::chunkSize ? (uint8_t)rng() : (uint8_t)((i / 100) % 5);
+	for (Codec codec : { Codec::LZ4, Codec::Zstd })
+	{
+		uint32_t chunkCount = ChunkedPayload::getChunkCount(raw.size());
+		std::vector<std::vector<uint8_t>> compressedChunks;
+		for (uint32_t i = 0; i < chunkCount; i++)
+			compressedChunks.push_back(ChunkedPayload::compress(codec, raw.data(), raw.size(), i));
+		std::vector<uint8_t> payload = ChunkedPayload::join(compressedChunks);
+		std::vector<uint8_t> decompressed(raw.size());
+		std::vector<ChunkedPayload::Chunk> chunks;
+		bool ok = ChunkedPayload::split(codec, payload.data(), payload.size(), decompressed.data(), decompressed.size(), chunks) && chunks.size() == chunkCount;
+		for (const ChunkedPayload::Chunk& chunk : chunks)
+			ok = ChunkedPayload::decompress(chunk) && ok;
+		check(ok && decompressed == raw && payload.size() < raw.size(), "Chunked payload", raw.size());
+		chunks.clear();
+		check(!ChunkedPayload::split(codec, payload.data(), payload.size() - 1, decompressed.data(), decompressed.size(), chunks), "Truncated payload", raw.size());
+	}
+
+	if (failures > 0)
+		return 1;
+	printf("Compression tests passed\n");
+	return 0;
+}